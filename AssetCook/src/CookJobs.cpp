@@ -0,0 +1,218 @@
+#include "CookJobs.h"
+#include "Data/CookedMesh.h"
+#include "Data/CookedTexture.h"
+#include "Data/MeshImporter.h"
+
+#include <d3dcompiler.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+	//File types assimp imports that we use, and texture types the texture loaders read. DDS textures are already as
+	//they load, and cooked files are never cooked again
+	const char* const kMeshExtensions[]    = { ".x", ".fbx", ".obj", ".3ds", ".dae", ".gltf", ".glb", ".blend", ".ply", ".ms3d", ".md5mesh" };
+	const char* const kTextureExtensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".tif", ".tiff", ".gif" };
+
+	//Shader profiles by the end of a shader's name, as the Engine project chooses its shader type
+	const std::pair<const char*, const char*> kShaderTargets[] =
+	{
+		{ "_vs.hlsl", "vs_5_0" }, { "_ps.hlsl", "ps_5_0" }, { "_gs.hlsl", "gs_5_0" },
+		{ "_hs.hlsl", "hs_5_0" }, { "_ds.hlsl", "ds_5_0" }, { "_cs.hlsl", "cs_5_0" },
+	};
+
+	bool EndsWith(const std::string& text, const char* ending)
+	{
+		const size_t length = std::char_traits<char>::length(ending);
+		return text.size() >= length && text.compare(text.size() - length, length, ending) == 0;
+	}
+
+	template <size_t N>
+	bool HasExtension(const std::string& lowerName, const char* const (&extensions)[N])
+	{
+		return std::any_of(extensions, extensions + N, [&](const char* extension) { return EndsWith(lowerName, extension); });
+	}
+
+	CookJob MakeJob(CookKind kind, const std::string& source, const std::string& output)
+	{
+		CookJob job;
+		job.Kind = kind;
+		job.Source = source;
+		job.Output = output;
+		return job;
+	}
+
+	//The jobs for one file, none if it isn't an asset that is cooked
+	void AddJobs(const std::string& fileName, const CookOptions& options, std::vector<CookJob>& jobs)
+	{
+		std::string lowerName = fileName;
+		for (char& c : lowerName)  c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+		if (HasExtension(lowerName, kMeshExtensions))
+		{
+			for (bool tangents : { false, true })
+			{
+				if (tangents && !options.MeshTangents)  continue;
+				CookJob job = MakeJob(CookKind::Mesh, fileName, CookedMeshFileName(fileName, tangents));
+				job.Settings = "mesh " + std::to_string(kCookedMeshVersion) + (tangents ? " tangents" : "");
+				job.Tangents = tangents;
+				jobs.push_back(job);
+			}
+		}
+		else if (HasExtension(lowerName, kTextureExtensions))
+		{
+			CookJob job = MakeJob(CookKind::Texture, fileName, CookedTextureFileName(fileName));
+			job.Settings = "texture " + std::to_string(kCookedTextureVersion) + (options.BlockCompressTextures ? " bc" : "");
+			job.BlockCompress = options.BlockCompressTextures;
+			jobs.push_back(job);
+		}
+		else
+		{
+			for (const auto& [ending, target] : kShaderTargets)
+			{
+				if (!EndsWith(lowerName, ending))  continue;
+				CookJob job = MakeJob(CookKind::Shader, fileName, fileName.substr(0, fileName.size() - 5) + ".cso");
+				job.Target = target;
+				job.Settings = "shader " + job.Target + " main" + (job.Target == "vs_5_0" ? " WX" : "") + " d3dcompiler " + std::to_string(D3D_COMPILER_VERSION);
+				jobs.push_back(job);
+			}
+		}
+	}
+
+	//Opens the files a shader includes, relative to the file including them as fxc does, and keeps their names
+	class RecordingInclude : public ID3DInclude
+	{
+	public:
+		explicit RecordingInclude(const std::string& shaderFileName) : m_Folder(std::filesystem::path(shaderFileName).parent_path()) {}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+		{
+			auto parent = m_Folders.find(parentData);
+			const std::filesystem::path path = ((parent != m_Folders.end() ? parent->second : m_Folder) / fileName).lexically_normal();
+
+			std::ifstream file(path, std::ios::binary);
+			if (!file)  return E_FAIL;
+			m_Contents.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+			//Recorded even if it is included again, duplicates are removed at the end
+			m_FileNames.push_back(path.generic_string());
+			*data = m_Contents.back().data();
+			*bytes = static_cast<UINT>(m_Contents.back().size());
+			m_Folders[*data] = path.parent_path();
+			return S_OK;
+		}
+
+		//The contents are kept until the shader is compiled
+		HRESULT __stdcall Close(LPCVOID) override { return S_OK; }
+
+		std::vector<std::string> FileNames() const
+		{
+			std::vector<std::string> fileNames = m_FileNames;
+			std::sort(fileNames.begin(), fileNames.end());
+			fileNames.erase(std::unique(fileNames.begin(), fileNames.end()), fileNames.end());
+			return fileNames;
+		}
+
+	private:
+		std::filesystem::path                         m_Folder;
+		std::list<std::string>                        m_Contents; //A list so the contents stay where they are
+		std::map<const void*, std::filesystem::path>  m_Folders;  //Of each file opened, by its contents
+		std::vector<std::string>                      m_FileNames;
+	};
+
+	//Compile a shader to its byte code
+	std::vector<std::string> CookShader(const CookJob& job)
+	{
+		UINT flags = 0;
+		if (job.Target == "vs_5_0")  flags |= D3DCOMPILE_WARNINGS_ARE_ERRORS;
+
+		RecordingInclude include(job.Source);
+		ID3DBlob* code = nullptr;
+		ID3DBlob* errors = nullptr;
+		HRESULT result = D3DCompileFromFile(std::filesystem::path(job.Source).c_str(), nullptr, &include, "main", job.Target.c_str(), flags, 0, &code, &errors);
+
+		std::string messages;
+		if (errors)
+		{
+			messages.assign(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize());
+			errors->Release();
+		}
+		if (FAILED(result))
+		{
+			if (code)  code->Release();
+			throw std::runtime_error("Can't compile shader " + job.Source + "\n" + messages);
+		}
+
+		const bool saved = SaveCookedFile(job.Output, code->GetBufferPointer(), code->GetBufferSize());
+		code->Release();
+		if (!saved)  throw std::runtime_error("Can't write " + job.Output);
+		return include.FileNames();
+	}
+}
+
+//Every asset that can be cooked in the given files and folders
+std::vector<CookJob> FindCookJobs(const std::vector<std::string>& inputs, const CookOptions& options)
+{
+	std::vector<CookJob> jobs;
+	for (const auto& input : inputs)
+	{
+		if (std::filesystem::is_directory(input))
+		{
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+			{
+				if (entry.is_regular_file())  AddJobs(entry.path().generic_string(), options, jobs);
+			}
+		}
+		else if (std::filesystem::is_regular_file(input))
+		{
+			AddJobs(input, options, jobs);
+		}
+		else
+		{
+			throw std::runtime_error("No file or folder " + input);
+		}
+	}
+	std::sort(jobs.begin(), jobs.end(), [](const CookJob& a, const CookJob& b) { return a.Output < b.Output; });
+	return jobs;
+}
+
+//Cook an asset
+std::vector<std::string> CookAsset(const CookJob& job)
+{
+	switch (job.Kind)
+	{
+	case CookKind::Mesh:
+	{
+		//The cooked mesh is stamped with its source, which the engine checks as it loads it (see CookedMesh::IsCurrent)
+		const CookedMeshSource source = GetCookedMeshSource(job.Source);
+		if (!SaveCookedMesh(job.Output, CookMesh(ImportMesh(job.Source, job.Tangents), source)))  throw std::runtime_error("Can't write " + job.Output);
+		return {};
+	}
+
+	case CookKind::Texture:
+		CookTexture(job.Source, job.BlockCompress);
+		return {};
+
+	case CookKind::Shader:
+		return CookShader(job);
+	}
+	return {};
+}
+
+//Stamp an asset's cooked file with its source's new size and time
+bool RestampCookedAsset(const CookJob& job, const CookInput& source)
+{
+	const CookedMeshSource stamp = { source.Size, source.Time };
+	switch (job.Kind)
+	{
+	case CookKind::Mesh:     return RestampCookedMesh(job.Output, stamp);
+	case CookKind::Texture:  return RestampCookedTexture(job.Source, stamp);
+	case CookKind::Shader:   return true; //Compiled shaders aren't stamped
+	}
+	return false;
+}
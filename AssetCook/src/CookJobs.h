@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// Cook jobs - the assets AssetCook finds, and cooking each of them
+//--------------------------------------------------------------------------------------
+// Meshes are imported as Mesh imports them (ImportMesh) and saved as cooked meshes, with and
+// without tangents. Textures are decoded as CResourceManager decodes them and saved as DDS
+// files with their mip-maps (CookTexture). Shaders are compiled as the Engine project compiles
+// them: entry point main, shader model 5.0, warnings as errors for vertex shaders. Each cooked
+// file is written where the engine looks for it, next to its source.
+
+#pragma once
+#include "Data/CookManifest.h"
+#include <string>
+#include <vector>
+
+enum class CookKind { Mesh, Texture, Shader };
+
+//Options that change how assets are cooked
+struct CookOptions
+{
+	bool MeshTangents          = true;  //Cook meshes with tangents as well as without
+	bool BlockCompressTextures = false; //Cook textures to BC1 or BC3 rather than as they decode
+};
+
+//An asset to cook
+struct CookJob
+{
+	CookKind    Kind = CookKind::Mesh;
+	std::string Source;
+	std::string Output;   //The cooked file
+	std::string Settings; //Everything other than the source that changes the cooked file (see CookRecord)
+	bool        Tangents = false;
+	bool        BlockCompress = false;
+	std::string Target;   //Shader profile, e.g. vs_5_0
+};
+
+//Every asset that can be cooked in the given files and folders (and the folders in them), sorted by cooked file
+//Throws a std::runtime_error if one of them isn't there
+std::vector<CookJob> FindCookJobs(const std::vector<std::string>& inputs, const CookOptions& options);
+
+//Cook an asset. Returns any files it used other than its source, e.g. the files a shader includes
+//Throws a std::runtime_error if it can't be cooked
+std::vector<std::string> CookAsset(const CookJob& job);
+
+//Stamp an asset's cooked file with the size and time its source has now, for a source saved again or checked out afresh
+//without changes, so the engine still takes the cooked file (see CookedMesh::IsCurrent). Returns false if it can't be,
+//and then the asset is cooked again
+bool RestampCookedAsset(const CookJob& job, const CookInput& source);
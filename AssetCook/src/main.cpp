@@ -0,0 +1,193 @@
+//--------------------------------------------------------------------------------------
+// AssetCook - cooks meshes, textures and shaders ahead of time, only those that have changed
+//--------------------------------------------------------------------------------------
+// Run from the folder the game runs in, passing the folders of assets to cook, e.g.
+//
+//     AssetCook ../Media Src/Shaders
+//
+// Each asset found is cooked next to its source, as the engine looks for it (see CookJobs.h),
+// on every core at once. A manifest (see CookManifest.h) records what each cooked file was made
+// from, so running again only cooks the assets whose source, included files or cook settings
+// have changed, or whose cooked file has gone. With nothing to cook a run only looks at the size
+// and time of each file.
+
+#include "CookJobs.h"
+#include "Data/CookManifest.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::vector<std::string> inputs;
+		std::string              manifest = "AssetCook.manifest";
+		CookOptions              cook;
+		bool                     force = false; //Cook everything, whatever the manifest says
+	};
+
+	//Save the manifest at least this often while cooking, so stopping a long cook part way doesn't lose what was done
+	const double kSaveSeconds = 10.0;
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: AssetCook <file or folder>... [--manifest <file>] [--force] [--compress-textures] [--no-tangents]\n"
+		             "  --manifest           where to keep what has been cooked, AssetCook.manifest by default\n"
+		             "  --force              cook every asset, even those that are up to date\n"
+		             "  --compress-textures  block compress textures (BC1, or BC3 with alpha)\n"
+		             "  --no-tangents        don't cook meshes with tangents, only without\n";
+	}
+
+	double SecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//Size of a job's source, to start the largest first so one big asset doesn't finish the cook on its own
+	uint64_t SourceSize(const CookJob& job)
+	{
+		std::error_code error;
+		const auto size = std::filesystem::file_size(job.Source, error);
+		return error ? 0 : static_cast<uint64_t>(size);
+	}
+
+	int Cook(const Options& options)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<CookJob> jobs = FindCookJobs(options.inputs, options.cook);
+
+		//Find which assets are out of date. Records are looked up first, as only checking them is safe across threads
+		CookManifest manifest;
+		if (!manifest.Load(options.manifest) && !options.force)  std::cout << "No usable manifest " << options.manifest << ", cooking everything\n";
+		std::vector<CookRecord*> records(jobs.size());
+		for (size_t i = 0; i < jobs.size(); ++i)  records[i] = manifest.Find(jobs[i].Output);
+
+		std::vector<char> current(jobs.size(), 0);
+		if (!options.force)
+		{
+			ThreadPool::Get().ParallelFor(0, static_cast<int>(jobs.size()), 16, [&](int begin, int end)
+			{
+				for (int i = begin; i < end; ++i)
+				{
+					if (!records[i] || records[i]->Inputs.empty())  continue;
+					const int64_t sourceTime = records[i]->Inputs.front().Time;
+					current[i] = CookManifest::IsCurrent(jobs[i].Output, *records[i], jobs[i].Settings);
+
+					//A source saved again or checked out afresh without changes. The engine goes by the source's size and
+					//time stamped in the cooked file, so it takes the new time too
+					const CookInput& source = records[i]->Inputs.front();
+					if (current[i] && source.Time != sourceTime)  current[i] = RestampCookedAsset(jobs[i], source);
+				}
+			});
+		}
+
+		std::vector<std::pair<uint64_t, const CookJob*>> bySize;
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			if (!current[i])  bySize.emplace_back(SourceSize(jobs[i]), &jobs[i]);
+		}
+		std::stable_sort(bySize.begin(), bySize.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+		std::vector<const CookJob*> stale;
+		for (const auto& job : bySize)  stale.push_back(job.second);
+
+		if (stale.empty())
+		{
+			manifest.Save(options.manifest); //Keeps the times of files saved again without changes, so they aren't hashed again
+			std::cout << "All " << jobs.size() << " assets up to date (" << std::fixed << std::setprecision(3) << SecondsSince(start) << "s)\n";
+			return 0;
+		}
+		std::cout << "Cooking " << stale.size() << " of " << jobs.size() << " assets on " << ThreadPool::Get().NumThreads() << " threads\n";
+
+		//Cook every core's worth at once. The manifest, output and errors are shared, each asset is cooked on its own
+		std::mutex mutex;
+		auto lastSave = std::chrono::steady_clock::now();
+		int numCooked = 0;
+		std::vector<std::string> errors;
+		ThreadPool::Get().ParallelFor(0, static_cast<int>(stale.size()), 1, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				const CookJob& job = *stale[i];
+				const auto cookStart = std::chrono::steady_clock::now();
+				try
+				{
+					//The source is read before it is cooked, so if it changes while cooking it is cooked again next time
+					CookRecord record;
+					record.Settings = job.Settings;
+					record.Inputs.emplace_back();
+					if (!ReadCookInput(job.Source, record.Inputs.back()))  throw std::runtime_error("Can't read " + job.Source);
+
+					for (const auto& fileName : CookAsset(job))
+					{
+						record.Inputs.emplace_back();
+						if (!ReadCookInput(fileName, record.Inputs.back()))  throw std::runtime_error("Can't read " + fileName + ", used by " + job.Source);
+					}
+
+					std::lock_guard<std::mutex> lock(mutex);
+					manifest.Set(job.Output, std::move(record));
+					std::cout << "[" << ++numCooked << "/" << stale.size() << "] " << job.Output << " (" << std::fixed << std::setprecision(2)
+					          << SecondsSince(cookStart) << "s)\n";
+					if (SecondsSince(lastSave) > kSaveSeconds)
+					{
+						//If it can't be saved now it is tried again at the end, which reports the error
+						try { manifest.Save(options.manifest); }
+						catch (const std::exception&) {}
+						lastSave = std::chrono::steady_clock::now();
+					}
+				}
+				catch (const std::exception& e)
+				{
+					//Forgotten, so it is cooked again next time even if nothing changes
+					std::lock_guard<std::mutex> lock(mutex);
+					manifest.Remove(job.Output);
+					errors.push_back(e.what());
+					std::cerr << "Failed " << job.Output << ": " << e.what() << "\n";
+				}
+			}
+		});
+		manifest.Save(options.manifest);
+
+		std::cout << "Cooked " << numCooked << " assets, " << errors.size() << " failed (" << std::fixed << std::setprecision(1) << SecondsSince(start) << "s)\n";
+		return errors.empty() ? 0 : 1;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	bool unknownOption = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if      (argument == "--force")              options.force = true;
+		else if (argument == "--compress-textures")  options.cook.BlockCompressTextures = true;
+		else if (argument == "--no-tangents")        options.cook.MeshTangents = false;
+		else if (argument == "--manifest" && i + 1 < argc)  options.manifest = argv[++i];
+		else if (argument.rfind("--", 0) == 0)       unknownOption = true; //Including --manifest without a file
+		else                                         options.inputs.push_back(argument);
+	}
+	if (options.inputs.empty() || unknownOption)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		return Cook(options);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "AssetCook: " << e.what() << "\n";
+		return 1;
+	}
+}
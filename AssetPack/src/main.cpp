@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// AssetPack - packs asset files into an archive the engine loads from (see AssetArchive.h)
+//--------------------------------------------------------------------------------------
+// Run from the folder the game runs in, passing files and folders as the game names them, so the
+// names in the archive match what the engine asks for:
+//
+//     AssetPack Assets.pak ../Media Src/Shaders
+//
+// Folders are packed with everything in them. Cooked meshes and compiled shaders are stored as
+// they are, so the engine uses them straight from the mapped archive. Other assets are LZ4
+// compressed when that saves at least an eighth of them.
+
+#include "Data/AssetArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string              archive;
+		std::vector<std::string> inputs;
+		bool                     store  = false; //Compress nothing
+		bool                     verify = false; //Read every asset back and compare it to its file
+		bool                     list   = false; //List an archive instead of packing one
+	};
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: AssetPack <archive> <file or folder>... [--store] [--verify]\n"
+		             "       AssetPack --list <archive>\n"
+		             "  --store   store every asset as it is, none are compressed\n"
+		             "  --verify  read every asset back from the archive and compare it with its file\n";
+	}
+
+	//True for assets the engine reads in place, which must be stored as they are to be used from the mapping
+	bool UsedInPlace(const std::string& fileName)
+	{
+		auto endsWith = [&](const char* ending) { const size_t n = std::strlen(ending);  return fileName.size() >= n && fileName.compare(fileName.size() - n, n, ending) == 0; };
+		return endsWith(".cmesh") || endsWith(".cso");
+	}
+
+	//Every file to pack, with folders expanded, sorted so archives come out the same each time
+	std::vector<std::string> FindFiles(const std::vector<std::string>& inputs)
+	{
+		std::vector<std::string> files;
+		for (const auto& input : inputs)
+		{
+			if (std::filesystem::is_directory(input))
+			{
+				for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+				{
+					//Names as the engine uses them: relative to where the game runs, with the folder as it was given
+					if (entry.is_regular_file() && entry.path().extension() != ".part")  files.push_back(entry.path().generic_string());
+				}
+			}
+			else if (std::filesystem::is_regular_file(input))
+			{
+				files.push_back(input);
+			}
+			else
+			{
+				throw std::runtime_error("No file or folder " + input);
+			}
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	//Read a whole file from disk
+	std::vector<unsigned char> ReadFile(const std::string& fileName)
+	{
+		AssetData data;
+		if (!ReadAsset(fileName, data))  throw std::runtime_error("Can't read " + fileName);
+		return std::vector<unsigned char>(data.Data(), data.Data() + data.Size());
+	}
+
+	void Pack(const Options& options)
+	{
+		const std::vector<std::string> files = FindFiles(options.inputs);
+		AssetArchiveWriter writer(options.archive);
+		uint64_t totalSize = 0;
+		int numCompressed = 0;
+		for (const auto& fileName : files)
+		{
+			const std::vector<unsigned char> data = ReadFile(fileName);
+			totalSize += data.size();
+			if (writer.Add(fileName, data.data(), data.size(), !options.store && !UsedInPlace(fileName)))  ++numCompressed;
+		}
+		writer.Finish();
+
+		std::cout << "Packed " << files.size() << " files (" << numCompressed << " compressed), " << totalSize / 1024 << " KB into "
+		          << writer.Size() / 1024 << " KB: " << options.archive << "\n";
+
+		if (!options.verify)  return;
+		AssetArchive archive;
+		archive.Open(options.archive);
+		for (const auto& fileName : files)
+		{
+			AssetData packed;
+			const std::vector<unsigned char> data = ReadFile(fileName);
+			if (!archive.Read(fileName, packed) || packed.Size() != data.size() || !std::equal(data.begin(), data.end(), packed.Data()))
+			{
+				throw std::runtime_error("Asset " + fileName + " doesn't match its file in the archive");
+			}
+		}
+		std::cout << "Verified " << files.size() << " assets\n";
+	}
+
+	void List(const std::string& fileName)
+	{
+		AssetArchive archive;
+		if (!archive.Open(fileName))  throw std::runtime_error("No archive " + fileName);
+
+		for (unsigned int asset = 0; asset < archive.NumberAssets(); ++asset)
+		{
+			const AssetArchiveEntry& entry = archive.Entry(asset);
+			std::cout << std::setw(12) << entry.Size << std::setw(12) << entry.StoredSize << (entry.Compression == kAssetLz4 ? "  lz4     " : "  stored  ")
+			          << archive.Name(entry) << "\n";
+		}
+		std::cout << archive.NumberAssets() << " assets, " << archive.Size() / 1024 << " KB\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if      (argument == "--store")   options.store = true;
+		else if (argument == "--verify")  options.verify = true;
+		else if (argument == "--list")    options.list = true;
+		else if (options.archive.empty()) options.archive = argument;
+		else                              options.inputs.push_back(argument);
+	}
+	if (options.archive.empty() || (!options.list && options.inputs.empty()))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		if (options.list)  List(options.archive);
+		else               Pack(options);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "AssetPack: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
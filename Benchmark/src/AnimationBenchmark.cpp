@@ -0,0 +1,267 @@
+//--------------------------------------------------------------------------------------
+// Animation: sampling compressed clips for many instances
+//--------------------------------------------------------------------------------------
+// The obvious sampler keeps every imported key, slerps rotations and builds each node's
+// matrix from three matrix products. AnimationClip keeps reduced, quantised keys and samples
+// every instance of a rig in one batch straight into the local matrices TransformHierarchy
+// works from. Checks the quantisation, the reduction and the batch against the full keys.
+
+#include "Benchmark.h"
+#include "Math/AnimationClip.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float kFramesPerSecond = 30.0f;
+	const float kDuration        = 2.0f;
+
+	//Angle between the rotations of two unit quaternions, from the distance between them as acos is too coarse near 1
+	float RotationAngle(const CQuaternion& q1, const CQuaternion& q2)
+	{
+		float sign = Dot(q1, q2) < 0.0f ? -1.0f : 1.0f;
+		CQuaternion d(q1.x - q2.x * sign, q1.y - q2.y * sign, q1.z - q2.z * sign, q1.w - q2.w * sign);
+		return 4.0f * std::asin(std::min(std::sqrt(Dot(d, d)) * 0.5f, 1.0f));
+	}
+
+	//Keys at every frame for each node but the root, the way a file exported from an animation package has them:
+	//some tracks never change, some move in straight lines and the rest follow smooth curves
+	std::vector<AnimationChannelKeys> MakeChannels(unsigned int numNodes, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f), speed(1.0f, 4.0f);
+		std::vector<AnimationChannelKeys> channels;
+		for (unsigned int node = 1; node < numNodes; ++node)
+		{
+			AnimationChannelKeys keys;
+			keys.Node = node;
+			CVector3 offset(unit(random), unit(random), unit(random)), direction(unit(random), unit(random), unit(random));
+			CVector3 axis = Normalise(CVector3(unit(random), unit(random), unit(random)));
+			float frequency = speed(random), phase = unit(random) * 3.0f;
+			int kind = node % 4;
+
+			for (float frame = 0; frame <= kDuration * kFramesPerSecond; ++frame)
+			{
+				float time = frame / kFramesPerSecond;
+				float wave = std::sin(time * frequency + phase);
+				keys.PositionTimes.push_back(time);
+				keys.Positions.push_back(kind == 0 ? offset : kind == 1 ? offset + direction * time : offset + direction * wave);
+				keys.RotationTimes.push_back(time);
+				keys.Rotations.push_back(QuaternionFromAxisAngle(axis, kind == 0 ? 0.3f : wave * 1.5f));
+				keys.ScaleTimes.push_back(time);
+				keys.Scales.push_back(kind == 3 ? CVector3(1, 1, 1) * (1.0f + 0.2f * wave) : CVector3(1, 1, 1));
+			}
+			channels.push_back(std::move(keys));
+		}
+		return channels;
+	}
+
+	//Value of a full track at a time, the nearest key outside the keys
+	template <class Value, class Interpolate>
+	Value SampleTrack(const std::vector<float>& times, const std::vector<Value>& values, float time, Interpolate interpolate)
+	{
+		size_t key = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+		if (key == 0)  return values.front();
+		if (key == times.size())  return values.back();
+		float t = (time - times[key - 1]) / (times[key] - times[key - 1]);
+		return interpolate(values[key - 1], values[key], t);
+	}
+
+	CVector3 Lerp(const CVector3& v1, const CVector3& v2, float t) { return v1 + (v2 - v1) * t; }
+
+	//The obvious sampler: every key kept, slerp, and the matrix built from separate scaling, rotation and translation
+	void SampleFullKeys(const std::vector<AnimationChannelKeys>& channels, float time, CMatrix4x4* localMatrices)
+	{
+		time = std::fmod(time, kDuration);
+		for (const auto& keys : channels)
+		{
+			CVector3 position = SampleTrack(keys.PositionTimes, keys.Positions, time, Lerp);
+			CQuaternion rotation = SampleTrack(keys.RotationTimes, keys.Rotations, time, Slerp);
+			CVector3 scale = SampleTrack(keys.ScaleTimes, keys.Scales, time, Lerp);
+			localMatrices[keys.Node] = MatrixScaling(scale) * MatrixFromQuaternion(rotation) * MatrixTranslation(position);
+		}
+	}
+
+	void CheckQuantisation(std::mt19937& random)
+	{
+		std::normal_distribution<float> normal;
+		std::vector<CQuaternion> rotations = { { 1, 0, 0, 0 }, { 0, -1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, -1 }, { 0.5f, 0.5f, 0.5f, 0.5f },
+		                                       { 0.70710678f, 0, 0, -0.70710678f } };
+		for (int i = 0; i < 10000; ++i)  rotations.push_back(Normalise(CQuaternion(normal(random), normal(random), normal(random), normal(random))));
+
+		for (const CQuaternion& rotation : rotations)
+		{
+			CQuaternion result = DequantiseRotation(QuantiseRotation(rotation));
+			if (std::abs(Dot(result, result) - 1.0f) > 1e-4f || RotationAngle(result, rotation) > 2e-4f)
+			{
+				throw std::runtime_error("Quantised rotation doesn't match the original");
+			}
+			CQuaternion negated = DequantiseRotation(QuantiseRotation({ -rotation.x, -rotation.y, -rotation.z, -rotation.w }));
+			if (RotationAngle(negated, rotation) > 2e-4f)  throw std::runtime_error("Quantised rotation of -q doesn't match q");
+		}
+	}
+
+	void CheckReduction()
+	{
+		//One node: constant, then moving in a straight line, then along a curve
+		AnimationChannelKeys keys;
+		keys.Node = 0;
+		for (float frame = 0; frame <= 60; ++frame)
+		{
+			keys.PositionTimes.push_back(frame / kFramesPerSecond);
+			keys.Positions.push_back({ 1, 2, 3 });
+			keys.RotationTimes.push_back(frame / kFramesPerSecond);
+			keys.Rotations.push_back(QuaternionFromAxisAngle({ 0, 1, 0 }, 0.5f));
+			keys.ScaleTimes.push_back(frame / kFramesPerSecond);
+			keys.Scales.push_back({ 2, 2, 2 });
+		}
+		if (AnimationClip("constant", kDuration, 1, { keys }).NumberKeys() != 3)  throw std::runtime_error("Constant tracks weren't reduced to one key");
+
+		for (size_t key = 0; key < keys.Positions.size(); ++key)  keys.Positions[key] = CVector3(1, 2, 3) * keys.PositionTimes[key];
+		if (AnimationClip("linear", kDuration, 1, { keys }).NumberKeys() != 4)  throw std::runtime_error("Straight line wasn't reduced to two keys");
+
+		for (size_t key = 0; key < keys.Positions.size(); ++key)  keys.Positions[key] = CVector3(std::sin(keys.PositionTimes[key] * 3.0f), 0, 0);
+		AnimationClip curve("curve", kDuration, 1, { keys });
+		if (curve.NumberKeys() <= 4 || curve.NumberKeys() >= 63)  throw std::runtime_error("Curve wasn't reduced to a few keys");
+
+		//Bad input
+		auto throws = [](const std::vector<AnimationChannelKeys>& channels, unsigned int numNodes)
+		{
+			return Throws([&] { AnimationClip clip("bad", kDuration, numNodes, channels); });
+		};
+		AnimationChannelKeys unsorted = keys, empty = keys;
+		std::swap(unsorted.ScaleTimes[3], unsorted.ScaleTimes[4]);
+		empty.RotationTimes.clear();
+		empty.Rotations.clear();
+		if (!throws({ keys }, 0) || !throws({ keys, keys }, 1) || !throws({ unsorted }, 1) || !throws({ empty }, 1))
+		{
+			throw std::runtime_error("AnimationClip accepted bad keys");
+		}
+	}
+
+	//Reduced clip against the full keys, at the keys, between them, and before and after the clip
+	void CheckSampling(const AnimationClip& clip, const std::vector<AnimationChannelKeys>& channels, const AnimationCompression& compression)
+	{
+		std::vector<float> times;
+		for (float frame = -30; frame <= 90; frame += 0.25f)  times.push_back(frame / kFramesPerSecond);
+		for (int channel = 0; channel < clip.NumberChannels(); ++channel)
+		{
+			const AnimationChannelKeys& keys = channels[clip.ChannelNode(channel) - 1];
+			for (float time : times)
+			{
+				float wrapped = std::fmod(time, kDuration);
+				if (wrapped < 0.0f)  wrapped += kDuration;
+				CVector3 position, scale;
+				CQuaternion rotation;
+				clip.SampleChannel(channel, time, position, rotation, scale);
+
+				//Between two kept keys the error can be a little over the tolerance at the keys
+				if (Length(position - SampleTrack(keys.PositionTimes, keys.Positions, wrapped, Lerp)) > compression.PositionTolerance * 2 ||
+				    Length(scale - SampleTrack(keys.ScaleTimes, keys.Scales, wrapped, Lerp)) > compression.ScaleTolerance * 2 ||
+				    RotationAngle(rotation, SampleTrack(keys.RotationTimes, keys.Rotations, wrapped, Slerp)) > compression.RotationTolerance * 2)
+				{
+					throw std::runtime_error("Compressed clip doesn't match the full keys at " + std::to_string(time) + "s");
+				}
+			}
+		}
+	}
+
+	//Batch against one channel at a time, nodes without channels untouched, the same across threads
+	void CheckBatch(const AnimationClip& clip, ThreadPool& singleThread, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> time(-5.0f, 5.0f);
+		const unsigned int numNodes = clip.NumberNodes();
+		for (int numInstances : { 0, 1, 7, 300 })
+		{
+			std::vector<float> times(numInstances);
+			for (float& t : times)  t = time(random);
+			std::vector<CMatrix4x4> pooled((numInstances + 1) * numNodes, MatrixScaling(2.0f)), single = pooled;
+			clip.Sample(times.data(), numInstances, pooled.data());
+			clip.Sample(times.data(), numInstances, single.data(), &singleThread);
+			if (std::memcmp(pooled.data(), single.data(), pooled.size() * sizeof(CMatrix4x4)) != 0)
+			{
+				throw std::runtime_error("Sampling across the thread pool doesn't match a single thread");
+			}
+
+			std::vector<CMatrix4x4> expected = pooled;
+			for (int instance = 0; instance <= numInstances; ++instance)
+			{
+				for (unsigned int node = 0; node < numNodes; ++node)  expected[instance * numNodes + node] = MatrixScaling(2.0f);
+			}
+			for (int instance = 0; instance < numInstances; ++instance)
+			{
+				for (int channel = 0; channel < clip.NumberChannels(); ++channel)
+				{
+					CVector3 position, scale;
+					CQuaternion rotation;
+					clip.SampleChannel(channel, times[instance], position, rotation, scale);
+					expected[instance * numNodes + clip.ChannelNode(channel)] = MatrixFromTransform(position, rotation, scale);
+				}
+			}
+			for (size_t i = 0; i < expected.size(); ++i)
+			{
+				for (int e = 0; e < 16; ++e)
+				{
+					if (std::abs((&pooled[i].e00)[e] - (&expected[i].e00)[e]) > 1e-5f)  throw std::runtime_error("Batch sampling doesn't match sampling each channel");
+				}
+			}
+		}
+	}
+}
+
+void RunAnimationBenchmark()
+{
+	std::mt19937 random(42);
+	ThreadPool singleThread(0);
+	CheckQuantisation(random);
+	CheckReduction();
+
+	//A 64 node rig with a 2 second clip at 30 frames a second
+	const unsigned int numNodes = 64;
+	std::vector<AnimationChannelKeys> channels = MakeChannels(numNodes, random);
+	AnimationCompression compression;
+	AnimationClip clip("clip", kDuration, numNodes, channels, compression);
+	CheckSampling(clip, channels, compression);
+	CheckBatch(clip, singleThread, random);
+
+	size_t fullKeys = 0, fullBytes = 0;
+	for (const auto& keys : channels)
+	{
+		fullKeys += keys.PositionTimes.size() + keys.RotationTimes.size() + keys.ScaleTimes.size();
+		fullBytes += keys.PositionTimes.size() * (sizeof(float) + sizeof(CVector3)) + keys.RotationTimes.size() * (sizeof(float) + sizeof(CQuaternion)) +
+		             keys.ScaleTimes.size() * (sizeof(float) + sizeof(CVector3));
+	}
+	std::cout << "  " << fullKeys << " keys (" << fullBytes / 1024 << " KB) reduced to " << clip.NumberKeys() << " keys ("
+	          << clip.KeyBytes() / 1024 << " KB)" << std::endl;
+
+	//A crowd, each character at its own point in the clip
+	const int numInstances = 2048;
+	std::uniform_real_distribution<float> startTime(0.0f, kDuration);
+	std::vector<float> times(numInstances);
+	for (float& t : times)  t = startTime(random);
+	std::vector<CMatrix4x4> local(numInstances * numNodes, MatrixIdentity());
+
+	double full = TimeBestOf(10, [&]
+	{
+		for (int instance = 0; instance < numInstances; ++instance)  SampleFullKeys(channels, times[instance], &local[instance * numNodes]);
+		DoNotOptimise(local.data());
+	});
+	double batchSingle = TimeBestOf(10, [&] { clip.Sample(times.data(), numInstances, local.data(), &singleThread);  DoNotOptimise(local.data()); });
+	double batch = TimeBestOf(10, [&] { clip.Sample(times.data(), numInstances, local.data());  DoNotOptimise(local.data()); });
+
+	const double numChannels = static_cast<double>(numInstances) * clip.NumberChannels();
+	ReportThroughput("Full keys and slerp, 2K x 63 channels", full, numChannels, "channels");
+	ReportThroughput("Compressed clip, 1 thread", batchSingle, numChannels, "channels");
+	ReportThroughput("Compressed clip, shared thread pool", batch, numChannels, "channels");
+	std::cout << "  Instances sampled per millisecond: " << std::fixed << std::setprecision(0) << numInstances / full << " full keys, "
+	          << numInstances / batchSingle << " compressed on 1 thread, " << numInstances / batch << " on the thread pool" << std::endl;
+	ReportComparison("2K instances, full keys -> compressed batch", full, batch);
+}
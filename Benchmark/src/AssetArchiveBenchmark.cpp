@@ -0,0 +1,295 @@
+//--------------------------------------------------------------------------------------
+// Asset archives: loading assets from one mapped archive rather than loose files
+//--------------------------------------------------------------------------------------
+// The resource manager checked each file was there then opened and read it, one file system
+// trip after another. Assets can now come from an archive built by AssetPack, mapped once
+// and searched in memory. Many small assets are packed, then checking for and reading each
+// as a loose file is timed against finding and reading it in the archive. Also times LZ4
+// decompression, which compressed assets go through, and checks the compressor and decoder
+// round trip every kind of data, that the decoder refuses corrupt blocks rather than
+// writing past its output, and that archives are searched, read in place and checked.
+
+#include "Benchmark.h"
+#include "Data/AssetArchive.h"
+#include "Utility/Lz4.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//Data like an asset's: text, runs of one byte, repeated blocks with a few changes and noise, each a fair share
+	std::vector<unsigned char> MakeAssetLike(size_t size, std::mt19937& random)
+	{
+		static const char* const kWords[] = { "vertex ", "normal ", "float4 ", "texture ", "position ", "return ", "= ", "0.5f; ", "\n" };
+		std::vector<unsigned char> data;
+		data.reserve(size);
+		while (data.size() < size)
+		{
+			switch (random() % 4)
+			{
+			case 0:
+				for (int i = 0; i < 32; ++i)
+				{
+					for (const char* c = kWords[random() % 9]; *c; ++c)  data.push_back(static_cast<unsigned char>(*c));
+				}
+				break;
+			case 1:
+				data.insert(data.end(), random() % 300, static_cast<unsigned char>(random()));
+				break;
+			case 2:
+				if (data.size() > 64)
+				{
+					const size_t start = random() % (data.size() - 64);
+					for (size_t i = 0; i < 64; ++i)  data.push_back(i % 16 == 0 ? static_cast<unsigned char>(random()) : data[start + i]);
+				}
+				break;
+			default:
+				for (int i = 0; i < 64; ++i)  data.push_back(static_cast<unsigned char>(random()));
+			}
+		}
+		data.resize(size);
+		return data;
+	}
+
+	//Compress and decompress, the result must match. Returns the compressed size
+	size_t RoundTrip(const std::vector<unsigned char>& data, const std::string& kind)
+	{
+		const std::vector<unsigned char> compressed = CompressLz4(data.data(), data.size());
+		std::vector<unsigned char> output(data.size() + 1, 0xcd);
+		if (!DecompressLz4(compressed.data(), compressed.size(), output.data(), data.size()) ||
+		    !std::equal(data.begin(), data.end(), output.begin()) || output[data.size()] != 0xcd)
+		{
+			throw std::runtime_error("LZ4 didn't round trip " + kind + " data of " + std::to_string(data.size()) + " bytes");
+		}
+		return compressed.size();
+	}
+
+	void CheckLz4()
+	{
+		std::mt19937 random(3);
+		for (size_t size : { 0, 1, 4, 5, 12, 13, 15, 16, 17, 100, 270, 4096, 65536, 65536 + 300, 1000000 })
+		{
+			std::vector<unsigned char> noise(size), zeros(size, 0), counting(size);
+			for (size_t i = 0; i < size; ++i)
+			{
+				noise[i] = static_cast<unsigned char>(random());
+				counting[i] = static_cast<unsigned char>(i / 7);
+			}
+			RoundTrip(noise, "random");
+			RoundTrip(counting, "counting");
+			RoundTrip(MakeAssetLike(size, random), "asset like");
+			const size_t zerosSize = RoundTrip(zeros, "zero");
+			if (size >= 1000 && zerosSize > size / 100)  throw std::runtime_error("LZ4 didn't compress a run of zeros");
+		}
+
+		//A block made by hand: 3 literals "abc", then a match of 9 at offset 3 (overlapping what it writes), then "xy"
+		const unsigned char block[] = { 0x35, 'a', 'b', 'c', 3, 0, 0x20, 'x', 'y' };
+		const std::string expected = "abcabcabcabcxy";
+		std::string output(expected.size(), '\0');
+		if (!DecompressLz4(block, sizeof(block), &output[0], output.size()) || output != expected)
+		{
+			throw std::runtime_error("LZ4 didn't decompress a block made by hand");
+		}
+
+		//The most a block can hold, which archives check compressed sizes against
+		const std::vector<unsigned char> zeros(1 << 20, 0);
+		if (CompressLz4(zeros.data(), zeros.size()).size() * kLz4MaxRatio < zeros.size())  throw std::runtime_error("LZ4 decompressed past kLz4MaxRatio");
+
+		//Damaged blocks must fail, not write outside the output
+		const std::vector<unsigned char> data = MakeAssetLike(20000, random);
+		const std::vector<unsigned char> compressed = CompressLz4(data.data(), data.size());
+		std::vector<unsigned char> guarded(data.size() + 64, 0xcd);
+		auto check = [&](const std::vector<unsigned char>& damaged, size_t outputSize, bool mayPass)
+		{
+			std::fill(guarded.begin(), guarded.end(), 0xcd);
+			const bool passed = DecompressLz4(damaged.data(), damaged.size(), guarded.data(), outputSize);
+			if (passed && !mayPass)  throw std::runtime_error("LZ4 decompressed a damaged block");
+			for (size_t i = outputSize; i < guarded.size(); ++i)
+			{
+				if (guarded[i] != 0xcd)  throw std::runtime_error("LZ4 wrote past its output decompressing a damaged block");
+			}
+		};
+		for (size_t cut : { size_t(1), size_t(2), compressed.size() / 2, compressed.size() - 1 })
+		{
+			check(std::vector<unsigned char>(compressed.begin(), compressed.begin() + cut), data.size(), false);
+		}
+		check(compressed, data.size() - 1, false);
+		check(compressed, data.size() + 1, false);
+		const unsigned char badOffset[] = { 0x10, 'a', 2, 0 }; //Copies from before the start
+		check(std::vector<unsigned char>(badOffset, badOffset + sizeof(badOffset)), 8, false);
+
+		//Flipped bytes may still decode into something, but never outside the output
+		for (int i = 0; i < 2000; ++i)
+		{
+			std::vector<unsigned char> damaged = compressed;
+			damaged[random() % damaged.size()] ^= static_cast<unsigned char>(1 + random() % 255);
+			check(damaged, data.size(), true);
+		}
+	}
+
+	void CheckArchive(const std::filesystem::path& folder)
+	{
+		if (NormaliseAssetName("..\\Media\\Stone.JPG") != "../media/stone.jpg" || NormaliseAssetName("./Src//Shaders/./Tint_ps.cso") != "src/shaders/tint_ps.cso" ||
+		    NormaliseAssetName("/Root\\x") != "/root/x" || NormaliseAssetName("") != "")
+		{
+			throw std::runtime_error("NormaliseAssetName didn't normalise a name");
+		}
+
+		std::mt19937 random(5);
+		const std::string fileName = (folder / "Check.pak").string();
+		const std::vector<unsigned char> text = MakeAssetLike(10000, random), noise = [&] { std::vector<unsigned char> n(5000); for (auto& b : n) b = static_cast<unsigned char>(random()); return n; }();
+		{
+			AssetArchiveWriter writer(fileName);
+			if (!writer.Add("../Media/Text.txt", text.data(), text.size()))  throw std::runtime_error("AssetArchiveWriter didn't compress text");
+			if (writer.Add("../Media/Noise.bin", noise.data(), noise.size()))  throw std::runtime_error("AssetArchiveWriter compressed noise");
+			writer.Add("Src/Shaders/Stored.cso", text.data(), text.size(), false);
+			writer.Add("Empty", nullptr, 0);
+			writer.Finish();
+		}
+
+		AssetArchive archive;
+		if (!archive.Open(fileName) || archive.NumberAssets() != 4)  throw std::runtime_error("AssetArchive didn't open an archive");
+		AssetData data;
+		if (!archive.Read("..\\media\\TEXT.txt", data) || data.IsMapped() || data.Size() != text.size() || !std::equal(text.begin(), text.end(), data.Data()))
+		{
+			throw std::runtime_error("AssetArchive didn't read a compressed asset");
+		}
+		if (!archive.Read("src/shaders/stored.cso", data) || !data.IsMapped() || data.Size() != text.size() ||
+		    !std::equal(text.begin(), text.end(), data.Data()) || reinterpret_cast<uintptr_t>(data.Data()) % kAssetAlignment != 0)
+		{
+			throw std::runtime_error("AssetArchive didn't read a stored asset in place");
+		}
+		if (!archive.Read("../Media/Noise.bin", data) || !data.IsMapped() || !std::equal(noise.begin(), noise.end(), data.Data()))
+		{
+			throw std::runtime_error("AssetArchive didn't read an asset that wasn't worth compressing");
+		}
+		if (!archive.Read("Empty", data) || data.Size() != 0 || archive.Contains("Text.txt") || archive.Contains("../Media/Text.tx"))
+		{
+			throw std::runtime_error("AssetArchive found the wrong assets");
+		}
+
+		//Two assets of the same name are refused, and nothing is left behind
+		const std::string twiceName = (folder / "Twice.pak").string();
+		if (!Throws([&] { AssetArchiveWriter writer(twiceName); writer.Add("A", "a", 1); writer.Add("a", "b", 1); writer.Finish(); }) ||
+		    std::filesystem::exists(twiceName))
+		{
+			throw std::runtime_error("AssetArchiveWriter accepted an asset twice");
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(folder))
+		{
+			if (entry.path().extension() == ".part")  throw std::runtime_error("AssetArchiveWriter left its part file behind");
+		}
+
+		//A missing archive isn't an error, a damaged one is, as is a cut short one
+		archive.Close();
+		if (archive.Open((folder / "Missing.pak").string()))  throw std::runtime_error("AssetArchive opened a missing archive");
+		std::vector<char> bytes(std::filesystem::file_size(fileName));
+		std::ifstream(fileName, std::ios::binary).read(bytes.data(), bytes.size());
+		auto damage = [&](size_t offset, size_t size)
+		{
+			std::vector<char> damaged(bytes.begin(), bytes.begin() + size);
+			if (offset < size)  damaged[offset] ^= 0x40;
+			WriteFile((folder / "Damaged.pak").string(), damaged.data(), damaged.size());
+			return Throws([&] { archive.Open((folder / "Damaged.pak").string()); }) && !archive.IsOpen();
+		};
+		AssetArchiveHeader header;
+		std::copy(bytes.begin(), bytes.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+		if (!damage(0, bytes.size()) || !damage(4, bytes.size()) || !damage(bytes.size(), bytes.size() - 1) ||
+		    !damage(static_cast<size_t>(header.EntriesOffset), bytes.size()) || !damage(static_cast<size_t>(header.NamesOffset), bytes.size()))
+		{
+			throw std::runtime_error("AssetArchive opened a damaged archive");
+		}
+
+		//A compressed asset claiming more than its bytes can decompress to, which would be allocated before it is decompressed
+		for (unsigned int asset = 0; asset < header.NumAssets; ++asset)
+		{
+			AssetArchiveEntry entry;
+			char* entryBytes = bytes.data() + header.EntriesOffset + asset * sizeof(entry);
+			std::copy(entryBytes, entryBytes + sizeof(entry), reinterpret_cast<char*>(&entry));
+			if (entry.Compression != kAssetLz4)  continue;
+
+			entry.Size = entry.StoredSize * kLz4MaxRatio + 1;
+			std::copy(reinterpret_cast<const char*>(&entry), reinterpret_cast<const char*>(&entry) + sizeof(entry), entryBytes);
+			if (!damage(bytes.size(), bytes.size()))  throw std::runtime_error("AssetArchive opened an archive with an impossible compressed size");
+		}
+	}
+}
+
+void RunAssetArchiveBenchmark()
+{
+	const TempFolder temp("EngineAssetArchiveBenchmark");
+	const std::filesystem::path& folder = temp.Path();
+	std::filesystem::create_directories(folder / "Media");
+
+	CheckLz4();
+	CheckArchive(folder);
+
+	//Many small assets, as loose files and packed. Stored as they are, the usual case for cooked meshes and shaders
+	const int numAssets = 2000;
+	std::mt19937 random(7);
+	std::vector<std::string> names;
+	size_t totalSize = 0;
+	{
+		AssetArchiveWriter writer((folder / "Assets.pak").string());
+		for (int i = 0; i < numAssets; ++i)
+		{
+			const std::vector<unsigned char> data = MakeAssetLike(1000 + random() % 16000, random);
+			const std::string name = (folder / "Media" / ("Asset" + std::to_string(i) + ".bin")).generic_string();
+			WriteFile(name, data.data(), data.size());
+			writer.Add(name, data.data(), data.size(), false);
+			names.push_back(name);
+			totalSize += data.size();
+		}
+		writer.Finish();
+	}
+	std::shuffle(names.begin(), names.end(), random);
+
+	//As the resource manager loads them: see whether the file is there, then read it
+	auto loadAll = [&]
+	{
+		size_t read = 0;
+		for (const auto& name : names)
+		{
+			AssetData data;
+			if (!AssetExists(name) || !ReadAsset(name, data))  throw std::runtime_error("Can't load asset " + name);
+			read += data.Size();
+			DoNotOptimise(data.Data());
+		}
+		if (read != totalSize)  throw std::runtime_error("Assets read weren't the size written");
+	};
+	const double looseTime = TimeBestOf(5, loadAll);
+	if (!AssetArchive::Get().Open((folder / "Assets.pak").string()))  throw std::runtime_error("Can't open the asset archive");
+	const double archiveTime = TimeBestOf(5, loadAll);
+
+	//Only finding them, without touching their bytes
+	const double findTime = TimeBestOf(5, [&]
+	{
+		for (const auto& name : names)  DoNotOptimise(AssetArchive::Get().Find(name));
+	});
+	AssetArchive::Get().Close();
+
+	ReportThroughput("Loose files, exists + read", looseTime, numAssets, "assets");
+	ReportThroughput("Archive, exists + read in place", archiveTime, numAssets, "assets");
+	ReportComparison("Loading from the archive", looseTime, archiveTime);
+	ReportThroughput("Archive, find", findTime, numAssets, "finds");
+
+	//Compression of asset like data, and the cost of decompressing it when read
+	const std::vector<unsigned char> data = MakeAssetLike(16 << 20, random);
+	std::vector<unsigned char> compressed;
+	const double compressTime = TimeBestOf(3, [&] { compressed = CompressLz4(data.data(), data.size()); });
+	std::vector<unsigned char> output(data.size());
+	const double decompressTime = TimeBestOf(5, [&]
+	{
+		if (!DecompressLz4(compressed.data(), compressed.size(), output.data(), output.size()))  throw std::runtime_error("LZ4 didn't decompress");
+	});
+	if (output != data)  throw std::runtime_error("LZ4 decompressed the wrong data");
+	ReportValue("LZ4 compressed size", static_cast<double>(compressed.size()) / data.size(), "of the original");
+	ReportThroughput("LZ4 compress", compressTime, static_cast<double>(data.size()), "B");
+	ReportThroughput("LZ4 decompress", decompressTime, static_cast<double>(data.size()), "B");
+}
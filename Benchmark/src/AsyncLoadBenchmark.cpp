@@ -0,0 +1,283 @@
+//--------------------------------------------------------------------------------------
+// Async loading: loading many assets at once through a LoadQueue
+//--------------------------------------------------------------------------------------
+// CResourceManager used to load each texture and mesh in turn on the main thread: read the
+// file, decode it, create the GPU objects, then on to the next. loadTextureAsync and
+// loadMeshAsync run the reading and decoding on the worker threads and only the GPU step on
+// the main thread, through a LoadQueue. There is no GPU or image decoder here, so each asset
+// is a cooked mesh file loaded the way loadMeshAsync loads one (mapped, prefetched, checked,
+// clips read), plus reducing a clip's keys to stand in for decoding, and the GPU step copies
+// the blocks into an upload buffer. Also checks the queue: steps run on the calling thread,
+// failed loads throw there, Update keeps to its budget and a queue can be destroyed mid-load.
+
+#include "Benchmark.h"
+#include "Data/CookedMesh.h"
+#include "Utility/LoadQueue.h"
+#include "Utility/MappedFile.h"
+#include "Utility/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const int kVertexSize = 32;
+
+	//Keys at every frame for every node but the root, for the stand-in decode work
+	std::vector<AnimationChannelKeys> MakeChannels(unsigned int numNodes, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<AnimationChannelKeys> channels;
+		for (unsigned int node = 1; node < numNodes; ++node)
+		{
+			AnimationChannelKeys keys;
+			keys.Node = node;
+			CVector3 axis = Normalise(CVector3(unit(random), unit(random), unit(random)));
+			float phase = unit(random) * 3.0f;
+			for (float frame = 0; frame <= 60; ++frame)
+			{
+				float time = frame / 30.0f, wave = std::sin(time * 2.0f + phase);
+				keys.PositionTimes.push_back(time);
+				keys.Positions.push_back(axis * wave);
+				keys.RotationTimes.push_back(time);
+				keys.Rotations.push_back(QuaternionFromAxisAngle(axis, wave));
+				keys.ScaleTimes.push_back(time);
+				keys.Scales.push_back(CVector3(1, 1, 1));
+			}
+			channels.push_back(std::move(keys));
+		}
+		return channels;
+	}
+
+	//A static mesh with one clip, cooked
+	std::vector<unsigned char> MakeCookedMesh(unsigned int numNodes, unsigned int numVertices, const std::vector<AnimationChannelKeys>& channels,
+	                                          std::mt19937& random)
+	{
+		CookedMeshData data;
+		for (unsigned int n = 0; n < numNodes; ++n)
+		{
+			CookedNode node = {};
+			node.Parent = n == 0 ? 0 : n - 1;
+			node.FirstSubMesh = 0;
+			node.NumSubMeshes = n == 0 ? 1 : 0;
+			node.DefaultMatrix = MatrixIdentity();
+			node.OffsetMatrix = MatrixIdentity();
+			data.Nodes.push_back(node);
+			data.NodeNames.push_back("Node" + std::to_string(n));
+		}
+		data.NodeSubMeshes.push_back(0);
+
+		CookedSubMesh subMesh = {};
+		subMesh.VertexSize = kVertexSize;
+		subMesh.NumVertices = numVertices;
+		subMesh.NumIndices = numVertices * 3;
+		subMesh.NormalOffset = 12;
+		subMesh.TangentOffset = -1;
+		subMesh.UVOffset = 24;
+		subMesh.BonesOffset = -1;
+		data.SubMeshes.push_back(subMesh);
+
+		data.Vertices.emplace_back(static_cast<size_t>(numVertices) * kVertexSize);
+		for (auto& byte : data.Vertices[0])  byte = static_cast<unsigned char>(random());
+		data.Indices.emplace_back(subMesh.NumIndices);
+		for (auto& index : data.Indices[0])  index = random() % numVertices;
+		data.Animations.emplace_back("Idle", 2.0f, numNodes, channels);
+		return CookMesh(data, CookedMeshSource());
+	}
+
+	//What the worker does for a mesh: map it, read it from disk, check it and read its clips. Reducing the keys again
+	//stands in for the decoding an import or image load does
+	struct LoadedAsset
+	{
+		MappedFile                 file;
+		std::unique_ptr<CookedMesh> cooked;
+		std::vector<AnimationClip> animations;
+		size_t                     decodedKeys = 0;
+	};
+
+	std::shared_ptr<LoadedAsset> LoadAsset(const std::string& fileName, unsigned int numNodes, const std::vector<AnimationChannelKeys>& channels)
+	{
+		auto asset = std::make_shared<LoadedAsset>();
+		asset->file = MappedFile(fileName);
+		asset->file.Prefetch();
+		asset->cooked = std::make_unique<CookedMesh>(asset->file.Data(), asset->file.Size(), fileName);
+		asset->animations = asset->cooked->ReadAnimations();
+		asset->decodedKeys = AnimationClip("Decode", 2.0f, numNodes, channels).NumberKeys();
+		return asset;
+	}
+
+	//What the main thread does for a mesh: copy its blocks to the GPU, here an upload buffer. Returns a checksum of what it copied
+	uint64_t UploadAsset(const LoadedAsset& asset, std::vector<unsigned char>& upload)
+	{
+		const CookedSubMesh& subMesh = asset.cooked->SubMesh(0);
+		const size_t vertexBytes = static_cast<size_t>(subMesh.NumVertices) * subMesh.VertexSize, indexBytes = subMesh.NumIndices * sizeof(uint32_t);
+		std::memcpy(upload.data(), asset.cooked->Vertices(0), vertexBytes);
+		std::memcpy(upload.data() + vertexBytes, asset.cooked->Indices(0), indexBytes);
+
+		uint64_t checksum = asset.animations[0].NumberKeys() + asset.decodedKeys;
+		for (size_t i = 0; i < vertexBytes + indexBytes; i += 64)  checksum = checksum * 31 + upload[i];
+		return checksum;
+	}
+
+	void CheckLoadQueue()
+	{
+		const std::thread::id mainThread = std::this_thread::get_id();
+
+		//Workers of its own, so the checks run across threads however many cores there are
+		ThreadPool workers(4);
+
+		//Every step runs once, on the thread running the queue, after its load
+		{
+			LoadQueue queue(workers);
+			std::vector<int> runs(100, 0);
+			std::atomic<int> loaded{ 0 };
+			bool offThread = false;
+			for (int i = 0; i < 100; ++i)
+			{
+				queue.Submit([&, i]() -> LoadQueue::FinishStep
+				{
+					++loaded;
+					return [&, i]() { ++runs[i];  offThread |= std::this_thread::get_id() != mainThread; };
+				});
+			}
+			queue.Finish();
+			if (loaded != 100 || queue.NumberPending() != 0)  throw std::runtime_error("LoadQueue finished before every load had run");
+			if (offThread)  throw std::runtime_error("LoadQueue ran a step off the calling thread");
+			for (int count : runs)  if (count != 1)  throw std::runtime_error("LoadQueue didn't run every step exactly once");
+			if (queue.Update(1.0f) != 0)  throw std::runtime_error("LoadQueue ran a step twice");
+		}
+
+		//A failed load throws on the calling thread, and the other loads still finish
+		{
+			LoadQueue queue(workers);
+			int finished = 0;
+			for (int i = 0; i < 10; ++i)
+			{
+				queue.Submit([&, i]() -> LoadQueue::FinishStep
+				{
+					if (i == 3)  throw std::runtime_error("missing file");
+					return [&]() { ++finished; };
+				});
+			}
+			bool threw = false;
+			for (int attempt = 0; attempt < 2 && queue.NumberPending() > 0; ++attempt)
+			{
+				try { queue.Finish(); }
+				catch (const std::runtime_error& error) { threw = std::string(error.what()) == "missing file"; }
+			}
+			if (!threw)  throw std::runtime_error("LoadQueue lost a failed load's exception");
+			if (finished != 9 || queue.NumberPending() != 0)  throw std::runtime_error("LoadQueue stopped after a failed load");
+		}
+
+		//Update keeps to its budget but always runs a step
+		{
+			LoadQueue queue(workers);
+			for (int i = 0; i < 20; ++i)
+			{
+				queue.Submit([]() -> LoadQueue::FinishStep { return []() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }; });
+			}
+			while (queue.NumberPending() > 0)
+			{
+				int numRun = queue.Update(5.0f);
+				if (numRun > 3)  throw std::runtime_error("LoadQueue went over its budget");
+				if (numRun == 0)  std::this_thread::yield();
+			}
+			queue.Submit([]() -> LoadQueue::FinishStep { return []() {}; });
+			while (queue.Update(0.0f) == 0)  std::this_thread::yield();
+			if (queue.NumberPending() != 0)  throw std::runtime_error("LoadQueue didn't run a step with no budget");
+		}
+
+		//Destroyed with loads still running: it waits for them and drops their steps
+		{
+			auto stepRan = std::make_shared<std::atomic<bool>>(false);
+			std::atomic<int> loaded{ 0 };
+			{
+				LoadQueue queue(workers);
+				for (int i = 0; i < 4; ++i)
+				{
+					queue.Submit([&, stepRan]() -> LoadQueue::FinishStep
+					{
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+						++loaded;
+						return [stepRan]() { *stepRan = true; };
+					});
+				}
+			}
+			if (loaded != 4)  throw std::runtime_error("LoadQueue was destroyed before its loads finished");
+			if (*stepRan)  throw std::runtime_error("LoadQueue ran a step without being asked");
+		}
+
+		//No workers: loads run on the calling thread as they are submitted
+		{
+			ThreadPool noWorkers(0);
+			LoadQueue queue(noWorkers);
+			std::thread::id loadThread;
+			int finished = 0;
+			queue.Submit([&]() -> LoadQueue::FinishStep { loadThread = std::this_thread::get_id();  return [&]() { ++finished; }; });
+			if (loadThread != mainThread || queue.NumberPending() != 1)  throw std::runtime_error("LoadQueue without workers didn't load straight away");
+			queue.Finish();
+			if (finished != 1)  throw std::runtime_error("LoadQueue without workers didn't finish");
+		}
+	}
+}
+
+void RunAsyncLoadBenchmark()
+{
+	CheckLoadQueue();
+
+	//A scene's worth of meshes on disk
+	const int numAssets = 48;
+	const unsigned int numNodes = 60, numVertices = 40000;
+	std::mt19937 random(42);
+	const std::vector<AnimationChannelKeys> channels = MakeChannels(numNodes, random);
+	const TempFolder folder("EngineAsyncLoadBenchmark");
+	std::vector<std::string> fileNames;
+	size_t totalBytes = 0;
+	for (int i = 0; i < numAssets; ++i)
+	{
+		std::vector<unsigned char> cooked = MakeCookedMesh(numNodes, numVertices, channels, random);
+		fileNames.push_back(folder.File("Mesh" + std::to_string(i) + ".cmesh"));
+		if (!SaveCookedMesh(fileNames.back(), cooked))  throw std::runtime_error("Can't save " + fileNames.back());
+		totalBytes += cooked.size();
+	}
+	std::cout << "  " << numAssets << " meshes of " << numVertices << " vertices and " << numNodes << " animated nodes, "
+	          << totalBytes / (1024 * 1024) << " MB, " << ThreadPool::Get().NumThreads() << " threads\n";
+
+	//One after another on the main thread, as the load functions do
+	std::vector<unsigned char> upload(static_cast<size_t>(numVertices) * (kVertexSize + 12));
+	std::vector<uint64_t> serialChecksums(numAssets), asyncChecksums(numAssets);
+	double serialTime = TimeBestOf(3, [&]
+	{
+		for (int i = 0; i < numAssets; ++i)  serialChecksums[i] = UploadAsset(*LoadAsset(fileNames[i], numNodes, channels), upload);
+	});
+
+	//All at once on the workers, uploads on the main thread as each load finishes
+	double asyncTime = TimeBestOf(3, [&]
+	{
+		LoadQueue queue;
+		for (int i = 0; i < numAssets; ++i)
+		{
+			queue.Submit([&, i]() -> LoadQueue::FinishStep
+			{
+				std::shared_ptr<LoadedAsset> asset = LoadAsset(fileNames[i], numNodes, channels);
+				return [&, i, asset]() { asyncChecksums[i] = UploadAsset(*asset, upload); };
+			});
+		}
+		queue.Finish();
+	});
+	if (serialChecksums != asyncChecksums)  throw std::runtime_error("Meshes loaded through the LoadQueue don't match the ones loaded in turn");
+
+	ReportThroughput("Loaded in turn on the main thread", serialTime, static_cast<double>(totalBytes), "B");
+	ReportThroughput("Loaded on workers, uploaded on the main thread", asyncTime, static_cast<double>(totalBytes), "B");
+	ReportComparison("Loading a scene's meshes", serialTime, asyncTime);
+}
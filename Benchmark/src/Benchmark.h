@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// Shared helpers for the engine benchmarks
+//--------------------------------------------------------------------------------------
+// Each benchmark is a plain function registered in main.cpp. Run the Benchmark project
+// with no arguments to run everything, or pass benchmark names to run a subset. Run with
+// ENGINE_SIMD set to sse2, avx2 or avx512 to check and time the kernels of each instruction
+// set on one machine; the results of each SIMD kernel name the version that ran.
+
+#pragma once
+#include <string>
+#include <functional>
+#include <filesystem>
+#include <stdexcept>
+
+//Run the given function the given number of times and return the fastest run in milliseconds
+double TimeBestOf(int repeats, const std::function<void()>& function);
+
+//Print a single result line in a consistent format
+void ReportResult(const std::string& name, double milliseconds);
+
+//Print a single result line with a throughput figure (items per second) next to the time
+void ReportThroughput(const std::string& name, double milliseconds, double items, const std::string& itemName);
+
+//Print a single measured figure that isn't a time, e.g. a compression ratio, in the same columns as the times
+void ReportValue(const std::string& name, double value, const std::string& unit);
+
+//Print a comparison of a baseline time against a new time
+void ReportComparison(const std::string& name, double baselineMilliseconds, double newMilliseconds);
+
+//Stops the optimiser throwing away results that are otherwise unused
+void DoNotOptimise(const void* pointer);
+
+
+//----------------//
+//    Fixtures    //
+//----------------//
+
+//Whether calling the function throws a std::runtime_error, for checking bad input is caught
+template <class Function>
+bool Throws(Function function)
+{
+	try { function(); }
+	catch (const std::runtime_error&) { return true; }
+	return false;
+}
+
+//An empty folder in the temp directory for a benchmark's files. Anything left in it from an earlier run is removed
+//first, and everything in it is removed again when it goes, even if the benchmark fails
+class TempFolder
+{
+public:
+	explicit TempFolder(const std::string& name);
+	~TempFolder();
+	TempFolder(const TempFolder&) = delete;
+	TempFolder& operator=(const TempFolder&) = delete;
+
+	const std::filesystem::path& Path() const { return m_Path; }
+
+	//Full name of a file in the folder
+	std::string File(const std::string& name) const { return (m_Path / name).string(); }
+
+private:
+	std::filesystem::path m_Path;
+};
+
+//Write a whole file, replacing any file already there. Throws a std::runtime_error if it can't be written
+void WriteFile(const std::string& fileName, const void* data, size_t size);
+void WriteFile(const std::string& fileName, const std::string& contents);
+
+
+//----------------//
+//   Benchmarks   //
+//----------------//
+void RunHeightFieldBenchmark();
+void RunDiamondSquareBenchmark();
+void RunPerlinBenchmark();
+void RunFractalBenchmark();
+void RunGridVerticesBenchmark();
+void RunGridUpdateBenchmark();
+void RunTerrainQuadTreeBenchmark();
+void RunFrustumCullingBenchmark();
+void RunMatrixBenchmark();
+void RunVec3SoABenchmark();
+void RunTransformBenchmark();
+void RunTransformHierarchyBenchmark();
+void RunSkinningBenchmark();
+void RunAnimationBenchmark();
+void RunBoneLoadBenchmark();
+void RunMeshLoadBenchmark();
+void RunAsyncLoadBenchmark();
+void RunResourceIdBenchmark();
+void RunResourcePoolBenchmark();
+void RunAssetArchiveBenchmark();
+void RunCookManifestBenchmark();
@@ -0,0 +1,355 @@
+//--------------------------------------------------------------------------------------
+// Bone loading: binding a large skinned mesh's bones and animations to its nodes
+//--------------------------------------------------------------------------------------
+// Mesh used to find the node of every bone (in every sub-mesh) and of every animation channel
+// by walking all the nodes comparing std::strings, then put each bone weight in the first free
+// slot of its vertex by walking the slots. Now the node names are interned in a NameIndex, built
+// once while reading the nodes, and looked up by hash, and a BoneWeightPacker counts the
+// influences of each vertex. The asset is synthetic, laid out as assimp hands it over: a 1000
+// node rig with long shared name prefixes, split into sub-meshes of at most 64 bones, with
+// weights listed bone by bone, and a set of clips animating every node. The asset has at most 4
+// influences a vertex, where the packer and the old loop agree byte for byte. Also checks NameIndex
+// and the packer on their own, including which influences it keeps past 4.
+
+#include "Benchmark.h"
+#include "Math/Skinning.h"
+#include "Utility/NameIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	//Typical skinned vertex: position, normal, uv, then 4 bone bytes and 4 float weights
+	const int kVertexSize = 52, kBonesOffset = 32;
+
+	struct BoneWeights
+	{
+		std::string                            name;
+		std::vector<std::pair<unsigned, float>> weights; //Vertex and weight, as aiBone::mWeights
+	};
+
+	struct SubMeshBones
+	{
+		int                      numVertices;
+		std::vector<BoneWeights> bones;
+	};
+
+	struct SyntheticAsset
+	{
+		std::vector<std::string>              nodeNames; //Depth-first, as ReadNodes visits them
+		std::vector<SubMeshBones>             subMeshes;
+		std::vector<std::vector<std::string>> clips;     //Node name of each channel of each clip
+	};
+
+	SkinnedVertexLayout BoneLayout()
+	{
+		SkinnedVertexLayout layout;
+		layout.VertexSize  = kVertexSize;
+		layout.BonesOffset = kBonesOffset;
+		return layout;
+	}
+
+	//Names like the ones exported rigs have: a long shared prefix, so comparing them takes a while
+	std::string NodeName(int node)
+	{
+		static const char* parts[] = { "Hips", "Spine", "Neck", "Head", "Shoulder", "Arm", "ForeArm", "Hand", "Thumb",
+		                               "Index", "Middle", "Ring", "Pinky", "UpLeg", "Leg", "Foot", "Toe", "Jaw", "Brow", "Lip" };
+		return std::string("Character_Rig:") + (node % 2 ? "Left" : "Right") + parts[node % 20] + "_" + std::to_string(node);
+	}
+
+	SyntheticAsset MakeAsset(int numNodes, int numSubMeshes, int verticesPerSubMesh, int bonesPerSubMesh, int numClips, std::mt19937& random)
+	{
+		SyntheticAsset asset;
+		for (int node = 0; node < numNodes; ++node)  asset.nodeNames.push_back(NodeName(node));
+
+		//Bones can only be the first 256 nodes (the indices are bytes), the rest of the nodes are props, helpers etc.
+		std::vector<int> boneNodes(std::min(numNodes, 256));
+		std::iota(boneNodes.begin(), boneNodes.end(), 0);
+		std::uniform_real_distribution<float> weight(0.05f, 1.0f);
+		for (int m = 0; m < numSubMeshes; ++m)
+		{
+			std::shuffle(boneNodes.begin(), boneNodes.end(), random);
+			SubMeshBones subMesh;
+			subMesh.numVertices = verticesPerSubMesh;
+			for (int b = 0; b < bonesPerSubMesh; ++b)  subMesh.bones.push_back({ NodeName(boneNodes[b]), {} });
+
+			//Each vertex gets 1 to 4 distinct bones of its sub-mesh, weights adding up to 1
+			std::uniform_int_distribution<int> bone(0, bonesPerSubMesh - 1), influences(1, 4);
+			for (int v = 0; v < verticesPerSubMesh; ++v)
+			{
+				int count = influences(random), chosen[4];
+				float weights[4], total = 0;
+				for (int i = 0; i < count; ++i)
+				{
+					do { chosen[i] = bone(random); } while (std::find(chosen, chosen + i, chosen[i]) != chosen + i);
+					weights[i] = weight(random);
+					total += weights[i];
+				}
+				for (int i = 0; i < count; ++i)  subMesh.bones[chosen[i]].weights.push_back({ v, weights[i] / total });
+			}
+			asset.subMeshes.push_back(std::move(subMesh));
+		}
+
+		//Every clip animates every node, channels in a different order to the nodes
+		std::vector<std::string> channels = asset.nodeNames;
+		for (int c = 0; c < numClips; ++c)
+		{
+			std::shuffle(channels.begin(), channels.end(), random);
+			asset.clips.push_back(channels);
+		}
+		return asset;
+	}
+
+
+	//What the asset comes out as: the vertices of each sub-mesh and the node of each animation channel
+	struct BoundAsset
+	{
+		std::vector<std::vector<unsigned char>> vertices;
+		std::vector<std::vector<unsigned int>>  channelNodes;
+	};
+
+	void ResetVertices(const SyntheticAsset& asset, BoundAsset& bound)
+	{
+		bound.vertices.resize(asset.subMeshes.size());
+		for (size_t m = 0; m < asset.subMeshes.size(); ++m)  bound.vertices[m].assign(asset.subMeshes[m].numVertices * kVertexSize, 0xcd);
+		bound.channelNodes.assign(asset.clips.size(), {});
+	}
+
+	//The loops Mesh had: a string compare against every node for each bone and channel, a walk for each weight
+	void BindLinear(const SyntheticAsset& asset, BoundAsset& bound)
+	{
+		std::vector<std::string> nodeNames(asset.nodeNames.size());
+		for (size_t node = 0; node < nodeNames.size(); ++node)  nodeNames[node] = asset.nodeNames[node].c_str();
+
+		for (size_t m = 0; m < asset.subMeshes.size(); ++m)
+		{
+			const SubMeshBones& subMesh = asset.subMeshes[m];
+			unsigned char* bones = bound.vertices[m].data() + kBonesOffset;
+			for (int v = 0; v < subMesh.numVertices; ++v)  std::memset(bones + v * kVertexSize, 0, 20);
+
+			for (const BoneWeights& assimpBone : subMesh.bones)
+			{
+				std::string boneName = assimpBone.name.c_str();
+				unsigned int nodeIndex;
+				for (nodeIndex = 0; nodeIndex < nodeNames.size(); ++nodeIndex)
+				{
+					if (nodeNames[nodeIndex] == boneName)  break;
+				}
+				if (nodeIndex == nodeNames.size())  throw std::runtime_error("Bone with no matching node");
+
+				for (const auto& assimpWeight : assimpBone.weights)
+				{
+					unsigned char* bone = bones + assimpWeight.first * kVertexSize;
+					float* weight = (float*)(bone + 4);
+					float* lastWeight = weight + 3;
+					while (*weight != 0.0f && weight != lastWeight)
+					{
+						bone++; weight++;
+					}
+					if (*weight == 0.0f)
+					{
+						*bone = nodeIndex;
+						*weight = assimpWeight.second;
+					}
+				}
+			}
+		}
+
+		for (size_t c = 0; c < asset.clips.size(); ++c)
+		{
+			for (const std::string& channel : asset.clips[c])
+			{
+				std::string nodeName = channel.c_str();
+				auto node = std::find_if(nodeNames.begin(), nodeNames.end(), [&](const std::string& n) { return n == nodeName; });
+				if (node == nodeNames.end())  throw std::runtime_error("Animation of a node that isn't in the asset");
+				bound.channelNodes[c].push_back(static_cast<unsigned int>(node - nodeNames.begin()));
+			}
+		}
+	}
+
+	//What Mesh does now: names interned as the nodes are read, then hash lookups and the packer
+	void BindIndexed(const SyntheticAsset& asset, BoundAsset& bound)
+	{
+		NameIndex nodeNames;
+		nodeNames.Reserve(static_cast<unsigned int>(asset.nodeNames.size()));
+		for (const std::string& name : asset.nodeNames)  nodeNames.Add(name);
+
+		for (size_t m = 0; m < asset.subMeshes.size(); ++m)
+		{
+			const SubMeshBones& subMesh = asset.subMeshes[m];
+			BoneWeightPacker weights(bound.vertices[m].data(), BoneLayout(), subMesh.numVertices);
+			for (const BoneWeights& assimpBone : subMesh.bones)
+			{
+				unsigned int nodeIndex = nodeNames.Find(assimpBone.name);
+				if (nodeIndex == NameIndex::kNotFound)  throw std::runtime_error("Bone with no matching node");
+				for (const auto& assimpWeight : assimpBone.weights)
+				{
+					weights.Add(assimpWeight.first, static_cast<uint8_t>(nodeIndex), assimpWeight.second);
+				}
+			}
+		}
+
+		for (size_t c = 0; c < asset.clips.size(); ++c)
+		{
+			for (const std::string& channel : asset.clips[c])
+			{
+				unsigned int nodeIndex = nodeNames.Find(channel);
+				if (nodeIndex == NameIndex::kNotFound)  throw std::runtime_error("Animation of a node that isn't in the asset");
+				bound.channelNodes[c].push_back(nodeIndex);
+			}
+		}
+	}
+
+
+	void CheckNameIndex()
+	{
+		NameIndex names;
+		if (names.Find("") != NameIndex::kNotFound || names.Size() != 0)  throw std::runtime_error("Empty NameIndex found a name");
+
+		//Enough names, some of them longer than a storage block, to need many blocks. Every fifth name repeats an earlier one
+		std::vector<std::string> expected;
+		for (int i = 0; i < 20000; ++i)
+		{
+			std::string name = i % 5 == 4 ? expected[i / 2] : NodeName(i);
+			if (i % 997 == 0)  name += std::string(5000 + i % 7, 'x');
+			if (i == 3)  name = "";
+			expected.push_back(name);
+			std::string_view stored = names.Add(name);
+			if (stored != name || stored.data()[stored.size()] != '\0')  throw std::runtime_error("NameIndex stored a name wrongly");
+		}
+
+		//Move it, the stored names mustn't move with it
+		std::vector<std::string_view> views;
+		for (unsigned int i = 0; i < names.Size(); ++i)  views.push_back(names.Name(i));
+		NameIndex moved = std::move(names);
+		if (moved.Size() != expected.size())  throw std::runtime_error("NameIndex lost names");
+		for (unsigned int i = 0; i < moved.Size(); ++i)
+		{
+			unsigned int first = static_cast<unsigned int>(std::find(expected.begin(), expected.end(), expected[i]) - expected.begin());
+			if (moved.Name(i) != expected[i] || views[i].data() != moved.Name(i).data())  throw std::runtime_error("NameIndex names moved or changed");
+			if (moved.Name(i).data() != moved.Name(first).data())  throw std::runtime_error("NameIndex didn't share a repeated name");
+			if (moved.Find(expected[i]) != first)  throw std::runtime_error("NameIndex didn't find the first index with a name");
+		}
+		if (moved.Find("Character_Rig:") != NameIndex::kNotFound || moved.Find(NodeName(20000)) != NameIndex::kNotFound)
+		{
+			throw std::runtime_error("NameIndex found a name it doesn't have");
+		}
+
+		moved.Clear();
+		if (moved.Size() != 0 || moved.Find(expected[0]) != NameIndex::kNotFound)  throw std::runtime_error("NameIndex didn't clear");
+		if (moved.Add("Grid") != "Grid" || moved.Find("Grid") != 0)  throw std::runtime_error("NameIndex isn't usable after clearing");
+	}
+
+	void CheckPacker()
+	{
+		const int numVertices = 5;
+		std::vector<unsigned char> vertices(numVertices * kVertexSize, 0xcd);
+		auto bone = [&](int vertex, int slot) { return vertices[vertex * kVertexSize + kBonesOffset + slot]; };
+		auto weight = [&](int vertex, int slot)
+		{
+			float w;
+			std::memcpy(&w, &vertices[vertex * kVertexSize + kBonesOffset + 4 + slot * 4], sizeof(w));
+			return w;
+		};
+
+		BoneWeightPacker weights(vertices.data(), BoneLayout(), numVertices);
+		for (int v = 0; v < numVertices; ++v)
+		{
+			for (int i = 0; i < kVertexSize; ++i)
+			{
+				bool isBones = i >= kBonesOffset && i < kBonesOffset + 20;
+				if (vertices[v * kVertexSize + i] != (isBones ? 0 : 0xcd))  throw std::runtime_error("BoneWeightPacker cleared the wrong bytes");
+			}
+		}
+
+		//Slots fill in order, zero weights are left out
+		weights.Add(0, 7, 0.5f);
+		weights.Add(0, 9, 0.0f);
+		weights.Add(0, 3, 0.25f);
+		if (weights.NumberInfluences(0) != 2 || bone(0, 0) != 7 || bone(0, 1) != 3 || weight(0, 0) != 0.5f || weight(0, 1) != 0.25f ||
+		    bone(0, 2) != 0 || weight(0, 2) != 0.0f)
+		{
+			throw std::runtime_error("BoneWeightPacker didn't fill slots in order");
+		}
+
+		//Past 4 influences a new one replaces the smallest in its slot if it is larger, and is dropped otherwise. The loop
+		//Mesh had dropped every influence past 4
+		auto slotsAre = [&](int vertex, const std::vector<int>& expectedBones, const std::vector<float>& expectedWeights)
+		{
+			for (int slot = 0; slot < 4; ++slot)
+			{
+				if (bone(vertex, slot) != expectedBones[slot] || weight(vertex, slot) != expectedWeights[slot])  return false;
+			}
+			return weights.NumberInfluences(vertex) == 4;
+		};
+		const float extra[6] = { 0.1f, 0.3f, 0.05f, 0.2f, 0.25f, 0.01f };
+		for (int i = 0; i < 5; ++i)  weights.Add(1, static_cast<uint8_t>(i + 1), extra[i]);
+		if (!slotsAre(1, { 1, 2, 5, 4 }, { 0.1f, 0.3f, 0.25f, 0.2f }))  throw std::runtime_error("BoneWeightPacker didn't replace the smallest weight");
+		weights.Add(1, 6, extra[5]);
+		if (!slotsAre(1, { 1, 2, 5, 4 }, { 0.1f, 0.3f, 0.25f, 0.2f }))  throw std::runtime_error("BoneWeightPacker kept a weight smaller than all 4");
+
+		//A weight equal to the smallest is dropped, and of equal smallest weights the first slot is replaced
+		for (int i = 0; i < 5; ++i)  weights.Add(2, static_cast<uint8_t>(11 + i), 0.25f);
+		if (!slotsAre(2, { 11, 12, 13, 14 }, { 0.25f, 0.25f, 0.25f, 0.25f }))  throw std::runtime_error("BoneWeightPacker replaced an equal weight");
+		weights.Add(2, 16, 0.5f);
+		weights.Add(2, 17, 0.375f);
+		if (!slotsAre(2, { 16, 17, 13, 14 }, { 0.5f, 0.375f, 0.25f, 0.25f }))  throw std::runtime_error("BoneWeightPacker replaced the wrong slot");
+
+		if (!Throws([&] { weights.Add(numVertices, 0, 1.0f); }))  throw std::runtime_error("BoneWeightPacker accepted a vertex that doesn't exist");
+
+		weights.BindAll(42);
+		for (int v = 0; v < numVertices; ++v)
+		{
+			if (weights.NumberInfluences(v) != 1 || bone(v, 0) != 42 || weight(v, 0) != 1.0f || bone(v, 1) != 0 || weight(v, 3) != 0.0f)
+			{
+				throw std::runtime_error("BoneWeightPacker didn't bind every vertex to one bone");
+			}
+		}
+	}
+}
+
+void RunBoneLoadBenchmark()
+{
+	std::mt19937 random(42);
+	CheckNameIndex();
+	CheckPacker();
+
+	//Small asset first to check both ways bind the same, then the large one
+	for (int large = 0; large < 2; ++large)
+	{
+		SyntheticAsset asset = large ? MakeAsset(1000, 32, 8192, 64, 20, random) : MakeAsset(300, 3, 500, 40, 2, random);
+		BoundAsset linear, indexed;
+		ResetVertices(asset, linear);
+		ResetVertices(asset, indexed);
+		BindLinear(asset, linear);
+		BindIndexed(asset, indexed);
+		if (linear.vertices != indexed.vertices)          throw std::runtime_error("Packed bone weights don't match the old loop");
+		if (linear.channelNodes != indexed.channelNodes)  throw std::runtime_error("Indexed animation channels don't match the old loop");
+		if (!large)  continue;
+
+		size_t numBones = 0, numWeights = 0;
+		for (const SubMeshBones& subMesh : asset.subMeshes)
+		{
+			numBones += subMesh.bones.size();
+			for (const BoneWeights& bone : subMesh.bones)  numWeights += bone.weights.size();
+		}
+		const size_t numLookups = numBones + asset.clips.size() * asset.nodeNames.size();
+		std::cout << "  " << asset.nodeNames.size() << " nodes, " << numBones << " bones over " << asset.subMeshes.size() << " sub-meshes, "
+		          << numWeights << " weights, " << asset.clips.size() << " clips\n";
+
+		double linearTime = TimeBestOf(3, [&] { ResetVertices(asset, linear);  BindLinear(asset, linear);  DoNotOptimise(&linear); });
+		double indexedTime = TimeBestOf(3, [&] { ResetVertices(asset, indexed);  BindIndexed(asset, indexed);  DoNotOptimise(&indexed); });
+		ReportThroughput("String compares and slot walks", linearTime, static_cast<double>(numLookups), "lookups");
+		ReportThroughput("NameIndex and BoneWeightPacker", indexedTime, static_cast<double>(numLookups), "lookups");
+		ReportComparison("Binding bones and animations", linearTime, indexedTime);
+	}
+}
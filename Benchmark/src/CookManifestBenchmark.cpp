@@ -0,0 +1,204 @@
+//--------------------------------------------------------------------------------------
+// Cook manifest: finding the assets that need cooking again
+//--------------------------------------------------------------------------------------
+// AssetCook keeps a manifest of what each cooked file was made from and only cooks the assets
+// whose files or settings have changed. A run with nothing to cook should take well under a
+// second however much content there is, so files are only hashed when their size or time has
+// changed. A tree of small assets is recorded, then checking it through the manifest is timed
+// against hashing every file as a plain content-hash check would, both serially and across
+// the thread pool as AssetCook checks. Also checks that changed contents, settings and
+// missing cooked files are caught, that a file saved again without changes isn't (and that the
+// engine still takes its cooked file once restamped), and that manifests save and load, and a
+// damaged one isn't trusted.
+
+#include "Benchmark.h"
+#include "Data/CookManifest.h"
+#include "Data/CookedMesh.h"
+#include "Utility/MappedFile.h"
+#include "Utility/ThreadPool.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//Move a file's write time on, so the change is seen however coarse the file system's times are
+	void TouchFile(const std::string& fileName)
+	{
+		std::filesystem::last_write_time(fileName, std::filesystem::last_write_time(fileName) + std::chrono::seconds(10));
+	}
+
+	//A record of an asset cooked from the given files
+	CookRecord Record(const std::string& settings, const std::vector<std::string>& fileNames)
+	{
+		CookRecord record;
+		record.Settings = settings;
+		for (const auto& fileName : fileNames)
+		{
+			record.Inputs.emplace_back();
+			if (!ReadCookInput(fileName, record.Inputs.back()))  throw std::runtime_error("Can't read cook input " + fileName);
+		}
+		return record;
+	}
+
+	void CheckManifest(const std::filesystem::path& folder)
+	{
+		const std::string source = (folder / "Stone wall.png").string(), include = (folder / "Common.hlsli").string();
+		const std::string output = (folder / "Stone wall.png.dds").string(), manifestName = (folder / "Check.manifest").string();
+		WriteFile(source, "texture contents");
+		WriteFile(include, "include contents");
+		WriteFile(output, "cooked");
+
+		CookManifest manifest;
+		if (manifest.Load(manifestName) || manifest.Size() != 0)  throw std::runtime_error("CookManifest loaded a missing manifest");
+		manifest.Set(output, Record("texture 1", { source, include }));
+		manifest.Save(manifestName);
+		if (!manifest.Load(manifestName) || manifest.Size() != 1 || !manifest.Find(output))  throw std::runtime_error("CookManifest didn't load what it saved");
+
+		CookRecord& record = *manifest.Find(output);
+		const CookRecord expected = Record("texture 1", { source, include });
+		if (record.Settings != expected.Settings || record.Inputs.size() != 2 || record.Inputs[1].FileName != include ||
+		    record.Inputs[1].Hash != expected.Inputs[1].Hash || record.Inputs[1].Time != expected.Inputs[1].Time || record.Inputs[1].Size != expected.Inputs[1].Size)
+		{
+			throw std::runtime_error("CookManifest didn't load the record it saved");
+		}
+		if (!CookManifest::IsCurrent(output, record, "texture 1"))  throw std::runtime_error("CookManifest thought an unchanged asset had changed");
+		if (CookManifest::IsCurrent(output, record, "texture 1 bc"))  throw std::runtime_error("CookManifest missed changed settings");
+
+		//Saved again without changes: current, and the new time is kept so it isn't hashed again
+		TouchFile(include);
+		if (!CookManifest::IsCurrent(output, record, "texture 1") || record.Inputs[1].Time != Record("", { include }).Inputs[0].Time)
+		{
+			throw std::runtime_error("CookManifest didn't take the new time of a file saved again without changes");
+		}
+
+		//Contents changed at the same size, so only the hash tells. The same size and time are trusted without hashing
+		WriteFile(include, "include CONTENTS");
+		TouchFile(include);
+		if (CookManifest::IsCurrent(output, record, "texture 1"))  throw std::runtime_error("CookManifest missed changed contents of the same size");
+		WriteFile(include, "include contents");
+		TouchFile(include);
+		if (!CookManifest::IsCurrent(output, record, "texture 1"))  throw std::runtime_error("CookManifest missed contents changed back");
+		WriteFile(source, "texture contents, longer");
+		if (CookManifest::IsCurrent(output, record, "texture 1"))  throw std::runtime_error("CookManifest missed a changed size");
+		manifest.Set(output, Record("texture 1", { source, include }));
+
+		//Missing files
+		std::filesystem::remove(output);
+		if (CookManifest::IsCurrent(output, *manifest.Find(output), "texture 1"))  throw std::runtime_error("CookManifest missed a missing cooked file");
+		WriteFile(output, "cooked");
+		std::filesystem::remove(include);
+		if (CookManifest::IsCurrent(output, *manifest.Find(output), "texture 1"))  throw std::runtime_error("CookManifest missed a missing input");
+
+		//A mesh checked out afresh: the manifest still takes it, and once its cooked mesh is stamped with the new time, as
+		//AssetCook does (RestampCookedAsset), so does the engine, which only looks at the stamp
+		const std::string mesh = (folder / "Rock.x").string(), cookedMesh = CookedMeshFileName(mesh, false);
+		WriteFile(mesh, "mesh contents");
+		if (!SaveCookedMesh(cookedMesh, CookMesh(CookedMeshData(), GetCookedMeshSource(mesh))))  throw std::runtime_error("Can't save " + cookedMesh);
+		CookRecord meshRecord = Record("mesh 1", { mesh });
+		TouchFile(mesh);
+		if (!CookManifest::IsCurrent(cookedMesh, meshRecord, "mesh 1"))  throw std::runtime_error("CookManifest thought a touched mesh had changed");
+		const CookInput& touched = meshRecord.Inputs.front();
+		if (!RestampCookedMesh(cookedMesh, { touched.Size, touched.Time }))  throw std::runtime_error("Can't restamp " + cookedMesh);
+		{
+			const std::vector<unsigned char> expected = CookMesh(CookedMeshData(), GetCookedMeshSource(mesh));
+			MappedFile mapped(cookedMesh);
+			if (!CookedMesh::IsCurrent(mapped.Data(), mapped.Size(), GetCookedMeshSource(mesh), false) || mapped.Size() != expected.size() ||
+			    std::memcmp(mapped.Data(), expected.data(), expected.size()) != 0)
+			{
+				throw std::runtime_error("The engine won't take a cooked mesh restamped after its source was touched");
+			}
+		}
+		if (RestampCookedMesh(source, { touched.Size, touched.Time }))  throw std::runtime_error("RestampCookedMesh restamped a file that isn't a cooked mesh");
+
+		//A damaged manifest is ignored completely, so everything is cooked again
+		manifest.Save(manifestName);
+		std::string text;
+		{
+			std::ifstream file(manifestName, std::ios::binary);
+			text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		WriteFile(manifestName, text + "input\tnot a number\t0\t0\tx\n");
+		if (manifest.Load(manifestName) || manifest.Size() != 0)  throw std::runtime_error("CookManifest loaded a damaged manifest");
+		WriteFile(manifestName, "AssetCook manifest 0\n");
+		if (manifest.Load(manifestName))  throw std::runtime_error("CookManifest loaded a manifest from another version");
+	}
+}
+
+void RunCookManifestBenchmark()
+{
+	const TempFolder temp("EngineCookManifestBenchmark");
+	const std::filesystem::path& folder = temp.Path();
+	std::filesystem::create_directories(folder / "Media");
+	CheckManifest(folder);
+
+	//A tree of assets, each with a cooked file, and a manifest of them
+	const int numAssets = 4000;
+	std::mt19937 random(11);
+	std::vector<std::string> sources, outputs;
+	CookManifest manifest;
+	size_t totalSize = 0;
+	for (int i = 0; i < numAssets; ++i)
+	{
+		std::string contents(4000 + random() % 60000, '\0');
+		for (auto& c : contents)  c = static_cast<char>('a' + random() % 26);
+		sources.push_back((folder / "Media" / ("Asset" + std::to_string(i) + ".png")).string());
+		outputs.push_back(sources.back() + ".dds");
+		WriteFile(sources.back(), contents);
+		WriteFile(outputs.back(), "cooked");
+		manifest.Set(outputs.back(), Record("texture 1", { sources.back() }));
+		totalSize += contents.size();
+	}
+	const std::string manifestName = (folder / "AssetCook.manifest").string();
+	manifest.Save(manifestName);
+
+	//A run with nothing to cook: load the manifest and check every asset
+	auto checkAll = [&](bool parallel)
+	{
+		CookManifest loaded;
+		if (!loaded.Load(manifestName))  throw std::runtime_error("Can't load the cook manifest");
+		std::vector<CookRecord*> records;
+		for (const auto& output : outputs)  records.push_back(loaded.Find(output));
+
+		std::vector<char> current(numAssets, 0);
+		auto check = [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)  current[i] = records[i] && CookManifest::IsCurrent(outputs[i], *records[i], "texture 1");
+		};
+		if (parallel)  ThreadPool::Get().ParallelFor(0, numAssets, 16, check);
+		else           check(0, numAssets);
+		for (char c : current)
+		{
+			if (!c)  throw std::runtime_error("An unchanged asset needs cooking");
+		}
+	};
+	const double manifestTime = TimeBestOf(5, [&] { checkAll(false); });
+	const double parallelTime = TimeBestOf(5, [&] { checkAll(true); });
+
+	const double loadTime = TimeBestOf(5, [&] { CookManifest loaded;  loaded.Load(manifestName); });
+
+	//Hashing every file each run instead
+	const double hashTime = TimeBestOf(3, [&]
+	{
+		for (const auto& source : sources)
+		{
+			CookInput input;
+			if (!ReadCookInput(source, input))  throw std::runtime_error("Can't read " + source);
+			DoNotOptimise(&input.Hash);
+		}
+	});
+
+	std::cout << "  " << numAssets << " assets, " << totalSize / (1024 * 1024) << " MB" << std::endl;
+	ReportResult("Hash every file", hashTime);
+	ReportResult("Manifest, size and time", manifestTime);
+	ReportComparison("No-op check", hashTime, manifestTime);
+	ReportResult("Manifest, across the thread pool", parallelTime);
+	ReportResult("of which loading the manifest", loadTime);
+}
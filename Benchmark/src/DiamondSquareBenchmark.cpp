@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Diamond-Square generation on one thread against the shared thread pool
+//--------------------------------------------------------------------------------------
+// Also checks the output is bit-identical whatever the number of threads
+
+#include "Benchmark.h"
+#include "Math/DiamondSquare.h"
+#include "Utility/ThreadPool.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+void RunDiamondSquareBenchmark()
+{
+	ThreadPool singleThread(0);
+
+	for (int size : { 1024, 4096 })
+	{
+		const std::string label = std::to_string(size + 1) + "^2 ";
+		DiamondSquare generator(size, 500.0f, 2.0f, 12345);
+
+		HeightField serial;
+		HeightField parallel;
+		double serialTime   = TimeBestOf(3, [&]() { generator.process(serial, &singleThread); });
+		double parallelTime = TimeBestOf(3, [&]() { generator.process(parallel); });
+		ReportComparison(label + "generate (1 -> " + std::to_string(ThreadPool::Get().NumThreads()) + " threads)", serialTime, parallelTime);
+
+		if (memcmp(serial.Data(), parallel.Data(), serial.SizeInBytes()) != 0)
+		{
+			throw std::runtime_error("Diamond-Square output depends on the number of threads");
+		}
+	}
+}
@@ -0,0 +1,162 @@
+//--------------------------------------------------------------------------------------
+// Fractal noise: per-point Sample against the tiled, multithreaded Generate
+//--------------------------------------------------------------------------------------
+// Also checks Generate stays within FractalNoise::kSampleTolerance of Sample for every type,
+// with and without the gradient, and that the gradient matches finite differences of Sample
+
+#include "Benchmark.h"
+#include "Math/FractalNoise.h"
+#include "Math/HeightField.h"
+#include "Utility/ThreadPool.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	const char* TypeName(EFractalType type)
+	{
+		switch (type)
+		{
+		case EFractalType::FBm:    return "fBm";
+		case EFractalType::Ridged: return "ridged";
+		case EFractalType::Billow: return "billow";
+		}
+		return "";
+	}
+
+	//Largest difference between Generate and Sample over the whole HeightField, as a fraction of the height
+	double MaxGenerateError(FractalNoise& fractal, HeightField& heightMap)
+	{
+		fractal.Generate(heightMap);
+
+		double maxError = 0.0;
+		for (int z = 0; z < heightMap.Height(); ++z)
+		{
+			for (int x = 0; x < heightMap.Width(); ++x)
+			{
+				double expected = fractal.Sample(fractal.Settings().OriginX + x, fractal.Settings().OriginZ + z);
+				maxError = std::max(maxError, std::abs(expected - heightMap(x, z)));
+			}
+		}
+		return maxError / fractal.Settings().Height;
+	}
+
+	//Largest difference between Generate with a gradient and Sample with slopes, as a fraction of the height
+	double MaxGradientError(FractalNoise& fractal, HeightField& heightMap)
+	{
+		HeightFieldGradient gradient;
+		fractal.Generate(heightMap, gradient);
+
+		double maxError = 0.0;
+		for (int z = 0; z < heightMap.Height(); ++z)
+		{
+			for (int x = 0; x < heightMap.Width(); ++x)
+			{
+				float dX, dZ;
+				double expected = fractal.Sample(fractal.Settings().OriginX + x, fractal.Settings().OriginZ + z, dX, dZ);
+				maxError = std::max(maxError, std::abs(expected - heightMap(x, z)));
+				maxError = std::max(maxError, static_cast<double>(std::abs(dX - gradient.DX(x, z))));
+				maxError = std::max(maxError, static_cast<double>(std::abs(dZ - gradient.DZ(x, z))));
+			}
+		}
+		return maxError / fractal.Settings().Height;
+	}
+
+	//Largest difference between the slopes from Sample and finite differences of Sample, as a fraction of the height.
+	//Ridged and billow noise have creases where the slope jumps, points where the forward and backward
+	//differences disagree are sitting on a crease and are skipped. Points just off a crease still disagree a little,
+	//so this only catches large mistakes, the difference against Sample above is the precise check
+	double MaxFiniteDifferenceError(const FractalNoise& fractal, int& creasePoints)
+	{
+		const double h = 1e-2;
+		const double creaseTolerance = 1e-3 * fractal.Settings().Height;
+		double maxError = 0.0;
+		creasePoints = 0;
+		for (int i = 0; i < 1000; ++i)
+		{
+			double x = i * 7.31 - 2000.0, z = i * 3.77 + 31.0;
+			float dX, dZ;
+			double centre = fractal.Sample(x, z, dX, dZ);
+
+			double forwardX = (fractal.Sample(x + h, z) - centre) / h, backwardX = (centre - fractal.Sample(x - h, z)) / h;
+			double forwardZ = (fractal.Sample(x, z + h) - centre) / h, backwardZ = (centre - fractal.Sample(x, z - h)) / h;
+			if (std::abs(forwardX - backwardX) > creaseTolerance || std::abs(forwardZ - backwardZ) > creaseTolerance)
+			{
+				++creasePoints;
+				continue;
+			}
+			maxError = std::max(maxError, std::abs(dX - (forwardX + backwardX) / 2));
+			maxError = std::max(maxError, std::abs(dZ - (forwardZ + backwardZ) / 2));
+		}
+		return maxError / fractal.Settings().Height;
+	}
+}
+
+void RunFractalBenchmark()
+{
+	for (EFractalType type : { EFractalType::FBm, EFractalType::Ridged, EFractalType::Billow })
+	{
+		FractalNoiseSettings settings;
+		settings.Type = type;
+		settings.Octaves = 8;
+		settings.Height = 500.0f;
+		settings.OriginX = -1000.5;
+		settings.OriginZ = 333.25;
+		FractalNoise fractal(42, settings);
+
+		//Odd size so the last row and column of tiles are partial
+		HeightField check(301, 157);
+		double maxError = MaxGenerateError(fractal, check);
+		std::cout << "  " << TypeName(type) << " max difference from Sample(): " << std::defaultfloat << maxError << " of height (tolerance "
+		          << FractalNoise::kSampleTolerance << ")" << std::endl;
+		if (maxError > FractalNoise::kSampleTolerance)
+		{
+			throw std::runtime_error(std::string("Fractal noise Generate differs from Sample for ") + TypeName(type));
+		}
+
+		double gradientError = MaxGradientError(fractal, check);
+		int creasePoints;
+		double finiteDifferenceError = MaxFiniteDifferenceError(fractal, creasePoints);
+		std::cout << "  " << TypeName(type) << " gradient max difference from Sample(): " << gradientError
+		          << ", Sample() slopes max difference from finite differences: " << finiteDifferenceError
+		          << " (" << creasePoints << " of 1000 points on creases)" << std::endl;
+		if (gradientError > FractalNoise::kSampleTolerance || finiteDifferenceError > 2e-3 || creasePoints > 100)
+		{
+			throw std::runtime_error(std::string("Fractal noise gradient is wrong for ") + TypeName(type));
+		}
+	}
+
+	FractalNoiseSettings settings;
+	settings.Octaves = 8;
+	FractalNoise fractal(42, settings);
+	ThreadPool singleThread(0);
+
+	//Sample is too slow to run over the large map, so only compare against it on the small one
+	HeightField small(1025, 1025);
+	double sampleTime = TimeBestOf(1, [&]()
+	{
+		for (int z = 0; z < small.Height(); ++z)
+		{
+			auto row = small.Row(z);
+			for (int x = 0; x < small.Width(); ++x)  row[x] = fractal.Sample(x, z);
+		}
+	});
+	DoNotOptimise(small.Data());
+	double smallTime = TimeBestOf(3, [&]() { fractal.Generate(small); });
+	ReportThroughput("1025^2 8 octaves Sample per point", sampleTime, 1025.0 * 1025.0, "points");
+	ReportComparison("1025^2 8 octaves Sample -> Generate", sampleTime, smallTime);
+
+	HeightField large(4097, 4097);
+	const double points = 4097.0 * 4097.0;
+	double serialTime   = TimeBestOf(3, [&]() { fractal.Generate(large, &singleThread); });
+	double parallelTime = TimeBestOf(3, [&]() { fractal.Generate(large); });
+
+	HeightFieldGradient gradient;
+	double gradientTime = TimeBestOf(3, [&]() { fractal.Generate(large, gradient); });
+	ReportThroughput("4097^2 8 octaves Generate, 1 thread", serialTime, points, "points");
+	ReportThroughput("4097^2 8 octaves Generate, " + std::to_string(ThreadPool::Get().NumThreads()) + " threads", parallelTime, points, "points");
+	ReportThroughput("4097^2 8 octaves Generate with gradient", gradientTime, points, "points");
+}
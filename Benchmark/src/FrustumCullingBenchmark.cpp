@@ -0,0 +1,220 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling: one box at a time with Frustum::Intersects against the batched kernels
+//--------------------------------------------------------------------------------------
+// Also checks every kernel agrees with Frustum::Intersects for boxes and spheres, apart
+// from bounds within rounding of a plane, including counts that are not a multiple of the
+// SIMD width or of the 32 bits in a mask word. Checks the bounds helpers the culler is fed
+// from too: transformed boxes and the bounds kept by GridVertexData
+
+#include "Benchmark.h"
+#include "Math/FractalNoise.h"
+#include "Math/FrustumCulling.h"
+#include "Math/FrustumCullingKernels.h"
+#include "Math/GridVertexData.h"
+#include "Utility/BufferUpdater.h"
+#include "Utility/CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	//Camera behind and above the origin, tilted down a little so the origin is in view (as are the zeroes padding a BoundsArray)
+	//Built the same way as Camera::UpdateMatrices
+	Frustum MakeFrustum(float yaw)
+	{
+		CMatrix4x4 world = MatrixRotationX(0.3f) * MatrixRotationY(yaw) * MatrixTranslation(CVector3(0.0f, 50.0f, -300.0f));
+
+		CMatrix4x4 projection = MatrixPerspectiveFOVx(1.2f, 16.0f / 9.0f, 1.0f, 2000.0f);
+		return Frustum(InverseAffine(world) * projection);
+	}
+
+	//Random boxes scattered all around the camera, so plenty are inside, outside and crossing the planes
+	void MakeBoxes(int count, unsigned seed, std::vector<BoundingBox>& boxes)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-2500.0f, 2500.0f);
+		std::uniform_real_distribution<float> size(0.5f, 60.0f);
+		boxes.resize(count);
+		for (auto& box : boxes)
+		{
+			CVector3 centre(position(random), position(random) * 0.1f, position(random));
+			CVector3 extents(size(random), size(random), size(random));
+			box = BoundingBox(centre - extents, centre + extents);
+		}
+	}
+
+	//True if the box comes within rounding distance of any plane, where the kernels and Frustum::Intersects can disagree
+	bool NearPlane(const Frustum& frustum, const CVector3& centre, float reachX, float reachY, float reachZ, bool sphere)
+	{
+		for (int i = 0; i < Frustum::NumPlanes; ++i)
+		{
+			const auto& plane = frustum.Plane(i);
+			float reach = sphere ? reachX : std::abs(plane.Normal.x) * reachX + std::abs(plane.Normal.y) * reachY + std::abs(plane.Normal.z) * reachZ;
+			if (std::abs(plane.Distance(centre) + reach) < 1e-2f)  return true;
+		}
+		return false;
+	}
+
+	//Check one kernel against Frustum::Intersects for every count up to the number of boxes given
+	void CheckKernel(const char* name, void (*kernel)(const FrustumCullArgs&), bool spheres, const Frustum& frustum,
+	                 const std::vector<BoundingBox>& boxes, const std::vector<int>& counts)
+	{
+		float planes[Frustum::NumPlanes * 4];
+		for (int i = 0; i < Frustum::NumPlanes; ++i)
+		{
+			const auto& plane = frustum.Plane(i);
+			planes[i * 4 + 0] = plane.Normal.x;
+			planes[i * 4 + 1] = plane.Normal.y;
+			planes[i * 4 + 2] = plane.Normal.z;
+			planes[i * 4 + 3] = plane.D;
+		}
+
+		for (int count : counts)
+		{
+			BoundsArray bounds;
+			for (int i = 0; i < count; ++i)
+			{
+				if (spheres)  bounds.Add(BoundingSphere(boxes[i]));
+				else          bounds.Add(boxes[i]);
+			}
+
+			//Fill the mask with garbage first, every word must be overwritten
+			std::vector<uint32_t> visible(VisibilityMaskWords(count), 0xdeadbeef);
+			FrustumCullArgs args = { planes, bounds.CentreX(), bounds.CentreY(), bounds.CentreZ(), bounds.ExtentX(), bounds.ExtentY(), bounds.ExtentZ(),
+			                         bounds.Radius(), count, visible.data() };
+			kernel(args);
+
+			int numVisible = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				bool expected = spheres ? frustum.Intersects(BoundingSphere(boxes[i])) : frustum.Intersects(boxes[i]);
+				numVisible += IsVisible(visible, i);
+				if (IsVisible(visible, i) == expected)  continue;
+
+				CVector3 extents = boxes[i].Extents();
+				if (spheres ? !NearPlane(frustum, boxes[i].Centre(), Length(extents), 0, 0, true)
+				            : !NearPlane(frustum, boxes[i].Centre(), extents.x, extents.y, extents.z, false))
+				{
+					throw std::runtime_error(std::string(name) + (spheres ? " sphere" : " box") + " culling disagrees with Frustum::Intersects");
+				}
+			}
+			for (int i = count; i < VisibilityMaskWords(count) * 32; ++i)
+			{
+				if (IsVisible(visible, i))  throw std::runtime_error(std::string(name) + " culling set bits past the last bound");
+			}
+			if (count >= 1000 && (numVisible == 0 || numVisible == count))  throw std::runtime_error("Culling test boxes are all inside or all outside");
+		}
+	}
+
+	//Corners of transformed boxes must lie inside the box TransformBox gives
+	void CheckTransformBox()
+	{
+		CMatrix4x4 m = MatrixScaling(CVector3(2.0f, 0.5f, 3.0f)) * MatrixRotationZ(0.4f) * MatrixRotationX(-1.1f) * MatrixRotationY(2.3f) *
+		               MatrixTranslation(CVector3(10.0f, -4.0f, 7.0f));
+		BoundingBox box(CVector3(-1.0f, -2.0f, 0.5f), CVector3(3.0f, 1.0f, 4.0f));
+		BoundingBox transformed = TransformBox(box, m);
+
+		BoundingBox corners;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			CVector3 p((corner & 1) ? box.Max.x : box.Min.x, (corner & 2) ? box.Max.y : box.Min.y, (corner & 4) ? box.Max.z : box.Min.z);
+			corners.Add(CVector3(p.x * m.e00 + p.y * m.e10 + p.z * m.e20 + m.e30,
+			                     p.x * m.e01 + p.y * m.e11 + p.z * m.e21 + m.e31,
+			                     p.x * m.e02 + p.y * m.e12 + p.z * m.e22 + m.e32));
+		}
+
+		//The box around the transformed corners is exactly the transformed box
+		if (Length(corners.Min - transformed.Min) > 1e-4f || Length(corners.Max - transformed.Max) > 1e-4f)
+		{
+			throw std::runtime_error("TransformBox doesn't fit the transformed corners");
+		}
+	}
+
+	//GridVertexData's bounds against the positions it wrote, after a build and after an edit
+	void CheckGridBounds()
+	{
+		FractalNoise fractal(5);
+		HeightField heightMap(130, 130);
+		fractal.Generate(heightMap);
+
+		GridVertexData vertices(GridVertexLayout::Make(true, false, true));
+		vertices.Build(CVector3(-50.0f, 0.0f, 20.0f), CVector3(70.0f, 0.0f, 90.0f), 128, 128, heightMap);
+
+		auto positionBounds = [&]()
+		{
+			BoundingBox bounds;
+			for (unsigned int i = 0; i < vertices.NumVertices(); ++i)
+			{
+				CVector3 position;
+				std::memcpy(&position, vertices.Data() + i * vertices.Layout().VertexSize + vertices.Layout().PositionOffset, sizeof(position));
+				bounds.Add(position);
+			}
+			return bounds;
+		};
+
+		BoundingBox expected = positionBounds();
+		if (Length(expected.Min - vertices.Bounds().Min) > 1e-4f || Length(expected.Max - vertices.Bounds().Max) > 1e-4f)
+		{
+			throw std::runtime_error("Grid bounds don't match the vertex positions");
+		}
+
+		//Raise a spike, the bounds must grow to take it in
+		heightMap(64, 100) += 1000.0f;
+		CpuBufferUpdater buffer(vertices.Data(), vertices.SizeInBytes());
+		vertices.Update(heightMap, nullptr, GridRegion(64, 100, 64, 100), buffer);
+		if (std::abs(positionBounds().Max.y - vertices.Bounds().Max.y) > 1e-4f)  throw std::runtime_error("Grid bounds didn't grow after an edit");
+	}
+}
+
+void RunFrustumCullingBenchmark()
+{
+	CheckTransformBox();
+	CheckGridBounds();
+
+	std::vector<BoundingBox> boxes;
+	MakeBoxes(5000, 7, boxes);
+	const std::vector<int> counts = { 1, 3, 7, 8, 9, 31, 32, 33, 100, 1001, 5000 };
+	for (float yaw : { 0.0f, 0.2f, -0.3f })
+	{
+		Frustum frustum = MakeFrustum(yaw);
+		CheckKernel("SSE2", CullBoxesSSE2, false, frustum, boxes, counts);
+		CheckKernel("SSE2", CullSpheresSSE2, true, frustum, boxes, counts);
+		if (GetCpuFeatures().avx2 && GetCpuFeatures().fma)
+		{
+			CheckKernel("AVX2", CullBoxesAVX2, false, frustum, boxes, counts);
+			CheckKernel("AVX2", CullSpheresAVX2, true, frustum, boxes, counts);
+		}
+	}
+
+	//Timing
+	const int count = 1 << 20;
+	MakeBoxes(count, 11, boxes);
+	BoundsArray bounds;
+	bounds.Reserve(count);
+	for (const auto& box : boxes)  bounds.Add(box);
+	Frustum frustum = MakeFrustum(0.5f);
+
+	std::vector<uint32_t> visible;
+	double scalar = TimeBestOf(5, [&]
+	{
+		visible.assign(VisibilityMaskWords(count), 0);
+		for (int i = 0; i < count; ++i)
+		{
+			if (frustum.Intersects(boxes[i]))  visible[i / 32] |= 1u << (i % 32);
+		}
+		DoNotOptimise(visible.data());
+	});
+	double batched = TimeBestOf(5, [&] { CullBoxes(frustum, bounds, visible); DoNotOptimise(visible.data()); });
+	double spheres = TimeBestOf(5, [&] { CullSpheres(frustum, bounds, visible); DoNotOptimise(visible.data()); });
+
+	ReportThroughput("Frustum::Intersects, 1M boxes", scalar, count, "boxes");
+	ReportThroughput(std::string("CullBoxes (") + FrustumCullingKernelName() + "), 1M boxes", batched, count, "boxes");
+	ReportThroughput(std::string("CullSpheres (") + FrustumCullingKernelName() + "), 1M spheres", spheres, count, "spheres");
+	ReportComparison("Box culling, one at a time -> batched", scalar, batched);
+}
@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------------------
+// Grid updates: rebuilding every vertex against rewriting only the rows a brush touched
+//--------------------------------------------------------------------------------------
+// GridVertexData uploads through a CpuBufferUpdater here, standing in for the GPU buffer.
+// Also checks that after a series of small edits the uploaded data is exactly what a full
+// rebuild from the edited heights gives, including edits at the edges of the grid
+
+#include "Benchmark.h"
+#include "Math/FractalNoise.h"
+#include "Math/GridVertexData.h"
+#include "Math/HeightField.h"
+#include "Utility/BufferUpdater.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	const CVector3 kMinPt = CVector3(-1000.0f, 0.0f, -1000.0f);
+	const CVector3 kMaxPt = CVector3(1000.0f, 0.0f, 1000.0f);
+
+	//Raise every height in a square, most in the middle, like a sculpting brush, and return the cells it changed
+	//Even the corners of the square are raised so that the edges of the region really change
+	GridRegion ApplyBrush(HeightField& heightMap, int centreX, int centreZ, int radius, float strength)
+	{
+		GridRegion region(std::max(centreX - radius, 0), std::max(centreZ - radius, 0),
+		                  std::min(centreX + radius, heightMap.Width() - 1), std::min(centreZ + radius, heightMap.Height() - 1));
+		for (int z = region.MinZ; z <= region.MaxZ; ++z)
+		{
+			for (int x = region.MinX; x <= region.MaxX; ++x)
+			{
+				float distance = std::sqrt(static_cast<float>((x - centreX) * (x - centreX) + (z - centreZ) * (z - centreZ)));
+				heightMap(x, z) += radius > 0 ? strength * (1.0f - distance / (2 * radius)) : strength;
+			}
+		}
+		return region;
+	}
+}
+
+void RunGridUpdateBenchmark()
+{
+	FractalNoiseSettings settings;
+	settings.Height = 400.0f;
+	FractalNoise fractal(11, settings);
+	auto layout = GridVertexLayout::Make(true, true, true);
+
+	//Grid one cell smaller than the HeightField, so edits just past the last column matter too
+	HeightField check(514, 514);
+	fractal.Generate(check);
+	const int checkSubDiv = 512;
+
+	GridVertexData vertices(layout);
+	vertices.Build(kMinPt, kMaxPt, checkSubDiv, checkSubDiv, check);
+	CpuBufferUpdater buffer(vertices.Data(), vertices.SizeInBytes());
+
+	//Middle, corners, and single heights just outside the grid
+	const int brushes[][3] = { { 200, 300, 20 }, { 0, 0, 5 }, { 512, 512, 7 }, { 513, 100, 0 }, { 100, 513, 0 }, { 250, 1, 1 } };
+	for (auto& brush : brushes)
+	{
+		GridRegion dirty = ApplyBrush(check, brush[0], brush[1], brush[2], 25.0f);
+		vertices.Update(check, nullptr, dirty, buffer);
+	}
+
+	GridVertexData rebuilt(layout);
+	rebuilt.Build(kMinPt, kMaxPt, checkSubDiv, checkSubDiv, check);
+	if (!std::equal(buffer.Data().begin(), buffer.Data().end(), rebuilt.Data()))
+	{
+		throw std::runtime_error("Grid vertices after dirty region updates differ from a full rebuild");
+	}
+	std::cout << "  Updates match a full rebuild, " << std::defaultfloat << 100.0 * buffer.BytesUploaded() / (buffer.NumUpdates() * vertices.SizeInBytes())
+	          << "% of the grid uploaded per brush on average" << std::endl;
+
+	//A brush on a large terrain, against rebuilding and uploading the whole thing
+	HeightField large(4097, 4097);
+	fractal.Generate(large);
+	const int subDiv = 4096;
+
+	GridVertexData largeVertices(layout);
+	largeVertices.Build(kMinPt, kMaxPt, subDiv, subDiv, large);
+	CpuBufferUpdater largeBuffer(largeVertices.Data(), largeVertices.SizeInBytes());
+
+	double rebuildTime = TimeBestOf(3, [&]()
+	{
+		largeVertices.Build(kMinPt, kMaxPt, subDiv, subDiv, large);
+		largeVertices.UploadAll(largeBuffer);
+	});
+
+	int brushNumber = 0;
+	double brushTime = TimeBestOf(10, [&]()
+	{
+		GridRegion dirty = ApplyBrush(large, 1000 + 37 * brushNumber, 2000 + 11 * brushNumber, 32, 5.0f);
+		largeVertices.Update(large, nullptr, dirty, largeBuffer);
+		++brushNumber;
+	});
+	DoNotOptimise(largeBuffer.Data().data());
+
+	ReportComparison("4097^2 full rebuild -> radius 32 brush update", rebuildTime, brushTime);
+}
@@ -0,0 +1,213 @@
+//--------------------------------------------------------------------------------------
+// Grid vertices: per-vertex scalar normals against the SIMD, multithreaded WriteGridVertices
+//--------------------------------------------------------------------------------------
+// Also checks every element of every vertex layout against GridNormalAt, from central
+// differences and from a gradient, including grids smaller than their HeightField, that a
+// gradient of the wrong size is refused, and that the 16 and 32-bit grid indices agree
+
+#include "Benchmark.h"
+#include "Math/FractalNoise.h"
+#include "Math/GridVertices.h"
+#include "Math/HeightField.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const CVector3 kMinPt = CVector3(-500.0f, 0.0f, -250.0f);
+	const CVector3 kMaxPt = CVector3(500.0f, 0.0f, 250.0f);
+	const float kPositionTolerance = 1e-4f; // A few float roundings at the size of the grid
+
+	float MaxDifference(const CVector3& a, const CVector3& b)
+	{
+		return std::max({ std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+	}
+
+	//Largest difference between the normals and tangents written by WriteGridVertices and GridNormalAt
+	//Heights and uvs are checked exactly, they are simple enough that there is no excuse for any difference. x and z
+	//can be a rounding off, as the compiler may fuse the kernel's multiply-adds for instruction sets with FMA
+	float MaxVertexError(const HeightField& heightMap, const HeightFieldGradient* gradient, int subDivX, int subDivZ, const GridVertexLayout& layout)
+	{
+		auto vertexData = std::make_unique<char[]>(static_cast<size_t>(subDivX + 1) * (subDivZ + 1) * layout.VertexSize);
+		WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, subDivX, subDivZ, heightMap, gradient);
+
+		float xStep = (kMaxPt.x - kMinPt.x) / subDivX;
+		float zStep = (kMaxPt.z - kMinPt.z) / subDivZ;
+		float maxError = 0.0f;
+		const char* vertex = vertexData.get();
+		for (int z = 0; z <= subDivZ; ++z)
+		{
+			for (int x = 0; x <= subDivX; ++x, vertex += layout.VertexSize)
+			{
+				auto position = *reinterpret_cast<const CVector3*>(vertex + layout.PositionOffset);
+				CVector3 expected = CVector3(kMinPt.x + x * xStep, heightMap(x, z), kMinPt.z + z * zStep);
+				if (std::abs(position.x - expected.x) > kPositionTolerance || position.y != expected.y || std::abs(position.z - expected.z) > kPositionTolerance)
+				{
+					throw std::runtime_error("Grid vertex position is wrong at " + std::to_string(x) + ", " + std::to_string(z));
+				}
+				if (layout.HasUVs())
+				{
+					auto uv = *reinterpret_cast<const CVector2*>(vertex + layout.UVOffset);
+					if (uv.x != x * (1.0f / subDivX) || uv.y != 1.0f - z * (1.0f / subDivZ))
+					{
+						throw std::runtime_error("Grid vertex uv is wrong at " + std::to_string(x) + ", " + std::to_string(z));
+					}
+				}
+
+				CVector3 normal, tangent;
+				GridNormalAt(heightMap, gradient, x, z, xStep, zStep, normal, tangent);
+				if (layout.HasNormals())
+				{
+					maxError = std::max(maxError, MaxDifference(normal, *reinterpret_cast<const CVector3*>(vertex + layout.NormalOffset)));
+				}
+				if (layout.HasTangents())
+				{
+					auto written = *reinterpret_cast<const CVector3*>(vertex + layout.TangentOffset);
+					maxError = std::max(maxError, MaxDifference(tangent, written));
+
+					//The normal mapping shaders build the bitangent with a cross product, so the two must be perpendicular
+					auto writtenNormal = *reinterpret_cast<const CVector3*>(vertex + layout.NormalOffset);
+					maxError = std::max(maxError, std::abs(Dot(written, writtenNormal)));
+				}
+			}
+		}
+		return maxError;
+	}
+
+	//Check the 16 and 32-bit indices of a grid are the same and every triangle is inside the grid
+	void CheckGridIndices(int subDivX, int subDivZ)
+	{
+		size_t count = GridIndexCount(subDivX, subDivZ);
+		std::vector<uint16_t> shortIndices(count);
+		std::vector<uint32_t> indices(count);
+		WriteGridIndices(shortIndices.data(), subDivX, subDivZ);
+		WriteGridIndices(indices.data(), subDivX, subDivZ);
+
+		uint32_t numVertices = static_cast<uint32_t>((subDivX + 1) * (subDivZ + 1));
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (shortIndices[i] != indices[i] || indices[i] >= numVertices)
+			{
+				throw std::runtime_error("Grid indices are wrong for " + std::to_string(subDivX) + " x " + std::to_string(subDivZ));
+			}
+		}
+
+		//First square of the second row, same winding as the grid has always used
+		size_t square = static_cast<size_t>(subDivX) * 6;
+		uint32_t tl = static_cast<uint32_t>(subDivX + 1);
+		uint32_t expected[6] = { tl, tl + subDivX + 1, tl + 1, tl + 1, tl + subDivX + 1, tl + subDivX + 2 };
+		if (subDivZ > 1 && !std::equal(expected, expected + 6, indices.begin() + square))
+		{
+			throw std::runtime_error("Grid index winding is wrong");
+		}
+	}
+
+	//What the grid mesh did before, one vertex at a time on the calling thread
+	void WriteGridVerticesScalar(char* vertexData, const GridVertexLayout& layout, int subDivX, int subDivZ, const HeightField& heightMap)
+	{
+		float xStep = (kMaxPt.x - kMinPt.x) / subDivX;
+		float zStep = (kMaxPt.z - kMinPt.z) / subDivZ;
+		char* vertex = vertexData;
+		for (int z = 0; z <= subDivZ; ++z)
+		{
+			for (int x = 0; x <= subDivX; ++x, vertex += layout.VertexSize)
+			{
+				CVector3 normal, tangent;
+				GridNormalAt(heightMap, nullptr, x, z, xStep, zStep, normal, tangent);
+				*reinterpret_cast<CVector3*>(vertex + layout.PositionOffset) = CVector3(kMinPt.x + x * xStep, heightMap(x, z), kMinPt.z + z * zStep);
+				*reinterpret_cast<CVector3*>(vertex + layout.NormalOffset) = normal;
+				*reinterpret_cast<CVector3*>(vertex + layout.TangentOffset) = tangent;
+				*reinterpret_cast<CVector2*>(vertex + layout.UVOffset) = CVector2(x / static_cast<float>(subDivX), 1.0f - z / static_cast<float>(subDivZ));
+			}
+		}
+	}
+}
+
+void RunGridVerticesBenchmark()
+{
+	FractalNoiseSettings settings;
+	settings.Type = EFractalType::Ridged;
+	settings.Frequency = 1.0 / 64.0;
+	settings.Height = 300.0f;
+	FractalNoise fractal(7, settings);
+
+	//Odd sizes so rows end part way through a group of vertices
+	HeightField check(301, 157);
+	HeightFieldGradient gradient;
+	fractal.Generate(check, gradient);
+
+	float maxError = 0.0f;
+	for (int elements = 0; elements < 8; ++elements)
+	{
+		auto layout = GridVertexLayout::Make((elements & 1) != 0, (elements & 2) != 0, (elements & 4) != 0);
+
+		//The whole HeightField, then a grid smaller than it so the last row and column use central differences too
+		maxError = std::max(maxError, MaxVertexError(check, nullptr, 300, 156, layout));
+		maxError = std::max(maxError, MaxVertexError(check, nullptr, 297, 150, layout));
+		maxError = std::max(maxError, MaxVertexError(check, &gradient, 300, 156, layout));
+	}
+	std::cout << "  Max normal / tangent difference from GridNormalAt(): " << std::defaultfloat << maxError
+	          << " (tolerance " << kGridNormalTolerance << ")" << std::endl;
+	if (maxError > kGridNormalTolerance)
+	{
+		throw std::runtime_error("WriteGridVertices differs from GridNormalAt");
+	}
+
+	//A gradient of another size would be read past its end, or at the wrong cells
+	{
+		auto layout = GridVertexLayout::Make(true, false, false);
+		HeightFieldGradient smaller;
+		smaller.Resize(check.Width() - 1, check.Height());
+		auto vertexData = std::make_unique<char[]>(static_cast<size_t>(301) * 157 * layout.VertexSize);
+		if (!Throws([&] { WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, 300, 156, check, &smaller); }))
+		{
+			throw std::runtime_error("WriteGridVertices used a gradient smaller than the HeightField");
+		}
+		smaller.DX.Resize(check.Width(), check.Height());
+		if (!Throws([&] { WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, 300, 156, check, &smaller); }))
+		{
+			throw std::runtime_error("WriteGridVertices used a gradient with a smaller DZ");
+		}
+	}
+
+	//Largest grid that fits in 16-bit indices, and a non-square one
+	if (!GridFitsSixteenBitIndices(255, 255) || GridFitsSixteenBitIndices(256, 255))
+	{
+		throw std::runtime_error("Wrong choice of 16-bit grid indices");
+	}
+	CheckGridIndices(255, 255);
+	CheckGridIndices(37, 11);
+
+	//Full vertex with tangents, the layout the normal mapping shaders need
+	HeightField large(4097, 4097);
+	fractal.Generate(large, gradient);
+	const int subDiv = 4096;
+	const double vertices = 4097.0 * 4097.0;
+	auto layout = GridVertexLayout::Make(true, true, true);
+	auto vertexData = std::make_unique<char[]>(static_cast<size_t>(vertices) * layout.VertexSize);
+	ThreadPool singleThread(0);
+
+	double scalarTime   = TimeBestOf(3, [&]() { WriteGridVerticesScalar(vertexData.get(), layout, subDiv, subDiv, large); });
+	double serialTime   = TimeBestOf(3, [&]() { WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, subDiv, subDiv, large, nullptr, &singleThread); });
+	double parallelTime = TimeBestOf(3, [&]() { WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, subDiv, subDiv, large); });
+	double gradientTime = TimeBestOf(3, [&]() { WriteGridVertices(vertexData.get(), layout, kMinPt, kMaxPt, subDiv, subDiv, large, &gradient); });
+	DoNotOptimise(vertexData.get());
+
+	ReportThroughput("4097^2 scalar per vertex", scalarTime, vertices, "vertices");
+	ReportComparison("4097^2 scalar -> WriteGridVertices, 1 thread", scalarTime, serialTime);
+	ReportThroughput(std::string("4097^2 WriteGridVertices (") + GridVerticesKernelName() + "), " + std::to_string(ThreadPool::Get().NumThreads()) + " threads", parallelTime, vertices, "vertices");
+	ReportThroughput("4097^2 WriteGridVertices from gradient", gradientTime, vertices, "vertices");
+
+	//Regenerating used to rebuild all the indices too, now they are built once and shared through GridIndexCache
+	std::vector<uint32_t> indices(GridIndexCount(subDiv, subDiv));
+	double indexTime = TimeBestOf(3, [&]() { WriteGridIndices(indices.data(), subDiv, subDiv); });
+	DoNotOptimise(indices.data());
+	ReportResult("4097^2 index rebuild saved per regeneration", indexTime);
+}
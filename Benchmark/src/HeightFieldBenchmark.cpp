@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// Nested std::vector heightmaps against the flat HeightField
+//--------------------------------------------------------------------------------------
+// Measures the three things the terrain pipeline does with a heightmap: allocating it (new, and
+// again as it is regenerated), streaming it row by row into grid vertices and running a
+// neighbour stencil over it
+
+#include "Benchmark.h"
+#include "Math/HeightField.h"
+#include "Math/CVector2.h"
+#include "Math/CVector3.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+
+namespace
+{
+	using NestedHeightMap = std::vector<std::vector<float>>;
+
+	struct GridVertex
+	{
+		CVector3 position;
+		CVector3 normal;
+		CVector2 uv;
+	};
+
+	//Same loop as the grid mesh builder, writes a position / normal / uv vertex for every height
+	template <class HeightMapType>
+	void BuildVertices(const HeightMapType& heightMap, int size, GridVertex* vertices)
+	{
+		const float step = 1.0f / (size - 1);
+		for (int z = 0; z < size; ++z)
+		{
+			const auto& row = heightMap[z];
+			for (int x = 0; x < size; ++x)
+			{
+				vertices->position = { x * step, row[x], z * step };
+				vertices->normal   = { 0.0f, 1.0f, 0.0f };
+				vertices->uv       = { x * step, 1.0f - z * step };
+				++vertices;
+			}
+		}
+	}
+
+	//Four neighbour average in the style of the diamond step, reads across rows as well as along them. Like the diamond
+	//step it walks along each row in turn
+	template <class HeightMapType>
+	void Smooth(const HeightMapType& source, HeightMapType& destination, int size)
+	{
+		for (int z = 1; z < size - 1; ++z)
+		{
+			for (int x = 1; x < size - 1; ++x)
+			{
+				destination[z][x] = 0.25f * (source[z][x - 1] + source[z][x + 1] + source[z - 1][x] + source[z + 1][x]);
+			}
+		}
+	}
+
+	//Fill a heightmap with a simple pattern so the stencil has something to work on
+	template <class HeightMapType>
+	void FillPattern(HeightMapType& heightMap, int size)
+	{
+		for (int z = 0; z < size; ++z)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				heightMap[z][x] = static_cast<float>((x * 7 + z * 13) & 255);
+			}
+		}
+	}
+
+	void RunForSize(int size)
+	{
+		const int repeats = size > 2048 ? 3 : 10;
+		const std::string label = std::to_string(size) + "^2 ";
+
+		//Allocation and clearing of a new heightmap. Past the allocator's mmap threshold (4097^2 is 64 MB) a HeightField
+		//is new memory from the OS each time, every page faulting in as it is cleared, while the nested rows are small
+		//enough to come back from the heap already faulted in. So here one block only wins on the smaller size
+		double nestedAllocate = TimeBestOf(repeats, [&]()
+		{
+			NestedHeightMap heightMap(size, std::vector<float>(size, 0.0f));
+			DoNotOptimise(heightMap.data());
+		});
+		double flatAllocate = TimeBestOf(repeats, [&]()
+		{
+			HeightField heightMap(size, size, 0.0f);
+			DoNotOptimise(heightMap.Data());
+		});
+		ReportComparison(label + "allocate", nestedAllocate, flatAllocate);
+
+		//Steady state, as the pipeline regenerates a heightmap it keeps: the nested rows are reassigned, the HeightField
+		//keeps its allocation
+		NestedHeightMap nestedKept;
+		HeightField flatKept;
+		double nestedReallocate = TimeBestOf(repeats, [&]()
+		{
+			nestedKept.assign(size, std::vector<float>(size, 0.0f));
+			DoNotOptimise(nestedKept.data());
+		});
+		double flatReallocate = TimeBestOf(repeats, [&]()
+		{
+			flatKept.Resize(size, size, 0.0f);
+			DoNotOptimise(flatKept.Data());
+		});
+		ReportComparison(label + "reallocate", nestedReallocate, flatReallocate);
+
+		NestedHeightMap nested(size, std::vector<float>(size, 0.0f));
+		NestedHeightMap nestedSmoothed(size, std::vector<float>(size, 0.0f));
+		HeightField flat(size, size);
+		HeightField flatSmoothed(size, size);
+		FillPattern(nested, size);
+		FillPattern(flat, size);
+
+		//Grid vertex generation
+		auto vertices = std::make_unique<GridVertex[]>(static_cast<size_t>(size) * size);
+		double nestedVertices = TimeBestOf(repeats, [&]() { BuildVertices(nested, size, vertices.get()); DoNotOptimise(vertices.get()); });
+		double flatVertices   = TimeBestOf(repeats, [&]() { BuildVertices(flat,   size, vertices.get()); DoNotOptimise(vertices.get()); });
+		ReportComparison(label + "build grid vertices", nestedVertices, flatVertices);
+
+		//Neighbour stencil
+		double nestedStencil = TimeBestOf(repeats, [&]() { Smooth(nested, nestedSmoothed, size); DoNotOptimise(nestedSmoothed.data()); });
+		double flatStencil   = TimeBestOf(repeats, [&]() { Smooth(flat,   flatSmoothed,   size); DoNotOptimise(flatSmoothed.Data()); });
+		ReportComparison(label + "4-neighbour stencil", nestedStencil, flatStencil);
+	}
+}
+
+void RunHeightFieldBenchmark()
+{
+	RunForSize(1025);
+	RunForSize(4097);
+}
@@ -0,0 +1,249 @@
+//--------------------------------------------------------------------------------------
+// Matrices: the scalar reference multiply against the SSE operators and the batch functions
+//--------------------------------------------------------------------------------------
+// Also checks every SIMD path against the scalar reference, including multiplying a matrix
+// by itself, working in place, point counts that don't fill the last SIMD register, and
+// that nothing is written past the end of the output. Camera projections are checked
+// against their inverses.
+
+#include "Benchmark.h"
+#include "Math/CMatrix4x4.h"
+#include "Math/MatrixKernels.h"
+#include "Utility/CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float kMatrixTolerance = 1e-4f;
+
+	//Rotation, scale and translation like the ones models and cameras are built from
+	CMatrix4x4 RandomMatrix(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> angle(-3.14f, 3.14f), scale(0.5f, 2.0f), position(-10.0f, 10.0f);
+		return MatrixScaling(CVector3(scale(random), scale(random), scale(random))) *
+		       MatrixRotationZ(angle(random)) * MatrixRotationX(angle(random)) * MatrixRotationY(angle(random)) *
+		       MatrixTranslation(CVector3(position(random), position(random), position(random)));
+	}
+
+	float MaxDifference(const CMatrix4x4& a, const CMatrix4x4& b)
+	{
+		float difference = 0.0f;
+		for (int i = 0; i < 16; ++i)  difference = std::max(difference, std::abs((&a.e00)[i] - (&b.e00)[i]));
+		return difference;
+	}
+
+	void CheckMatrix(const CMatrix4x4& result, const CMatrix4x4& expected, const std::string& what)
+	{
+		if (MaxDifference(result, expected) > kMatrixTolerance)  throw std::runtime_error(what + " doesn't match the reference multiply");
+	}
+
+	void CheckOperators(std::mt19937& random)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			CMatrix4x4 a = RandomMatrix(random), b = RandomMatrix(random);
+			CheckMatrix(a * b, MultiplyReference(a, b), "operator*");
+
+			CMatrix4x4 c = a;
+			c *= b;
+			CheckMatrix(c, MultiplyReference(a, b), "operator*=");
+			c = a;
+			c *= c;
+			CheckMatrix(c, MultiplyReference(a, a), "operator*= by itself");
+		}
+
+		//Matrices from other libraries needn't be aligned
+		float values[17];
+		for (int i = 0; i < 17; ++i)  values[i] = static_cast<float>(i);
+		CMatrix4x4 m;
+		m.SetValues(values + 1);
+		if (m.e00 != 1.0f || m.e33 != 16.0f)  throw std::runtime_error("SetValues from unaligned floats is wrong");
+	}
+
+	//Camera projections, and their inverses for picking: a point projected to the screen and back must come back where it was
+	void CheckProjection(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> fov(0.5f, 2.0f), aspectRatio(0.5f, 2.5f), angle(-3.0f, 3.0f);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f), depth(1.0f, 900.0f);
+		for (int i = 0; i < 200; ++i)
+		{
+			float nearClip = 0.5f, farClip = 1000.0f;
+			CMatrix4x4 projection = MatrixPerspectiveFOVx(fov(random), aspectRatio(random), nearClip, farClip);
+			if (MaxDifference(InversePerspective(projection) * projection, MatrixIdentity()) > kMatrixTolerance)
+			{
+				throw std::runtime_error("InversePerspective isn't the inverse of the projection");
+			}
+
+			//Same as Camera: the view matrix is the inverse of the camera's world matrix
+			CMatrix4x4 world = MatrixRotationZ(angle(random)) * MatrixRotationX(angle(random)) * MatrixRotationY(angle(random)) *
+			                   MatrixTranslation(CVector3(position(random), position(random), position(random)));
+			CMatrix4x4 viewProjection = InverseAffine(world) * projection;
+			CMatrix4x4 inverseViewProjection = InversePerspective(projection) * world;
+
+			//A point in front of the camera, through clip space and back. Depth precision falls off with distance, so the
+			//tolerance grows with it
+			float distance = depth(random);
+			CVector3 point = TransformPoint(CVector3(position(random) * 0.01f, position(random) * 0.01f, distance), world);
+			float clip[4], back[4];
+			for (int column = 0; column < 4; ++column)
+			{
+				const float* m = &viewProjection.e00 + column;
+				clip[column] = point.x * m[0] + point.y * m[4] + point.z * m[8] + m[12];
+			}
+
+			//Picking starts from the point on screen and its depth, i.e. after the divide by w
+			CVector3 screen = CVector3(clip[0], clip[1], clip[2]) * (1.0f / clip[3]);
+			for (int column = 0; column < 4; ++column)
+			{
+				const float* m = &inverseViewProjection.e00 + column;
+				back[column] = screen.x * m[0] + screen.y * m[4] + screen.z * m[8] + m[12];
+			}
+			CVector3 unprojected = CVector3(back[0], back[1], back[2]) * (1.0f / back[3]);
+			if (Length(unprojected - point) > 1e-3f * distance)  throw std::runtime_error("Inverse view-projection doesn't unproject points");
+		}
+	}
+
+	void CheckMultiplyMatrices(const char* name, void (*kernel)(const float*, const float*, float*, size_t), std::mt19937& random)
+	{
+		for (size_t count : { 0, 1, 2, 7, 64 })
+		{
+			std::vector<CMatrix4x4> in(count), out(count + 1);
+			for (auto& matrix : in)  matrix = RandomMatrix(random);
+			CMatrix4x4 m = RandomMatrix(random);
+			out[count] = MatrixIdentity();
+
+			kernel(&in.data()->e00, &m.e00, &out.data()->e00, count);
+			for (size_t i = 0; i < count; ++i)  CheckMatrix(out[i], MultiplyReference(in[i], m), std::string(name) + " MultiplyMatrices");
+			if (MaxDifference(out[count], MatrixIdentity()) != 0.0f)  throw std::runtime_error(std::string(name) + " MultiplyMatrices wrote past the end");
+
+			//In place
+			std::vector<CMatrix4x4> inPlace = in;
+			kernel(&inPlace.data()->e00, &m.e00, &inPlace.data()->e00, count);
+			for (size_t i = 0; i < count; ++i)  CheckMatrix(inPlace[i], out[i], std::string(name) + " MultiplyMatrices in place");
+		}
+	}
+
+	void CheckTransformPoints(const char* name, void (*kernel)(const float*, const float*, float*, size_t), std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		for (size_t count : { 0, 1, 2, 3, 4, 5, 33 })
+		{
+			std::vector<CVector3> in(count), out(count + 1);
+			for (auto& point : in)  point = CVector3(position(random), position(random), position(random));
+			CMatrix4x4 m = RandomMatrix(random);
+			out[count] = CVector3(1.0f, 2.0f, 3.0f);
+
+			kernel(&in.data()->x, &m.e00, &out.data()->x, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (Length(out[i] - TransformPoint(in[i], m)) > kMatrixTolerance * 100.0f)
+				{
+					throw std::runtime_error(std::string(name) + " TransformPoints doesn't match TransformPoint");
+				}
+			}
+			if (out[count].x != 1.0f || out[count].y != 2.0f || out[count].z != 3.0f)
+			{
+				throw std::runtime_error(std::string(name) + " TransformPoints wrote past the end");
+			}
+
+			std::vector<CVector3> inPlace = in;
+			kernel(&inPlace.data()->x, &m.e00, &inPlace.data()->x, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (Length(inPlace[i] - out[i]) != 0.0f)  throw std::runtime_error(std::string(name) + " TransformPoints in place is different");
+			}
+		}
+	}
+
+	//Random parents-first hierarchy, like a mesh's nodes
+	void MakeHierarchy(size_t count, std::mt19937& random, std::vector<CMatrix4x4>& relative, std::vector<unsigned int>& parents)
+	{
+		relative.resize(count);
+		parents.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			relative[i] = RandomMatrix(random);
+			parents[i] = i == 0 ? 0 : std::uniform_int_distribution<unsigned int>(static_cast<unsigned int>(i > 8 ? i - 8 : 0), static_cast<unsigned int>(i - 1))(random);
+		}
+	}
+
+	void CheckHierarchy(std::mt19937& random)
+	{
+		std::vector<CMatrix4x4> relative;
+		std::vector<unsigned int> parents;
+		MakeHierarchy(200, random, relative, parents);
+
+		//Keep the scale down over deep chains, so errors are compared at a sensible size
+		for (auto& matrix : relative)  matrix.SetRow(3, matrix.GetRow(3) * 0.1f);
+		for (auto& matrix : relative)  for (int row = 0; row < 3; ++row)  matrix.SetRow(row, Normalise(matrix.GetRow(row)));
+
+		std::vector<CMatrix4x4> absolute(relative.size()), expected(relative.size());
+		ConcatenateHierarchy(relative.data(), parents.data(), absolute.data(), relative.size());
+		expected[0] = relative[0];
+		for (size_t i = 1; i < relative.size(); ++i)  expected[i] = MultiplyReference(relative[i], expected[parents[i]]);
+		for (size_t i = 0; i < relative.size(); ++i)  CheckMatrix(absolute[i], expected[i], "ConcatenateHierarchy");
+
+		ConcatenateHierarchy(relative.data(), parents.data(), relative.data(), relative.size());
+		for (size_t i = 0; i < relative.size(); ++i)  CheckMatrix(relative[i], expected[i], "ConcatenateHierarchy in place");
+	}
+}
+
+void RunMatrixBenchmark()
+{
+	std::mt19937 random(42);
+	CheckOperators(random);
+	CheckHierarchy(random);
+	CheckProjection(random);
+	CheckMultiplyMatrices("SSE2", MultiplyMatricesSSE2, random);
+	CheckTransformPoints("SSE2", TransformPointsSSE2, random);
+	if (GetCpuFeatures().avx2 && GetCpuFeatures().fma)
+	{
+		CheckMultiplyMatrices("AVX2", MultiplyMatricesAVX2, random);
+		CheckTransformPoints("AVX2", TransformPointsAVX2, random);
+	}
+
+	//Single products, as Model::SetRotation and Camera::UpdateMatrices use them. Few enough matrices to stay in the
+	//cache, so this measures the arithmetic rather than memory bandwidth
+	const size_t count = 1 << 12;
+	std::vector<CMatrix4x4> in(count), out(count);
+	for (auto& matrix : in)  matrix = RandomMatrix(random);
+	CMatrix4x4 m = RandomMatrix(random);
+
+	double reference = TimeBestOf(10, [&] { for (size_t i = 0; i < count; ++i)  out[i] = MultiplyReference(in[i], m);  DoNotOptimise(out.data()); });
+	double sse = TimeBestOf(10, [&] { for (size_t i = 0; i < count; ++i)  out[i] = in[i] * m;  DoNotOptimise(out.data()); });
+	double batch = TimeBestOf(10, [&] { MultiplyMatrices(in.data(), m, out.data(), count);  DoNotOptimise(out.data()); });
+	ReportThroughput("MultiplyReference, 4K products", reference, count, "matrices");
+	ReportThroughput("operator* (SSE), 4K products", sse, count, "matrices");
+	ReportThroughput(std::string("MultiplyMatrices (") + MatrixKernelName() + "), 4K products", batch, count, "matrices");
+	ReportComparison("Matrix products, reference -> batch", reference, batch);
+
+	//A big hierarchy, as a scene of skinned characters would have
+	std::vector<CMatrix4x4> relative;
+	std::vector<unsigned int> parents;
+	MakeHierarchy(count, random, relative, parents);
+	double hierarchyReference = TimeBestOf(10, [&]
+	{
+		out[0] = relative[0];
+		for (size_t i = 1; i < count; ++i)  out[i] = MultiplyReference(relative[i], out[parents[i]]);
+		DoNotOptimise(out.data());
+	});
+	double hierarchy = TimeBestOf(10, [&] { ConcatenateHierarchy(relative.data(), parents.data(), out.data(), count);  DoNotOptimise(out.data()); });
+	ReportComparison("4K node hierarchy, reference -> batch", hierarchyReference, hierarchy);
+
+	//Points
+	const size_t numPoints = 1 << 20;
+	std::vector<CVector3> points(numPoints), transformed(numPoints);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	for (auto& point : points)  point = CVector3(position(random), position(random), position(random));
+	double pointsReference = TimeBestOf(10, [&] { for (size_t i = 0; i < numPoints; ++i)  transformed[i] = TransformPoint(points[i], m);  DoNotOptimise(transformed.data()); });
+	double pointsBatch = TimeBestOf(10, [&] { TransformPoints(points.data(), m, transformed.data(), numPoints);  DoNotOptimise(transformed.data()); });
+	ReportThroughput("TransformPoint, 1M points", pointsReference, numPoints, "points");
+	ReportThroughput(std::string("TransformPoints (") + MatrixKernelName() + "), 1M points", pointsBatch, numPoints, "points");
+}
@@ -0,0 +1,418 @@
+//--------------------------------------------------------------------------------------
+// Mesh loading: cooked meshes read through a memory mapping
+//--------------------------------------------------------------------------------------
+// Mesh used to import every file through assimp, then interleave the vertices, pack the bone
+// weights and reduce the animation keys, every time it loaded. Now the result is cooked to a
+// file once and mapped on later loads: the vertex and index blocks go to the GPU from where they
+// are in the mapping and the clips are copied out already reduced. There are no mesh files to
+// import here, so the asset is a synthetic skinned mesh built as the importer would build it. The
+// mapped load is timed against reading the same file into memory, and reading the cooked clips
+// against reducing their keys again. Also checks the round trip, that stale cooked files are
+// spotted and that damaged ones are rejected rather than used.
+
+#include "Benchmark.h"
+#include "Data/CookedMesh.h"
+#include "Utility/BinaryStream.h"
+#include "Utility/MappedFile.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//Skinned vertex as the importer lays it out: position, normal, uv, then 4 bone bytes and 4 float weights
+	const int kVertexSize = 52, kUVOffset = 24, kBonesOffset = 32;
+
+	const float kFramesPerSecond = 30.0f;
+
+	//Keys at every frame for every node but the root, smooth curves so most keys survive reduction
+	std::vector<AnimationChannelKeys> MakeChannels(unsigned int numNodes, float duration, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f), speed(1.0f, 4.0f);
+		std::vector<AnimationChannelKeys> channels;
+		for (unsigned int node = 1; node < numNodes; ++node)
+		{
+			AnimationChannelKeys keys;
+			keys.Node = node;
+			CVector3 offset(unit(random), unit(random), unit(random)), direction(unit(random), unit(random), unit(random));
+			CVector3 axis = Normalise(CVector3(unit(random), unit(random), unit(random)));
+			float frequency = speed(random), phase = unit(random) * 3.0f;
+			for (float frame = 0; frame <= duration * kFramesPerSecond; ++frame)
+			{
+				float time = frame / kFramesPerSecond;
+				float wave = std::sin(time * frequency + phase);
+				keys.PositionTimes.push_back(time);
+				keys.Positions.push_back(offset + direction * wave);
+				keys.RotationTimes.push_back(time);
+				keys.Rotations.push_back(QuaternionFromAxisAngle(axis, wave * 1.5f));
+				keys.ScaleTimes.push_back(time);
+				keys.Scales.push_back(CVector3(1, 1, 1));
+			}
+			channels.push_back(std::move(keys));
+		}
+		return channels;
+	}
+
+	//A skinned mesh as ImportMesh returns it: a node tree with a sub-mesh on some nodes, and a set of clips
+	CookedMeshData MakeMesh(unsigned int numNodes, unsigned int numSubMeshes, unsigned int numVertices, unsigned int numClips,
+	                        std::mt19937& random, std::vector<std::vector<AnimationChannelKeys>>& clipKeys)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		CookedMeshData data;
+		data.Flags = kCookedMeshBones;
+
+		for (unsigned int n = 0; n < numNodes; ++n)
+		{
+			CookedNode node = {};
+			node.Parent = n == 0 ? 0 : static_cast<uint32_t>(random() % n);
+			node.FirstSubMesh = static_cast<uint32_t>(data.NodeSubMeshes.size());
+			if (n < numSubMeshes)
+			{
+				node.NumSubMeshes = 1;
+				data.NodeSubMeshes.push_back(n);
+			}
+			node.DefaultMatrix = MatrixTranslation(CVector3(unit(random), unit(random), unit(random)));
+			node.OffsetMatrix = MatrixIdentity();
+			data.Nodes.push_back(node);
+			data.NodeNames.push_back("Character_Rig:Root_Spine_Chest_" + std::to_string(n));
+		}
+
+		for (unsigned int m = 0; m < numSubMeshes; ++m)
+		{
+			CookedSubMesh subMesh = {};
+			subMesh.VertexSize     = kVertexSize;
+			subMesh.NumVertices    = numVertices;
+			subMesh.NumIndices     = numVertices * 3;
+			subMesh.PositionOffset = 0;
+			subMesh.NormalOffset   = 12;
+			subMesh.TangentOffset  = -1;
+			subMesh.UVOffset       = kUVOffset;
+			subMesh.BonesOffset    = kBonesOffset;
+			subMesh.BoundsMin      = CVector3(-1, -1, -1);
+			subMesh.BoundsMax      = CVector3(1, 1, 1);
+			data.SubMeshes.push_back(subMesh);
+
+			std::vector<unsigned char> vertices(static_cast<size_t>(numVertices) * kVertexSize);
+			for (auto& byte : vertices)  byte = static_cast<unsigned char>(random());
+			std::vector<uint32_t> indices(subMesh.NumIndices);
+			for (auto& index : indices)  index = random() % numVertices;
+			data.Vertices.push_back(std::move(vertices));
+			data.Indices.push_back(std::move(indices));
+		}
+
+		for (unsigned int c = 0; c < numClips; ++c)
+		{
+			float duration = 2.0f + c;
+			clipKeys.push_back(MakeChannels(numNodes, duration, random));
+			data.Animations.emplace_back("Clip" + std::to_string(1000 + c), duration, numNodes, clipKeys.back());
+		}
+		return data;
+	}
+
+	//Check a cooked mesh holds exactly the data it was cooked from
+	void CheckRoundTrip(const CookedMeshData& data, const CookedMesh& cooked)
+	{
+		if (cooked.HasBones() != ((data.Flags & kCookedMeshBones) != 0) || cooked.HasTangents() != ((data.Flags & kCookedMeshTangents) != 0) ||
+		    cooked.NumberNodes() != data.Nodes.size() || cooked.NumberSubMeshes() != data.SubMeshes.size() ||
+		    cooked.NumberNodeSubMeshes() != data.NodeSubMeshes.size())
+		{
+			throw std::runtime_error("Cooked mesh has the wrong counts or flags");
+		}
+
+		for (unsigned int n = 0; n < cooked.NumberNodes(); ++n)
+		{
+			const CookedNode& node = cooked.Node(n);
+			const CookedNode& original = data.Nodes[n];
+			if (cooked.NodeName(n) != data.NodeNames[n] || cooked.NodeName(n).data()[cooked.NodeName(n).size()] != '\0' ||
+			    node.Parent != original.Parent || node.FirstSubMesh != original.FirstSubMesh || node.NumSubMeshes != original.NumSubMeshes ||
+			    std::memcmp(&node.DefaultMatrix, &original.DefaultMatrix, sizeof(CMatrix4x4)) != 0 ||
+			    std::memcmp(&node.OffsetMatrix, &original.OffsetMatrix, sizeof(CMatrix4x4)) != 0)
+			{
+				throw std::runtime_error("Cooked mesh node " + std::to_string(n) + " doesn't match");
+			}
+		}
+		if (!std::equal(data.NodeSubMeshes.begin(), data.NodeSubMeshes.end(), cooked.NodeSubMeshes()))  throw std::runtime_error("Cooked node sub-meshes don't match");
+
+		for (unsigned int m = 0; m < cooked.NumberSubMeshes(); ++m)
+		{
+			const CookedSubMesh& subMesh = cooked.SubMesh(m);
+			const CookedSubMesh& original = data.SubMeshes[m];
+			if (subMesh.VertexSize != original.VertexSize || subMesh.NumVertices != original.NumVertices || subMesh.NumIndices != original.NumIndices ||
+			    subMesh.PositionOffset != original.PositionOffset || subMesh.NormalOffset != original.NormalOffset ||
+			    subMesh.TangentOffset != original.TangentOffset || subMesh.UVOffset != original.UVOffset || subMesh.BonesOffset != original.BonesOffset ||
+			    subMesh.BoundsMin.x != original.BoundsMin.x || subMesh.BoundsMax.z != original.BoundsMax.z)
+			{
+				throw std::runtime_error("Cooked sub-mesh " + std::to_string(m) + " doesn't match");
+			}
+			if (reinterpret_cast<uintptr_t>(cooked.Vertices(m)) % 16 != 0 || reinterpret_cast<uintptr_t>(cooked.Indices(m)) % 16 != 0)
+			{
+				throw std::runtime_error("Cooked sub-mesh " + std::to_string(m) + " blocks aren't aligned");
+			}
+			if (std::memcmp(cooked.Vertices(m), data.Vertices[m].data(), data.Vertices[m].size()) != 0 ||
+			    std::memcmp(cooked.Indices(m), data.Indices[m].data(), data.Indices[m].size() * sizeof(uint32_t)) != 0)
+			{
+				throw std::runtime_error("Cooked sub-mesh " + std::to_string(m) + " blocks don't match");
+			}
+		}
+
+		//Clips sample exactly as the ones they were cooked from
+		std::vector<AnimationClip> animations = cooked.ReadAnimations();
+		if (animations.size() != data.Animations.size())  throw std::runtime_error("Cooked mesh has the wrong number of clips");
+		for (size_t a = 0; a < animations.size(); ++a)
+		{
+			const AnimationClip& clip = animations[a];
+			const AnimationClip& original = data.Animations[a];
+			if (clip.Name() != original.Name() || clip.Duration() != original.Duration() || clip.NumberNodes() != original.NumberNodes() ||
+			    clip.NumberChannels() != original.NumberChannels() || clip.NumberKeys() != original.NumberKeys())
+			{
+				throw std::runtime_error("Cooked clip " + original.Name() + " doesn't match");
+			}
+			for (int c = 0; c < clip.NumberChannels(); ++c)
+			{
+				if (clip.ChannelNode(c) != original.ChannelNode(c))  throw std::runtime_error("Cooked clip " + original.Name() + " animates other nodes");
+				for (float time = 0; time < clip.Duration(); time += 0.37f)
+				{
+					CVector3 p1, s1, p2, s2;
+					CQuaternion r1, r2;
+					clip.SampleChannel(c, time, p1, r1, s1);
+					original.SampleChannel(c, time, p2, r2, s2);
+					if (std::memcmp(&p1, &p2, sizeof(p1)) != 0 || std::memcmp(&r1, &r2, sizeof(r1)) != 0 || std::memcmp(&s1, &s2, sizeof(s1)) != 0)
+					{
+						throw std::runtime_error("Cooked clip " + original.Name() + " samples differently");
+					}
+				}
+			}
+		}
+	}
+
+	//True if loading the cooked image, clips and all, throws
+	bool Rejects(const std::vector<unsigned char>& image)
+	{
+		return Throws([&]
+		{
+			CookedMesh cooked(image.data(), image.size(), "damaged");
+			cooked.ReadAnimations();
+		});
+	}
+
+	//Each kind of damage to a cooked image must be caught
+	void CheckDamaged(const std::vector<unsigned char>& image)
+	{
+		if (Rejects(image))  throw std::runtime_error("Undamaged cooked mesh was rejected");
+
+		CookedMeshHeader header;
+		std::memcpy(&header, image.data(), sizeof(header));
+		auto damage = [&](const char* what, auto change)
+		{
+			std::vector<unsigned char> damaged = image;
+			CookedMeshHeader damagedHeader = header;
+			change(damaged, damagedHeader);
+			std::memcpy(damaged.data(), &damagedHeader, sizeof(damagedHeader));
+			if (Rejects(damaged))  return;
+			throw std::runtime_error(std::string("Cooked mesh with ") + what + " wasn't rejected");
+		};
+		auto node = [&](std::vector<unsigned char>& damaged) { return reinterpret_cast<CookedNode*>(damaged.data() + header.NodesOffset); };
+		auto subMesh = [&](std::vector<unsigned char>& damaged) { return reinterpret_cast<CookedSubMesh*>(damaged.data() + header.SubMeshesOffset); };
+
+		damage("a bad magic", [](auto&, CookedMeshHeader& h) { h.Magic[0] = 'X'; });
+		damage("another version", [](auto&, CookedMeshHeader& h) { ++h.Version; });
+		damage("a missing end", [](auto& d, CookedMeshHeader&) { d.pop_back(); });
+		damage("a wrong file size", [](auto&, CookedMeshHeader& h) { h.FileSize += 16; });
+		damage("nodes off the end", [](auto&, CookedMeshHeader& h) { h.NodesOffset = h.FileSize - 8; });
+		damage("misaligned nodes", [](auto&, CookedMeshHeader& h) { h.NodesOffset += 1; });
+		damage("too many sub-meshes", [](auto&, CookedMeshHeader& h) { h.NumSubMeshes = 1u << 30; });
+		damage("no nodes", [](auto&, CookedMeshHeader& h) { h.NumNodes = 0; });
+		damage("a node name outside the names", [&](auto& d, CookedMeshHeader& h) { node(d)[1].NameOffset = h.NamesSize; node(d)[1].NameLength = 1; });
+		damage("a node parent out of range", [&](auto& d, CookedMeshHeader& h) { node(d)[2].Parent = h.NumNodes; });
+		damage("node sub-meshes out of range", [&](auto& d, CookedMeshHeader& h) { node(d)[0].FirstSubMesh = h.NumNodeSubMeshes; });
+		damage("a missing sub-mesh", [&](auto& d, CookedMeshHeader& h)
+		{
+			reinterpret_cast<uint32_t*>(d.data() + h.NodeSubMeshesOffset)[0] = h.NumSubMeshes;
+		});
+		damage("vertices off the end", [&](auto& d, CookedMeshHeader&) { subMesh(d)[0].NumVertices *= 1000; });
+		damage("indices off the end", [&](auto& d, CookedMeshHeader& h) { subMesh(d)[1].IndicesOffset = h.FileSize; });
+		damage("bones outside the vertex", [&](auto& d, CookedMeshHeader&) { subMesh(d)[0].BonesOffset = kVertexSize - 8; });
+		damage("bones it doesn't have", [&](auto&, CookedMeshHeader& h) { h.Flags &= ~kCookedMeshBones; });
+		damage("no positions", [&](auto& d, CookedMeshHeader&) { subMesh(d)[0].PositionOffset = -1; });
+		damage("more clips than it has", [](auto&, CookedMeshHeader& h) { ++h.NumAnimations; });
+
+		//The first clip's node count, just after its name and duration. Channels for nodes past it must be caught
+		damage("a clip for fewer nodes", [&](auto& d, CookedMeshHeader& h)
+		{
+			BinaryReader reader(d.data(), d.size(), "damaged");
+			reader.Seek(h.AnimationsOffset);
+			reader.ReadString();
+			reader.Read<float>();
+			reader.Align(alignof(uint32_t));
+			uint32_t numNodes = 2;
+			std::memcpy(d.data() + reader.Position(), &numNodes, sizeof(numNodes));
+		});
+	}
+
+	void CheckBinaryReader()
+	{
+		BinaryWriter writer;
+		writer.Write<uint8_t>(7);
+		size_t floats = writer.WriteArray(std::vector<float>{ 1.0f, 2.0f, 3.0f }.data(), 3);
+		writer.WriteString("name");
+		std::vector<unsigned char> block = writer.Release();
+		if (floats != 4 || block.size() != 4 + 12 + 4 + 4)  throw std::runtime_error("BinaryWriter didn't align the floats");
+
+		BinaryReader reader(block.data(), block.size(), "block");
+		if (reader.Read<uint8_t>() != 7 || reader.ReadArray<float>(3)[2] != 3.0f || reader.ReadString() != "name" || reader.Position() != block.size())
+		{
+			throw std::runtime_error("BinaryReader didn't read back what was written");
+		}
+
+		if (!Throws([&] { reader.Read<uint8_t>(); }))                     throw std::runtime_error("BinaryReader read past the end");
+		if (!Throws([&] { reader.ArrayAt<float>(4, 6); }))               throw std::runtime_error("BinaryReader read an array past the end");
+		if (!Throws([&] { reader.ArrayAt<float>(block.size() + 4, 0); }))  throw std::runtime_error("BinaryReader read from past the end");
+		if (!Throws([&] { reader.ArrayAt<float>(1, 1); }))               throw std::runtime_error("BinaryReader read a misaligned float");
+		if (!Throws([&] { reader.ArrayAt<uint32_t>(0, ~size_t(0) / 2); }))  throw std::runtime_error("BinaryReader overflowed a count");
+		if (Throws([&] { reader.ArrayAt<float>(block.size(), 0); }))     throw std::runtime_error("BinaryReader rejected an empty array at the end");
+	}
+
+	//Which cooked files count as current for a source
+	void CheckStaleness(const std::vector<unsigned char>& image, const CookedMeshSource& source)
+	{
+		CookedMeshSource newer = source, resized = source, missing;
+		++newer.Time;
+		++resized.Size;
+		if (!CookedMesh::IsCurrent(image.data(), image.size(), source, false))  throw std::runtime_error("Cooked mesh isn't current for its own source");
+		if (CookedMesh::IsCurrent(image.data(), image.size(), newer, false) || CookedMesh::IsCurrent(image.data(), image.size(), resized, false))
+		{
+			throw std::runtime_error("Cooked mesh is current for a changed source");
+		}
+		if (CookedMesh::IsCurrent(image.data(), image.size(), source, true))  throw std::runtime_error("Cooked mesh without tangents is current for a mesh with them");
+		if (!CookedMesh::IsCurrent(image.data(), image.size(), missing, false))  throw std::runtime_error("Shipped cooked mesh isn't current without its source");
+		if (CookedMesh::IsCurrent(image.data(), sizeof(CookedMeshHeader) - 1, source, false) || CookedMesh::IsCurrent(nullptr, 0, missing, false))
+		{
+			throw std::runtime_error("A truncated cooked mesh is current");
+		}
+
+		std::vector<unsigned char> oldVersion = image;
+		reinterpret_cast<CookedMeshHeader*>(oldVersion.data())->Version = kCookedMeshVersion - 1;
+		if (CookedMesh::IsCurrent(oldVersion.data(), oldVersion.size(), missing, false))  throw std::runtime_error("An old cooked mesh is current");
+	}
+
+	void CheckMappedFile(const std::filesystem::path& folder)
+	{
+		MappedFile file;
+		if (file.Open((folder / "Missing.cmesh").string()) || file.IsOpen())  throw std::runtime_error("MappedFile opened a missing file");
+
+		const std::string emptyName = (folder / "Empty.cmesh").string();
+		WriteFile(emptyName, "");
+		if (!file.Open(emptyName) || !file.IsOpen() || file.Size() != 0)  throw std::runtime_error("MappedFile didn't open an empty file");
+		if (CookedMesh::IsCurrent(file.Data(), file.Size(), CookedMeshSource(), false))  throw std::runtime_error("An empty file is a current cooked mesh");
+		file.Close();
+	}
+
+	//Reading the whole file into memory first, as an ifstream load would
+	void ReadIntoMemory(const std::string& fileName, std::vector<unsigned char>& buffer)
+	{
+		std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+		buffer.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+		if (!file)  throw std::runtime_error("Can't read " + fileName);
+	}
+
+	//What Mesh does with a cooked mesh short of the GPU: view it, copy the blocks to the buffers and read the clips
+	size_t LoadCooked(const void* data, size_t size, std::vector<unsigned char>& upload)
+	{
+		CookedMesh cooked(data, size, "meshload");
+		size_t uploaded = 0;
+		for (unsigned int m = 0; m < cooked.NumberSubMeshes(); ++m)
+		{
+			const CookedSubMesh& subMesh = cooked.SubMesh(m);
+			size_t vertexBytes = static_cast<size_t>(subMesh.NumVertices) * subMesh.VertexSize, indexBytes = subMesh.NumIndices * sizeof(uint32_t);
+			std::memcpy(upload.data(), cooked.Vertices(m), vertexBytes);
+			std::memcpy(upload.data() + vertexBytes, cooked.Indices(m), indexBytes);
+			uploaded += vertexBytes + indexBytes;
+		}
+		std::vector<AnimationClip> animations = cooked.ReadAnimations();
+		DoNotOptimise(animations.data());
+		return uploaded;
+	}
+}
+
+void RunMeshLoadBenchmark()
+{
+	std::mt19937 random(42);
+	CheckBinaryReader();
+
+	const TempFolder temp("EngineMeshLoadBenchmark");
+	const std::filesystem::path& folder = temp.Path();
+	CheckMappedFile(folder);
+
+	std::vector<std::vector<AnimationChannelKeys>> clipKeys;
+	CookedMeshData data = MakeMesh(400, 24, 20000, 6, random, clipKeys);
+	CookedMeshSource source;
+	source.Size = 123456789;
+	source.Time = 987654321;
+	std::vector<unsigned char> image = CookMesh(data, source);
+	CheckRoundTrip(data, CookedMesh(image.data(), image.size(), "in memory"));
+	CheckStaleness(image, source);
+	CheckDamaged(image);
+
+	//Saved, mapped and read back
+	const std::string fileName = (folder / "Mesh.cmesh").string();
+	if (!SaveCookedMesh(fileName, image))  throw std::runtime_error("Can't save " + fileName);
+	if (CookedPartFileName(fileName) == CookedPartFileName(fileName))  throw std::runtime_error("CookedPartFileName gave the same name twice");
+	for (const auto& entry : std::filesystem::directory_iterator(folder))
+	{
+		if (entry.path().extension() == ".part")  throw std::runtime_error("SaveCookedMesh left its part file behind");
+	}
+	{
+		MappedFile mapped(fileName);
+		if (mapped.Size() != image.size() || std::memcmp(mapped.Data(), image.data(), image.size()) != 0)  throw std::runtime_error("Mapped cooked mesh doesn't match what was saved");
+		MappedFile moved = std::move(mapped);
+		if (mapped.IsOpen() || mapped.Data() != nullptr || !moved.IsOpen())  throw std::runtime_error("MappedFile didn't move");
+		CheckRoundTrip(data, CookedMesh(moved.Data(), moved.Size(), fileName));
+	}
+
+	size_t numKeys = 0;
+	for (const auto& keys : clipKeys)
+	{
+		for (const auto& channel : keys)  numKeys += channel.PositionTimes.size() + channel.RotationTimes.size() + channel.ScaleTimes.size();
+	}
+	std::cout << "  " << data.Nodes.size() << " nodes, " << data.SubMeshes.size() << " sub-meshes of " << data.SubMeshes[0].NumVertices
+	          << " vertices, " << data.Animations.size() << " clips from " << numKeys << " keys, " << image.size() / (1024 * 1024) << " MB cooked\n";
+
+	std::vector<unsigned char> buffer, upload(image.size());
+	double readTime = TimeBestOf(5, [&]
+	{
+		ReadIntoMemory(fileName, buffer);
+		DoNotOptimise(upload.data() + LoadCooked(buffer.data(), buffer.size(), upload));
+	});
+	double mappedTime = TimeBestOf(5, [&]
+	{
+		MappedFile mapped(fileName);
+		DoNotOptimise(upload.data() + LoadCooked(mapped.Data(), mapped.Size(), upload));
+	});
+	ReportThroughput("Cooked mesh read into memory", readTime, static_cast<double>(image.size()), "B");
+	ReportThroughput("Cooked mesh memory mapped", mappedTime, static_cast<double>(image.size()), "B");
+	ReportComparison("Loading a cooked mesh", readTime, mappedTime);
+
+	//The clips as the importer built them, against reading them reduced
+	double reduceTime = TimeBestOf(3, [&]
+	{
+		std::vector<AnimationClip> animations;
+		for (size_t c = 0; c < clipKeys.size(); ++c)  animations.emplace_back(data.Animations[c].Name(), data.Animations[c].Duration(), 400, clipKeys[c]);
+		DoNotOptimise(animations.data());
+	});
+	double readClipsTime = TimeBestOf(3, [&]
+	{
+		DoNotOptimise(CookedMesh(image.data(), image.size(), "in memory").ReadAnimations().data());
+	});
+	ReportThroughput("Reducing imported keys", reduceTime, static_cast<double>(numKeys), "keys");
+	ReportThroughput("Reading cooked clips", readClipsTime, static_cast<double>(numKeys), "keys");
+	ReportComparison("Loading animations", reduceTime, readClipsTime);
+}
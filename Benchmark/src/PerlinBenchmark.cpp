@@ -0,0 +1,147 @@
+//--------------------------------------------------------------------------------------
+// Perlin noise: the scalar noise() against the batch GenerateGrid
+//--------------------------------------------------------------------------------------
+// Also checks the batch results stay within CPerlinNoise::kBatchTolerance of noise(),
+// including rows whose length is not a multiple of the SIMD width and negative positions,
+// and that the derivatives agree with noise() and with finite differences of noise()
+
+#include "Benchmark.h"
+#include "Math/CPerlinNoise.h"
+#include "Math/HeightField.h"
+#include "Utility/ThreadPool.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	const double kFrequency = 1.0 / 64.0;
+
+	//Largest difference between GenerateGrid and noise() over the given grid
+	double MaxBatchError(const CPerlinNoise& perlin, int width, int height, double x, double y, double step, double z)
+	{
+		HeightField grid(width, height);
+		perlin.GenerateGrid(grid, x, y, step, step, z);
+
+		double maxError = 0.0;
+		for (int row = 0; row < height; ++row)
+		{
+			for (int column = 0; column < width; ++column)
+			{
+				double expected = perlin.noise(x + column * step, y + row * step, z);
+				maxError = std::max(maxError, std::abs(expected - grid(column, row)));
+			}
+		}
+		return maxError;
+	}
+
+	//Largest difference between the derivatives from GenerateGridDerivatives and from noise() over the given grid
+	double MaxDerivativeError(const CPerlinNoise& perlin, int width, int height, double x, double y, double step, double z)
+	{
+		HeightField grid(width, height), gridDX(width, height), gridDY(width, height);
+		perlin.GenerateGridDerivatives(grid.Data(), gridDX.Data(), gridDY.Data(), width, height, grid.Stride(), x, y, step, step, z);
+
+		double maxError = 0.0;
+		for (int row = 0; row < height; ++row)
+		{
+			for (int column = 0; column < width; ++column)
+			{
+				double dx, dy, dz;
+				double expected = perlin.noise(x + column * step, y + row * step, z, dx, dy, dz);
+				maxError = std::max(maxError, std::abs(expected - grid(column, row)));
+				maxError = std::max(maxError, std::abs(dx - gridDX(column, row)));
+				maxError = std::max(maxError, std::abs(dy - gridDY(column, row)));
+			}
+		}
+		return maxError;
+	}
+
+	//Largest difference between the derivatives from noise() and central differences of noise() at scattered points
+	double MaxFiniteDifferenceError(const CPerlinNoise& perlin)
+	{
+		const double h = 1e-5;
+		double maxError = 0.0;
+		for (int i = 0; i < 1000; ++i)
+		{
+			double x = i * 0.731 - 200.0, y = i * 0.377 + 3.1, z = i * 0.119 - 7.9;
+			double dx, dy, dz;
+			double value = perlin.noise(x, y, z, dx, dy, dz);
+			maxError = std::max(maxError, std::abs(value - perlin.noise(x, y, z)));
+			maxError = std::max(maxError, std::abs(dx - (perlin.noise(x + h, y, z) - perlin.noise(x - h, y, z)) / (2 * h)));
+			maxError = std::max(maxError, std::abs(dy - (perlin.noise(x, y + h, z) - perlin.noise(x, y - h, z)) / (2 * h)));
+			maxError = std::max(maxError, std::abs(dz - (perlin.noise(x, y, z + h) - perlin.noise(x, y, z - h)) / (2 * h)));
+		}
+		return maxError;
+	}
+}
+
+void RunPerlinBenchmark()
+{
+	CPerlinNoise perlin(1234);
+	std::cout << "  batch instruction set: " << CPerlinNoise::BatchInstructionSet() << std::endl;
+
+	//Check against the reference before timing anything
+	double maxError = 0.0;
+	for (int width = 1; width <= 40; ++width)
+	{
+		maxError = std::max(maxError, MaxBatchError(perlin, width, 3, 0.37, 5.1, 0.173, 0.5));
+	}
+	maxError = std::max(maxError, MaxBatchError(perlin, 513, 257, -300.25, -17.8, 0.61, -2.3));
+	maxError = std::max(maxError, MaxBatchError(perlin, 1025, 1025, 0.0, 0.0, kFrequency, 0.0));
+	std::cout << "  max difference from noise(): " << std::defaultfloat << maxError << " (tolerance " << CPerlinNoise::kBatchTolerance << ")" << std::endl;
+	if (maxError > CPerlinNoise::kBatchTolerance)
+	{
+		throw std::runtime_error("Batch Perlin noise differs from noise() by more than the tolerance");
+	}
+
+	double finiteDifferenceError = MaxFiniteDifferenceError(perlin);
+	double derivativeError = 0.0;
+	for (int width = 1; width <= 40; ++width)
+	{
+		derivativeError = std::max(derivativeError, MaxDerivativeError(perlin, width, 3, -0.37, 5.1, 0.173, 0.5));
+	}
+	derivativeError = std::max(derivativeError, MaxDerivativeError(perlin, 513, 257, -300.25, -17.8, 0.61, -2.3));
+	std::cout << "  derivatives: max difference from finite differences " << finiteDifferenceError
+	          << ", batch max difference from noise() " << derivativeError << std::endl;
+	if (finiteDifferenceError > 1e-6 || derivativeError > CPerlinNoise::kBatchTolerance)
+	{
+		throw std::runtime_error("Perlin noise derivatives are wrong");
+	}
+
+	ThreadPool singleThread(0);
+	for (int size : { 1024, 4096 })
+	{
+		const std::string label = std::to_string(size) + "^2 ";
+		const double points = static_cast<double>(size) * size;
+		HeightField grid(size, size);
+
+		double scalarTime = TimeBestOf(size > 1024 ? 1 : 3, [&]()
+		{
+			for (int z = 0; z < size; ++z)
+			{
+				auto row = grid.Row(z);
+				for (int x = 0; x < size; ++x)
+				{
+					row[x] = static_cast<float>(perlin.noise(x * kFrequency, z * kFrequency, 0.0));
+				}
+			}
+		});
+		DoNotOptimise(grid.Data());
+		double batchTime    = TimeBestOf(3, [&]() { perlin.GenerateGrid(grid, 0.0, 0.0, kFrequency, kFrequency, 0.0, &singleThread); });
+		double parallelTime = TimeBestOf(3, [&]() { perlin.GenerateGrid(grid, 0.0, 0.0, kFrequency, kFrequency, 0.0); });
+
+		HeightField gridDX(size, size), gridDY(size, size);
+		double derivativeTime = TimeBestOf(3, [&]()
+		{
+			perlin.GenerateGridDerivatives(grid.Data(), gridDX.Data(), gridDY.Data(), size, size, grid.Stride(), 0.0, 0.0, kFrequency, kFrequency, 0.0);
+		});
+
+		ReportThroughput(label + "noise() per point", scalarTime, points, "points");
+		ReportThroughput(label + "GenerateGrid, 1 thread", batchTime, points, "points");
+		ReportThroughput(label + "GenerateGrid, " + std::to_string(ThreadPool::Get().NumThreads()) + " threads", parallelTime, points, "points");
+		ReportThroughput(label + "GenerateGridDerivatives, " + std::to_string(ThreadPool::Get().NumThreads()) + " threads", derivativeTime, points, "points");
+		ReportComparison(label + "noise() -> GenerateGrid", scalarTime, parallelTime);
+	}
+}
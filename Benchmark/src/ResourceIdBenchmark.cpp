@@ -0,0 +1,176 @@
+//--------------------------------------------------------------------------------------
+// Resource ids: looking resources up by hashed name in a flat hash map
+//--------------------------------------------------------------------------------------
+// CResourceManager kept its textures and meshes in std::maps keyed by the address of the name,
+// so a lookup walked a red-black tree and only found names passed as the same string literal.
+// Now names are hashed to a 64-bit ResourceId (at compile time for fixed names) and kept in a
+// FlatHashMap. Lookups are timed against the old pointer-keyed map and against a std::map
+// keyed by the name itself, which is what looking up runtime-built names correctly costs with
+// a tree. Also checks the hash against known FNV-1a values and the flat map against
+// std::unordered_map through a long run of random inserts, erases and lookups.
+
+#include "Benchmark.h"
+#include "Utility/FlatHashMap.h"
+#include "Utility/ResourceId.h"
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	//Published FNV-1a 64-bit values, and names hash the same narrow or wide. Checked when this file compiles
+	static_assert(ResourceId("").Hash == 0xcbf29ce484222325ull, "FNV-1a of an empty name");
+	static_assert(ResourceId("a").Hash == 0xaf63dc4c8601ec8cull, "FNV-1a of \"a\"");
+	static_assert(ResourceId("foobar").Hash == 0x85944171f73967e8ull, "FNV-1a of \"foobar\"");
+	static_assert(ResourceId(L"foobar") == ResourceId("foobar"), "Wide and narrow names give the same id");
+	static_assert(ResourceId(L"Tree") != ResourceId(L"tree"), "Names are case sensitive");
+
+	struct Resource { int index; };
+
+	std::wstring ResourceName(int i)
+	{
+		return L"Media/Models/Environment/Tree_" + std::to_wstring(i) + L".x";
+	}
+
+	//Random inserts, erases and lookups on a FlatHashMap and a std::unordered_map, which must agree throughout
+	void CheckFlatHashMap(std::mt19937& random)
+	{
+		//Small consecutive keys, so std::hash (often the key itself) relies on the map spreading them
+		FlatHashMap<uint64_t, int> flat;
+		std::unordered_map<uint64_t, int> reference;
+		std::uniform_int_distribution<int> operation(0, 9), key(0, 3000);
+		for (int i = 0; i < 300000; ++i)
+		{
+			uint64_t k = static_cast<uint64_t>(key(random));
+			int op = operation(random);
+			if (op < 4)
+			{
+				auto inserted = flat.Insert(k, i);
+				auto expected = reference.insert({ k, i });
+				if (inserted.second != expected.second || *inserted.first != expected.first->second)  throw std::runtime_error("FlatHashMap insert disagrees");
+			}
+			else if (op < 7)
+			{
+				if (flat.Erase(k) != (reference.erase(k) == 1))  throw std::runtime_error("FlatHashMap erase disagrees");
+			}
+			else
+			{
+				const int* found = flat.Find(k);
+				auto expected = reference.find(k);
+				if ((found != nullptr) != (expected != reference.end()) || (found && *found != expected->second))  throw std::runtime_error("FlatHashMap find disagrees");
+			}
+			if (flat.Size() != reference.size())  throw std::runtime_error("FlatHashMap size disagrees");
+		}
+
+		//Every key is still found, and nothing else is there
+		size_t visited = 0;
+		flat.ForEach([&](const uint64_t& k, int& value)
+		{
+			auto expected = reference.find(k);
+			if (expected == reference.end() || expected->second != value)  throw std::runtime_error("FlatHashMap holds an entry it shouldn't");
+			++visited;
+		});
+		if (visited != reference.size())  throw std::runtime_error("FlatHashMap didn't visit every entry");
+		for (const auto& entry : reference)
+		{
+			if (!flat.Contains(entry.first))  throw std::runtime_error("FlatHashMap lost a key");
+		}
+
+		flat[5000] = 7;
+		if (flat[5000] != 7 || flat.Size() != reference.size() + 1)  throw std::runtime_error("FlatHashMap operator[] didn't add a key");
+		flat.Clear();
+		if (!flat.Empty() || flat.Contains(5000) || flat.Find(reference.begin()->first))  throw std::runtime_error("FlatHashMap didn't clear");
+		flat.Reserve(1000);
+		for (uint64_t k = 0; k < 1000; ++k)  flat.Insert(k, static_cast<int>(k));
+		for (uint64_t k = 0; k < 1000; ++k)  if (*flat.Find(k) != static_cast<int>(k))  throw std::runtime_error("FlatHashMap lost a key after reserving");
+	}
+
+	void CheckResourceNames()
+	{
+		ResourceNames names;
+		std::wstring built = L"Tr";
+		built += L"ee";
+		ResourceId tree = names.Add(L"Tree");
+		if (tree != ResourceId(built) || names.Add(built) != tree || names.Size() != 1)  throw std::runtime_error("A runtime-built name didn't give the literal's id");
+		const std::string unknown = names.Name(ResourceId("Rock"));
+		if (names.Name(tree) != "Tree" || unknown.size() != 17 || unknown[0] != '#')  throw std::runtime_error("ResourceNames named an id wrongly");
+		if (names.Name(ResourceId(uint64_t(0x0123456789abcdefull))) != "#0123456789abcdef")  throw std::runtime_error("ResourceNames didn't name an unknown id by its hash");
+		if (names.Name(names.Add(L"Caf\u00e9")) != "Caf\\u00e9")  throw std::runtime_error("ResourceNames didn't escape a wide name");
+		if (names.Name(names.Add(std::string("Rock"))) != "Rock" || names.Add(L"Rock") != ResourceId("Rock"))  throw std::runtime_error("Narrow and wide names don't share ids");
+	}
+}
+
+void RunResourceIdBenchmark()
+{
+	std::mt19937 random(42);
+	CheckFlatHashMap(random);
+	CheckResourceNames();
+
+	//A large scene's resources, looked up in a random order as models are drawn
+	const int numResources = 4000, numLookups = 2000000;
+	std::vector<Resource> resources(numResources);
+	std::vector<std::wstring> names(numResources);
+	std::map<const wchar_t*, Resource*> pointerMap;
+	std::map<std::wstring, Resource*> nameMap;
+	FlatHashMap<ResourceId, Resource*> flatMap;
+	std::vector<ResourceId> ids(numResources);
+	for (int i = 0; i < numResources; ++i)
+	{
+		resources[i].index = i;
+		names[i] = ResourceName(i);
+		ids[i] = ResourceId(names[i]);
+		pointerMap[names[i].c_str()] = &resources[i];
+		nameMap[names[i]] = &resources[i];
+		if (!flatMap.Insert(ids[i], &resources[i]).second)  throw std::runtime_error("Two resource names have the same id");
+	}
+	std::vector<int> order(numLookups);
+	std::uniform_int_distribution<int> pick(0, numResources - 1);
+	for (int& i : order)  i = pick(random);
+
+	//Names built at runtime only find their resource by name, never in the pointer map
+	const std::wstring rebuilt = ResourceName(17);
+	if (pointerMap.count(rebuilt.c_str()) != 0 || nameMap.at(rebuilt)->index != 17 || (*flatMap.Find(rebuilt))->index != 17)
+	{
+		throw std::runtime_error("A runtime-built name found the wrong resource");
+	}
+
+	long long sum = 0;
+	auto check = [&](long long result) { if (sum != 0 && result != sum) throw std::runtime_error("Maps found different resources");  sum = result; };
+	double pointerTime = TimeBestOf(3, [&]
+	{
+		long long total = 0;
+		for (int i : order)  total += pointerMap.find(names[i].c_str())->second->index;
+		check(total);
+	});
+	double flatIdTime = TimeBestOf(3, [&]
+	{
+		long long total = 0;
+		for (int i : order)  total += (*flatMap.Find(ids[i]))->index;
+		check(total);
+	});
+	double nameTime = TimeBestOf(3, [&]
+	{
+		long long total = 0;
+		for (int i : order)  total += nameMap.find(names[i])->second->index;
+		check(total);
+	});
+	double flatNameTime = TimeBestOf(3, [&]
+	{
+		long long total = 0;
+		for (int i : order)  total += (*flatMap.Find(ResourceId(names[i])))->index;
+		check(total);
+	});
+
+	std::cout << "  " << numResources << " resources, " << numLookups << " lookups\n";
+	ReportThroughput("std::map keyed by name address", pointerTime, numLookups, "lookups");
+	ReportThroughput("FlatHashMap with ResourceIds", flatIdTime, numLookups, "lookups");
+	ReportThroughput("std::map keyed by name", nameTime, numLookups, "lookups");
+	ReportThroughput("FlatHashMap hashing the name", flatNameTime, numLookups, "lookups");
+	ReportComparison("Lookups by id", pointerTime, flatIdTime);
+	ReportComparison("Lookups by runtime name", nameTime, flatNameTime);
+}
@@ -0,0 +1,344 @@
+//--------------------------------------------------------------------------------------
+// Resource pool: reference counts and least recently used eviction under a memory budget
+//--------------------------------------------------------------------------------------
+// CResourceManager kept every texture and mesh it had ever loaded. Its resources now live in a
+// ResourcePool, which evicts the ones nothing references, least recently used first, once they
+// use more than a budget, and the manager loads them again when they are next asked for.
+// A camera moving through a world much larger than the budget is simulated: each frame uses the
+// resources near it, loading those that aren't resident, then the pool is trimmed. The pool keeps
+// its eviction order in a list threaded through the entries, and is timed against the usual
+// alternative of stamping each resource when it is used and sorting the stamps when over
+// budget. Both must evict the same resources. Also checks the pool against that simple model
+// through a long run of random operations, that pinned entries are never evicted but can be
+// removed, and that stale handles are caught.
+
+#include "Benchmark.h"
+#include "Utility/ResourcePool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	void CheckHandles()
+	{
+		ResourcePool pool;
+		ResourceHandle first = pool.Add();
+		ResourceHandle second = pool.Add();
+		if (!pool.IsValid(first) || !pool.IsValid(second) || first == second || pool.IsValid(ResourceHandle()))
+		{
+			throw std::runtime_error("ResourcePool handed out bad handles");
+		}
+
+		//A removed entry's slot is reused with a new generation, so the old handle doesn't find the new entry
+		pool.Remove(first);
+		ResourceHandle reused = pool.Add();
+		if (reused.Index != first.Index || pool.IsValid(first) || !pool.IsValid(reused) || pool.Size() != 2)
+		{
+			throw std::runtime_error("ResourcePool didn't make a removed entry's handle stale");
+		}
+		if (!Throws([&] { pool.Touch(first); }) || !Throws([&] { pool.AddReference(first); }) || !Throws([&] { pool.Remove(first); }))
+		{
+			throw std::runtime_error("ResourcePool accepted a stale handle");
+		}
+
+		pool.AddReference(second);
+		if (!Throws([&] { pool.Remove(second); }))  throw std::runtime_error("ResourcePool removed a referenced entry");
+		pool.Release(second);
+		if (!Throws([&] { pool.Release(second); }))  throw std::runtime_error("ResourcePool released an unreferenced entry");
+
+		//Removing a loaded entry stops counting its memory
+		pool.SetResident(second, { 10, 20 });
+		pool.Remove(second);
+		if (pool.Used().CpuBytes != 0 || pool.Used().GpuBytes != 0)  throw std::runtime_error("ResourcePool still counts a removed entry");
+	}
+
+	void CheckEviction()
+	{
+		ResourcePool pool;
+		std::vector<ResourceHandle> entries;
+		for (int i = 0; i < 6; ++i)
+		{
+			entries.push_back(pool.Add());
+			pool.SetResident(entries.back(), { i < 3 ? size_t(100) : size_t(0), 1000 });
+		}
+
+		//Entry 0 is referenced, entry 1 used recently, so the order is 2, 3, 4, 5, 1 and 0 is kept
+		pool.AddReference(entries[0]);
+		pool.Touch(entries[1]);
+		std::vector<unsigned int> evicted;
+		auto record = [&](ResourceHandle handle) { evicted.push_back(handle.Index); };
+
+		pool.SetBudget({ 1000, 3500 });
+		if (pool.Trim(record) != 3 || evicted != std::vector<unsigned int>{ 2, 3, 4 } || pool.OverBudget())
+		{
+			throw std::runtime_error("ResourcePool didn't evict the least recently used entries");
+		}
+
+		//Only entries using CPU memory help when the CPU memory is over budget
+		evicted.clear();
+		pool.SetBudget({ 100, 100000 });
+		if (pool.Trim(record) != 1 || evicted != std::vector<unsigned int>{ 1 } || pool.IsResident(entries[1]) || !pool.IsResident(entries[5]))
+		{
+			throw std::runtime_error("ResourcePool evicted entries that didn't use the memory over budget");
+		}
+
+		//Referenced entries stay however far over budget, until they are released
+		evicted.clear();
+		pool.SetBudget({ 0, 0 });
+		pool.Trim(record);
+		if (evicted != std::vector<unsigned int>{ 5 } || !pool.IsResident(entries[0]) || !pool.OverBudget())
+		{
+			throw std::runtime_error("ResourcePool evicted a referenced entry");
+		}
+		pool.Release(entries[0]);
+		if (pool.Trim(record) != 1 || pool.Used().CpuBytes != 0 || pool.Used().GpuBytes != 0)
+		{
+			throw std::runtime_error("ResourcePool didn't evict a released entry");
+		}
+
+		//Pinned entries stay too, even once released, until they are unpinned. They can be removed while pinned
+		ResourceHandle pinned = pool.Add();
+		pool.SetResident(pinned, { 10, 10 });
+		pool.SetPinned(pinned, true);
+		pool.AddReference(pinned);
+		pool.Release(pinned);
+		if (pool.Trim(record) != 0 || !pool.IsResident(pinned) || !pool.IsPinned(pinned))  throw std::runtime_error("ResourcePool evicted a pinned entry");
+		pool.SetPinned(pinned, false);
+		if (pool.Trim(record) != 1 || pool.IsResident(pinned))  throw std::runtime_error("ResourcePool didn't evict an unpinned entry");
+		pool.SetResident(pinned, { 10, 10 });
+		pool.SetPinned(pinned, true);
+		pool.Remove(pinned);
+		if (pool.IsValid(pinned) || pool.Used().CpuBytes != 0 || pool.Used().GpuBytes != 0)  throw std::runtime_error("ResourcePool didn't remove a pinned entry");
+	}
+
+	//Random operations on a pool and on a model that stamps entries when they are used and sorts the stamps to evict.
+	//They must agree on what is evicted and in which order
+	void CheckAgainstModel(std::mt19937& random)
+	{
+		struct ModelEntry
+		{
+			ResourceHandle handle;
+			unsigned int   references = 0;
+			bool           resident   = false;
+			ResourceMemory memory;
+			unsigned long long stamp  = 0;
+		};
+		ResourcePool pool;
+		std::vector<ModelEntry> model;
+		std::vector<ResourceHandle> removed;
+		ResourceMemory used;
+		unsigned long long clock = 0;
+
+		std::uniform_int_distribution<int> operation(0, 9), bytes(0, 3);
+		for (int step = 0; step < 200000; ++step)
+		{
+			const int op = model.empty() ? 0 : operation(random);
+			const size_t pick = model.empty() ? 0 : std::uniform_int_distribution<size_t>(0, model.size() - 1)(random);
+			if (op == 0 && model.size() < 64)
+			{
+				model.push_back({ pool.Add() });
+			}
+			else if (op == 1)
+			{
+				const bool referenced = model[pick].references != 0;
+				if (Throws([&] { pool.Remove(model[pick].handle); }) != referenced)  throw std::runtime_error("ResourcePool removal disagrees");
+				if (!referenced)
+				{
+					if (model[pick].resident)  { used.CpuBytes -= model[pick].memory.CpuBytes;  used.GpuBytes -= model[pick].memory.GpuBytes; }
+					removed.push_back(model[pick].handle);
+					model.erase(model.begin() + pick);
+				}
+			}
+			else if (op == 2)
+			{
+				pool.AddReference(model[pick].handle);
+				++model[pick].references;
+			}
+			else if (op == 3)
+			{
+				ModelEntry& entry = model[pick];
+				if (Throws([&] { pool.Release(entry.handle); }) != (entry.references == 0))  throw std::runtime_error("ResourcePool release disagrees");
+				if (entry.references != 0 && --entry.references == 0)  entry.stamp = ++clock;
+			}
+			else if (op == 4)
+			{
+				ModelEntry& entry = model[pick];
+				ResourceMemory memory = { size_t(bytes(random)) * 16, size_t(bytes(random)) * 64 };
+				pool.SetResident(entry.handle, memory);
+				if (entry.resident)  { used.CpuBytes -= entry.memory.CpuBytes;  used.GpuBytes -= entry.memory.GpuBytes; }
+				entry.resident = true;
+				entry.memory = memory;
+				entry.stamp = ++clock;
+				used.CpuBytes += memory.CpuBytes;
+				used.GpuBytes += memory.GpuBytes;
+			}
+			else if (op == 5)
+			{
+				ModelEntry& entry = model[pick];
+				pool.SetEvicted(entry.handle);
+				if (entry.resident)  { used.CpuBytes -= entry.memory.CpuBytes;  used.GpuBytes -= entry.memory.GpuBytes; }
+				entry.resident = false;
+				entry.memory = ResourceMemory();
+			}
+			else if (op == 6 || op == 7)
+			{
+				pool.Touch(model[pick].handle);
+				if (model[pick].references == 0)  model[pick].stamp = ++clock;
+			}
+			else if (op == 8)
+			{
+				ResourceMemory budget = { size_t(bytes(random)) * 200, size_t(bytes(random)) * 800 };
+				pool.SetBudget(budget);
+				std::vector<ResourceHandle> evicted;
+				pool.Trim([&](ResourceHandle handle) { evicted.push_back(handle); });
+
+				std::vector<ModelEntry*> candidates;
+				for (auto& entry : model)  if (entry.resident && entry.references == 0)  candidates.push_back(&entry);
+				std::sort(candidates.begin(), candidates.end(), [](const ModelEntry* a, const ModelEntry* b) { return a->stamp < b->stamp; });
+				std::vector<ResourceHandle> expected;
+				for (ModelEntry* entry : candidates)
+				{
+					const bool overCpu = used.CpuBytes > budget.CpuBytes, overGpu = used.GpuBytes > budget.GpuBytes;
+					if (!overCpu && !overGpu)  break;
+					if ((overCpu && entry->memory.CpuBytes > 0) || (overGpu && entry->memory.GpuBytes > 0))
+					{
+						expected.push_back(entry->handle);
+						used.CpuBytes -= entry->memory.CpuBytes;
+						used.GpuBytes -= entry->memory.GpuBytes;
+						entry->resident = false;
+						entry->memory = ResourceMemory();
+					}
+				}
+				if (evicted != expected)  throw std::runtime_error("ResourcePool evicted differently from the model");
+			}
+			else if (!removed.empty())
+			{
+				const ResourceHandle& stale = removed[pick % removed.size()];
+				if (pool.IsValid(stale) || !Throws([&] { pool.Touch(stale); }))  throw std::runtime_error("ResourcePool accepted a stale handle");
+			}
+
+			if (pool.Used().CpuBytes != used.CpuBytes || pool.Used().GpuBytes != used.GpuBytes || pool.Size() != model.size())
+			{
+				throw std::runtime_error("ResourcePool memory or size disagrees with the model");
+			}
+		}
+	}
+}
+
+void RunResourcePoolBenchmark()
+{
+	std::mt19937 random(42);
+	CheckHandles();
+	CheckEviction();
+	CheckAgainstModel(random);
+
+	//A world of textures and meshes along the camera's path. Every 100th is a landmark texture, referenced so it always stays
+	const int numResources = 20000, numVisible = 400, numFrames = 4000, step = 10;
+	std::vector<ResourceMemory> sizes(numResources);
+	std::uniform_int_distribution<size_t> textureBytes(64 << 10, 4 << 20), meshBytes(16 << 10, 256 << 10);
+	ResourceMemory total;
+	for (int i = 0; i < numResources; ++i)
+	{
+		const bool mesh = i % 4 == 0;
+		sizes[i] = { mesh ? meshBytes(random) / 2 : 0, mesh ? meshBytes(random) : textureBytes(random) };
+		total.CpuBytes += sizes[i].CpuBytes;
+		total.GpuBytes += sizes[i].GpuBytes;
+	}
+	const ResourceMemory budget = { total.CpuBytes / 20, total.GpuBytes / 20 };
+	auto landmark = [](int i) { return i % 100 == 1; };
+
+	//Each frame uses the resources in view, loading any that aren't resident, then keeps to the budget
+	long long poolLoads = 0;
+	ResourceMemory poolPeak;
+	double poolTime = TimeBestOf(3, [&]
+	{
+		ResourcePool pool;
+		pool.SetBudget(budget);
+		std::vector<ResourceHandle> handles(numResources);
+		for (int i = 0; i < numResources; ++i)
+		{
+			handles[i] = pool.Add();
+			if (landmark(i))  pool.AddReference(handles[i]);
+		}
+		poolLoads = 0;
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			for (int v = 0; v < numVisible; ++v)
+			{
+				const int i = (frame * step + v) % numResources;
+				if (!pool.IsResident(handles[i]))
+				{
+					pool.SetResident(handles[i], sizes[i]);
+					++poolLoads;
+				}
+				pool.Touch(handles[i]);
+			}
+			poolPeak.CpuBytes = std::max(poolPeak.CpuBytes, pool.Used().CpuBytes);
+			poolPeak.GpuBytes = std::max(poolPeak.GpuBytes, pool.Used().GpuBytes);
+			pool.Trim([](ResourceHandle) {});
+		}
+		//The camera has passed every resource, so every landmark has been loaded
+		for (int i = 1; i < numResources; i += 100)
+		{
+			if (!pool.IsResident(handles[i]))  throw std::runtime_error("A referenced resource was evicted");
+		}
+	});
+
+	//The same with a stamp of when each resource was last used, sorting the resident ones by it when over budget
+	long long stampLoads = 0;
+	double stampTime = TimeBestOf(3, [&]
+	{
+		std::vector<char> resident(numResources, 0);
+		std::vector<unsigned long long> lastUsed(numResources, 0);
+		std::vector<int> candidates;
+		ResourceMemory used;
+		unsigned long long clock = 0;
+		stampLoads = 0;
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			for (int v = 0; v < numVisible; ++v)
+			{
+				const int i = (frame * step + v) % numResources;
+				if (!resident[i])
+				{
+					resident[i] = 1;
+					used.CpuBytes += sizes[i].CpuBytes;
+					used.GpuBytes += sizes[i].GpuBytes;
+					++stampLoads;
+				}
+				lastUsed[i] = ++clock;
+			}
+			if (used.CpuBytes <= budget.CpuBytes && used.GpuBytes <= budget.GpuBytes)  continue;
+
+			candidates.clear();
+			for (int i = 0; i < numResources; ++i)  if (resident[i] && !landmark(i))  candidates.push_back(i);
+			std::sort(candidates.begin(), candidates.end(), [&](int a, int b) { return lastUsed[a] < lastUsed[b]; });
+			for (int i : candidates)
+			{
+				const bool overCpu = used.CpuBytes > budget.CpuBytes, overGpu = used.GpuBytes > budget.GpuBytes;
+				if (!overCpu && !overGpu)  break;
+				if ((overCpu && sizes[i].CpuBytes > 0) || (overGpu && sizes[i].GpuBytes > 0))
+				{
+					resident[i] = 0;
+					used.CpuBytes -= sizes[i].CpuBytes;
+					used.GpuBytes -= sizes[i].GpuBytes;
+				}
+			}
+		}
+		DoNotOptimise(lastUsed.data());
+	});
+	if (poolLoads != stampLoads)  throw std::runtime_error("The pool and the frame stamps evicted different resources");
+
+	const double megabyte = 1024.0 * 1024.0;
+	std::cout << "  " << numResources << " resources, " << total.GpuBytes / megabyte << " MB GPU / " << total.CpuBytes / megabyte
+	          << " MB CPU in all, budget " << budget.GpuBytes / megabyte << " MB GPU / " << budget.CpuBytes / megabyte << " MB CPU\n";
+	std::cout << "  Peak before trimming " << poolPeak.GpuBytes / megabyte << " MB GPU / " << poolPeak.CpuBytes / megabyte << " MB CPU, "
+	          << static_cast<double>(poolLoads) / numFrames << " loads a frame (" << step << " come into view)\n";
+	ReportResult("Frame stamps, sorted when over budget", stampTime);
+	ReportResult("ResourcePool eviction list", poolTime);
+	ReportComparison("Eviction bookkeeping", stampTime, poolTime);
+}
@@ -0,0 +1,256 @@
+//--------------------------------------------------------------------------------------
+// Skinning: blending vertices between their bones on the CPU
+//--------------------------------------------------------------------------------------
+// Vertices are laid out as Mesh loads skinned meshes (position, normal, optional tangent, uv,
+// then 4 bone indices and 4 weights). Checks each SIMD kernel against the plain C++ reference,
+// for any number of vertices, into different output layouts and without touching anything
+// the output layout doesn't have, then times the reference against the SIMD kernel on one
+// thread and across the thread pool.
+
+#include "Benchmark.h"
+#include "Math/Skinning.h"
+#include "Math/SkinningKernels.h"
+#include "Utility/CpuFeatures.h"
+#include "Utility/ThreadPool.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float         kTolerance = 1e-4f;
+	const unsigned char kUntouched = 0xCD;
+
+	//Layouts Mesh gives skinned sub-meshes, without and with tangents
+	SkinnedVertexLayout LoaderLayout(bool tangents)
+	{
+		SkinnedVertexLayout layout;
+		layout.PositionOffset = 0;
+		layout.NormalOffset   = 12;
+		layout.TangentOffset  = tangents ? 24 : -1;
+		layout.BonesOffset    = (tangents ? 36 : 24) + 8; //After the uvs
+		layout.VertexSize     = layout.BonesOffset + 20;
+		return layout;
+	}
+
+	//Output layouts for batching: just positions and normals packed together, or positions alone
+	SkinnedVertexLayout PackedLayout(bool normals)
+	{
+		SkinnedVertexLayout layout;
+		layout.PositionOffset = 0;
+		layout.NormalOffset   = normals ? 12 : -1;
+		layout.VertexSize     = normals ? 24 : 12;
+		return layout;
+	}
+
+	//Random vertices with 1 to 4 bones each. Unused bones are still real bones but with zero weight
+	std::vector<unsigned char> MakeVertices(const SkinnedVertexLayout& layout, int count, int numBones, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f), unit(-1.0f, 1.0f), weight(0.05f, 1.0f);
+		std::uniform_int_distribution<int> bone(0, numBones - 1), influences(1, 4);
+
+		std::vector<unsigned char> vertices(static_cast<size_t>(count) * layout.VertexSize, kUntouched);
+		for (int i = 0; i < count; ++i)
+		{
+			unsigned char* vertex = vertices.data() + static_cast<size_t>(i) * layout.VertexSize;
+			float position[3] = { coordinate(random), coordinate(random), coordinate(random) };
+			float normal[3]   = { unit(random), unit(random), unit(random) };
+			float tangent[3]  = { unit(random), unit(random), unit(random) };
+			std::memcpy(vertex + layout.PositionOffset, position, sizeof(position));
+			std::memcpy(vertex + layout.NormalOffset, normal, sizeof(normal));
+			if (layout.TangentOffset >= 0)  std::memcpy(vertex + layout.TangentOffset, tangent, sizeof(tangent));
+
+			uint8_t bones[4];
+			float weights[4] = {};
+			int numInfluences = influences(random);
+			float total = 0.0f;
+			for (int influence = 0; influence < 4; ++influence)
+			{
+				bones[influence] = static_cast<uint8_t>(bone(random));
+				if (influence < numInfluences)  total += weights[influence] = weight(random);
+			}
+			for (float& w : weights)  w /= total;
+			std::memcpy(vertex + layout.BonesOffset, bones, sizeof(bones));
+			std::memcpy(vertex + layout.BonesOffset + 4, weights, sizeof(weights));
+		}
+		return vertices;
+	}
+
+	std::vector<CMatrix4x4> MakeBones(int count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> angle(-3.0f, 3.0f), position(-5.0f, 5.0f), scale(0.5f, 2.0f);
+		std::vector<CMatrix4x4> bones(count);
+		for (auto& bone : bones)
+		{
+			bone = MatrixScaling(scale(random)) * MatrixRotationZ(angle(random)) * MatrixRotationX(angle(random)) *
+			       MatrixRotationY(angle(random)) * MatrixTranslation(CVector3(position(random), position(random), position(random)));
+		}
+		return bones;
+	}
+
+	//Same arguments SkinVertices passes its kernel
+	SkinningArgs MakeArgs(const std::vector<unsigned char>& vertices, const SkinnedVertexLayout& layout, int count,
+	                      const std::vector<CMatrix4x4>& bones, std::vector<unsigned char>& output, const SkinnedVertexLayout& outputLayout)
+	{
+		auto both = [](int in, int out) { return in >= 0 && out >= 0 ? in : -1; };
+		return { reinterpret_cast<const char*>(vertices.data()), layout.VertexSize, both(layout.PositionOffset, outputLayout.PositionOffset),
+		         both(layout.NormalOffset, outputLayout.NormalOffset), both(layout.TangentOffset, outputLayout.TangentOffset), layout.BonesOffset,
+		         reinterpret_cast<char*>(output.data()), outputLayout.VertexSize, outputLayout.PositionOffset, outputLayout.NormalOffset,
+		         outputLayout.TangentOffset, &bones[0].e00, count };
+	}
+
+	//Output from a kernel must match the reference: the floats it writes to within rounding, every other byte exactly
+	void CheckOutput(const std::string& name, const std::vector<unsigned char>& result, const std::vector<unsigned char>& expected,
+	                 const SkinnedVertexLayout& outputLayout, int count)
+	{
+		for (size_t byte = 0; byte < result.size(); ++byte)
+		{
+			size_t vertex = byte / outputLayout.VertexSize;
+			int offset = static_cast<int>(byte % outputLayout.VertexSize);
+			int partStart = -1;
+			for (int part : { outputLayout.PositionOffset, outputLayout.NormalOffset, outputLayout.TangentOffset })
+			{
+				if (part >= 0 && offset >= part && offset < part + 12)  partStart = part;
+			}
+
+			if (partStart < 0 || vertex >= static_cast<size_t>(count))
+			{
+				if (result[byte] != expected[byte])  throw std::runtime_error(name + " skinning wrote outside the output parts");
+				continue;
+			}
+			if ((offset - partStart) % 4 != 0)  continue;
+
+			float a, b;
+			std::memcpy(&a, &result[byte], sizeof(float));
+			std::memcpy(&b, &expected[byte], sizeof(float));
+			if (!(std::abs(a - b) <= kTolerance * (1.0f + std::abs(b))))  throw std::runtime_error(name + " skinning doesn't match the reference");
+		}
+	}
+
+	void CheckKernel(const std::string& name, void (*kernel)(const SkinningArgs&), std::mt19937& random)
+	{
+		std::vector<CMatrix4x4> bones = MakeBones(256, random);
+		for (bool tangents : { false, true })
+		{
+			SkinnedVertexLayout layout = LoaderLayout(tangents);
+			for (const SkinnedVertexLayout& outputLayout : { layout, PackedLayout(true), PackedLayout(false) })
+			{
+				for (int count : { 0, 1, 2, 3, 7, 64, 1001 })
+				{
+					std::vector<unsigned char> vertices = MakeVertices(layout, count, static_cast<int>(bones.size()), random);
+
+					//One spare vertex at the end to catch writes past the last one
+					std::vector<unsigned char> expected(static_cast<size_t>(count + 1) * outputLayout.VertexSize, kUntouched), result = expected;
+					SkinVerticesReference(vertices.data(), layout, count, bones.data(), expected.data(), outputLayout);
+					kernel(MakeArgs(vertices, layout, count, bones, result, outputLayout));
+					CheckOutput(name, result, expected, outputLayout, count);
+				}
+			}
+		}
+	}
+
+	//The reference itself, against CMatrix4x4 for a vertex on a single bone and the identity for any blend
+	void CheckReference(std::mt19937& random)
+	{
+		SkinnedVertexLayout layout = LoaderLayout(false), outputLayout = PackedLayout(true);
+		std::vector<CMatrix4x4> bones = MakeBones(4, random);
+		std::vector<unsigned char> vertices = MakeVertices(layout, 1, 4, random), output(outputLayout.VertexSize);
+		const uint8_t singleBone[4] = { 2, 0, 0, 0 };
+		const float singleWeight[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+		std::memcpy(&vertices[layout.BonesOffset], singleBone, 4);
+		std::memcpy(&vertices[layout.BonesOffset + 4], singleWeight, 16);
+		SkinVerticesReference(vertices.data(), layout, 1, bones.data(), output.data(), outputLayout);
+
+		CVector3 position, normal, skinnedPosition, skinnedNormal;
+		std::memcpy(&position, &vertices[layout.PositionOffset], 12);
+		std::memcpy(&normal, &vertices[layout.NormalOffset], 12);
+		std::memcpy(&skinnedPosition, &output[0], 12);
+		std::memcpy(&skinnedNormal, &output[12], 12);
+		CVector3 expectedPosition = TransformPoint(position, bones[2]);
+		CVector3 expectedNormal = TransformPoint(normal, bones[2]) - TransformPoint(CVector3(0, 0, 0), bones[2]);
+		if (Length(skinnedPosition - expectedPosition) > kTolerance * 10 || Length(skinnedNormal - expectedNormal) > kTolerance)
+		{
+			throw std::runtime_error("Skinning with one bone doesn't match the bone's matrix");
+		}
+
+		const int count = 100;
+		std::vector<CMatrix4x4> identity(256, MatrixIdentity());
+		vertices = MakeVertices(layout, count, 256, random);
+		output.assign(count * layout.VertexSize, 0);
+		SkinVerticesReference(vertices.data(), layout, count, identity.data(), output.data(), layout);
+		for (int i = 0; i < count; ++i)
+		{
+			for (int part : { layout.PositionOffset, layout.NormalOffset })
+			{
+				CVector3 in, out;
+				std::memcpy(&in, &vertices[i * layout.VertexSize + part], 12);
+				std::memcpy(&out, &output[i * layout.VertexSize + part], 12);
+				if (Length(in - out) > kTolerance)  throw std::runtime_error("Skinning with identity bones moved a vertex");
+			}
+		}
+	}
+
+	//Vertex ranges spread over threads must give the same result as one thread, and the layouts must be passed on as the
+	//kernel checks above pass them, from vertices with tangents into an output without
+	void CheckThreads(ThreadPool& singleThread, std::mt19937& random)
+	{
+		SkinnedVertexLayout layout = LoaderLayout(true), outputLayout = PackedLayout(true);
+		std::vector<CMatrix4x4> bones = MakeBones(64, random);
+		for (int count : { 2048, 2049, 100003 })
+		{
+			std::vector<unsigned char> vertices = MakeVertices(layout, count, 64, random);
+			std::vector<unsigned char> expected(static_cast<size_t>(count + 1) * outputLayout.VertexSize, kUntouched), single = expected, pooled = expected;
+			SkinVerticesSSE2(MakeArgs(vertices, layout, count, bones, expected, outputLayout));
+			std::vector<unsigned char> reference = single;
+			SkinVerticesReference(vertices.data(), layout, count, bones.data(), reference.data(), outputLayout);
+			CheckOutput("Reference", reference, expected, outputLayout, count);
+			SkinVertices(vertices.data(), layout, count, bones.data(), single.data(), outputLayout, &singleThread);
+			SkinVertices(vertices.data(), layout, count, bones.data(), pooled.data(), outputLayout);
+			CheckOutput("Single threaded", single, expected, outputLayout, count);
+			if (pooled != single)  throw std::runtime_error("Skinning across the thread pool doesn't match a single thread");
+		}
+	}
+}
+
+void RunSkinningBenchmark()
+{
+	std::mt19937 random(42);
+	ThreadPool singleThread(0);
+	CheckReference(random);
+	CheckKernel("SSE2", SkinVerticesSSE2, random);
+	if (GetCpuFeatures().avx2 && GetCpuFeatures().fma)  CheckKernel("AVX2", SkinVerticesAVX2, random);
+	CheckThreads(singleThread, random);
+
+	//A crowd's worth of vertices on a 64 bone rig, skinned into a packed position and normal buffer for batching
+	const int numVertices = 1 << 18, numBones = 64;
+	SkinnedVertexLayout layout = LoaderLayout(false), outputLayout = PackedLayout(true);
+	std::vector<CMatrix4x4> bones = MakeBones(numBones, random);
+	std::vector<unsigned char> vertices = MakeVertices(layout, numVertices, numBones, random);
+	std::vector<unsigned char> output(static_cast<size_t>(numVertices) * outputLayout.VertexSize);
+
+	double reference = TimeBestOf(10, [&]
+	{
+		SkinVerticesReference(vertices.data(), layout, numVertices, bones.data(), output.data(), outputLayout);
+		DoNotOptimise(output.data());
+	});
+	double simdSingle = TimeBestOf(10, [&]
+	{
+		SkinVertices(vertices.data(), layout, numVertices, bones.data(), output.data(), outputLayout, &singleThread);
+		DoNotOptimise(output.data());
+	});
+	double simd = TimeBestOf(10, [&]
+	{
+		SkinVertices(vertices.data(), layout, numVertices, bones.data(), output.data(), outputLayout);
+		DoNotOptimise(output.data());
+	});
+
+	ReportThroughput("Reference, 256K vertices x 4 bones", reference, numVertices, "vertices");
+	ReportThroughput(std::string("SIMD (") + SkinningKernelName() + "), 1 thread", simdSingle, numVertices, "vertices");
+	ReportThroughput("SIMD, shared thread pool", simd, numVertices, "vertices");
+	ReportComparison("256K vertices, reference -> SIMD threaded", reference, simd);
+}
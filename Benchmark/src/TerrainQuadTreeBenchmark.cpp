@@ -0,0 +1,287 @@
+//--------------------------------------------------------------------------------------
+// Terrain quadtree: building the tree and selecting chunks each frame on a 16k terrain
+//--------------------------------------------------------------------------------------
+// Also checks the selection is sound from many camera positions and fields of view: the
+// chunks cover the terrain exactly once, neighbouring chunks are at most one level apart,
+// every chunk is at the right level for its distance, frustum culling only removes chunks
+// that are out of sight, and node heights match the HeightField after edits
+
+#include "Benchmark.h"
+#include "Math/CMatrix4x4.h"
+#include "Math/FractalNoise.h"
+#include "Math/MathHelpers.h"
+#include "Math/TerrainQuadTree.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+	const float kPi = 3.14159265f;
+
+	//View-projection matrix for a camera, built the same way as Camera::UpdateMatrices
+	CMatrix4x4 CameraViewProjection(const CVector3& position, const CVector3& rotation, float fov, float aspectRatio, float nearClip, float farClip)
+	{
+		CMatrix4x4 world = MatrixRotationZ(rotation.z) * MatrixRotationX(rotation.x) * MatrixRotationY(rotation.y) * MatrixTranslation(position);
+		CMatrix4x4 projection = MatrixPerspectiveFOVx(fov, aspectRatio, nearClip, farClip);
+		return InverseAffine(world) * projection;
+	}
+
+	//Cheap rolling hills for the big timing terrain, where generating real noise would take longer than the test
+	void FillHills(HeightField& heightMap)
+	{
+		ThreadPool::Get().ParallelFor(0, heightMap.Height(), 64, [&](int first, int last)
+		{
+			for (int z = first; z < last; ++z)
+			{
+				float* row = heightMap.RowData(z);
+				for (int x = 0; x < heightMap.Width(); ++x)
+				{
+					row[x] = 300.0f * std::sin(x * 0.0021f) * std::cos(z * 0.0017f) + 40.0f * std::sin((x + z) * 0.013f);
+				}
+			}
+		});
+	}
+
+	//Check every node's heights against the HeightField directly
+	void CheckNodeHeights(const TerrainQuadTree& tree, const HeightField& heightMap, const char* when)
+	{
+		for (const auto& node : tree.Nodes())
+		{
+			float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+			for (int z = node.Z; z <= std::min(node.Z + node.Size, heightMap.Height() - 1); ++z)
+			{
+				for (int x = node.X; x <= std::min(node.X + node.Size, heightMap.Width() - 1); ++x)
+				{
+					minHeight = std::min(minHeight, heightMap(x, z));
+					maxHeight = std::max(maxHeight, heightMap(x, z));
+				}
+			}
+			if (node.MinHeight != minHeight || node.MaxHeight != maxHeight)
+			{
+				throw std::runtime_error(std::string("Terrain quadtree node heights are wrong ") + when);
+			}
+		}
+	}
+
+	//Check a selection made without a frustum, returns the number of chunks
+	size_t CheckSelection(const TerrainQuadTree& tree, const CVector3& camera, float fov, const std::vector<TerrainChunk>& chunks)
+	{
+		std::vector<float> ranges;
+		tree.LodRanges(fov, ranges);
+
+		//Level drawn at each leaf sized square, -1 until a chunk covers it
+		int leafSize = tree.Settings().LeafSize;
+		const auto& root = tree.Nodes()[0];
+		int leavesAcross = root.Size / leafSize;
+		std::vector<int> coverage(leavesAcross * leavesAcross, -1);
+		int numLeaves = 0;
+
+		for (const auto& chunk : chunks)
+		{
+			const auto& node = tree.Nodes()[chunk.Node];
+			if (chunk.Level != node.Level && chunk.Level != node.Level + 1)  throw std::runtime_error("Terrain chunk is drawn at the wrong level for its node");
+
+			//Chunks at a coarser level are there because nothing in them needs the next level down, and the
+			//chunk must be within its level's range, or its area would have been drawn coarser still
+			BoundingBox box = tree.NodeBounds(chunk.Node);
+			float distance = std::sqrt(box.DistanceSquared(camera));
+			if (chunk.Level > 0 && distance < ranges[chunk.Level - 1] && chunk.Level == node.Level)
+			{
+				throw std::runtime_error("Terrain chunk is coarser than its distance allows");
+			}
+			if (chunk.Level == node.Level + 1 && distance <= ranges[node.Level])
+			{
+				throw std::runtime_error("Terrain chunk was drawn by its parent while in range of its own level");
+			}
+			if (chunk.Level == node.Level && distance > ranges[chunk.Level])  throw std::runtime_error("Terrain chunk is beyond the range of its level");
+
+			//Every leaf square of the terrain is covered exactly once
+			for (int z = node.Z / leafSize; z < (node.Z + node.Size) / leafSize; ++z)
+			{
+				for (int x = node.X / leafSize; x < (node.X + node.Size) / leafSize; ++x)
+				{
+					auto& level = coverage[z * leavesAcross + x];
+					if (level >= 0)  throw std::runtime_error("Terrain chunks overlap");
+					level = chunk.Level;
+					++numLeaves;
+				}
+			}
+		}
+
+		int expectedLeaves = 0;
+		for (const auto& node : tree.Nodes())  expectedLeaves += node.Level == 0;
+
+		for (int z = 0; z < leavesAcross; ++z)
+		{
+			for (int x = 0; x < leavesAcross; ++x)
+			{
+				int level = coverage[z * leavesAcross + x];
+				if (level < 0)  continue; // Only squares outside the HeightField, checked by the count below
+				if ((x + 1 < leavesAcross && coverage[z * leavesAcross + x + 1] >= 0 && std::abs(coverage[z * leavesAcross + x + 1] - level) > 1) ||
+					(z + 1 < leavesAcross && coverage[(z + 1) * leavesAcross + x] >= 0 && std::abs(coverage[(z + 1) * leavesAcross + x] - level) > 1))
+				{
+					throw std::runtime_error("Neighbouring terrain chunks are more than one level apart");
+				}
+			}
+		}
+
+		//Squares outside the HeightField can be covered by chunks clipped to it, so compare against leaves that exist
+		int coveredLeaves = 0;
+		for (const auto& node : tree.Nodes())
+		{
+			if (node.Level == 0 && coverage[(node.Z / leafSize) * leavesAcross + node.X / leafSize] >= 0)  ++coveredLeaves;
+		}
+		if (coveredLeaves != expectedLeaves)  throw std::runtime_error("Terrain chunks leave gaps");
+		DoNotOptimise(&numLeaves);
+		return chunks.size();
+	}
+
+	//Check a selection made with a frustum against the same selection without one
+	void CheckCulling(const TerrainQuadTree& tree, const Frustum& frustum, const std::vector<TerrainChunk>& all, const std::vector<TerrainChunk>& culled)
+	{
+		std::set<std::pair<int, int>> kept;
+		for (const auto& chunk : culled)
+		{
+			if (!frustum.Intersects(tree.NodeBounds(chunk.Node)))  throw std::runtime_error("Terrain chunk outside the frustum was kept");
+			kept.insert({ chunk.Node, chunk.Level });
+		}
+		for (const auto& chunk : all)
+		{
+			bool visible = frustum.Intersects(tree.NodeBounds(chunk.Node));
+			if (visible != (kept.count({ chunk.Node, chunk.Level }) > 0))
+			{
+				throw std::runtime_error("Terrain culling dropped a visible chunk or kept one the full selection doesn't have");
+			}
+		}
+		if (kept.size() != culled.size())  throw std::runtime_error("Terrain culling selected a chunk twice");
+	}
+
+	void CheckMorph()
+	{
+		for (int x = 0; x <= 8; ++x)
+		{
+			float morphedX, morphedZ;
+			TerrainQuadTree::MorphGridVertex(x, 8 - x, 1.0f, morphedX, morphedZ);
+			if (static_cast<int>(morphedX) % 2 != 0 || static_cast<int>(morphedZ) % 2 != 0)  throw std::runtime_error("Morphed terrain vertex is not on the coarser grid");
+			TerrainQuadTree::MorphGridVertex(x, 8 - x, 0.0f, morphedX, morphedZ);
+			if (morphedX != x || morphedZ != 8 - x)  throw std::runtime_error("Unmorphed terrain vertex moved");
+		}
+
+		TerrainChunk chunk;
+		chunk.MorphStart = 70.0f;
+		chunk.MorphEnd = 100.0f;
+		if (TerrainQuadTree::MorphFactor(chunk, 50.0f) != 0.0f || TerrainQuadTree::MorphFactor(chunk, 100.0f) != 1.0f ||
+			std::abs(TerrainQuadTree::MorphFactor(chunk, 85.0f) - 0.5f) > 1e-6f)
+		{
+			throw std::runtime_error("Terrain morph factor is wrong");
+		}
+	}
+}
+
+void RunTerrainQuadTreeBenchmark()
+{
+	CheckMorph();
+
+	//Check the selection on a small terrain with a size that isn't a power of two, so the tree is ragged at the edges
+	{
+		FractalNoiseSettings settings;
+		settings.Height = 400.0f;
+		FractalNoise fractal(3, settings);
+		HeightField heightMap(1500, 1100);
+		fractal.Generate(heightMap);
+
+		TerrainQuadTreeSettings treeSettings;
+		treeSettings.LeafSize = 32;
+		TerrainQuadTree tree(treeSettings);
+		const CVector3 minPt(-3000.0f, 0.0f, -2200.0f), maxPt(3000.0f, 0.0f, 2200.0f);
+		tree.Build(heightMap, minPt, maxPt);
+		CheckNodeHeights(tree, heightMap, "after building");
+
+		//Dig a hole and raise a hill, one starting on a node boundary and one on the far edges
+		for (int z = 500; z < 540; ++z)  for (int x = 64; x < 70; ++x)  heightMap(x, z) -= 900.0f;
+		tree.UpdateHeights(heightMap, GridRegion(64, 500, 69, 539));
+		for (int z = 1090; z < 1100; ++z)  for (int x = 1480; x < 1500; ++x)  heightMap(x, z) += 900.0f;
+		tree.UpdateHeights(heightMap, GridRegion(1480, 1090, 1499, 1099));
+		CheckNodeHeights(tree, heightMap, "after editing");
+
+		std::vector<TerrainChunk> all, culled;
+		size_t minChunks = SIZE_MAX, maxChunks = 0;
+		for (int i = 0; i < 200; ++i)
+		{
+			float t = i / 200.0f;
+			CVector3 camera(minPt.x * std::cos(t * 9.0f), 100.0f + 2000.0f * t * t, maxPt.z * std::sin(t * 13.0f));
+			CVector3 rotation(0.1f + t * 0.9f, t * 20.0f, 0.0f);
+			float fov = (30.0f + 90.0f * ((i * 7) % 200) / 200.0f) * kPi / 180.0f;
+
+			tree.Select(camera, fov, nullptr, all);
+			size_t numChunks = CheckSelection(tree, camera, fov, all);
+			minChunks = std::min(minChunks, numChunks);
+			maxChunks = std::max(maxChunks, numChunks);
+
+			Frustum frustum(CameraViewProjection(camera, rotation, fov, 16.0f / 9.0f, 1.0f, 20000.0f));
+			tree.Select(camera, fov, &frustum, culled);
+			CheckCulling(tree, frustum, all, culled);
+		}
+		std::cout << "  Selection checks passed, " << minChunks << " to " << maxChunks << " chunks per frame" << std::endl;
+	}
+
+	//Timing on a 16k terrain
+	const int size = 16385;
+	HeightField heightMap(size, size);
+	FillHills(heightMap);
+	const CVector3 minPt(-16384.0f, 0.0f, -16384.0f), maxPt(16384.0f, 0.0f, 16384.0f);
+
+	TerrainQuadTree tree;
+	ThreadPool singleThread(0);
+	double singleBuild = TimeBestOf(2, [&] { tree.Build(heightMap, minPt, maxPt, &singleThread); });
+	double poolBuild = TimeBestOf(2, [&] { tree.Build(heightMap, minPt, maxPt); });
+	ReportComparison("Build 16385^2 quadtree, 1 -> pool threads", singleBuild, poolBuild);
+	std::cout << "  " << tree.Nodes().size() << " nodes in " << tree.NumLevels() << " levels" << std::endl;
+
+	//A camera flying across the terrain, with a frame's worth of selection each step
+	const int numFrames = 1000;
+	const float fov = 75.0f * kPi / 180.0f;
+	std::vector<TerrainChunk> chunks;
+	size_t totalChunks = 0, maxChunks = 0;
+	auto fly = [&](bool cull)
+	{
+		totalChunks = maxChunks = 0;
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			float t = static_cast<float>(frame) / numFrames;
+			CVector3 camera(-15000.0f + 30000.0f * t, 400.0f + 300.0f * std::sin(t * 10.0f), 8000.0f * std::sin(t * 3.0f));
+			CVector3 rotation(0.3f, t * 4.0f, 0.0f);
+			if (cull)
+			{
+				Frustum frustum(CameraViewProjection(camera, rotation, fov, 16.0f / 9.0f, 1.0f, 40000.0f));
+				tree.Select(camera, fov, &frustum, chunks);
+			}
+			else
+			{
+				tree.Select(camera, fov, nullptr, chunks);
+			}
+			totalChunks += chunks.size();
+			maxChunks = std::max(maxChunks, chunks.size());
+		}
+		DoNotOptimise(chunks.data());
+	};
+
+	double selectAll = TimeBestOf(3, [&] { fly(false); }) / numFrames;
+	size_t allChunks = maxChunks;
+	ReportResult("Select per frame, no culling", selectAll);
+	double selectCulled = TimeBestOf(3, [&] { fly(true); }) / numFrames;
+	ReportResult("Select per frame, frustum culled", selectCulled);
+
+	long long chunkVertices = static_cast<long long>(tree.Settings().LeafSize + 1) * (tree.Settings().LeafSize + 1);
+	std::cout << "  Most chunks per frame: " << allChunks << " unculled, " << maxChunks << " culled (average "
+	          << totalChunks / numFrames << ")" << std::endl;
+	std::cout << "  Most vertices per frame: " << maxChunks * chunkVertices / 1000 << "K against "
+	          << static_cast<long long>(size) * size / 1000000 << "M for the flat grid" << std::endl;
+}
@@ -0,0 +1,255 @@
+//--------------------------------------------------------------------------------------
+// Transforms: matrix-only nodes against position / quaternion / scale with lazy matrices
+//--------------------------------------------------------------------------------------
+// The old Model kept only a matrix per node, so setting a rotation took the scale and position
+// back out of it and rebuilt it with four matrix products, and reading the rotation took the
+// matrix apart again. NodeTransforms keeps the parts and builds the matrix once, when it is read.
+// Also checks the quaternion functions against the matrix functions they stand in for.
+
+#include "Benchmark.h"
+#include "Math/CQuaternion.h"
+#include "Math/NodeTransforms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float kTolerance = 1e-4f;
+
+	CQuaternion RandomRotation(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+		return Normalise(CQuaternion(component(random), component(random), component(random), component(random)));
+	}
+
+	CVector3 RandomEulerAngles(std::mt19937& random)
+	{
+		//X kept away from +-90 degrees, where the angles are ambiguous (gimbal lock)
+		std::uniform_real_distribution<float> angle(-3.1f, 3.1f), pitch(-1.5f, 1.5f);
+		return { pitch(random), angle(random), angle(random) };
+	}
+
+	float MaxDifference(const CMatrix4x4& a, const CMatrix4x4& b)
+	{
+		float difference = 0.0f;
+		for (int i = 0; i < 16; ++i)  difference = std::max(difference, std::abs((&a.e00)[i] - (&b.e00)[i]));
+		return difference;
+	}
+
+	void CheckMatrix(const CMatrix4x4& result, const CMatrix4x4& expected, const std::string& what)
+	{
+		if (MaxDifference(result, expected) > kTolerance)  throw std::runtime_error(what + " doesn't match the matrix version");
+	}
+
+	void CheckVector(const CVector3& result, const CVector3& expected, const std::string& what)
+	{
+		if (Length(result - expected) > kTolerance)  throw std::runtime_error(what + " is wrong");
+	}
+
+	//q and -q are the same rotation
+	void CheckSameRotation(const CQuaternion& result, const CQuaternion& expected, const std::string& what)
+	{
+		if (std::abs(Dot(result, expected)) < 1.0f - kTolerance)  throw std::runtime_error(what + " gives the wrong rotation");
+	}
+
+	void CheckConversions(std::mt19937& random)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			CVector3 angles = RandomEulerAngles(random);
+			CQuaternion q = QuaternionFromEulerAngles(angles);
+			CheckMatrix(MatrixFromQuaternion(q), MatrixRotationZ(angles.z) * MatrixRotationX(angles.x) * MatrixRotationY(angles.y),
+			            "QuaternionFromEulerAngles");
+			CheckSameRotation(QuaternionFromEulerAngles(EulerAngles(q)), q, "EulerAngles");
+			CheckSameRotation(QuaternionFromMatrix(MatrixFromQuaternion(q)), q, "QuaternionFromMatrix");
+
+			CQuaternion q2 = RandomRotation(random);
+			CheckSameRotation(QuaternionFromMatrix(MatrixFromQuaternion(q2)), q2, "QuaternionFromMatrix");
+			CheckMatrix(MatrixFromQuaternion(q * q2), MatrixFromQuaternion(q) * MatrixFromQuaternion(q2), "Quaternion product");
+			CheckMatrix(MatrixFromQuaternion(q * Inverse(q)), MatrixIdentity(), "Inverse");
+
+			CVector3 v = { 1.0f, -2.0f, 3.0f };
+			CheckVector(Rotate(v, q2), TransformPoint(v, MatrixFromQuaternion(q2)), "Rotate");
+		}
+
+		//Every branch of QuaternionFromMatrix: no rotation, and half turns about each axis
+		for (const CVector3& axis : { CVector3(1, 0, 0), CVector3(0, 1, 0), CVector3(0, 0, 1), Normalise(CVector3(1, 1, 1)) })
+		{
+			for (float angle : { 0.0f, 3.14159265f, -2.5f })
+			{
+				CQuaternion q = QuaternionFromAxisAngle(axis, angle);
+				CheckSameRotation(QuaternionFromMatrix(MatrixFromQuaternion(q)), q, "QuaternionFromMatrix near a half turn");
+			}
+		}
+	}
+
+	void CheckDecompose(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> scale(0.25f, 4.0f), position(-10.0f, 10.0f);
+		for (int i = 0; i < 1000; ++i)
+		{
+			CVector3 s = { scale(random), scale(random), scale(random) };
+			if (i % 4 == 1)  s.y = -s.y; //Mirrored matrices
+			if (i % 4 == 2)  s = { -s.x, -s.y, -s.z };
+			CVector3 p = { position(random), position(random), position(random) };
+			CQuaternion q = RandomRotation(random);
+			CMatrix4x4 m = MatrixScaling(s) * MatrixFromQuaternion(q) * MatrixTranslation(p);
+			CheckMatrix(MatrixFromTransform(p, q, s), m, "MatrixFromTransform");
+
+			CVector3 p2, s2;
+			CQuaternion q2;
+			DecomposeTransform(m, p2, q2, s2);
+			CheckMatrix(MatrixFromTransform(p2, q2, s2), m, "DecomposeTransform");
+			if (std::abs(Dot(q2, q2) - 1.0f) > kTolerance)  throw std::runtime_error("DecomposeTransform rotation isn't unit length");
+		}
+
+		//Flattened matrices have no rotation, but must keep their position and scale
+		CVector3 p, s;
+		CQuaternion q;
+		DecomposeTransform(MatrixScaling(CVector3(2, 0, 3)) * MatrixTranslation(CVector3(1, 2, 3)), p, q, s);
+		CheckVector(p, { 1, 2, 3 }, "DecomposeTransform position of a flattened matrix");
+		CheckVector(s, { 2, 0, 3 }, "DecomposeTransform scale of a flattened matrix");
+	}
+
+	void CheckInterpolation(std::mt19937& random)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			CQuaternion q1 = RandomRotation(random), q2 = RandomRotation(random);
+			if (i % 2)  q2 = QuaternionFromAxisAngle({ 0, 1, 0 }, 0.001f * i) * q1; //Close together, slerp falls back to nlerp
+
+			for (auto interpolate : { Slerp, Nlerp })
+			{
+				CheckSameRotation(interpolate(q1, q2, 0.0f), q1, "Interpolation start");
+				CheckSameRotation(interpolate(q1, q2, 1.0f), q2, "Interpolation end");
+
+				//q2 and -q2 are the same rotation, both must take the same short path
+				CQuaternion negated = { -q2.x, -q2.y, -q2.z, -q2.w };
+				CheckSameRotation(interpolate(q1, negated, 0.3f), interpolate(q1, q2, 0.3f), "Interpolation to a negated quaternion");
+				if (Dot(interpolate(q1, q2, 0.5f), q1) < std::abs(Dot(q1, q2)) - kTolerance)
+				{
+					throw std::runtime_error("Interpolation doesn't take the shortest path");
+				}
+				CQuaternion middle = interpolate(q1, q2, 0.6f);
+				if (std::abs(Dot(middle, middle) - 1.0f) > kTolerance)  throw std::runtime_error("Interpolation isn't unit length");
+			}
+
+			//Slerp turns at a constant rate, so a quarter of the way along is a quarter of the angle
+			float angle = std::acos(std::min(std::abs(Dot(q1, q2)), 1.0f));
+			float quarter = std::acos(std::min(std::abs(Dot(q1, Slerp(q1, q2, 0.25f))), 1.0f));
+			if (std::abs(quarter - angle * 0.25f) > 1e-3f)  throw std::runtime_error("Slerp doesn't turn at a constant rate");
+		}
+	}
+
+	void CheckNodeTransforms(std::mt19937& random)
+	{
+		NodeTransforms nodes;
+		nodes.Resize(3);
+		CheckMatrix(nodes.Matrix(2), MatrixIdentity(), "New node");
+
+		CQuaternion q = RandomRotation(random);
+		nodes.SetPosition(1, { 1, 2, 3 });
+		nodes.SetRotation(1, q);
+		nodes.SetScale(1, { 2, 2, 2 });
+		if (!nodes.IsDirty(1) || nodes.IsDirty(0))  throw std::runtime_error("NodeTransforms dirty flags are wrong");
+		CheckMatrix(nodes.Matrix(1), MatrixFromTransform({ 1, 2, 3 }, q, { 2, 2, 2 }), "NodeTransforms matrix");
+		if (nodes.IsDirty(1))  throw std::runtime_error("NodeTransforms matrix wasn't kept after it was built");
+
+		nodes.SetPosition(1, { 4, 5, 6 });
+		CheckVector(nodes.Matrix(1).GetRow(3), { 4, 5, 6 }, "NodeTransforms matrix after a change");
+
+		//A matrix that is set is kept exactly, its parts are found for the getters
+		CMatrix4x4 m = MatrixScaling(3.0f) * MatrixFromQuaternion(q) * MatrixTranslation(CVector3(7, 8, 9));
+		nodes.SetMatrix(0, m);
+		if (nodes.IsDirty(0) || MaxDifference(nodes.Matrix(0), m) != 0.0f)  throw std::runtime_error("NodeTransforms SetMatrix didn't keep the matrix");
+		CheckVector(nodes.Scale(0), { 3, 3, 3 }, "NodeTransforms scale from a matrix");
+		CheckSameRotation(nodes.Rotation(0), q, "NodeTransforms rotation from a matrix");
+	}
+
+	//Old Model setters, for comparison: everything is read from and written to the matrix
+	CVector3 MatrixScale(const CMatrix4x4& m)  { return { Length(m.GetRow(0)), Length(m.GetRow(1)), Length(m.GetRow(2)) }; }
+	void MatrixSetRotation(CMatrix4x4& m, const CVector3& rotation)
+	{
+		m = MatrixScaling(MatrixScale(m)) *
+		    MatrixRotationZ(rotation.z) * MatrixRotationX(rotation.x) * MatrixRotationY(rotation.y) *
+		    MatrixTranslation(m.GetRow(3));
+	}
+}
+
+void RunTransformBenchmark()
+{
+	std::mt19937 random(42);
+	CheckConversions(random);
+	CheckDecompose(random);
+	CheckInterpolation(random);
+	CheckNodeTransforms(random);
+
+	//Thousands of animated props. Each frame every prop is turned between two key rotations and moved, then its
+	//world matrix is read for rendering and its rotation read back by game code
+	const int count = 1 << 12;
+	std::vector<CVector3> startAngles(count), endAngles(count);
+	std::vector<CQuaternion> startRotations(count), endRotations(count);
+	for (int i = 0; i < count; ++i)
+	{
+		startAngles[i] = RandomEulerAngles(random);
+		endAngles[i] = RandomEulerAngles(random);
+		startRotations[i] = QuaternionFromEulerAngles(startAngles[i]);
+		endRotations[i] = QuaternionFromEulerAngles(endAngles[i]);
+	}
+
+	std::vector<CMatrix4x4> matrices(count, MatrixScaling(2.0f));
+	std::vector<CMatrix4x4> rendered(count);
+	std::vector<CVector3> rotations(count);
+	float t = 0.0f;
+	double matrixOnly = TimeBestOf(10, [&]
+	{
+		t = t < 1.0f ? t + 0.01f : 0.0f;
+		for (int i = 0; i < count; ++i)
+		{
+			MatrixSetRotation(matrices[i], startAngles[i] + (endAngles[i] - startAngles[i]) * t);
+			matrices[i].SetRow(3, matrices[i].GetRow(3) + CVector3(0, 0, 0.01f));
+			rendered[i] = matrices[i];
+			rotations[i] = matrices[i].GetEulerAngles();
+		}
+		DoNotOptimise(rendered.data());
+		DoNotOptimise(rotations.data());
+	});
+
+	NodeTransforms nodes;
+	nodes.Resize(count);
+	for (int i = 0; i < count; ++i)  nodes.SetScale(i, { 2, 2, 2 });
+	std::vector<CQuaternion> quaternions(count);
+	double lazy = TimeBestOf(10, [&]
+	{
+		t = t < 1.0f ? t + 0.01f : 0.0f;
+		for (int i = 0; i < count; ++i)
+		{
+			nodes.SetRotation(i, Slerp(startRotations[i], endRotations[i], t));
+			nodes.SetPosition(i, nodes.Position(i) + CVector3(0, 0, 0.01f));
+			rendered[i] = nodes.Matrix(i);
+			quaternions[i] = nodes.Rotation(i);
+		}
+		DoNotOptimise(rendered.data());
+		DoNotOptimise(quaternions.data());
+	});
+	ReportThroughput("Matrix only, set + read back, 4K props", matrixOnly, count, "props");
+	ReportThroughput("Quaternion slerp + lazy matrix, 4K props", lazy, count, "props");
+	ReportComparison("Animated props, matrix only -> lazy", matrixOnly, lazy);
+
+	//Props that didn't move this frame cost nothing to read again
+	double idle = TimeBestOf(10, [&]
+	{
+		for (int i = 0; i < count; ++i)  rendered[i] = nodes.Matrix(i);
+		DoNotOptimise(rendered.data());
+	});
+	ReportThroughput("Lazy matrix read, unchanged props", idle, count, "props");
+
+	double slerp = TimeBestOf(10, [&] { for (int i = 0; i < count; ++i)  quaternions[i] = Slerp(startRotations[i], endRotations[i], 0.3f);  DoNotOptimise(quaternions.data()); });
+	double nlerp = TimeBestOf(10, [&] { for (int i = 0; i < count; ++i)  quaternions[i] = Nlerp(startRotations[i], endRotations[i], 0.3f);  DoNotOptimise(quaternions.data()); });
+	ReportComparison("4K interpolations, slerp -> nlerp", slerp, nlerp);
+}
@@ -0,0 +1,144 @@
+//--------------------------------------------------------------------------------------
+// Transform hierarchy: every model of a mesh one at a time against one batched update
+//--------------------------------------------------------------------------------------
+// The old way worked out the world matrices of each model on its own, into a freshly allocated
+// vector, with a matrix product per node. TransformHierarchy updates all the models of a mesh
+// from one contiguous array, spread over the thread pool. Also checks the batch against the
+// plain loop, for any number of instances, in place, and on a single thread.
+
+#include "Benchmark.h"
+#include "Math/TransformHierarchy.h"
+#include "Utility/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float kMatrixTolerance = 1e-4f;
+
+	//A tree shaped like a character rig: a spine with limbs branching off it, stored depth-first
+	std::vector<unsigned int> MakeParents(int count, std::mt19937& random)
+	{
+		std::vector<unsigned int> parents(count, 0);
+		for (int node = 1; node < count; ++node)
+		{
+			//Mostly carry on down the current limb, sometimes branch off an earlier node
+			std::uniform_int_distribution<int> earlier(0, node - 1);
+			parents[node] = random() % 4 ? node - 1 : earlier(random);
+		}
+		return parents;
+	}
+
+	CMatrix4x4 RandomMatrix(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> angle(-0.5f, 0.5f), position(-1.0f, 1.0f);
+		return MatrixRotationZ(angle(random)) * MatrixRotationX(angle(random)) * MatrixRotationY(angle(random)) *
+		       MatrixTranslation(CVector3(position(random), position(random), position(random)));
+	}
+
+	//The loop the commented-out Mesh::Render used for a single model
+	void UpdateOneModel(const std::vector<unsigned int>& parents, const CMatrix4x4* local, CMatrix4x4* world)
+	{
+		world[0] = local[0];
+		for (size_t node = 1; node < parents.size(); ++node)  world[node] = MultiplyReference(local[node], world[parents[node]]);
+	}
+
+	void CheckUpdate(const std::vector<unsigned int>& parents, std::mt19937& random, ThreadPool* threadPool)
+	{
+		TransformHierarchy hierarchy(parents);
+		const int numNodes = hierarchy.NumberNodes();
+		for (int numInstances : { 0, 1, 3, 50, 333 })
+		{
+			std::vector<CMatrix4x4> local(numInstances * numNodes), world((numInstances + 1) * numNodes, MatrixIdentity());
+			for (auto& matrix : local)  matrix = RandomMatrix(random);
+			hierarchy.UpdateWorldMatrices(local.data(), world.data(), numInstances, threadPool);
+
+			std::vector<CMatrix4x4> expected(numNodes);
+			for (int instance = 0; instance < numInstances; ++instance)
+			{
+				UpdateOneModel(parents, &local[instance * numNodes], expected.data());
+				for (int node = 0; node < numNodes; ++node)
+				{
+					const CMatrix4x4& result = world[instance * numNodes + node];
+					for (int i = 0; i < 16; ++i)
+					{
+						if (std::abs((&result.e00)[i] - (&expected[node].e00)[i]) > kMatrixTolerance)
+						{
+							throw std::runtime_error("Batched hierarchy update doesn't match one model at a time");
+						}
+					}
+				}
+			}
+			const CMatrix4x4 identity = MatrixIdentity();
+			for (size_t i = local.size(); i < world.size(); ++i)
+			{
+				if (std::memcmp(&world[i], &identity, sizeof(CMatrix4x4)) != 0)  throw std::runtime_error("Batched hierarchy update wrote past the end");
+			}
+
+			//In place, as Model::WorldBounds uses it
+			hierarchy.UpdateWorldMatrices(local.data(), local.data(), numInstances, threadPool);
+			if (!std::equal(local.begin(), local.end(), world.begin(), [](const CMatrix4x4& a, const CMatrix4x4& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; }))
+			{
+				throw std::runtime_error("Batched hierarchy update in place doesn't match");
+			}
+		}
+	}
+
+	void CheckOrder()
+	{
+		for (const std::vector<unsigned int>& parents : { std::vector<unsigned int>{ 1, 0 }, std::vector<unsigned int>{ 0, 0, 2 }, std::vector<unsigned int>{ 0, 2, 0 } })
+		{
+			if (!Throws([&] { TransformHierarchy hierarchy(parents); }))  throw std::runtime_error("TransformHierarchy accepted nodes before their parents");
+		}
+	}
+}
+
+void RunTransformHierarchyBenchmark()
+{
+	std::mt19937 random(42);
+	ThreadPool singleThread(0);
+	CheckOrder();
+	for (int numNodes : { 1, 2, 17, 64 })
+	{
+		std::vector<unsigned int> parents = MakeParents(numNodes, random);
+		CheckUpdate(parents, random, nullptr);
+		CheckUpdate(parents, random, &singleThread);
+	}
+
+	//A crowd of characters sharing one 64 bone rig
+	const int numNodes = 64, numInstances = 2048;
+	std::vector<unsigned int> parents = MakeParents(numNodes, random);
+	TransformHierarchy hierarchy(parents);
+	std::vector<CMatrix4x4> local(numInstances * numNodes), world(numInstances * numNodes);
+	for (auto& matrix : local)  matrix = RandomMatrix(random);
+
+	double perModel = TimeBestOf(10, [&]
+	{
+		for (int instance = 0; instance < numInstances; ++instance)
+		{
+			//A new vector each model, as Mesh::Render had
+			std::vector<CMatrix4x4> absoluteMatrices(numNodes);
+			absoluteMatrices[0] = local[instance * numNodes];
+			for (int node = 1; node < numNodes; ++node)
+			{
+				absoluteMatrices[node] = local[instance * numNodes + node] * absoluteMatrices[parents[node]];
+			}
+			std::copy(absoluteMatrices.begin(), absoluteMatrices.end(), world.begin() + instance * numNodes);
+		}
+		DoNotOptimise(world.data());
+	});
+	double batchSingle = TimeBestOf(10, [&] { hierarchy.UpdateWorldMatrices(local.data(), world.data(), numInstances, &singleThread);  DoNotOptimise(world.data()); });
+	double batch = TimeBestOf(10, [&] { hierarchy.UpdateWorldMatrices(local.data(), world.data(), numInstances);  DoNotOptimise(world.data()); });
+
+	const double numMatrices = static_cast<double>(numInstances) * numNodes;
+	ReportThroughput("One model at a time, 2K x 64 nodes", perModel, numMatrices, "matrices");
+	ReportThroughput(std::string("Batched (") + MatrixKernelName() + "), 1 thread", batchSingle, numMatrices, "matrices");
+	ReportThroughput("Batched, shared thread pool", batch, numMatrices, "matrices");
+	ReportComparison("2K models, one at a time -> batched", perModel, batch);
+}
@@ -0,0 +1,216 @@
+//--------------------------------------------------------------------------------------
+// Vec3SoA: bulk vector maths eight vectors at a time against CVector3 one at a time
+//--------------------------------------------------------------------------------------
+// First checks every Vec3SoA operation against the CVector3 version, including vectors too
+// short to normalise, and that gathering / scattering partial groups from interleaved vertex
+// data reads and writes only the vectors asked for
+
+#include "Benchmark.h"
+#include "Math/Vec3SoA.h"
+#include "Math/CVector3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float kVec3SoATolerance = 1e-5f;
+
+	//Interleaved like a mesh vertex with a position, normal and uv, 32 bytes each
+	struct TestVertex
+	{
+		CVector3 position;
+		CVector3 normal;
+		float    u, v;
+	};
+
+	void CheckLanes(const Vec3SoA& result, const CVector3* expected, const std::string& what)
+	{
+		alignas(32) float x[kFloat8Width], y[kFloat8Width], z[kFloat8Width];
+		Store(x, y, z, result);
+		for (int lane = 0; lane < kFloat8Width; ++lane)
+		{
+			//Relative to the size of the result, the scalar code may be compiled with fused multiply-adds
+			float difference = std::max({ std::abs(x[lane] - expected[lane].x), std::abs(y[lane] - expected[lane].y), std::abs(z[lane] - expected[lane].z) });
+			if (difference > kVec3SoATolerance * std::max(1.0f, Length(expected[lane])))  throw std::runtime_error("Vec3SoA " + what + " doesn't match CVector3");
+		}
+	}
+
+	void CheckLanes(float8 result, const float* expected, const std::string& what)
+	{
+		alignas(32) float values[kFloat8Width];
+		Store(values, result);
+		for (int lane = 0; lane < kFloat8Width; ++lane)
+		{
+			if (std::abs(values[lane] - expected[lane]) > kVec3SoATolerance * std::max(1.0f, std::abs(expected[lane])))
+			{
+				throw std::runtime_error("Vec3SoA " + what + " doesn't match CVector3");
+			}
+		}
+	}
+
+	void CheckOperations(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		for (int test = 0; test < 100; ++test)
+		{
+			CVector3 a[kFloat8Width], b[kFloat8Width];
+			float t[kFloat8Width];
+			for (int lane = 0; lane < kFloat8Width; ++lane)
+			{
+				a[lane] = CVector3(value(random), value(random), value(random));
+				b[lane] = CVector3(value(random), value(random), value(random));
+				t[lane] = value(random) * 0.1f;
+			}
+			a[3] = CVector3(0.0f, 0.0f, 0.0f);     // Can't be normalised, should become zero
+			a[5] = CVector3(1e-4f, 0.0f, -1e-4f); // Squared length below epsilon, also zero
+
+			Vec3SoA soaA = GatherVec3(a, sizeof(CVector3));
+			Vec3SoA soaB = GatherVec3(b, sizeof(CVector3));
+			float8 soaT = Load(t);
+
+			CVector3 expected[kFloat8Width];
+			float expectedFloats[kFloat8Width];
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = a[lane] + b[lane];
+			CheckLanes(soaA + soaB, expected, "add");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = a[lane] - b[lane];
+			CheckLanes(soaA - soaB, expected, "subtract");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  { expected[lane] = a[lane];  expected[lane] *= b[lane]; }
+			CheckLanes(soaA * soaB, expected, "multiply");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = a[lane] * t[lane];
+			CheckLanes(soaA * soaT, expected, "scale");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = Cross(a[lane], b[lane]);
+			CheckLanes(Cross(soaA, soaB), expected, "cross");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = Normalise(a[lane]);
+			CheckLanes(Normalise(soaA), expected, "normalise");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expected[lane] = a[lane] + (b[lane] - a[lane]) * t[lane];
+			CheckLanes(Lerp(soaA, soaB, soaT), expected, "lerp");
+
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expectedFloats[lane] = Dot(a[lane], b[lane]);
+			CheckLanes(Dot(soaA, soaB), expectedFloats, "dot");
+			for (int lane = 0; lane < kFloat8Width; ++lane)  expectedFloats[lane] = Length(a[lane]);
+			CheckLanes(Length(soaA), expectedFloats, "length");
+		}
+	}
+
+	//Gather and scatter the normals of every partial group, checking nothing else in the vertices changes
+	void CheckGatherScatter(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+		for (int count = 0; count <= kFloat8Width; ++count)
+		{
+			//Exactly count vertices, so reading or writing past the last normal would go out of the allocation
+			std::vector<TestVertex> vertices(count);
+			for (auto& vertex : vertices)
+			{
+				vertex.position = CVector3(value(random), value(random), value(random));
+				vertex.normal = CVector3(value(random), value(random), value(random));
+				vertex.u = value(random);
+				vertex.v = value(random);
+			}
+			std::vector<TestVertex> original = vertices;
+
+			Vec3SoA normals = GatherVec3(&vertices.data()->normal, sizeof(TestVertex), count);
+			alignas(32) float x[kFloat8Width], y[kFloat8Width], z[kFloat8Width];
+			Store(x, y, z, normals);
+			for (int lane = 0; lane < kFloat8Width; ++lane)
+			{
+				bool match = lane < count ? x[lane] == original[lane].normal.x && y[lane] == original[lane].normal.y && z[lane] == original[lane].normal.z
+				                          : x[lane] == 0.0f && y[lane] == 0.0f && z[lane] == 0.0f;
+				if (!match)  throw std::runtime_error("GatherVec3 of " + std::to_string(count) + " vectors is wrong");
+			}
+
+			ScatterVec3(&vertices.data()->normal, sizeof(TestVertex), Normalise(normals), count);
+			for (int i = 0; i < count; ++i)
+			{
+				CVector3 expected = Normalise(original[i].normal);
+				if (Length(vertices[i].normal - expected) > kVec3SoATolerance)  throw std::runtime_error("ScatterVec3 wrote the wrong normal");
+
+				vertices[i].normal = original[i].normal;
+				if (std::memcmp(&vertices[i], &original[i], sizeof(TestVertex)) != 0)  throw std::runtime_error("ScatterVec3 wrote outside the normals");
+			}
+		}
+	}
+}
+
+void RunVec3SoABenchmark()
+{
+	std::mt19937 random(42);
+	CheckOperations(random);
+	CheckGatherScatter(random);
+
+	//Particles: steer each velocity towards a target direction, then move. AoS CVector3 against SoA arrays
+	const size_t count = 1 << 18;
+	const float dt = 1.0f / 60.0f;
+	std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+
+	std::vector<CVector3> positions(count), velocities(count), targets(count);
+	std::vector<float> soa(count * 9);
+	float* px = soa.data();         float* py = px + count;  float* pz = py + count;
+	float* vx = pz + count;         float* vy = vx + count;  float* vz = vy + count;
+	float* tx = vz + count;         float* ty = tx + count;  float* tz = ty + count;
+	for (size_t i = 0; i < count; ++i)
+	{
+		positions[i] = CVector3(value(random), value(random), value(random));
+		velocities[i] = CVector3(value(random), value(random), value(random));
+		targets[i] = CVector3(value(random), value(random), value(random));
+		px[i] = positions[i].x;   py[i] = positions[i].y;   pz[i] = positions[i].z;
+		vx[i] = velocities[i].x;  vy[i] = velocities[i].y;  vz[i] = velocities[i].z;
+		tx[i] = targets[i].x;     ty[i] = targets[i].y;     tz[i] = targets[i].z;
+	}
+
+	double scalar = TimeBestOf(10, [&]
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			CVector3 steer = Normalise(targets[i] - positions[i]) * Length(velocities[i]);
+			velocities[i] = velocities[i] + (steer - velocities[i]) * 0.1f;
+			positions[i] += velocities[i] * dt;
+		}
+		DoNotOptimise(positions.data());
+	});
+
+	double batch = TimeBestOf(10, [&]
+	{
+		const float8 steerRate = Splat(0.1f);
+		const float8 timeStep = Splat(dt);
+		for (size_t i = 0; i < count; i += kFloat8Width)
+		{
+			Vec3SoA position = Load(px + i, py + i, pz + i);
+			Vec3SoA velocity = Load(vx + i, vy + i, vz + i);
+			Vec3SoA target = Load(tx + i, ty + i, tz + i);
+			Vec3SoA steer = Normalise(target - position) * Length(velocity);
+			velocity = Lerp(velocity, steer, steerRate);
+			Store(vx + i, vy + i, vz + i, velocity);
+			Store(px + i, py + i, pz + i, position + velocity * timeStep);
+		}
+		DoNotOptimise(px);
+	});
+	ReportThroughput("CVector3 particles, 256K", scalar, count, "particles");
+	ReportThroughput("Vec3SoA particles, 256K", batch, count, "particles");
+	ReportComparison("Particle update, CVector3 -> Vec3SoA", scalar, batch);
+
+	//Renormalising the normals of interleaved vertex data in place, e.g. after a deformation
+	std::vector<TestVertex> vertices(count);
+	for (auto& vertex : vertices)  vertex.normal = CVector3(value(random), value(random), value(random));
+	double scalarNormals = TimeBestOf(10, [&]
+	{
+		for (auto& vertex : vertices)  vertex.normal = Normalise(vertex.normal);
+		DoNotOptimise(vertices.data());
+	});
+	double batchNormals = TimeBestOf(10, [&]
+	{
+		for (size_t i = 0; i < count; i += kFloat8Width)
+		{
+			CVector3* normal = &vertices[i].normal;
+			ScatterVec3(normal, sizeof(TestVertex), Normalise(GatherVec3(normal, sizeof(TestVertex))));
+		}
+		DoNotOptimise(vertices.data());
+	});
+	ReportComparison("Vertex normals, CVector3 -> gather / scatter", scalarNormals, batchNormals);
+}
@@ -0,0 +1,147 @@
+#include "Benchmark.h"
+#include "Utility/Timer.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	struct BenchmarkEntry
+	{
+		const char* name;
+		void (*function)();
+	};
+
+	//Every benchmark in the project, in the order they are run
+	const BenchmarkEntry gBenchmarks[] =
+	{
+		{ "heightfield",   RunHeightFieldBenchmark },
+		{ "diamondsquare", RunDiamondSquareBenchmark },
+		{ "perlin",        RunPerlinBenchmark },
+		{ "fractal",       RunFractalBenchmark },
+		{ "gridvertices",  RunGridVerticesBenchmark },
+		{ "gridupdate",    RunGridUpdateBenchmark },
+		{ "terrain",       RunTerrainQuadTreeBenchmark },
+		{ "culling",       RunFrustumCullingBenchmark },
+		{ "matrix",        RunMatrixBenchmark },
+		{ "vec3soa",       RunVec3SoABenchmark },
+		{ "transforms",    RunTransformBenchmark },
+		{ "hierarchy",     RunTransformHierarchyBenchmark },
+		{ "skinning",      RunSkinningBenchmark },
+		{ "animation",     RunAnimationBenchmark },
+		{ "boneload",      RunBoneLoadBenchmark },
+		{ "meshload",      RunMeshLoadBenchmark },
+		{ "asyncload",     RunAsyncLoadBenchmark },
+		{ "resourceids",   RunResourceIdBenchmark },
+		{ "resourcepool",  RunResourcePoolBenchmark },
+		{ "assetarchive",  RunAssetArchiveBenchmark },
+		{ "cookmanifest",  RunCookManifestBenchmark },
+	};
+
+	volatile const void* gSink = nullptr;
+}
+
+//Run the given function the given number of times and return the fastest run in milliseconds
+double TimeBestOf(int repeats, const std::function<void()>& function)
+{
+	Timer timer;
+	double best = 1e30;
+	for (int i = 0; i < repeats; ++i)
+	{
+		timer.Reset();
+		function();
+		best = std::min(best, static_cast<double>(timer.GetTime()) * 1000.0);
+	}
+	return best;
+}
+
+//Print a single result line in a consistent format
+void ReportResult(const std::string& name, double milliseconds)
+{
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+	          << std::setw(12) << milliseconds << " ms" << std::endl;
+}
+
+//Print a single result line with a throughput figure (items per second) next to the time
+void ReportThroughput(const std::string& name, double milliseconds, double items, const std::string& itemName)
+{
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+	          << std::setw(12) << milliseconds << " ms" << std::setprecision(1)
+	          << std::setw(16) << (items / (milliseconds / 1000.0)) / 1e6 << " M" << itemName << "/s" << std::endl;
+}
+
+//Print a single measured figure that isn't a time
+void ReportValue(const std::string& name, double value, const std::string& unit)
+{
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+	          << std::setw(12) << value << " " << unit << std::endl;
+}
+
+//Print a comparison of a baseline time against a new time
+void ReportComparison(const std::string& name, double baselineMilliseconds, double newMilliseconds)
+{
+	std::cout << "  " << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+	          << std::setw(12) << baselineMilliseconds << " ms -> " << newMilliseconds << " ms  (x"
+	          << std::setprecision(2) << baselineMilliseconds / newMilliseconds << ")" << std::endl;
+}
+
+//Stops the optimiser throwing away results that are otherwise unused
+void DoNotOptimise(const void* pointer)
+{
+	gSink = pointer;
+}
+
+//Make an empty folder in the temp directory
+TempFolder::TempFolder(const std::string& name)
+	: m_Path(std::filesystem::temp_directory_path() / name)
+{
+	std::filesystem::remove_all(m_Path);
+	std::filesystem::create_directories(m_Path);
+}
+
+//Remove the folder and everything in it. Errors are ignored, at worst the files stay until the next run
+TempFolder::~TempFolder()
+{
+	std::error_code error;
+	std::filesystem::remove_all(m_Path, error);
+}
+
+//Write a whole file
+void WriteFile(const std::string& fileName, const void* data, size_t size)
+{
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	if (!file)  throw std::runtime_error("Can't write " + fileName);
+}
+
+void WriteFile(const std::string& fileName, const std::string& contents)
+{
+	WriteFile(fileName, contents.data(), contents.size());
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> selected(argv + 1, argv + argc);
+
+	int failures = 0;
+	for (auto& benchmark : gBenchmarks)
+	{
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), benchmark.name) == selected.end())  continue;
+
+		std::cout << "[" << benchmark.name << "]" << std::endl;
+		try
+		{
+			benchmark.function();
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "  FAILED: " << e.what() << std::endl;
+			++failures;
+		}
+		std::cout << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
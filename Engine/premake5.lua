@@ -77,6 +77,16 @@ project "Engine"
 		shadertype("Vertex")
 		shaderoptions({"/WX"})
 
+	-- Kernels for the wider instruction sets are only called after checking the CPU supports them,
+	-- they skip the precompiled header so no shared code gets compiled for those instruction sets
+	filter("files:src/**AVX2.cpp")
+		flags("NoPCH")
+		vectorextensions("AVX2")
+
+	filter("files:src/**AVX512.cpp")
+		flags("NoPCH")
+		buildoptions("/arch:AVX512")
+
 	filter "system:windows"
 		systemversion "latest"
 
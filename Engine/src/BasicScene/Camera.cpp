@@ -15,70 +15,99 @@ void Camera::Control(float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode
 	if (KeyHeld(Key_Down))
 	{
 		mRotation.x += ROTATION_SPEED * frameTime; // Use of frameTime to ensure same speed on different machines
+		mViewDirty = true;
 	}
 	if (KeyHeld(Key_Up))
 	{
 		mRotation.x -= ROTATION_SPEED * frameTime;
+		mViewDirty = true;
 	}
 	if (KeyHeld(Key_Right))
 	{
 		mRotation.y += ROTATION_SPEED * frameTime;
+		mViewDirty = true;
 	}
 	if (KeyHeld(Key_Left))
 	{
 		mRotation.y -= ROTATION_SPEED * frameTime;
+		mViewDirty = true;
 	}
 
 	//**** LOCAL MOVEMENT ****
+	// Move along the axes of the world matrix, brought up to date with any rotation above
+	if (!KeyHeld(Key_D) && !KeyHeld(Key_A) && !KeyHeld(Key_W) && !KeyHeld(Key_S))  return;
+	const CMatrix4x4& worldMatrix = WorldMatrix();
+	mViewDirty = true;
+
 	if (KeyHeld(Key_D))
 	{
-		mPosition.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e00; // See comments on local movement in UpdateCube code above
-		mPosition.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e01; 
-		mPosition.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e02; 
+		mPosition.x += MOVEMENT_SPEED * frameTime * worldMatrix.e00; // See comments on local movement in UpdateCube code above
+		mPosition.y += MOVEMENT_SPEED * frameTime * worldMatrix.e01; 
+		mPosition.z += MOVEMENT_SPEED * frameTime * worldMatrix.e02; 
 	}
 	if (KeyHeld(Key_A))
 	{
-		mPosition.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e00;
-		mPosition.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e01;
-		mPosition.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e02;
+		mPosition.x -= MOVEMENT_SPEED * frameTime * worldMatrix.e00;
+		mPosition.y -= MOVEMENT_SPEED * frameTime * worldMatrix.e01;
+		mPosition.z -= MOVEMENT_SPEED * frameTime * worldMatrix.e02;
 	}
 	if (KeyHeld(Key_W))
 	{
-		mPosition.x += MOVEMENT_SPEED * frameTime * mWorldMatrix.e20;
-		mPosition.y += MOVEMENT_SPEED * frameTime * mWorldMatrix.e21;
-		mPosition.z += MOVEMENT_SPEED * frameTime * mWorldMatrix.e22;
+		mPosition.x += MOVEMENT_SPEED * frameTime * worldMatrix.e20;
+		mPosition.y += MOVEMENT_SPEED * frameTime * worldMatrix.e21;
+		mPosition.z += MOVEMENT_SPEED * frameTime * worldMatrix.e22;
 	}
 	if (KeyHeld(Key_S))
 	{
-		mPosition.x -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e20;
-		mPosition.y -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e21;
-		mPosition.z -= MOVEMENT_SPEED * frameTime * mWorldMatrix.e22;
+		mPosition.x -= MOVEMENT_SPEED * frameTime * worldMatrix.e20;
+		mPosition.y -= MOVEMENT_SPEED * frameTime * worldMatrix.e21;
+		mPosition.z -= MOVEMENT_SPEED * frameTime * worldMatrix.e22;
 	}
 }
 
 
-// Update the matrices used for the camera in the rendering pipeline
-void Camera::UpdateMatrices()
+// Update the world and view matrices if the position or rotation have changed
+void Camera::UpdateView()
 {
+    if (!mViewDirty)  return;
+
     // "World" matrix for the camera - treat it like a model at first
     mWorldMatrix = MatrixRotationZ(mRotation.z) * MatrixRotationX(mRotation.x) * MatrixRotationY(mRotation.y) * MatrixTranslation(mPosition);
 
     // View matrix is the usual matrix used for the camera in shaders, it is the inverse of the world matrix (see lectures)
     mViewMatrix = InverseAffine(mWorldMatrix);
 
+    mViewDirty = false;
+    mViewProjectionDirty = true;
+}
+
+// Update the projection matrix if the field of view, aspect ratio or clip distances have changed
+void Camera::UpdateProjection()
+{
+    if (!mProjectionDirty)  return;
+
     // Projection matrix, how to flatten the 3D world onto the screen (needs field of view, near and far clip, aspect ratio)
-    float tanFOVx = std::tan(mFOVx * 0.5f);
-    float scaleX = 1.0f / tanFOVx;
-    float scaleY = mAspectRatio / tanFOVx;
-    float scaleZa = mFarClip / (mFarClip - mNearClip);
-    float scaleZb = -mNearClip * scaleZa;
+    mProjectionMatrix = MatrixPerspectiveFOVx(mFOVx, mAspectRatio, mNearClip, mFarClip);
+    mInverseProjectionMatrix = InversePerspective(mProjectionMatrix);
 
-    mProjectionMatrix = { scaleX,   0.0f,    0.0f,   0.0f,
-                            0.0f, scaleY,    0.0f,   0.0f,
-                            0.0f,   0.0f, scaleZa,   1.0f,
-                            0.0f,   0.0f, scaleZb,   0.0f };
+    mProjectionDirty = false;
+    mViewProjectionDirty = true;
+}
+
+// Update the matrices combining view and projection if either has changed
+void Camera::UpdateViewProjection()
+{
+    UpdateView();
+    UpdateProjection();
+    if (!mViewProjectionDirty)  return;
 
     // The view-projection matrix combines the two matrices usually used for the camera into one, which can save a multiply in the shaders (optional)
     mViewProjectionMatrix = mViewMatrix * mProjectionMatrix;
-}
 
+    // The inverse undoes the projection then the view, and the inverse of the view matrix is the world matrix
+    mInverseViewProjectionMatrix = mInverseProjectionMatrix * mWorldMatrix;
+
+    mFrustum = Frustum(mViewProjectionMatrix);
+
+    mViewProjectionDirty = false;
+}
@@ -2,10 +2,12 @@
 // Class encapsulating a camera
 //--------------------------------------------------------------------------------------
 // Holds position, rotation, near/far clip and field of view. These to a view and projection matrices as required
+// The matrices are cached, and only the ones affected by a change are rebuilt, the next time they are read
 
 #include "Common/Common.h"
 #include "Math/CVector3.h"
 #include "Math/CMatrix4x4.h"
+#include "Math/Frustum.h"
 #include "Math/MathHelpers.h"
 #include "Utility/Input.h"
 
@@ -38,31 +40,44 @@ public:
 	//-------------------------------------
 
 	// Getters / setters
+	// Setters only record the change, the matrices that depend on it are rebuilt the next time one is read
 	CVector3 Position()  { return mPosition; }
 	CVector3 Rotation()  { return mRotation;	}
-	void SetPosition(CVector3 position)  { mPosition = position; }
-	void SetRotation(CVector3 rotation)  { mRotation = rotation; }
+	void SetPosition(CVector3 position)  { mPosition = position; mViewDirty = true; }
+	void SetRotation(CVector3 rotation)  { mRotation = rotation; mViewDirty = true; }
 
-	float FOV()       { return mFOVx;     }
-	float NearClip()  { return mNearClip; }
-	float FarClip()   { return mFarClip;  }
+	float FOV()          { return mFOVx;        }
+	float AspectRatio()  { return mAspectRatio; }
+	float NearClip()     { return mNearClip;    }
+	float FarClip()      { return mFarClip;     }
 
-	void SetFOV     (float fov     )  { mFOVx     = fov;      }
-	void SetNearClip(float nearClip)  { mNearClip = nearClip; }
-	void SetFarClip (float farClip )  { mFarClip  = farClip;  }
+	void SetFOV        (float fov        )  { mFOVx        = fov;         mProjectionDirty = true; }
+	void SetAspectRatio(float aspectRatio)  { mAspectRatio = aspectRatio; mProjectionDirty = true; }
+	void SetNearClip   (float nearClip   )  { mNearClip    = nearClip;    mProjectionDirty = true; }
+	void SetFarClip    (float farClip    )  { mFarClip     = farClip;     mProjectionDirty = true; }
 
 	// Read only access to camera matrices, updated on request from position, rotation and camera settings
-	CMatrix4x4 ViewMatrix()            { UpdateMatrices(); return mViewMatrix;           }
-	CMatrix4x4 ProjectionMatrix()      { UpdateMatrices(); return mProjectionMatrix;     }
-	CMatrix4x4 ViewProjectionMatrix()  { UpdateMatrices(); return mViewProjectionMatrix; }
+	// Each is only recalculated if something it depends on has changed since it was last read
+	const CMatrix4x4& WorldMatrix()                  { UpdateView();           return mWorldMatrix;                 }
+	const CMatrix4x4& ViewMatrix()                   { UpdateView();           return mViewMatrix;                  }
+	const CMatrix4x4& ProjectionMatrix()             { UpdateProjection();     return mProjectionMatrix;            }
+	const CMatrix4x4& ViewProjectionMatrix()         { UpdateViewProjection(); return mViewProjectionMatrix;        }
+
+	// Takes points from clip space back to world space, e.g. to turn a mouse position into a picking ray
+	const CMatrix4x4& InverseViewProjectionMatrix()  { UpdateViewProjection(); return mInverseViewProjectionMatrix; }
+
+	// Planes around what the camera can see, taken from the view-projection matrix. Used to cull models and terrain
+	const Frustum& ViewFrustum()                     { UpdateViewProjection(); return mFrustum;                     }
 
 	
 //-------------------------------------
 // Private members
 //-------------------------------------
 private:
-	// Update the matrices used for the camera in the rendering pipeline
-	void UpdateMatrices();
+	// Update the matrices used for the camera in the rendering pipeline, if the settings they come from have changed
+	void UpdateView();           // World and view matrices, from position and rotation
+	void UpdateProjection();     // Projection matrix and its inverse, from field of view, aspect ratio and clip distances
+	void UpdateViewProjection(); // Everything that combines the two: view-projection matrix, its inverse and the frustum
 
 	// Postition and rotations for the camera (rarely scale cameras)
 	CVector3 mPosition;
@@ -82,6 +97,15 @@ private:
 	CMatrix4x4 mProjectionMatrix;     // Projection matrix holds the field of view and near/far clip distances
 	CMatrix4x4 mViewProjectionMatrix; // Combine (multiply) the view and projection matrices together, which
 	                                  // can sometimes save a matrix multiply in the shader (optional)
+
+	CMatrix4x4 mInverseProjectionMatrix;     // Inverses for going from the screen back into the world (picking)
+	CMatrix4x4 mInverseViewProjectionMatrix;
+	Frustum    mFrustum;
+
+	// Which matrices are out of date. Everything starts out of date so it is all calculated on first use
+	bool mViewDirty           = true; // Position or rotation changed
+	bool mProjectionDirty     = true; // Field of view, aspect ratio or clip distances changed
+	bool mViewProjectionDirty = true; // Either of the above has been rebuilt since the combined matrices were
 };
 
 
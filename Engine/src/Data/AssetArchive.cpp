@@ -0,0 +1,341 @@
+#include "epch.h"
+#include "AssetArchive.h"
+#include "CookedMesh.h"
+#include "Utility/Lz4.h"
+#include "Utility/ResourceId.h"
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+	const char kAssetArchiveMagic[4] = { 'E', 'P', 'A', 'K' };
+
+	//Entries are sorted by the hash of their name, then by name for the rare hashes that are the same
+	bool EntryBefore(const AssetArchiveEntry& a, std::string_view aName, const AssetArchiveEntry& b, std::string_view bName)
+	{
+		return a.NameHash != b.NameHash ? a.NameHash < b.NameHash : aName < bName;
+	}
+}
+
+//An asset's name as it is stored in archives
+std::string NormaliseAssetName(std::string_view name)
+{
+	std::string normalised;
+	normalised.reserve(name.size());
+	size_t start = 0;
+	while (start <= name.size())
+	{
+		size_t end = name.find_first_of("/\\", start);
+		if (end == std::string_view::npos)  end = name.size();
+		const std::string_view part = name.substr(start, end - start);
+
+		//A leading slash is kept, empty and "." parts in between are dropped. ".." can't be resolved without the
+		//file system, and "../Media" is a usual name, so it is kept as it is
+		if (start == 0 && part.empty() && end < name.size())
+		{
+			normalised += '/';
+		}
+		else if (!part.empty() && part != ".")
+		{
+			if (!normalised.empty() && normalised.back() != '/')  normalised += '/';
+			for (char c : part)  normalised += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+		start = end + 1;
+	}
+	return normalised;
+}
+
+
+//--------------------------------------------------------------------------------------
+// AssetData
+//--------------------------------------------------------------------------------------
+
+//Point at bytes that stay valid elsewhere
+void AssetData::SetMapped(const unsigned char* data, size_t size)
+{
+	m_Owned = std::vector<unsigned char>();
+	m_Data = data;
+	m_Size = size;
+}
+
+//Make room for bytes of its own
+unsigned char* AssetData::SetOwned(size_t size)
+{
+	//At least a byte, so an empty asset still isn't mistaken for a mapped one
+	m_Owned.assign(std::max<size_t>(size, 1), 0);
+	m_Data = m_Owned.data();
+	m_Size = size;
+	return m_Owned.data();
+}
+
+//Touch every page of mapped bytes so they are read from disk now
+void AssetData::Prefetch() const
+{
+	if (!IsMapped())  return;
+
+	//As MappedFile::Prefetch, reading through volatile so the reads aren't optimised away
+	const size_t kPageSize = 4096;
+	const volatile unsigned char* data = m_Data;
+	for (size_t offset = 0; offset < m_Size; offset += kPageSize)  (void)data[offset];
+}
+
+
+//--------------------------------------------------------------------------------------
+// AssetArchive
+//--------------------------------------------------------------------------------------
+
+//The archive the engine loads assets from
+AssetArchive& AssetArchive::Get()
+{
+	static AssetArchive archive;
+	return archive;
+}
+
+//Map the given archive
+bool AssetArchive::Open(const std::string& fileName)
+{
+	Close();
+	if (!m_File.Open(fileName))  return false;
+
+	try
+	{
+		Validate(fileName);
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	m_File.Close();
+	m_Header  = nullptr;
+	m_Entries = nullptr;
+	m_Names   = nullptr;
+}
+
+//Check the header and table of contents are inside the file and in order
+void AssetArchive::Validate(const std::string& fileName)
+{
+	const unsigned char* data = m_File.Data();
+	const uint64_t size = m_File.Size();
+	auto corrupt = [&](const char* problem) { return std::runtime_error("Asset archive " + fileName + " is corrupt: " + problem); };
+
+	if (size < sizeof(AssetArchiveHeader))  throw corrupt("too short");
+	m_Header = reinterpret_cast<const AssetArchiveHeader*>(data);
+	if (std::memcmp(m_Header->Magic, kAssetArchiveMagic, sizeof(kAssetArchiveMagic)) != 0)  throw corrupt("not an asset archive");
+	if (m_Header->Version != kAssetArchiveVersion)
+	{
+		throw std::runtime_error("Asset archive " + fileName + " is version " + std::to_string(m_Header->Version) + ", expected " +
+		                         std::to_string(kAssetArchiveVersion) + ". Pack it again");
+	}
+	if (m_Header->FileSize != size)  throw corrupt("wrong size, it may not have been written completely");
+
+	const uint64_t entriesSize = static_cast<uint64_t>(m_Header->NumAssets) * sizeof(AssetArchiveEntry);
+	if (m_Header->EntriesOffset % alignof(AssetArchiveEntry) != 0 || m_Header->EntriesOffset > size ||
+	    entriesSize > size - m_Header->EntriesOffset)
+	{
+		throw corrupt("table of contents outside the file");
+	}
+	if (m_Header->NamesOffset > size || m_Header->NamesSize > size - m_Header->NamesOffset)  throw corrupt("names outside the file");
+	m_Entries = reinterpret_cast<const AssetArchiveEntry*>(data + m_Header->EntriesOffset);
+	m_Names   = reinterpret_cast<const char*>(data + m_Header->NamesOffset);
+
+	for (unsigned int asset = 0; asset < m_Header->NumAssets; ++asset)
+	{
+		const AssetArchiveEntry& entry = m_Entries[asset];
+		if (entry.NameOffset > m_Header->NamesSize || entry.NameLength > m_Header->NamesSize - entry.NameOffset)  throw corrupt("name outside the names");
+		if (entry.Offset % kAssetAlignment != 0 || entry.Offset > size || entry.StoredSize > size - entry.Offset)  throw corrupt("asset outside the file");
+		if (entry.Compression != kAssetStored && entry.Compression != kAssetLz4)  throw corrupt("unknown compression");
+		if (entry.Compression == kAssetStored && entry.StoredSize != entry.Size)  throw corrupt("stored asset of the wrong size");
+		if (entry.Compression == kAssetLz4 && entry.Size > entry.StoredSize * kLz4MaxRatio)  throw corrupt("compressed asset larger than its bytes can hold");
+
+		const std::string_view name = Name(entry);
+		if (entry.NameHash != HashResourceName(name))  throw corrupt("name hash doesn't match");
+		if (asset > 0 && !EntryBefore(m_Entries[asset - 1], Name(m_Entries[asset - 1]), entry, name))  throw corrupt("table of contents out of order");
+	}
+}
+
+//The entry of an asset
+const AssetArchiveEntry* AssetArchive::Find(std::string_view name) const
+{
+	if (!m_Header)  return nullptr;
+
+	const std::string normalised = NormaliseAssetName(name);
+	const uint64_t hash = HashResourceName(std::string_view(normalised));
+	const AssetArchiveEntry* end = m_Entries + m_Header->NumAssets;
+	const AssetArchiveEntry* entry = std::lower_bound(m_Entries, end, hash, [](const AssetArchiveEntry& e, uint64_t h) { return e.NameHash < h; });
+	for (; entry != end && entry->NameHash == hash; ++entry)
+	{
+		if (Name(*entry) == normalised)  return entry;
+	}
+	return nullptr;
+}
+
+//Read an asset, in place if it is stored as it is
+bool AssetArchive::Read(std::string_view name, AssetData& data) const
+{
+	const AssetArchiveEntry* entry = Find(name);
+	if (!entry)  return false;
+	Read(*entry, data);
+	return true;
+}
+
+void AssetArchive::Read(const AssetArchiveEntry& entry, AssetData& data) const
+{
+	const unsigned char* stored = m_File.Data() + entry.Offset;
+	if (entry.Compression == kAssetStored)
+	{
+		data.SetMapped(stored, static_cast<size_t>(entry.Size));
+		return;
+	}
+
+	unsigned char* output = data.SetOwned(static_cast<size_t>(entry.Size));
+	if (!DecompressLz4(stored, static_cast<size_t>(entry.StoredSize), output, static_cast<size_t>(entry.Size)))
+	{
+		throw std::runtime_error("Asset " + std::string(Name(entry)) + " in an asset archive is corrupt");
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// AssetArchiveWriter
+//--------------------------------------------------------------------------------------
+
+//Constructor, starts writing the given archive
+AssetArchiveWriter::AssetArchiveWriter(const std::string& fileName)
+	: m_FileName(fileName), m_PartFileName(CookedPartFileName(fileName))
+{
+	m_File.open(m_PartFileName, std::ios::binary | std::ios::trunc);
+	if (!m_File)  throw std::runtime_error("Can't create asset archive " + m_PartFileName);
+
+	//The header is written by Finish, once the table of contents has been
+	AssetArchiveHeader header = {};
+	Append(&header, sizeof(header));
+	Pad(kAssetAlignment);
+}
+
+//Destructor, deletes the part written if Finish wasn't called
+AssetArchiveWriter::~AssetArchiveWriter()
+{
+	if (m_Finished)  return;
+	m_File.close();
+	std::error_code error;
+	std::filesystem::remove(m_PartFileName, error);
+}
+
+//Add an asset
+bool AssetArchiveWriter::Add(std::string_view name, const void* data, size_t size, bool compress)
+{
+	if (m_Finished)  throw std::runtime_error("Adding to asset archive " + m_FileName + " after it was finished");
+
+	const std::string normalised = NormaliseAssetName(name);
+	AssetArchiveEntry entry = {};
+	entry.NameHash   = HashResourceName(std::string_view(normalised));
+	entry.Offset     = m_Size;
+	entry.Size       = size;
+	entry.NameOffset = static_cast<uint32_t>(m_Names.size());
+	entry.NameLength = static_cast<uint32_t>(normalised.size());
+	m_Names += normalised;
+
+	//Compressed assets have to be decompressed into memory of their own, so it is only worth it if it saves enough
+	std::vector<unsigned char> compressed;
+	if (compress)  compressed = CompressLz4(data, size);
+	if (compress && compressed.size() <= size - size / 8)
+	{
+		entry.Compression = kAssetLz4;
+		entry.StoredSize  = compressed.size();
+		Append(compressed.data(), compressed.size());
+	}
+	else
+	{
+		entry.Compression = kAssetStored;
+		entry.StoredSize  = size;
+		Append(data, size);
+	}
+	Pad(kAssetAlignment);
+	m_Entries.push_back(entry);
+	return entry.Compression == kAssetLz4;
+}
+
+//Write the table of contents and put the archive in place
+void AssetArchiveWriter::Finish()
+{
+	if (m_Finished)  return;
+
+	auto name = [&](const AssetArchiveEntry& entry) { return std::string_view(m_Names).substr(entry.NameOffset, entry.NameLength); };
+	std::sort(m_Entries.begin(), m_Entries.end(), [&](const AssetArchiveEntry& a, const AssetArchiveEntry& b) { return EntryBefore(a, name(a), b, name(b)); });
+	for (size_t i = 1; i < m_Entries.size(); ++i)
+	{
+		if (name(m_Entries[i - 1]) == name(m_Entries[i]))  throw std::runtime_error("Asset " + std::string(name(m_Entries[i])) + " was added twice");
+	}
+
+	AssetArchiveHeader header = {};
+	std::memcpy(header.Magic, kAssetArchiveMagic, sizeof(header.Magic));
+	header.Version   = kAssetArchiveVersion;
+	header.NumAssets = static_cast<uint32_t>(m_Entries.size());
+	header.NamesSize = static_cast<uint32_t>(m_Names.size());
+
+	header.EntriesOffset = m_Size;
+	Append(m_Entries.data(), m_Entries.size() * sizeof(AssetArchiveEntry));
+	header.NamesOffset = m_Size;
+	Append(m_Names.data(), m_Names.size());
+	header.FileSize = m_Size;
+
+	m_File.seekp(0);
+	m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_File.close();
+	if (!m_File)  throw std::runtime_error("Can't write asset archive " + m_PartFileName);
+
+	if (!ReplaceWithPartFile(m_PartFileName, m_FileName))  throw std::runtime_error("Can't replace asset archive " + m_FileName);
+	m_Finished = true;
+}
+
+//Write bytes at the end of the archive
+void AssetArchiveWriter::Append(const void* data, size_t size)
+{
+	m_File.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	if (!m_File)  throw std::runtime_error("Can't write asset archive " + m_PartFileName);
+	m_Size += size;
+}
+
+//Write zeros up to a multiple of the given alignment
+void AssetArchiveWriter::Pad(uint64_t alignment)
+{
+	static const char kZeros[kAssetAlignment] = {};
+	const uint64_t padding = (alignment - m_Size % alignment) % alignment;
+	Append(kZeros, static_cast<size_t>(padding));
+}
+
+
+//--------------------------------------------------------------------------------------
+// Loading assets
+//--------------------------------------------------------------------------------------
+
+//True if the file is in the archive assets are loaded from or on disk
+bool AssetExists(const std::string& fileName)
+{
+	if (AssetArchive::Get().Contains(fileName))  return true;
+
+	//Only asks the file system, rather than opening the file
+	std::error_code error;
+	return std::filesystem::is_regular_file(fileName, error);
+}
+
+//Read a whole file from the archive assets are loaded from, otherwise from disk
+bool ReadAsset(const std::string& fileName, AssetData& data)
+{
+	if (AssetArchive::Get().Read(fileName, data))  return true;
+
+	std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())  return false;
+
+	const std::streamoff fileSize = file.tellg();
+	if (fileSize < 0)  return false;
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.SetOwned(static_cast<size_t>(fileSize))), fileSize);
+	return !file.fail();
+}
@@ -0,0 +1,214 @@
+//--------------------------------------------------------------------------------------
+// Asset archives - every asset file packed into one memory mapped file
+//--------------------------------------------------------------------------------------
+// Loading loose files means opening each one (often twice, once to see it is there), and
+// on a cold disk many small reads scattered about. An archive packs them into a single file
+// that is opened and mapped once. Its table of contents is sorted by the hash of each asset's
+// name, so finding an asset is a binary search in memory rather than a trip to the file system.
+// Each asset starts on a 4KB boundary, so one stored as it is can be used straight from the
+// mapping (e.g. a cooked mesh or shader byte code, which are read in place), and its pages are
+// only read from disk when it is used. Assets that shrink enough are LZ4 compressed instead,
+// and decompressed when read. Archives are built by the AssetPack tool with AssetArchiveWriter.
+//
+// Names are stored as the engine asks for the files, e.g. "../Media/Stone.jpg", but with
+// forward slashes and in lower case (NormaliseAssetName), as they are on a Windows file system.
+// Open the archive the engine loads from with AssetArchive::Get().Open at startup, before any
+// loading starts. ReadAsset and AssetExists then look in it first and fall back on loose files.
+
+#pragma once
+#include "epch.h"
+#include "Utility/MappedFile.h"
+#include <fstream>
+#include <string_view>
+
+//Bumped whenever the layout below changes, older archives can't be opened
+const uint32_t kAssetArchiveVersion = 1;
+
+//Start of an archive. Offsets are in bytes from the start of the file
+struct AssetArchiveHeader
+{
+	char     Magic[4];
+	uint32_t Version;
+	uint32_t NumAssets;
+	uint32_t NamesSize;
+	uint64_t EntriesOffset; //NumAssets AssetArchiveEntry, sorted by NameHash then name
+	uint64_t NamesOffset;   //Names of the assets, not null terminated
+	uint64_t FileSize;
+};
+
+const uint32_t kAssetStored = 0; //Compression of an asset
+const uint32_t kAssetLz4    = 1;
+
+//An asset in the table of contents
+struct AssetArchiveEntry
+{
+	uint64_t NameHash;    //HashResourceName of the normalised name
+	uint64_t Offset;      //Of the stored bytes, a multiple of kAssetAlignment
+	uint64_t StoredSize;  //Bytes in the archive
+	uint64_t Size;        //Bytes once decompressed
+	uint32_t NameOffset;  //Into the names
+	uint32_t NameLength;
+	uint32_t Compression; //kAssetStored or kAssetLz4
+	uint32_t Reserved;
+};
+
+//Assets start on a boundary of this many bytes, the page size
+const uint64_t kAssetAlignment = 4096;
+
+//An asset's name as it is stored in archives: forward slashes, ASCII letters in lower case, no "./" or repeated slashes
+std::string NormaliseAssetName(std::string_view name);
+
+
+//The bytes of an asset, either where they are in a mapped archive or a copy of its own (a decompressed or loose file)
+class AssetData
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	AssetData() {}
+
+	AssetData(const AssetData&) = delete;
+	AssetData& operator=(const AssetData&) = delete;
+	AssetData(AssetData&&) = default;
+	AssetData& operator=(AssetData&&) = default;
+
+	//Point at bytes that stay valid elsewhere, e.g. a mapped archive
+	void SetMapped(const unsigned char* data, size_t size);
+
+	//Make room for the given number of bytes of its own, returns where to put them
+	unsigned char* SetOwned(size_t size);
+
+	//Touch every page of mapped bytes so they are read from disk now, e.g. on a loading thread
+	void Prefetch() const;
+
+	const unsigned char* Data() const { return m_Data; }
+	size_t Size() const { return m_Size; }
+
+	//True if the bytes are in a mapped archive rather than a copy
+	bool IsMapped() const { return m_Data != nullptr && m_Owned.empty(); }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	const unsigned char*       m_Data = nullptr;
+	size_t                     m_Size = 0;
+	std::vector<unsigned char> m_Owned;
+};
+
+
+class AssetArchive
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//The archive the engine loads assets from, closed (so only loose files are used) until it is opened
+	static AssetArchive& Get();
+
+	AssetArchive() {}
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	//Map the given archive, closing any archive already open. Returns false if the file isn't there
+	//Checks the table of contents, and throws a std::runtime_error if it is corrupt or from another version
+	bool Open(const std::string& fileName);
+
+	void Close();
+	bool IsOpen() const { return m_File.IsOpen(); }
+
+	//The entry of an asset, null if it isn't in the archive (or the archive isn't open)
+	const AssetArchiveEntry* Find(std::string_view name) const;
+	bool Contains(std::string_view name) const { return Find(name) != nullptr; }
+
+	//Read an asset, in place if it is stored as it is. Returns false if it isn't in the archive. Throws a
+	//std::runtime_error if it doesn't decompress. Safe on any thread once the archive is open
+	bool Read(std::string_view name, AssetData& data) const;
+	void Read(const AssetArchiveEntry& entry, AssetData& data) const;
+
+	//Every asset, sorted by the hash of its name, and the name of one
+	unsigned int NumberAssets() const { return m_Header ? m_Header->NumAssets : 0; }
+	const AssetArchiveEntry& Entry(unsigned int asset) const { return m_Entries[asset]; }
+	std::string_view Name(const AssetArchiveEntry& entry) const { return { m_Names + entry.NameOffset, entry.NameLength }; }
+
+	//Size of the whole archive
+	size_t Size() const { return m_File.Size(); }
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Check the header and table of contents are inside the file and in order, throws if not
+	void Validate(const std::string& fileName);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	MappedFile                 m_File;
+	const AssetArchiveHeader*  m_Header  = nullptr;
+	const AssetArchiveEntry*   m_Entries = nullptr;
+	const char*                m_Names   = nullptr;
+};
+
+
+//Writes an archive, one asset at a time so only the table of contents is kept in memory. The archive is written under
+//another name and renamed by Finish, so a reader never sees half of it
+class AssetArchiveWriter
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor, starts writing the given archive. Throws a std::runtime_error if it can't be created
+	explicit AssetArchiveWriter(const std::string& fileName);
+
+	//Destructor, deletes the part written if Finish wasn't called
+	~AssetArchiveWriter();
+
+	AssetArchiveWriter(const AssetArchiveWriter&) = delete;
+	AssetArchiveWriter& operator=(const AssetArchiveWriter&) = delete;
+
+	//Add an asset under the given name (normalised). It is LZ4 compressed if allowed and that saves at least an eighth
+	//of it, otherwise stored as it is. Returns true if it was compressed. Throws a std::runtime_error if it can't be written
+	bool Add(std::string_view name, const void* data, size_t size, bool compress = true);
+
+	//Write the table of contents and put the archive in place. Throws a std::runtime_error if it can't, or if two assets
+	//have the same name
+	void Finish();
+
+	//Bytes written so far
+	uint64_t Size() const { return m_Size; }
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Write bytes at the end of the archive
+	void Append(const void* data, size_t size);
+
+	//Write zeros up to a multiple of the given alignment
+	void Pad(uint64_t alignment);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::string                    m_FileName;
+	std::string                    m_PartFileName;
+	std::ofstream                  m_File;
+	uint64_t                       m_Size = 0;
+	std::vector<AssetArchiveEntry> m_Entries;
+	std::string                    m_Names;
+	bool                           m_Finished = false;
+};
+
+
+//True if the file is in the archive assets are loaded from (AssetArchive::Get) or on disk
+bool AssetExists(const std::string& fileName);
+
+//Read a whole file from the archive assets are loaded from, in place where possible, otherwise from disk. Returns false
+//if it is in neither. Safe on any thread once the archive is open
+bool ReadAsset(const std::string& fileName, AssetData& data);
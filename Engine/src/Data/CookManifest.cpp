@@ -0,0 +1,175 @@
+#include "epch.h"
+#include "CookManifest.h"
+#include "CookedMesh.h"
+#include "Utility/MappedFile.h"
+#include "Utility/ResourceId.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <charconv>
+
+namespace
+{
+	//First line of a manifest. Bumped whenever the layout below changes, older manifests are ignored
+	const char kCookManifestHeader[] = "AssetCook manifest 1";
+
+	//The manifest is text, a line for each cooked file followed by a line for each of its inputs, fields separated by
+	//tabs and names last, so they can hold spaces:
+	//  asset <tab> settings <tab> cooked file
+	//  input <tab> size <tab> time <tab> hash in hex <tab> file
+	const char kAssetLine[] = "asset";
+	const char kInputLine[] = "input";
+
+	//Size and write time of a file. Returns false if it isn't there
+	bool ReadFileStamp(const std::string& fileName, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		const auto fileSize = std::filesystem::file_size(fileName, error);
+		if (error)  return false;
+		const auto fileTime = std::filesystem::last_write_time(fileName, error);
+		if (error)  return false;
+
+		size = static_cast<uint64_t>(fileSize);
+		time = static_cast<int64_t>(fileTime.time_since_epoch().count());
+		return true;
+	}
+
+	//Read a whole field as a number. Returns false if it isn't one
+	template <class Number>
+	bool ParseNumber(const std::string& field, int base, Number& number)
+	{
+		const auto result = std::from_chars(field.data(), field.data() + field.size(), number, base);
+		return result.ec == std::errc() && result.ptr == field.data() + field.size() && !field.empty();
+	}
+
+	//Split a line into the given number of tab separated fields, the last taking the rest of the line
+	bool SplitFields(const std::string& line, size_t numFields, std::vector<std::string>& fields)
+	{
+		fields.clear();
+		size_t start = 0;
+		while (fields.size() + 1 < numFields)
+		{
+			const size_t tab = line.find('\t', start);
+			if (tab == std::string::npos)  return false;
+			fields.push_back(line.substr(start, tab - start));
+			start = tab + 1;
+		}
+		fields.push_back(line.substr(start));
+		return true;
+	}
+}
+
+//64-bit hash of a file's contents
+uint64_t HashFileContents(const unsigned char* data, size_t size)
+{
+	return HashResourceName(std::string_view(reinterpret_cast<const char*>(data), size));
+}
+
+//Read the size, write time and contents hash of a file
+bool ReadCookInput(const std::string& fileName, CookInput& input)
+{
+	MappedFile file;
+	if (!file.Open(fileName) || !ReadFileStamp(fileName, input.Size, input.Time))  return false;
+
+	input.FileName = fileName;
+	input.Hash = HashFileContents(file.Data(), file.Size());
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// CookManifest
+//--------------------------------------------------------------------------------------
+
+//Load a manifest
+bool CookManifest::Load(const std::string& fileName)
+{
+	m_Records.clear();
+	std::ifstream file(fileName);
+	std::string line;
+	if (!std::getline(file, line) || line != kCookManifestHeader)  return false;
+
+	std::vector<std::string> fields;
+	CookRecord* record = nullptr;
+	while (std::getline(file, line))
+	{
+		if (line.empty())  continue;
+
+		if (SplitFields(line, 3, fields) && fields[0] == kAssetLine)
+		{
+			record = &m_Records[fields[2]];
+			record->Settings = fields[1];
+			continue;
+		}
+
+		CookInput input;
+		if (record && SplitFields(line, 5, fields) && fields[0] == kInputLine)
+		{
+			if (ParseNumber(fields[1], 10, input.Size) && ParseNumber(fields[2], 10, input.Time) && ParseNumber(fields[3], 16, input.Hash) &&
+			    !fields[4].empty())
+			{
+				input.FileName = fields[4];
+				record->Inputs.push_back(std::move(input));
+				continue;
+			}
+		}
+
+		//Anything else means the manifest is damaged, so trust none of it
+		m_Records.clear();
+		return false;
+	}
+	return true;
+}
+
+//Save the manifest
+void CookManifest::Save(const std::string& fileName) const
+{
+	std::ostringstream text;
+	text << kCookManifestHeader << '\n';
+	for (const auto& [output, record] : m_Records)
+	{
+		text << kAssetLine << '\t' << record.Settings << '\t' << output << '\n';
+		for (const auto& input : record.Inputs)
+		{
+			text << kInputLine << '\t' << input.Size << '\t' << input.Time << '\t' << std::hex << input.Hash << std::dec << '\t' << input.FileName << '\n';
+		}
+	}
+
+	const std::string contents = text.str();
+	if (!SaveCookedFile(fileName, contents.data(), contents.size()))  throw std::runtime_error("Can't write cook manifest " + fileName);
+}
+
+//The record of a cooked file
+CookRecord* CookManifest::Find(const std::string& output)
+{
+	auto record = m_Records.find(output);
+	return record != m_Records.end() ? &record->second : nullptr;
+}
+
+void CookManifest::Set(const std::string& output, CookRecord record)
+{
+	m_Records[output] = std::move(record);
+}
+
+//True if the cooked file is there and was cooked the same way from the same files
+bool CookManifest::IsCurrent(const std::string& output, CookRecord& record, const std::string& settings)
+{
+	if (record.Settings != settings || record.Inputs.empty())  return false;
+
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(output, error))  return false;
+
+	for (auto& input : record.Inputs)
+	{
+		uint64_t size;
+		int64_t time;
+		if (!ReadFileStamp(input.FileName, size, time))  return false;
+		if (size == input.Size && time == input.Time)  continue;
+
+		//Changed on disk, but maybe only saved again or checked out afresh. Only the contents matter
+		CookInput current;
+		if (size != input.Size || !ReadCookInput(input.FileName, current) || current.Hash != input.Hash)  return false;
+		input.Time = current.Time;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Cook manifest - what each cooked asset was made from, so only changed assets are cooked
+//--------------------------------------------------------------------------------------
+// The AssetCook tool records, for each file it writes, the settings it was cooked with and
+// every file that went into it (the source, and e.g. the files a shader includes) with their
+// size, write time and a hash of their contents. An asset is only cooked again when its
+// settings or the contents of one of its files change, or the cooked file has gone. Files are
+// only hashed when their size or time has changed, so checking a whole tree that hasn't
+// changed costs a look at each file's size and time, and a file that was just saved again
+// without changes (or checked out afresh) isn't cooked again.
+
+#pragma once
+#include "epch.h"
+#include <map>
+
+//A file an asset was cooked from, and what it held then
+struct CookInput
+{
+	std::string FileName;
+	uint64_t    Size = 0;
+	int64_t     Time = 0;
+	uint64_t    Hash = 0; //HashFileContents
+};
+
+//How an asset was last cooked
+struct CookRecord
+{
+	std::string            Settings; //Everything other than its files that changes the cooked asset, e.g. format versions
+	std::vector<CookInput> Inputs;   //The source first, then any files it uses
+};
+
+//64-bit hash of a file's contents, FNV-1a as for resource names
+uint64_t HashFileContents(const unsigned char* data, size_t size);
+
+//Read the size, write time and contents hash of a file. Returns false if it can't be read
+bool ReadCookInput(const std::string& fileName, CookInput& input);
+
+
+class CookManifest
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Load a manifest, replacing the records held. Returns false, with no records, if there isn't one or it can't be used
+	//(e.g. from another version), and then everything is cooked again
+	bool Load(const std::string& fileName);
+
+	//Save the manifest. It is written under another name then renamed, so an interrupted save leaves the last one
+	//Throws a std::runtime_error if it can't be written
+	void Save(const std::string& fileName) const;
+
+	//The record of a cooked file, null if it has never been cooked. Records stay where they are as others are added
+	CookRecord* Find(const std::string& output);
+	void Set(const std::string& output, CookRecord record);
+	void Remove(const std::string& output) { m_Records.erase(output); }
+
+	size_t Size() const { return m_Records.size(); }
+
+	//True if the cooked file is there and its record has the given settings and files that haven't changed. Files whose
+	//size or time has changed are hashed, and if their contents haven't changed the record takes their new size and
+	//time so they aren't hashed next time. Safe to call for different records on different threads
+	static bool IsCurrent(const std::string& output, CookRecord& record, const std::string& settings);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	//Sorted by cooked file, so a manifest saves the same way each time
+	std::map<std::string, CookRecord> m_Records;
+};
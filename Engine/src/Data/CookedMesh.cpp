@@ -0,0 +1,241 @@
+#include "epch.h"
+#include "CookedMesh.h"
+#include "Utility/BinaryStream.h"
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	const char kCookedMeshMagic[4] = { 'E', 'M', 'S', 'H' };
+
+	//Vertex and index blocks start on a 16 byte boundary, so SIMD code can read them in place
+	const size_t kBlockAlignment = 16;
+
+	//True if a vertex part of the given size at the given offset (-1 for none) fits in the vertex
+	bool PartFits(int32_t offset, uint32_t partSize, uint32_t vertexSize)
+	{
+		return offset == -1 || (offset >= 0 && static_cast<uint32_t>(offset) + partSize <= vertexSize);
+	}
+}
+
+
+//Lay out mesh data as a cooked mesh, stamped with the file it came from
+std::vector<unsigned char> CookMesh(const CookedMeshData& data, const CookedMeshSource& source)
+{
+	if (data.Nodes.size() != data.NodeNames.size() || data.SubMeshes.size() != data.Vertices.size() ||
+	    data.SubMeshes.size() != data.Indices.size())
+	{
+		throw std::runtime_error("Mesh data to cook has mismatched arrays");
+	}
+
+	BinaryWriter writer;
+	CookedMeshHeader header = {};
+	std::copy(kCookedMeshMagic, kCookedMeshMagic + 4, header.Magic);
+	header.Version          = kCookedMeshVersion;
+	header.Source           = source;
+	header.Flags            = data.Flags;
+	header.NumNodes         = static_cast<uint32_t>(data.Nodes.size());
+	header.NumSubMeshes     = static_cast<uint32_t>(data.SubMeshes.size());
+	header.NumNodeSubMeshes = static_cast<uint32_t>(data.NodeSubMeshes.size());
+	header.NumAnimations    = static_cast<uint32_t>(data.Animations.size());
+	writer.Write(header); //Offsets are patched in at the end
+
+	//The big blocks first, each one aligned
+	std::vector<CookedSubMesh> subMeshes = data.SubMeshes;
+	for (size_t m = 0; m < subMeshes.size(); ++m)
+	{
+		auto& subMesh = subMeshes[m];
+		if (data.Vertices[m].size() != static_cast<size_t>(subMesh.NumVertices) * subMesh.VertexSize ||
+		    data.Indices[m].size() != subMesh.NumIndices)
+		{
+			throw std::runtime_error("Mesh data to cook has blocks of the wrong size");
+		}
+		writer.Align(kBlockAlignment);
+		subMesh.VerticesOffset = writer.WriteArray(data.Vertices[m].data(), data.Vertices[m].size());
+		writer.Align(kBlockAlignment);
+		subMesh.IndicesOffset = writer.WriteArray(data.Indices[m].data(), data.Indices[m].size());
+	}
+
+	//Names one after another, each null terminated
+	std::vector<CookedNode> nodes = data.Nodes;
+	std::string names;
+	for (size_t n = 0; n < nodes.size(); ++n)
+	{
+		nodes[n].NameOffset = static_cast<uint32_t>(names.size());
+		nodes[n].NameLength = static_cast<uint32_t>(data.NodeNames[n].size());
+		names += data.NodeNames[n];
+		names += '\0';
+	}
+	header.NamesSize = static_cast<uint32_t>(names.size());
+
+	header.NodesOffset         = writer.WriteArray(nodes.data(), nodes.size());
+	header.NodeSubMeshesOffset = writer.WriteArray(data.NodeSubMeshes.data(), data.NodeSubMeshes.size());
+	header.SubMeshesOffset     = writer.WriteArray(subMeshes.data(), subMeshes.size());
+	header.NamesOffset         = writer.WriteArray(names.data(), names.size());
+	writer.Align(8);
+	header.AnimationsOffset = writer.Size();
+	for (const AnimationClip& animation : data.Animations)  animation.Write(writer);
+	header.FileSize = writer.Size();
+
+	writer.Patch(0, header);
+	return writer.Release();
+}
+
+//Name of the cooked file for a mesh file
+std::string CookedMeshFileName(const std::string& fileName, bool requireTangents)
+{
+	return fileName + (requireTangents ? ".tangents.cmesh" : ".cmesh");
+}
+
+//Size and write time of a mesh file, both 0 if it isn't there
+CookedMeshSource GetCookedMeshSource(const std::string& fileName)
+{
+	CookedMeshSource source;
+	std::error_code error;
+	auto size = std::filesystem::file_size(fileName, error);
+	if (error)  return source;
+	auto time = std::filesystem::last_write_time(fileName, error);
+	if (error)  return source;
+
+	source.Size = static_cast<uint64_t>(size);
+	source.Time = static_cast<int64_t>(time.time_since_epoch().count());
+	return source;
+}
+
+//A new name to write a cooked file under. Random for each process, counted within it
+std::string CookedPartFileName(const std::string& cookedFileName)
+{
+	static const unsigned int process = std::random_device()();
+	static std::atomic<unsigned int> count = 0;
+	return cookedFileName + "." + std::to_string(process) + "-" + std::to_string(++count) + ".part";
+}
+
+//Put a part file in place of the file it was written for
+bool ReplaceWithPartFile(const std::string& partFileName, const std::string& fileName)
+{
+	std::error_code error;
+	std::filesystem::rename(partFileName, fileName, error);
+	if (!error)  return true;
+	std::filesystem::remove(partFileName, error);
+	return false;
+}
+
+//Write a whole cooked file under another name then rename it
+bool SaveCookedFile(const std::string& cookedFileName, const void* data, size_t size)
+{
+	const std::string partFileName = CookedPartFileName(cookedFileName);
+	{
+		std::ofstream file(partFileName, std::ios::binary | std::ios::trunc);
+		if (!file)  return false;
+		if (!file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size)).flush())
+		{
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(partFileName, error);
+			return false;
+		}
+	}
+	return ReplaceWithPartFile(partFileName, cookedFileName);
+}
+
+//Write a cooked mesh to disk
+bool SaveCookedMesh(const std::string& cookedFileName, const std::vector<unsigned char>& cooked)
+{
+	return SaveCookedFile(cookedFileName, cooked.data(), cooked.size());
+}
+
+//Stamp a cooked mesh on disk with a new source, in place
+bool RestampCookedMesh(const std::string& cookedFileName, const CookedMeshSource& source)
+{
+	std::fstream file(cookedFileName, std::ios::binary | std::ios::in | std::ios::out);
+	CookedMeshHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))  return false;
+	if (!std::equal(kCookedMeshMagic, kCookedMeshMagic + 4, header.Magic) || header.Version != kCookedMeshVersion)  return false;
+
+	file.seekp(offsetof(CookedMeshHeader, Source));
+	return static_cast<bool>(file.write(reinterpret_cast<const char*>(&source), sizeof(source)).flush());
+}
+
+
+//--------------------------------------------------------------------------------------
+// CookedMesh
+//--------------------------------------------------------------------------------------
+
+//True if the memory holds a current cooked mesh for the given source
+bool CookedMesh::IsCurrent(const void* data, size_t size, const CookedMeshSource& source, bool requireTangents)
+{
+	if (data == nullptr || size < sizeof(CookedMeshHeader))  return false;
+
+	CookedMeshHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (!std::equal(kCookedMeshMagic, kCookedMeshMagic + 4, header.Magic) || header.Version != kCookedMeshVersion)  return false;
+	if (((header.Flags & kCookedMeshTangents) != 0) != requireTangents)  return false;
+
+	//A cooked mesh shipped without its source is always current
+	if (source.Size == 0 && source.Time == 0)  return true;
+	return header.Source.Size == source.Size && header.Source.Time == source.Time;
+}
+
+//Constructor from the memory holding a cooked mesh, checks everything in it refers to something inside it
+CookedMesh::CookedMesh(const void* data, size_t size, const std::string& name)
+	: m_Data(static_cast<const unsigned char*>(data)), m_Size(size), m_Name(name)
+{
+	BinaryReader reader(data, size, "cooked mesh " + name);
+	m_Header = reader.ArrayAt<CookedMeshHeader>(0, 1);
+	if (!std::equal(kCookedMeshMagic, kCookedMeshMagic + 4, m_Header->Magic))  throw std::runtime_error(name + " isn't a cooked mesh");
+	if (m_Header->Version != kCookedMeshVersion)  throw std::runtime_error(name + " was cooked by a different version");
+	if (m_Header->FileSize != size)  throw std::runtime_error("Cooked mesh " + name + " is the wrong size");
+
+	m_Nodes         = reader.ArrayAt<CookedNode>(m_Header->NodesOffset, m_Header->NumNodes);
+	m_NodeSubMeshes = reader.ArrayAt<uint32_t>(m_Header->NodeSubMeshesOffset, m_Header->NumNodeSubMeshes);
+	m_Names         = reader.ArrayAt<char>(m_Header->NamesOffset, m_Header->NamesSize);
+	m_SubMeshes     = reader.ArrayAt<CookedSubMesh>(m_Header->SubMeshesOffset, m_Header->NumSubMeshes);
+	if (m_Header->NumNodes == 0)  throw std::runtime_error("Cooked mesh " + name + " has no nodes");
+
+	for (unsigned int n = 0; n < m_Header->NumNodes; ++n)
+	{
+		const CookedNode& node = m_Nodes[n];
+		if (node.NameOffset > m_Header->NamesSize || node.NameLength > m_Header->NamesSize - node.NameOffset ||
+		    node.FirstSubMesh > m_Header->NumNodeSubMeshes || node.NumSubMeshes > m_Header->NumNodeSubMeshes - node.FirstSubMesh ||
+		    node.Parent >= m_Header->NumNodes)
+		{
+			throw std::runtime_error("Cooked mesh " + name + " has a node outside the file");
+		}
+	}
+	for (unsigned int i = 0; i < m_Header->NumNodeSubMeshes; ++i)
+	{
+		if (m_NodeSubMeshes[i] >= m_Header->NumSubMeshes)  throw std::runtime_error("Cooked mesh " + name + " has a node with a missing sub-mesh");
+	}
+
+	const uint32_t bonesSize = HasBones() ? 20 : 0;
+	for (unsigned int m = 0; m < m_Header->NumSubMeshes; ++m)
+	{
+		const CookedSubMesh& subMesh = m_SubMeshes[m];
+		reader.ArrayAt<unsigned char>(subMesh.VerticesOffset, static_cast<size_t>(subMesh.NumVertices) * subMesh.VertexSize);
+		reader.ArrayAt<uint32_t>(subMesh.IndicesOffset, subMesh.NumIndices);
+		if (subMesh.PositionOffset < 0 || !PartFits(subMesh.PositionOffset, 12, subMesh.VertexSize) ||
+		    !PartFits(subMesh.NormalOffset, 12, subMesh.VertexSize) || !PartFits(subMesh.TangentOffset, 12, subMesh.VertexSize) ||
+		    !PartFits(subMesh.UVOffset, 8, subMesh.VertexSize) || !PartFits(subMesh.BonesOffset, bonesSize, subMesh.VertexSize) ||
+		    (subMesh.BonesOffset >= 0) != HasBones())
+		{
+			throw std::runtime_error("Cooked mesh " + name + " has a vertex layout that doesn't fit its vertices");
+		}
+	}
+}
+
+//The animation clips, copied out of the cooked memory
+std::vector<AnimationClip> CookedMesh::ReadAnimations() const
+{
+	BinaryReader reader(m_Data, m_Size, "cooked mesh " + m_Name);
+	reader.Seek(m_Header->AnimationsOffset);
+	std::vector<AnimationClip> animations;
+	animations.reserve(m_Header->NumAnimations);
+	for (unsigned int a = 0; a < m_Header->NumAnimations; ++a)
+	{
+		animations.push_back(AnimationClip::Read(reader));
+		if (animations.back().NumberNodes() != NumberNodes())  throw std::runtime_error("Cooked mesh " + m_Name + " has an animation for other nodes");
+	}
+	return animations;
+}
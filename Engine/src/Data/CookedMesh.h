@@ -0,0 +1,176 @@
+//--------------------------------------------------------------------------------------
+// Cooked meshes - a mesh file laid out exactly as Mesh uses it, loaded without assimp
+//--------------------------------------------------------------------------------------
+// Importing through assimp runs some twenty post-processing steps every time a mesh loads. A
+// cooked mesh holds the result of the import as Mesh builds it: the interleaved vertex block and
+// 32-bit index block of each sub-mesh, where each part of its vertices is, the flattened node
+// tree and the compressed animation clips. Every block is aligned in the file, so a memory
+// mapped cooked file is used where it is, the vertex and index blocks go straight from the
+// mapping to the GPU. The cooked file sits next to the mesh file (CookedMeshFileName) and
+// remembers the size and write time of the file it was cooked from, so a cooked file older than
+// its source is ignored (and Mesh cooks it again). A cooked file can also be shipped on its own.
+
+#pragma once
+#include "epch.h"
+#include "Math/CMatrix4x4.h"
+#include "Math/AnimationClip.h"
+#include <string_view>
+
+//Bumped whenever the layout below or the way meshes are imported changes, so old cooked files are cooked again
+const uint32_t kCookedMeshVersion = 1;
+
+//Size and last write time of the mesh file a cooked mesh was made from. Both 0 if the file isn't there
+struct CookedMeshSource
+{
+	uint64_t Size = 0;
+	int64_t  Time = 0;
+};
+
+//Start of a cooked mesh. Offsets are in bytes from the start of the file
+struct CookedMeshHeader
+{
+	char     Magic[4];
+	uint32_t Version;
+	CookedMeshSource Source;
+
+	uint32_t Flags;             //kCookedMeshTangents, kCookedMeshBones
+	uint32_t NumNodes;
+	uint32_t NumSubMeshes;
+	uint32_t NumNodeSubMeshes;
+	uint32_t NumAnimations;
+	uint32_t NamesSize;
+
+	uint64_t NodesOffset;       //NumNodes CookedNode
+	uint64_t NodeSubMeshesOffset; //NumNodeSubMeshes uint32_t, the sub-meshes of each node one node after another
+	uint64_t NamesOffset;       //Node names, each null terminated
+	uint64_t SubMeshesOffset;   //NumSubMeshes CookedSubMesh
+	uint64_t AnimationsOffset;  //NumAnimations clips written by AnimationClip::Write
+	uint64_t FileSize;
+};
+
+const uint32_t kCookedMeshTangents = 1; //Vertices have tangents (Mesh's requireTangents)
+const uint32_t kCookedMeshBones    = 2; //Vertices have bones and weights, and the mesh is skinned
+
+//A node of the mesh, in depth-first order
+struct CookedNode
+{
+	uint32_t   NameOffset;      //Into the names
+	uint32_t   NameLength;
+	uint32_t   Parent;          //Root is its own parent
+	uint32_t   FirstSubMesh;    //NumSubMeshes entries of the node sub-meshes from here
+	uint32_t   NumSubMeshes;
+	uint32_t   Padding[3];
+	CMatrix4x4 DefaultMatrix;   //Relative to the parent
+	CMatrix4x4 OffsetMatrix;    //Bind pose to bone, identity for nodes that aren't bones
+};
+
+//A sub-mesh with one material: a vertex block and an index block, 16-byte aligned in the file
+struct CookedSubMesh
+{
+	uint32_t VertexSize;
+	uint32_t NumVertices;
+	uint32_t NumIndices;        //32-bit, three per triangle
+
+	//Where each part of a vertex is, in bytes from its start. Parts the vertices don't have are -1
+	int32_t  PositionOffset;
+	int32_t  NormalOffset;
+	int32_t  TangentOffset;
+	int32_t  UVOffset;
+	int32_t  BonesOffset;       //4 bone indices (bytes) then 4 float weights
+
+	CVector3 BoundsMin;         //Box around the positions
+	CVector3 BoundsMax;
+
+	uint64_t VerticesOffset;
+	uint64_t IndicesOffset;
+};
+
+
+//Everything that goes in a cooked mesh, as the importer builds it
+struct CookedMeshData
+{
+	uint32_t                                Flags = 0;
+	std::vector<std::string>                NodeNames;
+	std::vector<CookedNode>                 Nodes;         //Name fields are filled in when the mesh is cooked
+	std::vector<uint32_t>                   NodeSubMeshes;
+	std::vector<CookedSubMesh>              SubMeshes;     //Block offsets are filled in when the mesh is cooked
+	std::vector<std::vector<unsigned char>> Vertices;      //Block of each sub-mesh
+	std::vector<std::vector<uint32_t>>      Indices;
+	std::vector<AnimationClip>              Animations;
+};
+
+//Lay out mesh data as a cooked mesh, stamped with the file it came from
+std::vector<unsigned char> CookMesh(const CookedMeshData& data, const CookedMeshSource& source);
+
+//Name of the cooked file for a mesh file. Meshes with and without tangents are cooked separately
+std::string CookedMeshFileName(const std::string& fileName, bool requireTangents);
+
+//Size and write time of a mesh file, both 0 if it isn't there
+CookedMeshSource GetCookedMeshSource(const std::string& fileName);
+
+//A name to write a cooked file under before renaming it. Each call gives a new name, so threads and processes writing
+//the same cooked file at once don't write into each other's
+std::string CookedPartFileName(const std::string& cookedFileName);
+
+//Rename a part file over the file it was written for. Returns false, having removed the part file, if it can't be
+bool ReplaceWithPartFile(const std::string& partFileName, const std::string& fileName);
+
+//Write a whole cooked file (or any file written in one go) under a part name then rename it, so a reader never sees
+//half of it. Returns false, leaving no part file behind, if it can't be written (e.g. a read-only folder)
+bool SaveCookedFile(const std::string& cookedFileName, const void* data, size_t size);
+
+//Write a cooked mesh to disk with SaveCookedFile
+//Returns false if it can't be written, the mesh will just be imported again next time
+bool SaveCookedMesh(const std::string& cookedFileName, const std::vector<unsigned char>& cooked);
+
+//Stamp a cooked mesh on disk with the source it now has, for a source saved again or checked out afresh without
+//changes. Only the stamp is written, in place. Returns false if it isn't a cooked mesh of this version
+bool RestampCookedMesh(const std::string& cookedFileName, const CookedMeshSource& source);
+
+
+//A cooked mesh in memory, e.g. a MappedFile. Everything is read where it is, the memory must outlive the view
+class CookedMesh
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//True if the memory holds a cooked mesh of this version with the given tangents, cooked from the given source
+	//Only looks at the header. A source that isn't there (size and time 0) accepts any cooked mesh
+	static bool IsCurrent(const void* data, size_t size, const CookedMeshSource& source, bool requireTangents);
+
+	//Constructor from the memory holding a cooked mesh. Checks every offset and count stays inside the memory, and that
+	//the nodes and sub-meshes refer to each other correctly. Throws a std::runtime_error if they don't
+	CookedMesh(const void* data, size_t size, const std::string& name);
+
+	bool HasTangents() const { return (m_Header->Flags & kCookedMeshTangents) != 0; }
+	bool HasBones() const { return (m_Header->Flags & kCookedMeshBones) != 0; }
+
+	unsigned int NumberNodes() const { return m_Header->NumNodes; }
+	const CookedNode& Node(unsigned int node) const { return m_Nodes[node]; }
+	std::string_view NodeName(unsigned int node) const { return { m_Names + m_Nodes[node].NameOffset, m_Nodes[node].NameLength }; }
+
+	unsigned int NumberNodeSubMeshes() const { return m_Header->NumNodeSubMeshes; }
+	const uint32_t* NodeSubMeshes() const { return m_NodeSubMeshes; }
+
+	unsigned int NumberSubMeshes() const { return m_Header->NumSubMeshes; }
+	const CookedSubMesh& SubMesh(unsigned int subMesh) const { return m_SubMeshes[subMesh]; }
+	const unsigned char* Vertices(unsigned int subMesh) const { return m_Data + m_SubMeshes[subMesh].VerticesOffset; }
+	const uint32_t* Indices(unsigned int subMesh) const { return reinterpret_cast<const uint32_t*>(m_Data + m_SubMeshes[subMesh].IndicesOffset); }
+
+	//The animation clips. These are copied out, so they outlive the cooked memory
+	std::vector<AnimationClip> ReadAnimations() const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	const unsigned char*    m_Data;
+	size_t                  m_Size;
+	std::string             m_Name;
+	const CookedMeshHeader* m_Header;
+	const CookedNode*       m_Nodes;
+	const uint32_t*         m_NodeSubMeshes;
+	const char*             m_Names;
+	const CookedSubMesh*    m_SubMeshes;
+};
@@ -0,0 +1,142 @@
+#include "epch.h"
+#include "CookedTexture.h"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	//The stamp sits in the DDS header's reserved words, after the 4 byte "DDS " magic and 7 words of the header
+	const size_t kDdsHeaderSize = 128;
+	const size_t kStampOffset   = 4 + 7 * sizeof(uint32_t);
+	const char   kStampMagic[4] = { 'E', 'T', 'E', 'X' };
+
+	struct CookedTextureStamp
+	{
+		char             Magic[4];
+		uint32_t         Version;
+		CookedMeshSource Source;
+	};
+	static_assert(kStampOffset + sizeof(CookedTextureStamp) <= kStampOffset + 11 * sizeof(uint32_t), "The stamp must fit in the 11 reserved words");
+}
+
+//Name of the cooked file for a texture file
+std::string CookedTextureFileName(const std::string& fileName)
+{
+	return fileName + ".dds";
+}
+
+//True if the memory holds a current cooked texture for the given source
+bool IsCurrentCookedTexture(const void* data, size_t size, const CookedMeshSource& source)
+{
+	if (data == nullptr || size < kDdsHeaderSize || std::memcmp(data, "DDS ", 4) != 0)  return false;
+
+	CookedTextureStamp stamp;
+	std::memcpy(&stamp, static_cast<const unsigned char*>(data) + kStampOffset, sizeof(stamp));
+	if (!std::equal(kStampMagic, kStampMagic + 4, stamp.Magic) || stamp.Version != kCookedTextureVersion)  return false;
+
+	//A cooked texture shipped without its texture file is always current
+	if (source.Size == 0 && source.Time == 0)  return true;
+	return stamp.Source.Size == source.Size && stamp.Source.Time == source.Time;
+}
+
+//Read the cooked file of a texture file if it is current
+bool ReadCurrentCookedTexture(const std::string& fileName, AssetData& cooked)
+{
+	if (ReadAsset(CookedTextureFileName(fileName), cooked) && IsCurrentCookedTexture(cooked.Data(), cooked.Size(), GetCookedMeshSource(fileName)))
+	{
+		return true;
+	}
+	cooked = AssetData();
+	return false;
+}
+
+//Decode a texture file's bytes and make its mip-maps
+bool DecodeTexture(const std::string& fileName, const void* data, size_t size, DirectX::ScratchImage& image)
+{
+	//WIC needs COM on the calling thread. Worker threads haven't started it, the main thread already has
+	HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	HRESULT result;
+	std::string dds = ".dds"; //check the filename extension (case insensitive)
+	if (fileName.size() >= 4 &&
+		std::equal(dds.rbegin(), dds.rend(), fileName.rbegin(), [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); }))
+	{
+		result = DirectX::LoadFromDDSMemory(data, size, DirectX::DDS_FLAGS_NONE, nullptr, image);
+	}
+	else
+	{
+		result = DirectX::LoadFromWICMemory(data, size, DirectX::WIC_FLAGS_NONE, nullptr, image);
+	}
+
+	//Formats the loaders above don't support, e.g. TGA
+	if (FAILED(result))
+	{
+		result = DirectX::LoadFromTGAMemory(data, size, DirectX::TGA_FLAGS_NONE, nullptr, image);
+	}
+
+	//Images without mip-maps get a full chain, made here rather than on the GPU so it happens on the loading thread
+	const DirectX::TexMetadata& metadata = image.GetMetadata();
+	if (SUCCEEDED(result) && metadata.mipLevels == 1 && !DirectX::IsCompressed(metadata.format))
+	{
+		DirectX::ScratchImage mipChain;
+		if (SUCCEEDED(DirectX::GenerateMipMaps(image.GetImages(), image.GetImageCount(), metadata, DirectX::TEX_FILTER_DEFAULT, 0, mipChain)))
+		{
+			image = std::move(mipChain);
+		}
+	}
+
+	if (SUCCEEDED(com))  CoUninitialize();
+	return SUCCEEDED(result);
+}
+
+//Decode a texture file and save it as its cooked file
+void CookTexture(const std::string& fileName, bool blockCompress)
+{
+	//Stamped with the texture file as it was before reading it, so if it changes while cooking it is cooked again
+	const CookedMeshSource source = GetCookedMeshSource(fileName);
+	AssetData file;
+	DirectX::ScratchImage image;
+	if (!ReadAsset(fileName, file))  throw std::runtime_error("Can't read texture " + fileName);
+	if (!DecodeTexture(fileName, file.Data(), file.Size(), image))  throw std::runtime_error("Can't decode texture " + fileName);
+
+	if (blockCompress && !DirectX::IsCompressed(image.GetMetadata().format))
+	{
+		DXGI_FORMAT format = image.IsAlphaAllOpaque() ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC3_UNORM;
+		if (DirectX::IsSRGB(image.GetMetadata().format))  format = DirectX::MakeSRGB(format);
+
+		DirectX::ScratchImage compressed;
+		if (FAILED(DirectX::Compress(image.GetImages(), image.GetImageCount(), image.GetMetadata(), format, DirectX::TEX_COMPRESS_DEFAULT,
+		                             DirectX::TEX_THRESHOLD_DEFAULT, compressed)))
+		{
+			throw std::runtime_error("Can't compress texture " + fileName);
+		}
+		image = std::move(compressed);
+	}
+
+	const std::string cookedFileName = CookedTextureFileName(fileName);
+	DirectX::Blob dds;
+	if (FAILED(DirectX::SaveToDDSMemory(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DirectX::DDS_FLAGS_NONE, dds)) ||
+	    dds.GetBufferSize() < kDdsHeaderSize)
+	{
+		throw std::runtime_error("Can't write cooked texture " + cookedFileName);
+	}
+	CookedTextureStamp stamp;
+	std::memcpy(stamp.Magic, kStampMagic, sizeof(stamp.Magic));
+	stamp.Version = kCookedTextureVersion;
+	stamp.Source = source;
+	std::memcpy(static_cast<unsigned char*>(dds.GetBufferPointer()) + kStampOffset, &stamp, sizeof(stamp));
+
+	if (!SaveCookedFile(cookedFileName, dds.GetBufferPointer(), dds.GetBufferSize()))  throw std::runtime_error("Can't write cooked texture " + cookedFileName);
+}
+
+//Stamp a cooked texture on disk with a new source, in place
+bool RestampCookedTexture(const std::string& fileName, const CookedMeshSource& source)
+{
+	std::fstream file(CookedTextureFileName(fileName), std::ios::binary | std::ios::in | std::ios::out);
+	unsigned char header[kDdsHeaderSize];
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || !IsCurrentCookedTexture(header, sizeof(header), CookedMeshSource()))  return false;
+
+	file.seekp(kStampOffset + offsetof(CookedTextureStamp, Source));
+	return static_cast<bool>(file.write(reinterpret_cast<const char*>(&source), sizeof(source)).flush());
+}
@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Cooked textures - texture files decoded ahead of time into DDS files with their mip-maps
+//--------------------------------------------------------------------------------------
+// Loading a PNG or JPEG means decoding it through WIC and then making its mip-maps, every time
+// it loads. A cooked texture is the result saved as a DDS file (optionally block compressed,
+// which also quarters or halves its GPU memory), which loads with little more than a copy.
+// The cooked file sits next to the texture file (CookedTextureFileName) and CResourceManager
+// uses it in place of the texture file while it is current. Like a cooked mesh it is stamped
+// with the size and write time of its texture file (CookedMeshSource), kept in the reserved
+// part of the DDS header that loaders ignore. Textures are cooked by the AssetCook tool, or with
+// CookTexture.
+
+#pragma once
+#include "epch.h"
+#include "AssetArchive.h"
+#include "CookedMesh.h"
+#include <DirectXTex.h>
+
+//Bumped whenever the way textures are cooked changes, so they are cooked again
+const uint32_t kCookedTextureVersion = 2;
+
+//Name of the cooked file for a texture file
+std::string CookedTextureFileName(const std::string& fileName);
+
+//True if the memory holds a DDS file cooked by this version from the given source
+bool IsCurrentCookedTexture(const void* data, size_t size, const CookedMeshSource& source);
+
+//Read the cooked file of a texture file, from the asset archive (see AssetArchive.h) or disk, if it is current
+//Returns false if there isn't one or it is out of date
+bool ReadCurrentCookedTexture(const std::string& fileName, AssetData& cooked);
+
+//Decode a texture file's bytes, DDS, TGA or anything WIC reads (chosen by the file name then the contents), and make
+//a full chain of mip-maps if it has none. Safe on any thread. Returns false if it can't be decoded
+bool DecodeTexture(const std::string& fileName, const void* data, size_t size, DirectX::ScratchImage& image);
+
+//Decode a texture file as above and save it as its cooked file. Block compressed textures are BC1, or BC3 if they
+//have any alpha. Throws a std::runtime_error on failure
+void CookTexture(const std::string& fileName, bool blockCompress);
+
+//Stamp the cooked file of a texture file with the source it now has, for a texture file saved again or checked out
+//afresh without changes. Only the stamp is written, in place. Returns false if there isn't a cooked texture of this version
+bool RestampCookedTexture(const std::string& fileName, const CookedMeshSource& source);
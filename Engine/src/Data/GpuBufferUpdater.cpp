@@ -0,0 +1,21 @@
+#include "epch.h"
+#include "GpuBufferUpdater.h"
+#include "Common/Common.h"
+
+//Copy bytes [offset, offset + size) of source over the same bytes of the buffer
+void GpuBufferUpdater::Update(const void* source, size_t offset, size_t size)
+{
+	if (size == 0)  return;
+
+	// For buffers the box is a range of bytes, the other dimensions are a single slice
+	D3D11_BOX box;
+	box.left   = static_cast<UINT>(offset);
+	box.right  = static_cast<UINT>(offset + size);
+	box.top    = 0;
+	box.bottom = 1;
+	box.front  = 0;
+	box.back   = 1;
+
+	// The source pointer is for the start of the box, not the start of the buffer
+	gD3DContext->UpdateSubresource(m_Buffer, 0, &box, static_cast<const char*>(source) + offset, 0, 0);
+}
@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------
+// GPU buffer updater - sends changed ranges of CPU-side data to a Direct3D buffer
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include "epch.h"
+#include "Utility/BufferUpdater.h"
+
+class GpuBufferUpdater : public IBufferUpdater
+{
+public:
+	//Constructor, the buffer must have been created with D3D11_USAGE_DEFAULT. Doesn't take a reference to the buffer
+	explicit GpuBufferUpdater(ID3D11Buffer* buffer) : m_Buffer(buffer) {}
+
+	//Copy bytes [offset, offset + size) of source over the same bytes of the buffer
+	void Update(const void* source, size_t offset, size_t size) override;
+
+private:
+	ID3D11Buffer* m_Buffer;
+};
@@ -0,0 +1,80 @@
+#include "epch.h"
+#include "GridIndexCache.h"
+#include "Common/Common.h"
+#include "Math/GridVertices.h"
+
+//The cache shared by every grid mesh
+GridIndexCache& GridIndexCache::Get()
+{
+	static GridIndexCache cache;
+	return cache;
+}
+
+//The index buffer for a subDivX x subDivZ grid, created the first time a grid of that size is asked for
+std::shared_ptr<const GridIndexBuffer> GridIndexCache::Acquire(int subDivX, int subDivZ, bool allowSixteenBit /*= true*/)
+{
+	DXGI_FORMAT format = allowSixteenBit && GridFitsSixteenBitIndices(subDivX, subDivZ) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	Key key(subDivX, subDivZ, format);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	RemoveExpired();
+
+	auto& entry = m_Buffers[key];
+	std::shared_ptr<GridIndexBuffer> buffer = entry.lock();
+	if (buffer == nullptr)
+	{
+		buffer = CreateBuffer(subDivX, subDivZ, format);
+		entry = buffer;
+	}
+	return buffer;
+}
+
+//Number of index buffers currently alive
+size_t GridIndexCache::Size()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	RemoveExpired();
+	return m_Buffers.size();
+}
+
+//Build the indices on the CPU and create the GPU buffer from them
+std::shared_ptr<GridIndexBuffer> GridIndexCache::CreateBuffer(int subDivX, int subDivZ, DXGI_FORMAT format)
+{
+	auto buffer = std::make_shared<GridIndexBuffer>();
+	buffer->Format = format;
+	buffer->NumIndices = static_cast<unsigned int>(GridIndexCount(subDivX, subDivZ));
+
+	// Create the grid indexes (CPU-side first)
+	unsigned int indexSize = format == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	auto indexData = std::make_unique<char[]>(static_cast<size_t>(buffer->NumIndices) * indexSize);
+	if (format == DXGI_FORMAT_R16_UINT)  WriteGridIndices(reinterpret_cast<uint16_t*>(indexData.get()), subDivX, subDivZ);
+	else                                 WriteGridIndices(reinterpret_cast<uint32_t*>(indexData.get()), subDivX, subDivZ);
+
+	// The indices of a grid never change, so the buffer can be immutable
+	D3D11_BUFFER_DESC bufferDesc;
+	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.ByteWidth = buffer->NumIndices * indexSize;
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initData; // Initial data
+	initData.pSysMem = indexData.get();
+	initData.SysMemPitch = 0;
+	initData.SysMemSlicePitch = 0;
+	if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, &initData, &buffer->Buffer)))
+	{
+		throw std::runtime_error("Failure creating index buffer for grid mesh");
+	}
+	return buffer;
+}
+
+//Forget buffers that no mesh is using any more
+void GridIndexCache::RemoveExpired()
+{
+	for (auto entry = m_Buffers.begin(); entry != m_Buffers.end(); )
+	{
+		if (entry->second.expired())  entry = m_Buffers.erase(entry);
+		else                          ++entry;
+	}
+}
@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------
+// Grid index cache - index buffers shared by every grid mesh of the same size
+//--------------------------------------------------------------------------------------
+// The indices of a grid only depend on how many squares it has, so grid meshes of the
+// same size share a single GPU index buffer instead of each building their own. A buffer
+// lives for as long as any mesh holds on to it, regenerating terrain at the same size
+// never touches the indices. 16-bit indices are used whenever the grid is small enough.
+
+#pragma once
+#include "epch.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+//A GPU index buffer for a grid, released once the last mesh using it lets go
+struct GridIndexBuffer
+{
+	ID3D11Buffer* Buffer     = nullptr;
+	DXGI_FORMAT   Format     = DXGI_FORMAT_R32_UINT;
+	unsigned int  NumIndices = 0;
+
+	GridIndexBuffer() {}
+	~GridIndexBuffer() { if (Buffer)  Buffer->Release(); }
+
+	GridIndexBuffer(const GridIndexBuffer&) = delete;
+	GridIndexBuffer& operator=(const GridIndexBuffer&) = delete;
+};
+
+class GridIndexCache
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//The cache shared by every grid mesh
+	static GridIndexCache& Get();
+
+	//The index buffer for a subDivX x subDivZ grid, created the first time a grid of that size is asked for
+	//Uses 16-bit indices when every vertex can be reached with them, unless allowSixteenBit is false
+	//Will throw a std::runtime_error exception if the buffer can't be created
+	std::shared_ptr<const GridIndexBuffer> Acquire(int subDivX, int subDivZ, bool allowSixteenBit = true);
+
+	//Number of index buffers currently alive
+	size_t Size();
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Build the indices on the CPU and create the GPU buffer from them
+	static std::shared_ptr<GridIndexBuffer> CreateBuffer(int subDivX, int subDivZ, DXGI_FORMAT format);
+
+	//Forget buffers that no mesh is using any more
+	void RemoveExpired();
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	using Key = std::tuple<int, int, DXGI_FORMAT>;
+
+	//The cache doesn't keep buffers alive itself, the meshes using them do
+	std::map<Key, std::weak_ptr<GridIndexBuffer>> m_Buffers;
+	std::mutex m_Mutex;
+};
@@ -9,337 +9,56 @@
 #include "Mesh.h"
 #include "Shaders/Shader.h" // Needed for helper function CreateSignatureForVertexLayout
 #include "Utility/GraphicsHelpers.h" // Helper functions to unclutter the code here
+#include "GridIndexCache.h"            // Index buffers shared between grids of the same size
+#include "GpuBufferUpdater.h"          // Uploads the changed parts of grid vertices
+#include "CookedMesh.h"                // Mesh files laid out as the mesh uses them
+#include "MeshImporter.h"              // Reads mesh files through assimp, when there is no cooked mesh
 
 // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
 // Optionally request tangents to be calculated (for normal and parallax mapping - see later lab)
 // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
 Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
+    : Mesh(CookedMeshFile(fileName, requireTangents))
 {
+}
 
-    Assimp::Importer importer;
-    // Flags for processing the mesh. Assimp provides a huge amount of control - right click any of these
-    // and "Peek Definition" to see documention above each constant
-    unsigned int assimpFlags = aiProcess_MakeLeftHanded |
-                               aiProcess_GenSmoothNormals |
-                               aiProcess_FixInfacingNormals |
-                               aiProcess_GenUVCoords | 
-                               aiProcess_TransformUVCoords |
-                               aiProcess_FlipUVs |
-                               aiProcess_FlipWindingOrder |
-                               aiProcess_Triangulate |
-                               aiProcess_JoinIdenticalVertices |
-                               aiProcess_ImproveCacheLocality |
-                               aiProcess_SortByPType |
-                               aiProcess_FindInvalidData | 
-                               aiProcess_OptimizeMeshes |
-                               aiProcess_FindInstances |
-                               aiProcess_FindDegenerates |
-                               aiProcess_RemoveRedundantMaterials |
-                               aiProcess_Debone |
-                               aiProcess_SplitByBoneCount | 
-                               aiProcess_LimitBoneWeights |
-                               aiProcess_RemoveComponent;
-
-    // Flags to specify what mesh data to ignore
-    int removeComponents = aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_TEXTURES | aiComponent_COLORS | 
-                           aiComponent_ANIMATIONS | aiComponent_MATERIALS;
-
-    // Add / remove tangents as required by user
-    if (requireTangents)
-    {
-        assimpFlags |= aiProcess_CalcTangentSpace;
-    }
-    else
-    {
-        removeComponents |= aiComponent_TANGENTS_AND_BITANGENTS;
-    }
-
-    // Other miscellaneous settings
-    importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f); // Smoothing angle for normals
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);  // Remove points and lines (keep triangles only)
-    importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);                 // Remove degenerate triangles
-    importer.SetPropertyBool(AI_CONFIG_PP_DB_ALL_OR_NONE, true);            // Default to removing bones/weights from meshes that don't need skinning
-
-	// Set maximum bones that can affect one vertex, and also maximum bones affecting a single mesh
-    unsigned int maxBonesPerVertex = 4; // The shaders support 4 bones per verted (null bones are added if necessary)
-    unsigned int maxBonesPerMesh = 256; // Bone indexes are stored in a byte, so no more than 256 
-    importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, maxBonesPerVertex);
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBBC_MAX_BONES, maxBonesPerMesh);
-  
-    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeComponents);
-
-    // Import mesh with assimp given above requirements - log output
-    Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
-    const aiScene* scene = importer.ReadFile(fileName, assimpFlags);
-    Assimp::DefaultLogger::kill();
-    if (scene == nullptr)  throw std::runtime_error("Error loading mesh (" + fileName + "). " + importer.GetErrorString());
-    if (scene->mNumMeshes == 0)  throw std::runtime_error("No usable geometry in mesh: " + fileName);
-
-    //-----------------------------------
-
-    //*********************************************************************//
-    // Read node hierachy - each node has a matrix and contains sub-meshes //
-
-    // Uses recursive helper functions to build node hierarchy    
-    mNodes.resize(CountNodes(scene->mRootNode));
-    ReadNodes(scene->mRootNode, 0, 0);
-
-    //******************************************//
-    // Read geometry - multiple parts supported //
-
-	mHasBones = false;
-	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
-        if (scene->mMeshes[m]->HasBones())  mHasBones = true;
-
-    // A mesh is made of sub-meshes, each one can have a different material (texture)
-    // Import each sub-mesh in the file to seperate index / vertex buffer (could share buffers between sub-meshes but that would make things more complex)
-    mSubMeshes.resize(scene->mNumMeshes);
-    for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
-    {
-        aiMesh* assimpMesh = scene->mMeshes[m];
-        std::string subMeshName = assimpMesh->mName.C_Str();
-        auto& subMesh = mSubMeshes[m]; // Short name for the submesh we're currently preparing - makes code below more readable
-
-        //-----------------------------------
-
-        // Check for presence of position and normal data. Tangents and UVs are optional.
-        std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
-        unsigned int offset = 0;
-    
-        if (!assimpMesh->HasPositions())  throw std::runtime_error("No position data for sub-mesh " + subMeshName + " in " + fileName);
-        unsigned int positionOffset = offset;
-        vertexElements.push_back( { "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-        offset += 12;
-
-        if (!assimpMesh->HasNormals())  throw std::runtime_error("No normal data for sub-mesh " + subMeshName + " in " + fileName);
-        unsigned int normalOffset = offset;
-        vertexElements.push_back( { "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-        offset += 12;
-
-        unsigned int tangentOffset = offset;
-        if (requireTangents)
-        {
-            if (!assimpMesh->HasTangentsAndBitangents())  throw std::runtime_error("No tangent data for sub-mesh " + subMeshName + " in " + fileName);
-            vertexElements.push_back( { "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-            offset += 12;
-        }
-    
-        unsigned int uvOffset = offset;
-        if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
-        {
-            if (assimpMesh->mNumUVComponents[0] != 2)  throw std::runtime_error("Unsupported texture coordinates in " + subMeshName + " in " + fileName);
-            vertexElements.push_back( { "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, uvOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-            offset += 8;
-        }
-
-        unsigned int bonesOffset = offset;
-        if (mHasBones)
-        {
-            vertexElements.push_back( { "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, bonesOffset,     D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-            offset += 4;
-            vertexElements.push_back( { "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, bonesOffset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 } );
-            offset += 16;
-        }
-
-        subMesh.vertexSize = offset;
-
-        // Create a "vertex layout" to describe to DirectX what is data in each vertex of this mesh
-        auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
-        HRESULT hr = gD3DDevice->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
-                                                   shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
-                                                   &subMesh.vertexLayout);
-        if (shaderSignature)  shaderSignature->Release();
-        if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
-
-        //-----------------------------------
-
-        // Create CPU-side buffers to hold current mesh data - exact content is flexible so can't use a structure for a vertex - so just a block of bytes
-        // Note: for large arrays a unique_ptr is better than a vector because vectors default-initialise all the values which is a waste of time.
-        subMesh.numVertices = assimpMesh->mNumVertices;
-        subMesh.numIndices  = assimpMesh->mNumFaces * 3;
-        auto vertices = std::make_unique<unsigned char[]>(subMesh.numVertices * subMesh.vertexSize);
-        auto indices  = std::make_unique<unsigned char[]>(subMesh.numIndices * 4); // Using 32 bit indexes (4 bytes) for each indeex
-
-
-        //-----------------------------------
-
-        // Copy mesh data from assimp to our CPU-side vertex buffer
-
-        CVector3* assimpPosition = reinterpret_cast<CVector3*>(assimpMesh->mVertices);
-        unsigned char* position = vertices.get() + positionOffset;
-        unsigned char* positionEnd = position + subMesh.numVertices * subMesh.vertexSize;
-        while (position != positionEnd)
-        {
-            *(CVector3*)position = *assimpPosition;
-            position += subMesh.vertexSize;
-            ++assimpPosition;
-        }
-
-        CVector3* assimpNormal = reinterpret_cast<CVector3*>(assimpMesh->mNormals);
-        unsigned char* normal = vertices.get() + normalOffset;
-        unsigned char* normalEnd = normal + subMesh.numVertices * subMesh.vertexSize;
-        while (normal != normalEnd)
-        {
-            *(CVector3*)normal = *assimpNormal;
-            normal += subMesh.vertexSize;
-            ++assimpNormal;
-        }
-
-        if (requireTangents)
-        {
-            CVector3* assimpTangent = reinterpret_cast<CVector3*>(assimpMesh->mTangents);
-            unsigned char* tangent =  vertices.get() + tangentOffset;
-            unsigned char* tangentEnd = tangent + subMesh.numVertices * subMesh.vertexSize;
-            while (tangent != tangentEnd)
-            {
-                *(CVector3*)tangent = *assimpTangent;
-                tangent += subMesh.vertexSize;
-                ++assimpTangent;
-            }
-        }
-
-        if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
-        {
-            aiVector3D* assimpUV = assimpMesh->mTextureCoords[0];
-            unsigned char* uv = vertices.get() + uvOffset;
-            unsigned char* uvEnd = uv + subMesh.numVertices * subMesh.vertexSize;
-            while (uv != uvEnd)
-            {
-                *(CVector2*)uv = CVector2(assimpUV->x, assimpUV->y);
-                uv += subMesh.vertexSize;
-                ++assimpUV;
-            }
-        }
-
-		if (mHasBones)
-		{
-			if (assimpMesh->HasBones())
-			{
-				// Set all bones and weights to 0 to start with
-				unsigned char* bones = vertices.get() + bonesOffset;
-				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-				while (bones != bonesEnd)
-				{
-					memset(bones, 0, 20);
-					bones += subMesh.vertexSize;
-				}
-
-				for (auto& node : mNodes)
-				{
-					node.offsetMatrix = MatrixIdentity();
-				}
-
-				// Go through each assimp bone
-				bones = vertices.get() + bonesOffset;
-				for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
-				{
-					// Get offset matrix for the bone (transform from skinned mesh root to bone root
-					aiBone* assimpBone = assimpMesh->mBones[i];
-					std::string boneName = assimpBone->mName.C_Str();
-                    unsigned int nodeIndex;
-					for (nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-					{
-						if (mNodes[nodeIndex].name == boneName)
-						{
-							mNodes[nodeIndex].offsetMatrix.SetValues(&assimpBone->mOffsetMatrix.a1);
-							mNodes[nodeIndex].offsetMatrix.Transpose(); // Assimp stores matrices differently to this app
-							break;
-						}
-					}
-                    if (nodeIndex == mNodes.size())  throw std::runtime_error("Bone with no matching node in " + fileName);
-
-					// Go through each weight of the bone and update the vertex it influences
-					// Find the first 0 weight on that vertex and put the new influence / weight there.
-					// A vertex can only have up to 4 influences
-					for (unsigned int j = 0; j < assimpBone->mNumWeights; ++j)
-					{
-						unsigned int vertexIndex = assimpBone->mWeights[j].mVertexId;
-						unsigned char* bone = bones + vertexIndex * subMesh.vertexSize;
-						float* weight = (float*)(bone + 4);
-						float* lastWeight = weight + 3;
-						while (*weight != 0.0f && weight != lastWeight)
-						{
-							bone++; weight++;
-						}
-						if (*weight == 0.0f)
-						{
-							*bone = nodeIndex;
-							*weight = assimpBone->mWeights[j].mWeight;
-						}
-					}
-				}
-			}
-			else
-			{
-				// In a mesh that uses skinning any sub-meshes that don't contain bones are given bones so the whole mesh can use one shader
-				unsigned int subMeshNode = 0;
-				for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-				{
-					for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
-					{
-						if (subMeshIndex == m)
-							subMeshNode = nodeIndex;
-					}
-				}
-				
-				unsigned char* bones = vertices.get() + bonesOffset;
-				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-				while (bones != bonesEnd)
-				{
-					memset(bones, 0, 20);
-					bones[0] = subMeshNode;
-					*(float*)(bones + 4) = 1.0f;
-					bones += subMesh.vertexSize;
-				}
-
-			}
-		}
-        //-----------------------------------
-
-        // Copy face data from assimp to our CPU-side index buffer
-        if (!assimpMesh->HasFaces())  throw std::runtime_error("No face data in " + subMeshName + " in " + fileName);
-
-        DWORD* index = reinterpret_cast<DWORD*>(indices.get());
-        for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
-        {
-            *index++ = assimpMesh->mFaces[face].mIndices[0];
-            *index++ = assimpMesh->mFaces[face].mIndices[1];
-            *index++ = assimpMesh->mFaces[face].mIndices[2];
-        }      
-        GenerateBuffers(vertices.get(), indices.get());
-    }
+// Create the mesh from a cooked mesh file, e.g. one loaded on a worker thread. Creates the GPU buffers, so call on the main thread
+Mesh::Mesh(const CookedMeshFile& file)
+{
+    Load(file.Cooked(), file.FileName());
 }
 
-Mesh::Mesh(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& heightMap, bool normals /* = false */, bool uvs /* = true */)
+Mesh::Mesh(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap, bool normals /* = true */, bool uvs /* = true */,
+           const HeightFieldGradient* gradient /* = nullptr */, bool tangents /* = false */)
 {
     // Create a single node, disable skinning
-    mNodes.push_back({ "Grid", MatrixIdentity(), MatrixIdentity(), 0, {}, {0} });
+    mNodes.push_back({ mNodeNames.Add("Grid"), MatrixIdentity(), MatrixIdentity(), 0, 1 });
+    mNodeSubMeshes.push_back(0);
+    mHierarchy = TransformHierarchy({ 0 });
     mHasBones = false;
 
     mSubMeshes.resize(1); // Grid will be in a single sub-mesh  
-     
-    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
-    unsigned int offset = 0;
 
-    unsigned int positionOffset = offset;
-    vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-    offset += 12;
+    // Same element order as meshes loaded from file, so the grid can use the same shaders
+    mGridVertices = std::make_unique<GridVertexData>(GridVertexLayout::Make(normals, tangents, uvs));
+    const GridVertexLayout& gridLayout = mGridVertices->Layout();
 
-    unsigned int normalOffset = offset;
-    if (normals)
+    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+    vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(gridLayout.PositionOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 });
+    if (gridLayout.HasNormals())
     {
-        vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-        offset += 12;
+        vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(gridLayout.NormalOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 });
     }
-
-    unsigned int uvOffset = offset;
-    if (uvs)
+    if (gridLayout.HasTangents())
+    {
+        vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(gridLayout.TangentOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 });
+    }
+    if (gridLayout.HasUVs())
     {
-        vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, uvOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-        offset += 8;
+        vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, static_cast<UINT>(gridLayout.UVOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 });
     }
 
-    mSubMeshes[0].vertexSize = offset;
+    mSubMeshes[0].vertexSize = gridLayout.VertexSize;
 
     // Create a vertex layout object from above array - used by DirectX to understand the data in each vertex of this mesh
     auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
@@ -353,199 +72,104 @@ Mesh::Mesh(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector
 
     ////-----------------------------------
 
-    //// Allocate space to create the grid vertices (CPU-side first)
-    mSubMeshes[0].numVertices = (subDivX + 1) * (subDivZ + 1);
-    auto vertexData = std::make_unique<char[]>(mSubMeshes[0].numVertices * mSubMeshes[0].vertexSize); // Smart pointer
-
-    // Create the grid vertices (CPU-side), to be passed to the GPU afterwards
-    float xStep = (maxPt.x - minPt.x) / subDivX; // X-size of a single grid square
-    float zStep = (maxPt.z - minPt.z) / subDivZ; // Z-size of a single grid square
-    float uStep = 1.0f / subDivX;                // U-size of a single grid square (UVs go from 0 to 1 over the whole grid)
-    float vStep = 1.0f / subDivZ;                // V-size of a single grid square (UVs go from 0 to 1 over the whole grid)
-    CVector3 pt = minPt;                         // Start position at bottom-left of grid (looking down on it)
-    CVector3 normal = CVector3(0, 1, 0);           // All normals will be up (useful to make grid use same data as ordinary models so it can use the same shaders)         
-    CVector2 uv = CVector2(0, 1);                 // UVs also start at bottom-left (V axis is opposite direction to Z)
-    // A 2D array of data, only complexity is that some data is optional. So byte-offsets and pointer casting is needed 
-    
-    auto currVert = vertexData.get();
-
-    //Go through each z coordinate of the grid
-    for (int z = 0; z <= subDivZ; ++z)
-    {
-        //Go through each x Coordinate of the grid
-        for (int x = 0; x <= subDivX; ++x)
-        {
-            *reinterpret_cast<CVector3*>(currVert) = pt;
-            currVert += sizeof(CVector3);
-            if (normals)
-            {
-                *reinterpret_cast<CVector3*>(currVert) = normal;
-                currVert += sizeof(CVector3);
-            }
-            if (uvs)
-            {
-                *reinterpret_cast<CVector2*>(currVert) = uv;
-                currVert += sizeof(CVector2);
-            }
-            //Increase the pt and uv's X position
-            pt.x += xStep;
-            uv.x += uStep;
-
-            //set the Y value of the vertex point to the HeightMap value
-            pt.y = heightMap[z][x];
-        }
-        //Reset the Point and UV's X value
-        pt.x = minPt.x;
-        uv.x = 0;
-
-        //Set the current Points Y value to the HeightMap value at the Z coordinate
-        pt.y = heightMap[z][0];
-
-        //Increase the pt and uv's Z and T position
-        pt.z += zStep;
-        uv.y -= vStep; // V axis is opposite direction to Z
-    }
+    // Create the grid vertices (CPU-side), kept after they are passed to the GPU so they can be updated later
+    mGridVertices->Build(minPt, maxPt, subDivX, subDivZ, heightMap, gradient);
+    mSubMeshes[0].numVertices = mGridVertices->NumVertices();
+    mSubMeshes[0].bounds = mGridVertices->Bounds();
+    CalculateNodeBounds();
 
+    //Generate the Vertex Buffer, the Index Buffer is shared with every other grid of this size
+    CreateVertexBuffer(mSubMeshes[0], mGridVertices->Data());
+    SetGridIndices(subDivX, subDivZ);
+}
 
-    // Allocate space to create the grid indices. To keep model rendering code simpler using a triangle
-    // list, even though a strip would work nicely here
-    mSubMeshes[0].numIndices = subDivX * subDivZ * 6; // Two triangles for each grid square
-    auto indexData = std::make_unique<char[]>(mSubMeshes[0].numIndices * 4); // 4 byte integer for each index
+//Update the vertices of the Mesh
+void Mesh::UpdateVertices(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap,
+                          const HeightFieldGradient* gradient /* = nullptr */)
+{
+    if (mGridVertices == nullptr)  throw std::runtime_error("Only grid meshes can have their vertices updated");
 
-    // Create the grid indexes (CPU-side first)
-    uint32_t tlIndex = 0;
-    auto currIndex = reinterpret_cast<uint32_t*>(indexData.get()); // uint32_t = 4-byte indexes
+    mGridVertices->Build(minPt, maxPt, subDivX, subDivZ, heightMap, gradient);
 
-    //Go through each z coordinate of the grid
-    for (int z = 0; z < subDivZ; ++z)
+    // Same number of vertices, so the existing buffer can be overwritten rather than recreated
+    auto& subMesh = mSubMeshes[0];
+    if (mGridVertices->NumVertices() == subMesh.numVertices)
     {
-        //Go through each x coordinate of the grid
-        for (int x = 0; x < subDivX; ++x)
-        {
-            // Bottom-left triangle in grid square (looking down on the grid)
-            *currIndex++ = tlIndex;
-            *currIndex++ = tlIndex + subDivX + 1;
-            *currIndex++ = tlIndex + 1;
-
-            // Top-right triangle in grid square
-            *currIndex++ = tlIndex + 1;
-            *currIndex++ = tlIndex + subDivX + 1;
-            *currIndex++ = tlIndex + subDivX + 2;
-
-            Indix.push_back(tlIndex);
-            ++tlIndex;
-        }
-        ++tlIndex;
+        GpuBufferUpdater vertexBuffer(subMesh.vertexBuffer);
+        mGridVertices->UploadAll(vertexBuffer);
+    }
+    else
+    {
+        subMesh.vertexBuffer->Release();
+        subMesh.vertexBuffer = nullptr;
+
+        subMesh.numVertices = mGridVertices->NumVertices();
+        CreateVertexBuffer(subMesh, mGridVertices->Data());
     }
 
-    //Generate the Vertex and Index Buffers
-    GenerateBuffers(vertexData.get(), indexData.get());  
+    //The indices only change if the grid has changed size
+    SetGridIndices(subDivX, subDivZ);
+
+    subMesh.bounds = mGridVertices->Bounds();
+    CalculateNodeBounds();
 }
 
-//Update the vertices of the Mesh
-void Mesh::UpdateVertices(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& heightMap, bool normals /* = false */, bool uvs /* = true */)
+//Update only the vertices of the Mesh affected by heights in the dirty region
+void Mesh::UpdateVertices(const HeightField& heightMap, const GridRegion& dirty, const HeightFieldGradient* gradient /* = nullptr */)
 {
-    //-----------------------------------
-    // Allocate space to create the grid vertices (CPU-side first)
-    mSubMeshes[0].numVertices = (subDivX + 1) * (subDivZ + 1);
-    auto vertexData = std::make_unique<char[]>(mSubMeshes[0].numVertices * mSubMeshes[0].vertexSize); // Smart pointer
-
-    // Create the grid vertices (CPU-side), to be passed to the GPU afterwards
-    float xStep = (maxPt.x - minPt.x) / subDivX; // X-size of a single grid square
-    float zStep = (maxPt.z - minPt.z) / subDivZ; // Z-size of a single grid square
-    float uStep = 1.0f / subDivX;                // U-size of a single grid square (UVs go from 0 to 1 over the whole grid)
-    float vStep = 1.0f / subDivZ;                // V-size of a single grid square (UVs go from 0 to 1 over the whole grid)
-    CVector3 pt = minPt;                         // Start position at bottom-left of grid (looking down on it)
-    CVector3 normal = CVector3(0, 1, 0);           // All normals will be up (useful to make grid use same data as ordinary models so it can use the same shaders)         
-    CVector2 uv = CVector2(0, 1);                 // UVs also start at bottom-left (V axis is opposite direction to Z)
-    // A 2D array of data, only complexity is that some data is optional. So byte-offsets and pointer casting is needed
-
-    auto currVert = vertexData.get();
-
-    //Go through each z coordinate of the grid
-    for (int z = 0; z <= subDivZ; ++z)
-    {
-        //Go through each x coordinate of the grid
-        for (int x = 0; x <= subDivX; ++x)
-        {
-            *reinterpret_cast<CVector3*>(currVert) = pt;
-            currVert += sizeof(CVector3);
-            if (normals)
-            {
-                *reinterpret_cast<CVector3*>(currVert) = normal;
-                currVert += sizeof(CVector3);
-            }
-            if (uvs)
-            {
-                *reinterpret_cast<CVector2*>(currVert) = uv;
-                currVert += sizeof(CVector2);
-            }
-            //Increase the pt and uv's X position
-            pt.x += xStep;
-            uv.x += uStep;
-
-            //set the Y value of the vertex point to the HeightMap value
-            pt.y = heightMap[z][x];
-        }
-        //Reset the Point and UV's X value
-        pt.x = minPt.x;
-        uv.x = 0;
+    if (mGridVertices == nullptr)  throw std::runtime_error("Only grid meshes can have their vertices updated");
 
-        //Set the current Points Y value to the HeightMap value at the Z coordinate
-        pt.y = heightMap[z][0];
+    GpuBufferUpdater vertexBuffer(mSubMeshes[0].vertexBuffer);
+    mGridVertices->Update(heightMap, gradient, dirty, vertexBuffer);
 
-        //Increase the pt and uv's Z and T position
-        pt.z += zStep;
-        uv.y -= vStep; // V axis is opposite direction to Z
+    mSubMeshes[0].bounds = mGridVertices->Bounds();
+    CalculateNodeBounds();
+}
+
+// Skinning matrices for a skinned mesh: each node's offset matrix (from the bind pose to the bone) then its world matrix
+void Mesh::CalculateSkinningMatrices(const CMatrix4x4* worldMatrices, CMatrix4x4* skinningMatrices)
+{
+    for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+    {
+        skinningMatrices[nodeIndex] = mNodes[nodeIndex].offsetMatrix * worldMatrices[nodeIndex];
     }
+}
 
-    // Allocate space to create the grid indices. To keep model rendering code simpler using a triangle
-    // list, even though a strip would work nicely here
-    mSubMeshes[0].numIndices = subDivX * subDivZ * 6; // Two triangles for each grid square
-    auto indexData = std::make_unique<char[]>(mSubMeshes[0].numIndices * 4); // 4 byte integer for each index
+// Skin a sub-mesh of a skinned mesh on the CPU from its bind pose vertices
+void Mesh::SkinSubMesh(unsigned int subMesh, const CMatrix4x4* skinningMatrices, void* output, const SkinnedVertexLayout& outputLayout,
+                       ThreadPool* threadPool /*= nullptr*/)
+{
+    if (!mHasBones)  throw std::runtime_error("Only skinned meshes can be skinned on the CPU");
 
-    // Create the grid indexes (CPU-side first)
-    uint32_t tlIndex = 0;
-    auto currIndex = reinterpret_cast<uint32_t*>(indexData.get()); // uint32_t = 4-byte indexes
+    const auto& source = mSubMeshes[subMesh];
+    SkinVertices(source.bindPoseVertices.data(), source.skinningLayout, static_cast<int>(source.numVertices), skinningMatrices,
+                 output, outputLayout, threadPool);
+}
 
-    //Go through each z coordinate of the grid
-    for (int z = 0; z < subDivZ; ++z)
+// Memory the mesh uses on the CPU and on the GPU
+ResourceMemory Mesh::MemoryUsage() const
+{
+    ResourceMemory memory;
+    memory.CpuBytes = mNodes.size() * sizeof(Node) + mSubMeshes.size() * sizeof(SubMesh) + mNodeSubMeshes.size() * sizeof(unsigned int);
+    for (const auto& subMesh : mSubMeshes)
     {
-        //Go through each x coordinate of the grid
-        for (int x = 0; x < subDivX; ++x)
-        {
-            // Bottom-left triangle in grid square (looking down on the grid)
-            *currIndex++ = tlIndex;
-            *currIndex++ = tlIndex + subDivX + 1;
-            *currIndex++ = tlIndex + 1;
-
-            // Top-right triangle in grid square
-            *currIndex++ = tlIndex + 1;
-            *currIndex++ = tlIndex + subDivX + 1;
-            *currIndex++ = tlIndex + subDivX + 2;
+        memory.CpuBytes += subMesh.bindPoseVertices.size();
 
-            ++tlIndex;
-        }
-        ++tlIndex;
+        const size_t indexSize = subMesh.indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+        memory.GpuBytes += static_cast<size_t>(subMesh.numVertices) * subMesh.vertexSize + static_cast<size_t>(subMesh.numIndices) * indexSize;
     }
-
-    //Release the vertex buffer to ensure that the Mesh is regenerated properly 
-    mSubMeshes[0].vertexBuffer->Release();
-    mSubMeshes[0].vertexBuffer = 0;
-
-    //Generate the Vertex and Index Buffers
-    GenerateBuffers(vertexData.get(), indexData.get());
+    for (const auto& animation : mAnimations)  memory.CpuBytes += animation.KeyBytes();
+    if (mGridVertices)  memory.CpuBytes += mGridVertices->SizeInBytes();
+    return memory;
 }
 
-//Generate the Vertex and Index buffers with the new vertices of the mesh
-void Mesh::GenerateBuffers(const void* vertices, const void* indices)
+//Create the vertex buffer of a sub-mesh and fill it with the given vertex data
+void Mesh::CreateVertexBuffer(SubMesh& subMesh, const void* vertices)
 {
-
-    // Create the vertex buffer and fill it with the loaded vertex data
     D3D11_BUFFER_DESC bufferDesc;
     bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     bufferDesc.Usage = D3D11_USAGE_DEFAULT; ////Do not generate a Dynamic Buffer
-    bufferDesc.ByteWidth = mSubMeshes[0].numVertices * mSubMeshes[0].vertexSize; // Buffer size
+    bufferDesc.ByteWidth = subMesh.numVertices * subMesh.vertexSize; // Buffer size
     bufferDesc.CPUAccessFlags = 0;
     bufferDesc.MiscFlags = 0;
 
@@ -553,20 +177,60 @@ void Mesh::GenerateBuffers(const void* vertices, const void* indices)
     initData.pSysMem = vertices;
     initData.SysMemPitch = 0;
     initData.SysMemSlicePitch = 0;
-    if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, &initData, &mSubMeshes[0].vertexBuffer)))
+    if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.vertexBuffer)))
     {
-        throw std::runtime_error("Failure creating vertex buffer for grid mesh");
+        throw std::runtime_error("Failure creating vertex buffer for mesh");
     }
-    // Create the index buffer
+}
+
+//Create the index buffer of a sub-mesh and fill it with the given 32-bit indices
+void Mesh::CreateIndexBuffer(SubMesh& subMesh, const void* indices)
+{
+    D3D11_BUFFER_DESC bufferDesc;
     bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
     bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    bufferDesc.ByteWidth = mSubMeshes[0].numIndices * 4;
+    bufferDesc.ByteWidth = subMesh.numIndices * 4;
     bufferDesc.CPUAccessFlags = 0;
     bufferDesc.MiscFlags = 0;
+
+    D3D11_SUBRESOURCE_DATA initData; // Initial data
     initData.pSysMem = indices;
-    if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, &initData, &mSubMeshes[0].indexBuffer)))
+    initData.SysMemPitch = 0;
+    initData.SysMemSlicePitch = 0;
+    if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer)))
     {
-        throw std::runtime_error("Failure creating index buffer for grid mesh");
+        throw std::runtime_error("Failure creating index buffer for mesh");
+    }
+    subMesh.indexFormat = DXGI_FORMAT_R32_UINT;
+}
+
+//Point the grid sub-mesh at the shared index buffer for a grid of the given size
+void Mesh::SetGridIndices(int subDivX, int subDivZ)
+{
+    auto gridIndices = GridIndexCache::Get().Acquire(subDivX, subDivZ);
+    if (gridIndices == mGridIndices)  return;
+
+    // The sub-mesh keeps its own reference to the buffer so it is released in the destructor like any other
+    auto& subMesh = mSubMeshes[0];
+    gridIndices->Buffer->AddRef();
+    if (subMesh.indexBuffer)  subMesh.indexBuffer->Release();
+    subMesh.indexBuffer = gridIndices->Buffer;
+    subMesh.indexFormat = gridIndices->Format;
+    subMesh.numIndices  = gridIndices->NumIndices;
+
+    mGridIndices = std::move(gridIndices);
+}
+
+//Work out each node's bounds from the bounds of its sub-meshes
+void Mesh::CalculateNodeBounds()
+{
+    for (auto& node : mNodes)
+    {
+        node.bounds = BoundingBox();
+        for (unsigned int i = node.firstSubMesh; i < node.firstSubMesh + node.numSubMeshes; ++i)
+        {
+            node.bounds.Add(mSubMeshes[mNodeSubMeshes[i]].bounds);
+        }
     }
 }
 
@@ -594,8 +258,8 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
     // Indicate the layout of vertex buffer
     gD3DContext->IASetInputLayout(subMesh.vertexLayout);
 
-    // Set index buffer as next data source for GPU, indicate it uses 32-bit integers
-    gD3DContext->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+    // Set index buffer as next data source for GPU, indicate whether it uses 16 or 32-bit integers
+    gD3DContext->IASetIndexBuffer(subMesh.indexBuffer, subMesh.indexFormat, 0);
 
     // Using triangle lists only in this class
     gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -604,21 +268,14 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
     gD3DContext->DrawIndexed(subMesh.numIndices, 0, 0);
 }
 
-// Render the mesh with the given matrices
+// Render the mesh with the given world matrices for every node, from Hierarchy().UpdateWorldMatrices
 // Handles rigid body meshes (including single part meshes) as well as skinned meshes
 // LIMITATION: The mesh must use a single texture throughout
-//void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices, ID3D11Buffer* buffer, PerModelConstants& ModelConstants)
+//void Mesh::Render(CMatrix4x4* worldMatrices, ID3D11Buffer* buffer, PerModelConstants& ModelConstants)
 //{
-//	// Skinning needs all matrices available in the shader at the same time, so first calculate all the absolute
-//	// matrices before rendering anything
-//    std::vector<CMatrix4x4> absoluteMatrices(modelMatrices.size());
-//    absoluteMatrices[0] = modelMatrices[0]; // First matrix for a model is the root matrix, already in world space
-//    for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
-//    {
-//		// Multiply each model matrix by its parent's absolute world matrix (already calculated earlier in this loop)
-//		// Same process as for rigid bodies, simply done prior to rendering now
-//        absoluteMatrices[nodeIndex] = modelMatrices[nodeIndex] * absoluteMatrices[mNodes[nodeIndex].parentIndex];
-//    }
+//	// Skinning needs all matrices available in the shader at the same time, so the absolute matrices of every node are
+//	// calculated before rendering anything. That is done for every model using this mesh at once, see TransformHierarchy
+//    CMatrix4x4* absoluteMatrices = worldMatrices;
 //
 //	if (mHasBones) // Render a mesh that uses skinning
 //	{
@@ -665,9 +322,10 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
 //            gD3DContext->PSSetConstantBuffers(1, 1, &buffer);
 //
 //			// Render the sub-meshes attached to this node (no bones - rigid movement)
-//			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+//			const Node& node = mNodes[nodeIndex];
+//			for (unsigned int i = node.firstSubMesh; i < node.firstSubMesh + node.numSubMeshes; ++i)
 //			{ 
-//				RenderSubMesh(mSubMeshes[subMeshIndex]);
+//				RenderSubMesh(mSubMeshes[mNodeSubMeshes[i]]);
 //			}
 //		}
 //	}
@@ -677,40 +335,83 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
 // Helper functions
 //--------------------------------------------------------------------------------------
 
-// Count the number of nodes with given assimp node as root - recursive
-unsigned int Mesh::CountNodes(aiNode* assimpNode)
+// Build the mesh from a cooked mesh. Nothing is parsed: the nodes and sub-meshes are read where they are, and the vertex
+// and index blocks go to the GPU straight from the cooked memory
+void Mesh::Load(const CookedMesh& cooked, const std::string& fileName)
 {
-    unsigned int count = 1;
-    for (unsigned int child = 0; child < assimpNode->mNumChildren; ++child)
-        count += CountNodes(assimpNode->mChildren[child]);
-    return count;
-}
-
-// Help build the arrays of submeshes and nodes from the assimp data - recursive
-unsigned int Mesh::ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex)
-{
-    auto& node = mNodes[nodeIndex];
-    node.parentIndex = parentIndex;
-    unsigned int thisIndex = nodeIndex;
-    ++nodeIndex;
-
-    node.name = assimpNode->mName.C_Str();
-
-    node.defaultMatrix.SetValues(&assimpNode->mTransformation.a1);
-    node.defaultMatrix.Transpose(); // Assimp stores matrices differently to this app
+    // Node hierarchy - each node has a matrix and contains sub-meshes. Depth-first, so parents always come before their children
+    mNodes.resize(cooked.NumberNodes());
+    mNodeNames.Reserve(cooked.NumberNodes());
+    std::vector<unsigned int> parents(mNodes.size());
+    for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+    {
+        const CookedNode& cookedNode = cooked.Node(nodeIndex);
+        auto& node = mNodes[nodeIndex];
+        node.name          = mNodeNames.Add(cooked.NodeName(nodeIndex)); // Nodes are named in index order, so the name table lines up with mNodes
+        node.defaultMatrix = cookedNode.DefaultMatrix;
+        node.offsetMatrix  = cookedNode.OffsetMatrix;
+        node.firstSubMesh  = cookedNode.FirstSubMesh;
+        node.numSubMeshes  = cookedNode.NumSubMeshes;
+        parents[nodeIndex] = cookedNode.Parent;
+    }
+    mHierarchy = TransformHierarchy(std::move(parents));
+    mNodeSubMeshes.assign(cooked.NodeSubMeshes(), cooked.NodeSubMeshes() + cooked.NumberNodeSubMeshes());
 
-    node.subMeshes.resize(assimpNode->mNumMeshes);
-    for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+    // Geometry - if any sub-mesh has bones, then all of them do
+    mHasBones = cooked.HasBones();
+    mSubMeshes.resize(cooked.NumberSubMeshes());
+    for (unsigned int m = 0; m < mSubMeshes.size(); ++m)
     {
-        node.subMeshes[i] = assimpNode->mMeshes[i];
+        const CookedSubMesh& cookedSubMesh = cooked.SubMesh(m);
+        auto& subMesh = mSubMeshes[m];
+        subMesh.vertexSize  = cookedSubMesh.VertexSize;
+        subMesh.numVertices = cookedSubMesh.NumVertices;
+        subMesh.numIndices  = cookedSubMesh.NumIndices;
+        subMesh.bounds      = BoundingBox(cookedSubMesh.BoundsMin, cookedSubMesh.BoundsMax);
+        CreateVertexLayout(subMesh, cookedSubMesh, fileName);
+
+        // Skinned meshes keep their bind pose vertices CPU-side too, so they can be skinned on the CPU (see SkinSubMesh)
+        const unsigned char* vertices = cooked.Vertices(m);
+        if (mHasBones)
+        {
+            subMesh.skinningLayout.VertexSize     = cookedSubMesh.VertexSize;
+            subMesh.skinningLayout.PositionOffset = cookedSubMesh.PositionOffset;
+            subMesh.skinningLayout.NormalOffset   = cookedSubMesh.NormalOffset;
+            subMesh.skinningLayout.TangentOffset  = cookedSubMesh.TangentOffset;
+            subMesh.skinningLayout.BonesOffset    = cookedSubMesh.BonesOffset;
+            subMesh.bindPoseVertices.assign(vertices, vertices + subMesh.numVertices * subMesh.vertexSize);
+        }
+
+        CreateVertexBuffer(subMesh, vertices);
+        CreateIndexBuffer(subMesh, cooked.Indices(m));
     }
+    CalculateNodeBounds();
 
-    node.childNodes.resize(assimpNode->mNumChildren);
-    for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+    mAnimations = cooked.ReadAnimations();
+}
+
+// Create the DirectX vertex layout of a sub-mesh from where each part of its vertices is
+void Mesh::CreateVertexLayout(SubMesh& subMesh, const CookedSubMesh& layout, const std::string& fileName)
+{
+    std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+    vertexElements.push_back( { "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(layout.PositionOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 } );
+    if (layout.NormalOffset >= 0)
+        vertexElements.push_back( { "normal",  0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(layout.NormalOffset),  D3D11_INPUT_PER_VERTEX_DATA, 0 } );
+    if (layout.TangentOffset >= 0)
+        vertexElements.push_back( { "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, static_cast<UINT>(layout.TangentOffset), D3D11_INPUT_PER_VERTEX_DATA, 0 } );
+    if (layout.UVOffset >= 0)
+        vertexElements.push_back( { "uv",      0, DXGI_FORMAT_R32G32_FLOAT,    0, static_cast<UINT>(layout.UVOffset),      D3D11_INPUT_PER_VERTEX_DATA, 0 } );
+    if (layout.BonesOffset >= 0)
     {
-        node.childNodes[i] = nodeIndex;
-        nodeIndex = ReadNodes(assimpNode->mChildren[i], nodeIndex, thisIndex);
+        vertexElements.push_back( { "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, static_cast<UINT>(layout.BonesOffset),     D3D11_INPUT_PER_VERTEX_DATA, 0 } );
+        vertexElements.push_back( { "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, static_cast<UINT>(layout.BonesOffset + 4), D3D11_INPUT_PER_VERTEX_DATA, 0 } );
     }
 
-    return nodeIndex;
+    // Create a "vertex layout" to describe to DirectX what is data in each vertex of this mesh
+    auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+    HRESULT hr = gD3DDevice->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
+                                               shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
+                                               &subMesh.vertexLayout);
+    if (shaderSignature)  shaderSignature->Release();
+    if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
 }
@@ -8,12 +8,25 @@
 #include "Common/common.h"
 #include "Math/CVector2.h" 
 #include "Math/CVector3.h" 
+#include "Math/Bounds.h"
+#include "Math/HeightField.h"
+#include "Math/GridVertexData.h"
+#include "Math/TransformHierarchy.h"
+#include "Math/Skinning.h"
+#include "Math/AnimationClip.h"
+#include "Utility/NameIndex.h"
+#include "Utility/ResourcePool.h"
+#include "GridIndexCache.h"
 #include "assimp/Exporter.hpp"
 
 
 #ifndef _MESH_H_INCLUDED_
 #define _MESH_H_INCLUDED_
 
+class CookedMesh;
+class CookedMeshFile;
+struct CookedSubMesh;
+
 class Mesh
 {
 //--------------------------------------------------------------------------------------
@@ -23,11 +36,20 @@ public:
 
     // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
     // Optionally request tangents to be calculated (for normal and parallax mapping - see later lab)
+    // The imported mesh is cooked into a file next to the mesh file (see CookedMesh.h). Later loads memory map the cooked
+    // file instead of importing again, until the mesh file changes. The cooked file can also be loaded on its own
     // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
     Mesh(const std::string& fileName, bool requireTangents = false);
 
+    // Create the mesh from a cooked mesh file (see MeshImporter.h), which can be loaded on a worker thread. Creates the
+    // GPU buffers, so call on the main thread. Throws a std::runtime_error exception on failure
+    explicit Mesh(const CookedMeshFile& file);
+
     //Mesh Constructor to generate a Grid Mesh 
-    Mesh(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& temp, bool normals = true, bool uvs = true);
+    //Normals come from the gradient of the HeightMap when one is given (e.g. from FractalNoise::Generate), otherwise
+    //from central differences of the heights. Request tangents to render the grid with the normal mapping shaders
+    Mesh(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap, bool normals = true, bool uvs = true,
+         const HeightFieldGradient* gradient = nullptr, bool tangents = false);
 
     //Class deconstructor
     ~Mesh();
@@ -39,17 +61,65 @@ public:
     // The default matrix for a given node - used to set the initial position for a new model
     CMatrix4x4 GetNodeDefaultMatrix(unsigned int node) { return mNodes[node].defaultMatrix; }
 
+    // The parent of a given node, the root node is its own parent. Parents always come before their children
+    unsigned int GetNodeParent(unsigned int node) { return mHierarchy.Parent(node); }
+
+    // The node tree as an array of parent indices. Use it to work out the world matrices of every model made from this mesh
+    // in one batch (TransformHierarchy::UpdateWorldMatrices), rather than a model at a time
+    const TransformHierarchy& Hierarchy()  { return mHierarchy; }
+
+    // How many sub-meshes (parts with a single material) are in this mesh
+    unsigned int NumberSubMeshes()  { return static_cast<unsigned int>(mSubMeshes.size()); }
+
+    // Bounding boxes worked out when the mesh is loaded, for culling. A sub-mesh's box is in the space of the node
+    // that uses it, and a node's box covers the sub-meshes it renders (empty if it renders nothing).
+    // Skinned meshes only have bounds for their bind pose
+    const BoundingBox& GetSubMeshBounds(unsigned int subMesh) { return mSubMeshes[subMesh].bounds; }
+    const BoundingBox& GetNodeBounds(unsigned int node)       { return mNodes[node].bounds; }
+
+    // Animations imported with the mesh. Sample them into the local matrices of the models made from this mesh (see
+    // AnimationClip::Sample), before working out their world matrices
+    unsigned int NumberAnimations()  { return static_cast<unsigned int>(mAnimations.size()); }
+    const AnimationClip& GetAnimation(unsigned int animation)  { return mAnimations[animation]; }
+
+    // True if the mesh is skinned: each vertex is blended between up to 4 bones (nodes)
+    bool HasBones()  { return mHasBones; }
+
+    // Number of vertices in a sub-mesh, e.g. to size the output of SkinSubMesh
+    unsigned int GetSubMeshNumVertices(unsigned int subMesh)  { return mSubMeshes[subMesh].numVertices; }
+
+    // Where each part of a skinned sub-mesh's vertices is. Skinning into a copy of the sub-mesh's vertices in this layout
+    // gives vertices that can go straight into a vertex buffer like the sub-mesh's own
+    const SkinnedVertexLayout& GetSubMeshSkinningLayout(unsigned int subMesh)  { return mSubMeshes[subMesh].skinningLayout; }
+
+    // Skinning matrices of a skinned mesh from the world matrices of every node (Hierarchy().UpdateWorldMatrices)
+    // Both arrays have NumberNodes() matrices
+    void CalculateSkinningMatrices(const CMatrix4x4* worldMatrices, CMatrix4x4* skinningMatrices);
+
+    // Memory the mesh uses on the CPU (bind pose and grid vertices, nodes, animations) and on the GPU (vertex and index
+    // buffers), e.g. for a resource budget. A grid counts all of its index buffer, though grids of the same size share one
+    ResourceMemory MemoryUsage() const;
+
+    // Skin a sub-mesh of a skinned mesh on the CPU with the given skinning matrices, writing world space positions, normals
+    // and tangents into the output in the given layout (GetSubMeshNumVertices vertices). Lets skinned models be batched into
+    // shared buffers, or their posed shape be used on the CPU. Vertex ranges are spread over the thread pool
+    void SkinSubMesh(unsigned int subMesh, const CMatrix4x4* skinningMatrices, void* output, const SkinnedVertexLayout& outputLayout,
+                     ThreadPool* threadPool = nullptr);
+
  
-	// Render the mesh with the given matrices
+	// Render the mesh with the given world matrices for every node, from Hierarchy().UpdateWorldMatrices
 	// Handles rigid body meshes (including single part meshes) as well as skinned meshes
 	// LIMITATION: The mesh must use a single texture throughout
-    //void Render(std::vector<CMatrix4x4>& modelMatrices, ID3D11Buffer* buffer, PerModelConstants& ModelConstants);
+    //void Render(CMatrix4x4* worldMatrices, ID3D11Buffer* buffer, PerModelConstants& ModelConstants);
 
-    //Generate the Vertex and Index buffers with the new vertices of the mesh
-    void GenerateBuffers(const void* vertices, const void* indices);
+    //Updates the vertices for a grid mesh, the vertices keep the layout the grid was created with
+    //The vertex buffer is updated in place unless the grid has changed size, the shared indices only change with the size too
+    void UpdateVertices(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap,
+                        const HeightFieldGradient* gradient = nullptr);
 
-    //Updates the vertices and indices for the mesh 
-    void UpdateVertices(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& temp, bool normals = true, bool uvs = true);
+    //Updates only the vertices of a grid mesh affected by the heights in the dirty region (HeightField cells) having changed
+    //Only those rows of vertices are rewritten and uploaded. The grid keeps its size and extents
+    void UpdateVertices(const HeightField& heightMap, const GridRegion& dirty, const HeightFieldGradient* gradient = nullptr);
 
 
 //--------------------------------------------------------------------------------------
@@ -70,6 +140,13 @@ private:
 
         unsigned int       numIndices = 0;
         ID3D11Buffer*      indexBuffer  = nullptr;
+        DXGI_FORMAT        indexFormat  = DXGI_FORMAT_R32_UINT; // Grids use 16-bit indices when they are small enough
+
+        BoundingBox        bounds; // Box around the vertex positions
+
+        // Skinned meshes only: CPU-side copy of the vertices in their bind pose, and where each part of them is
+        std::vector<unsigned char> bindPoseVertices;
+        SkinnedVertexLayout        skinningLayout;
     };
 
 
@@ -78,17 +155,18 @@ private:
     // A node can also have child nodes. The children will follow the motion of the parent node
     // Each node has a default matrix which is it's initial/ default position. Models using this mesh are
     // given these default matrices as a starting position.
+    // The tree itself is kept flat: parent indices are in mHierarchy, and each node's sub-meshes are a range of mNodeSubMeshes
     struct Node
     {
-        std::string  name;
+        std::string_view name;      // Interned in mNodeNames
 
         CMatrix4x4   defaultMatrix; // Starting position/rotation/scale for this node. Relative to parent. Used when first creating a model from this mesh
         CMatrix4x4   offsetMatrix;
 
-        unsigned int parentIndex;   // Index of the parent node (from the mNodes vector below). Root node refers to itself (0)
+        unsigned int firstSubMesh;  // The geometry representing this node, numSubMeshes entries of mNodeSubMeshes starting here
+        unsigned int numSubMeshes;
 
-        std::vector<unsigned int> childNodes; // Child nodes that are controlled by this node (indexes into the mNodes vector below)
-        std::vector<unsigned int> subMeshes;  // The geometry representing this node (indexes into the mSubMeshes vector below)
+        BoundingBox  bounds;        // Box around the sub-meshes of this node, in the node's own space
     };
 
 
@@ -97,35 +175,47 @@ private:
 //--------------------------------------------------------------------------------------
 private:
 
-    // Count the number of nodes with given assimp node as root
-    unsigned int CountNodes(aiNode* assimpNode);
+    // Build the mesh from a cooked mesh. The vertex and index blocks go to the GPU straight from the cooked memory
+    void Load(const CookedMesh& cooked, const std::string& fileName);
 
-    // Help build the arrays of submeshes and nodes from the assimp data - recursive
-    unsigned int ReadNodes(aiNode* assimpNode,unsigned int nodeIndex, unsigned int parentIndex);
+    // Create the DirectX vertex layout of a sub-mesh from where each part of its vertices is
+    void CreateVertexLayout(SubMesh& subMesh, const CookedSubMesh& layout, const std::string& fileName);
 
 	// Helper function for Render function - renders a given sub-mesh. World matrices / textures / states etc. must already be set
 	void RenderSubMesh(const SubMesh& subMesh);
 
+    // Create the vertex buffer of a sub-mesh and fill it with the given vertex data
+    void CreateVertexBuffer(SubMesh& subMesh, const void* vertices);
+
+    // Create the index buffer of a sub-mesh and fill it with the given 32-bit indices
+    void CreateIndexBuffer(SubMesh& subMesh, const void* indices);
+
+    // Point the grid sub-mesh at the shared index buffer for a grid of the given size
+    void SetGridIndices(int subDivX, int subDivZ);
+
+    // Work out each node's bounds from the bounds of its sub-meshes
+    void CalculateNodeBounds();
+
 //--------------------------------------------------------------------------------------
 // Member data
 //--------------------------------------------------------------------------------------
 private:
     std::vector<Node>    mNodes;     // The mesh hierarchy. First entry is root. remainder aree stored in depth-first order
+    NameIndex            mNodeNames; // Name of each node, same order as mNodes. Bones and animations find their nodes here
+
+    TransformHierarchy        mHierarchy;      // Parent of each node, same order as mNodes
+    std::vector<unsigned int> mNodeSubMeshes;  // Sub-meshes of every node, one node after another (indexes into mSubMeshes)
+
+    std::vector<AnimationClip> mAnimations; // Keyframe animations of the nodes, from the mesh file
 
 	bool mHasBones; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
 
-protected:
-    std::vector<SubMesh> mSubMeshes; // The mesh geometry. Nodes refer to sub-meshes in this vector
+    std::unique_ptr<GridVertexData> mGridVertices; // CPU-side copy of the vertices of grid meshes, so they can be updated a few rows at a time
 
-    std::vector<CVector3> Point;
-    std::vector<uint32_t> Indix;
+    std::shared_ptr<const GridIndexBuffer> mGridIndices; // Grid meshes share their index buffer with all grids of the same size
 
-    struct VertexType
-    {
-        CVector3 position;
-        CVector2 texture;
-        CVector3 normal;
-    };
+protected:
+    std::vector<SubMesh> mSubMeshes; // The mesh geometry. Nodes refer to sub-meshes in this vector
 };
 
 
@@ -0,0 +1,336 @@
+#include "epch.h"
+#include "MeshImporter.h"
+#include "Math/CVector2.h"
+#include "Math/Bounds.h"
+#include "Math/Skinning.h"
+#include "Utility/NameIndex.h"
+#include <mutex>
+
+namespace
+{
+	//Nodes in the assimp tree from the given node down, including it - recursive
+	unsigned int CountNodes(const aiNode* assimpNode)
+	{
+		unsigned int count = 1;
+		for (unsigned int child = 0; child < assimpNode->mNumChildren; ++child)  count += CountNodes(assimpNode->mChildren[child]);
+		return count;
+	}
+
+	//Read the assimp tree into the flat node array, depth-first so parents come before their children - recursive
+	//Returns the index after the last node read. Nodes are named in index order, so the name index lines up with the nodes
+	unsigned int ReadNodes(const aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex, CookedMeshData& mesh, NameIndex& nodeNames)
+	{
+		CookedNode& node = mesh.Nodes[nodeIndex];
+		node.Parent = parentIndex;
+		const unsigned int thisIndex = nodeIndex++;
+
+		mesh.NodeNames[thisIndex] = nodeNames.Add({ assimpNode->mName.data, assimpNode->mName.length });
+
+		node.DefaultMatrix.SetValues(&assimpNode->mTransformation.a1);
+		node.DefaultMatrix.Transpose(); //Assimp stores matrices differently to this app
+
+		//Nodes that aren't bones don't move the vertices attached to them, bones get their offsets with the sub-meshes
+		node.OffsetMatrix = MatrixIdentity();
+
+		//Nodes are read in order, so each node's sub-meshes follow on from the previous node's
+		node.FirstSubMesh = static_cast<uint32_t>(mesh.NodeSubMeshes.size());
+		node.NumSubMeshes = assimpNode->mNumMeshes;
+		mesh.NodeSubMeshes.insert(mesh.NodeSubMeshes.end(), assimpNode->mMeshes, assimpNode->mMeshes + assimpNode->mNumMeshes);
+
+		for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+		{
+			nodeIndex = ReadNodes(assimpNode->mChildren[i], nodeIndex, thisIndex, mesh, nodeNames);
+		}
+		return nodeIndex;
+	}
+
+	//Copy one kind of assimp vector into its place in every vertex
+	template <class Convert>
+	void CopyVertexPart(const aiVector3D* source, unsigned char* vertices, const CookedSubMesh& subMesh, int offset, Convert convert)
+	{
+		unsigned char* part = vertices + offset;
+		for (unsigned int v = 0; v < subMesh.NumVertices; ++v, part += subMesh.VertexSize)
+		{
+			auto value = convert(source[v]);
+			std::memcpy(part, &value, sizeof(value));
+		}
+	}
+
+	//Read an assimp mesh into the vertex and index blocks of a sub-mesh. Skinned meshes give every sub-mesh bones so the
+	//whole mesh can use one shader, a sub-mesh without bones is bound entirely to the node that renders it
+	void ReadSubMesh(const aiMesh* assimpMesh, unsigned int m, bool requireTangents, const NameIndex& nodeNames, const std::string& fileName,
+	                 CookedMeshData& mesh)
+	{
+		const std::string subMeshName = assimpMesh->mName.C_Str();
+		const bool hasBones = (mesh.Flags & kCookedMeshBones) != 0;
+		const bool hasUVs = assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0);
+		if (!assimpMesh->HasPositions())  throw std::runtime_error("No position data for sub-mesh " + subMeshName + " in " + fileName);
+		if (!assimpMesh->HasNormals())  throw std::runtime_error("No normal data for sub-mesh " + subMeshName + " in " + fileName);
+		if (requireTangents && !assimpMesh->HasTangentsAndBitangents())  throw std::runtime_error("No tangent data for sub-mesh " + subMeshName + " in " + fileName);
+		if (hasUVs && assimpMesh->mNumUVComponents[0] != 2)  throw std::runtime_error("Unsupported texture coordinates in " + subMeshName + " in " + fileName);
+		if (!assimpMesh->HasFaces())  throw std::runtime_error("No face data in " + subMeshName + " in " + fileName);
+
+		//Position and normal, then tangent, uv and bones if the mesh has them
+		CookedSubMesh& subMesh = mesh.SubMeshes[m];
+		int offset = 0;
+		auto addPart = [&](bool present, int size) { if (!present)  return -1;  offset += size;  return offset - size; };
+		subMesh.PositionOffset = addPart(true, 12);
+		subMesh.NormalOffset   = addPart(true, 12);
+		subMesh.TangentOffset  = addPart(requireTangents, 12);
+		subMesh.UVOffset       = addPart(hasUVs, 8);
+		subMesh.BonesOffset    = addPart(hasBones, 20); //4 bone indices then 4 weights
+		subMesh.VertexSize     = offset;
+		subMesh.NumVertices    = assimpMesh->mNumVertices;
+		subMesh.NumIndices     = assimpMesh->mNumFaces * 3;
+
+		std::vector<unsigned char>& vertices = mesh.Vertices[m];
+		vertices.resize(static_cast<size_t>(subMesh.NumVertices) * subMesh.VertexSize);
+		auto asVector3 = [](const aiVector3D& v) { return CVector3(v.x, v.y, v.z); };
+		CopyVertexPart(assimpMesh->mVertices, vertices.data(), subMesh, subMesh.PositionOffset, asVector3);
+		CopyVertexPart(assimpMesh->mNormals,  vertices.data(), subMesh, subMesh.NormalOffset,   asVector3);
+		if (requireTangents)  CopyVertexPart(assimpMesh->mTangents, vertices.data(), subMesh, subMesh.TangentOffset, asVector3);
+		if (hasUVs)  CopyVertexPart(assimpMesh->mTextureCoords[0], vertices.data(), subMesh, subMesh.UVOffset, [](const aiVector3D& v) { return CVector2(v.x, v.y); });
+
+		BoundingBox bounds;
+		for (unsigned int v = 0; v < subMesh.NumVertices; ++v)  bounds.Add(asVector3(assimpMesh->mVertices[v]));
+		subMesh.BoundsMin = bounds.Min;
+		subMesh.BoundsMax = bounds.Max;
+
+		if (hasBones)
+		{
+			//Starts with all bones and weights set to 0
+			SkinnedVertexLayout boneLayout;
+			boneLayout.VertexSize  = static_cast<int>(subMesh.VertexSize);
+			boneLayout.BonesOffset = subMesh.BonesOffset;
+			BoneWeightPacker weights(vertices.data(), boneLayout, static_cast<int>(subMesh.NumVertices));
+
+			if (assimpMesh->HasBones())
+			{
+				//Bones are the nodes with the same names. Each weight goes in the next free slot of its vertex
+				for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
+				{
+					const aiBone* assimpBone = assimpMesh->mBones[i];
+					unsigned int nodeIndex = nodeNames.Find({ assimpBone->mName.data, assimpBone->mName.length });
+					if (nodeIndex == NameIndex::kNotFound)  throw std::runtime_error("Bone with no matching node in " + fileName);
+					if (nodeIndex > 255)  throw std::runtime_error("Bone index doesn't fit in a byte in " + fileName);
+
+					//Offset matrix for the bone, transform from skinned mesh root to bone root
+					CMatrix4x4& offsetMatrix = mesh.Nodes[nodeIndex].OffsetMatrix;
+					offsetMatrix.SetValues(&assimpBone->mOffsetMatrix.a1);
+					offsetMatrix.Transpose(); //Assimp stores matrices differently to this app
+
+					for (unsigned int j = 0; j < assimpBone->mNumWeights; ++j)
+					{
+						weights.Add(assimpBone->mWeights[j].mVertexId, static_cast<uint8_t>(nodeIndex), assimpBone->mWeights[j].mWeight);
+					}
+				}
+			}
+			else
+			{
+				unsigned int subMeshNode = 0;
+				for (unsigned int nodeIndex = 0; nodeIndex < mesh.Nodes.size(); ++nodeIndex)
+				{
+					const CookedNode& node = mesh.Nodes[nodeIndex];
+					for (unsigned int i = node.FirstSubMesh; i < node.FirstSubMesh + node.NumSubMeshes; ++i)
+					{
+						if (mesh.NodeSubMeshes[i] == m)  subMeshNode = nodeIndex;
+					}
+				}
+				weights.BindAll(static_cast<uint8_t>(subMeshNode));
+			}
+		}
+
+		//Triangles only (see aiProcess_Triangulate and AI_CONFIG_PP_SBP_REMOVE)
+		std::vector<uint32_t>& indices = mesh.Indices[m];
+		indices.resize(subMesh.NumIndices);
+		for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
+		{
+			const unsigned int* faceIndices = assimpMesh->mFaces[face].mIndices;
+			std::copy(faceIndices, faceIndices + 3, indices.begin() + face * 3);
+		}
+	}
+
+	//Import every animation in the scene as a clip. Keys are converted from ticks to seconds, and tracks the file leaves
+	//out keep the node's default transform
+	void ReadAnimations(const aiScene* scene, const NameIndex& nodeNames, const std::string& fileName, CookedMeshData& mesh)
+	{
+		for (unsigned int a = 0; a < scene->mNumAnimations; ++a)
+		{
+			const aiAnimation* assimpAnimation = scene->mAnimations[a];
+			double ticksPerSecond = assimpAnimation->mTicksPerSecond > 0 ? assimpAnimation->mTicksPerSecond : 25.0; //Assimp's default when the file doesn't say
+			auto seconds = [&](double ticks) { return static_cast<float>(ticks / ticksPerSecond); };
+
+			std::vector<AnimationChannelKeys> channels(assimpAnimation->mNumChannels);
+			for (unsigned int c = 0; c < assimpAnimation->mNumChannels; ++c)
+			{
+				const aiNodeAnim* assimpChannel = assimpAnimation->mChannels[c];
+				unsigned int nodeIndex = nodeNames.Find({ assimpChannel->mNodeName.data, assimpChannel->mNodeName.length });
+				if (nodeIndex == NameIndex::kNotFound)  throw std::runtime_error("Animation of a node that isn't in " + fileName);
+
+				auto& keys = channels[c];
+				keys.Node = nodeIndex;
+				for (unsigned int k = 0; k < assimpChannel->mNumPositionKeys; ++k)
+				{
+					const aiVectorKey& key = assimpChannel->mPositionKeys[k];
+					keys.PositionTimes.push_back(seconds(key.mTime));
+					keys.Positions.push_back({ key.mValue.x, key.mValue.y, key.mValue.z });
+				}
+				for (unsigned int k = 0; k < assimpChannel->mNumRotationKeys; ++k)
+				{
+					//Assimp's quaternions rotate the same way as its matrices, so they match this app's once matrices are transposed
+					const aiQuatKey& key = assimpChannel->mRotationKeys[k];
+					keys.RotationTimes.push_back(seconds(key.mTime));
+					keys.Rotations.push_back({ key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w });
+				}
+				for (unsigned int k = 0; k < assimpChannel->mNumScalingKeys; ++k)
+				{
+					const aiVectorKey& key = assimpChannel->mScalingKeys[k];
+					keys.ScaleTimes.push_back(seconds(key.mTime));
+					keys.Scales.push_back({ key.mValue.x, key.mValue.y, key.mValue.z });
+				}
+
+				CVector3 defaultPosition, defaultScale;
+				CQuaternion defaultRotation;
+				DecomposeTransform(mesh.Nodes[nodeIndex].DefaultMatrix, defaultPosition, defaultRotation, defaultScale);
+				if (keys.Positions.empty())  { keys.PositionTimes.push_back(0); keys.Positions.push_back(defaultPosition); }
+				if (keys.Rotations.empty())  { keys.RotationTimes.push_back(0); keys.Rotations.push_back(defaultRotation); }
+				if (keys.Scales.empty())     { keys.ScaleTimes.push_back(0);    keys.Scales.push_back(defaultScale); }
+			}
+
+			mesh.Animations.emplace_back(assimpAnimation->mName.C_Str(), seconds(assimpAnimation->mDuration),
+			                             static_cast<unsigned int>(mesh.Nodes.size()), channels);
+		}
+	}
+}
+
+
+//Import a mesh file through assimp
+CookedMeshData ImportMesh(const std::string& fileName, bool requireTangents /*= false*/)
+{
+	Assimp::Importer importer;
+	//Flags for processing the mesh. Assimp provides a huge amount of control - right click any of these
+	//and "Peek Definition" to see documention above each constant
+	unsigned int assimpFlags = aiProcess_MakeLeftHanded |
+	                           aiProcess_GenSmoothNormals |
+	                           aiProcess_FixInfacingNormals |
+	                           aiProcess_GenUVCoords |
+	                           aiProcess_TransformUVCoords |
+	                           aiProcess_FlipUVs |
+	                           aiProcess_FlipWindingOrder |
+	                           aiProcess_Triangulate |
+	                           aiProcess_JoinIdenticalVertices |
+	                           aiProcess_ImproveCacheLocality |
+	                           aiProcess_SortByPType |
+	                           aiProcess_FindInvalidData |
+	                           aiProcess_OptimizeMeshes |
+	                           aiProcess_FindInstances |
+	                           aiProcess_FindDegenerates |
+	                           aiProcess_RemoveRedundantMaterials |
+	                           aiProcess_Debone |
+	                           aiProcess_SplitByBoneCount |
+	                           aiProcess_LimitBoneWeights |
+	                           aiProcess_RemoveComponent;
+
+	//Flags to specify what mesh data to ignore
+	int removeComponents = aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_TEXTURES | aiComponent_COLORS |
+	                       aiComponent_MATERIALS;
+
+	//Add / remove tangents as required by user
+	if (requireTangents)  assimpFlags |= aiProcess_CalcTangentSpace;
+	else                  removeComponents |= aiComponent_TANGENTS_AND_BITANGENTS;
+
+	//Other miscellaneous settings
+	importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f); //Smoothing angle for normals
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE); //Remove points and lines (keep triangles only)
+	importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);                 //Remove degenerate triangles
+	importer.SetPropertyBool(AI_CONFIG_PP_DB_ALL_OR_NONE, true);            //Default to removing bones/weights from meshes that don't need skinning
+
+	//Set maximum bones that can affect one vertex, and also maximum bones affecting a single mesh
+	unsigned int maxBonesPerVertex = 4; //The shaders support 4 bones per vertex (null bones are added if necessary)
+	unsigned int maxBonesPerMesh = 256; //Bone indexes are stored in a byte, so no more than 256
+	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, maxBonesPerVertex);
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBBC_MAX_BONES, maxBonesPerMesh);
+
+	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeComponents);
+
+	//Import mesh with assimp given above requirements - log output. The logger is shared by every importer, and meshes can
+	//be imported on several threads at once, so it is created once and kept rather than created and killed around each import
+	static std::once_flag createLogger;
+	std::call_once(createLogger, []() { Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE); });
+	const aiScene* scene = importer.ReadFile(fileName, assimpFlags);
+	if (scene == nullptr)  throw std::runtime_error("Error loading mesh (" + fileName + "). " + importer.GetErrorString());
+	if (scene->mNumMeshes == 0)  throw std::runtime_error("No usable geometry in mesh: " + fileName);
+
+	CookedMeshData mesh;
+	if (requireTangents)  mesh.Flags |= kCookedMeshTangents;
+
+	//If any sub-mesh has bones then all sub-meshes are given bones - makes rendering easier (one shader for the whole mesh)
+	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+	{
+		if (scene->mMeshes[m]->HasBones())  mesh.Flags |= kCookedMeshBones;
+	}
+
+	//Node hierarchy - each node has a matrix and contains sub-meshes
+	const unsigned int numNodes = CountNodes(scene->mRootNode);
+	mesh.Nodes.resize(numNodes, CookedNode());
+	mesh.NodeNames.resize(numNodes);
+	NameIndex nodeNames;
+	nodeNames.Reserve(numNodes);
+	ReadNodes(scene->mRootNode, 0, 0, mesh, nodeNames);
+
+	//Geometry, a sub-mesh for each material (texture)
+	mesh.SubMeshes.resize(scene->mNumMeshes, CookedSubMesh());
+	mesh.Vertices.resize(scene->mNumMeshes);
+	mesh.Indices.resize(scene->mNumMeshes);
+	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+	{
+		ReadSubMesh(scene->mMeshes[m], m, requireTangents, nodeNames, fileName, mesh);
+	}
+
+	//Keys for each node, compressed into clips
+	ReadAnimations(scene, nodeNames, fileName, mesh);
+	return mesh;
+}
+
+
+//Map the current cooked file of a mesh file, or import the mesh file and cook it
+CookedMeshFile::CookedMeshFile(const std::string& fileName, bool requireTangents)
+	: m_FileName(fileName)
+{
+	const std::string cookedFileName = CookedMeshFileName(fileName, requireTangents);
+	const CookedMeshSource source = GetCookedMeshSource(fileName);
+
+	//IsCurrent only checks the header, so a cooked mesh damaged after it (e.g. cut short) is only found as it is read.
+	//It is then imported and cooked again like a stale one
+	auto useCooked = [&](const void* data, size_t size)
+	{
+		if (!CookedMesh::IsCurrent(data, size, source, requireTangents))  return false;
+		try
+		{
+			m_Mesh.emplace(data, size, cookedFileName);
+			return true;
+		}
+		catch (const std::runtime_error&)
+		{
+			m_Mesh.reset();
+			return false;
+		}
+	};
+
+	if (AssetArchive::Get().Read(cookedFileName, m_Archived) && useCooked(m_Archived.Data(), m_Archived.Size()))  return;
+	m_Archived = AssetData();
+
+	if (m_File.Open(cookedFileName) && useCooked(m_File.Data(), m_File.Size()))  return;
+
+	m_File.Close();
+	m_Cooked = CookMesh(ImportMesh(fileName, requireTangents), source);
+	SaveCookedMesh(cookedFileName, m_Cooked); //If it can't be saved the mesh is just imported again next time
+	m_Mesh.emplace(m_Cooked.data(), m_Cooked.size(), fileName);
+}
+
+//Read the whole cooked mesh from disk now
+void CookedMeshFile::Prefetch() const
+{
+	m_Archived.Prefetch();
+	m_File.Prefetch();
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Mesh importer - reads mesh files through assimp into the data a cooked mesh holds
+//--------------------------------------------------------------------------------------
+// Uses assimp (http://www.assimp.org/) to support many file types, with the post-processing
+// Mesh needs: left-handed triangles, smooth normals, joined and cache-ordered vertices, at most
+// 4 bones per vertex and 256 per sub-mesh. Nothing here touches the GPU, so meshes can be
+// imported and cooked (CookMesh) ahead of time as well as when Mesh loads one. CookedMeshFile
+// does both halves of loading a mesh that don't need the GPU, so it can run on a loading thread.
+
+#pragma once
+#include "epch.h"
+#include "CookedMesh.h"
+#include "AssetArchive.h"
+#include "Utility/MappedFile.h"
+#include <optional>
+
+//Import a mesh file, optionally calculating tangents (for normal and parallax mapping). The vertices of each sub-mesh
+//have a position, a normal, then a tangent, uvs and bones when the mesh has them. Throws a std::runtime_error on failure
+CookedMeshData ImportMesh(const std::string& fileName, bool requireTangents = false);
+
+
+//The cooked mesh for a mesh file, in the memory it was mapped or cooked into. Nothing here touches the GPU, so it can be
+//loaded on a worker thread and handed to Mesh on the main thread
+class CookedMeshFile
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor that uses the mesh file's cooked file if it is current (see CookedMesh::IsCurrent), in place from the asset
+	//archive (see AssetArchive.h) or mapped from disk, otherwise imports the mesh file and cooks it, saving the cooked file
+	//for next time. Throws a std::runtime_error on failure
+	CookedMeshFile(const std::string& fileName, bool requireTangents);
+
+	CookedMeshFile(const CookedMeshFile&) = delete;
+	CookedMeshFile& operator=(const CookedMeshFile&) = delete;
+
+	//Touch every page of a mapped cooked file so it is read from disk now rather than when the GPU buffers are filled
+	void Prefetch() const;
+
+	const CookedMesh& Cooked() const { return *m_Mesh; }
+	const std::string& FileName() const { return m_FileName; }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::string                m_FileName;
+	AssetData                  m_Archived; //The cooked file when it was current in the asset archive
+	MappedFile                 m_File;     //or on disk
+	std::vector<unsigned char> m_Cooked;   //Otherwise the mesh cooked just now
+	std::optional<CookedMesh>  m_Mesh;
+};
@@ -13,10 +13,10 @@
 Model::Model(Mesh* mesh, CVector3 position /*= { 0,0,0 }*/, CVector3 rotation /*= { 0,0,0 }*/, float scale /*= 1*/)
     : mMesh(mesh)
 {
-    // Set default matrices from mesh
-    mWorldMatrices.resize(mesh->NumberNodes());
-    for (int i = 0; i < mWorldMatrices.size(); ++i)
-        mWorldMatrices[i] = mesh->GetNodeDefaultMatrix(i);
+    // Set default matrices from mesh, split into position, rotation and scale
+    mTransforms.Resize(mesh->NumberNodes());
+    for (int i = 0; i < mTransforms.Size(); ++i)
+        mTransforms.SetMatrix(i, mesh->GetNodeDefaultMatrix(i));
 }
 
 // The render function simply passes this model's matrices over to Mesh:Render.
@@ -30,46 +30,78 @@ Model::Model(Mesh* mesh, CVector3 position /*= { 0,0,0 }*/, CVector3 rotation /*
 void Model::Control(int node, float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode turnLeft, KeyCode turnRight,
                                                KeyCode turnCW, KeyCode turnCCW, KeyCode moveForward, KeyCode moveBackward)
 {
-    auto& matrix = mWorldMatrices[node]; // Use reference to node matrix to make code below more readable
+    // Rotations are about the node's own axes, so each one is applied before the node's current rotation
+    // The node is only updated if a key is held, so an idle node keeps its world matrix
+    CQuaternion rotation = mTransforms.Rotation(node);
+    bool turned = false;
+    auto turn = [&](const CVector3& axis, float angle)
+    {
+        rotation = QuaternionFromAxisAngle(axis, angle) * rotation;
+        turned = true;
+    };
 
 	if (KeyHeld( turnUp ))
 	{
-		matrix = MatrixRotationX(ROTATION_SPEED * frameTime) * matrix;
+		turn({ 1, 0, 0 }, ROTATION_SPEED * frameTime);
 	}
 	if (KeyHeld( turnDown ))
 	{
-		matrix = MatrixRotationX(-ROTATION_SPEED * frameTime) * matrix;
+		turn({ 1, 0, 0 }, -ROTATION_SPEED * frameTime);
 	}
 	if (KeyHeld( turnRight ))
 	{
-		matrix = MatrixRotationY(ROTATION_SPEED * frameTime) * matrix;
+		turn({ 0, 1, 0 }, ROTATION_SPEED * frameTime);
 	}
 	if (KeyHeld( turnLeft ))
 	{
-		matrix = MatrixRotationY(-ROTATION_SPEED * frameTime) * matrix;
+		turn({ 0, 1, 0 }, -ROTATION_SPEED * frameTime);
 	}
 	if (KeyHeld( turnCW ))
 	{
-		matrix = MatrixRotationZ(ROTATION_SPEED * frameTime) * matrix;
+		turn({ 0, 0, 1 }, ROTATION_SPEED * frameTime);
 	}
 	if (KeyHeld( turnCCW ))
 	{
-		matrix = MatrixRotationZ(-ROTATION_SPEED * frameTime) * matrix;
+		turn({ 0, 0, 1 }, -ROTATION_SPEED * frameTime);
 	}
 
-	// Local Z movement - move in the direction of the Z axis, get axis from world matrix
-    CVector3 localZDir = Normalise(matrix.GetRow(2)); // normalise axis in case world matrix has scaling
+    // Renormalise so rounding errors don't build up over many frames of small rotations
+    if (turned)  mTransforms.SetRotation(node, rotation = Normalise(rotation));
+
+	// Local Z movement - move in the direction of the node's Z axis
 	if (KeyHeld( moveForward ))
 	{
-
-		matrix.SetRow(3, matrix.GetRow(3) + localZDir * MOVEMENT_SPEED * frameTime);
+		mTransforms.SetPosition(node, mTransforms.Position(node) + Rotate({ 0, 0, 1 }, rotation) * MOVEMENT_SPEED * frameTime);
 	}
 	if (KeyHeld( moveBackward ))
 	{
-		matrix.SetRow(3, matrix.GetRow(3) - localZDir * MOVEMENT_SPEED * frameTime);
+		mTransforms.SetPosition(node, mTransforms.Position(node) - Rotate({ 0, 0, 1 }, rotation) * MOVEMENT_SPEED * frameTime);
 	}
 }
 
+// Copy the matrix of every node into an array, in node order
+void Model::CopyLocalMatrices(CMatrix4x4* matrices)
+{
+    for (int node = 0; node < mTransforms.Size(); ++node)
+        matrices[node] = mTransforms.Matrix(node);
+}
+
+// Box in world space around every part of the model, from the mesh's node bounds and the current matrices
+BoundingBox Model::WorldBounds()
+{
+    // Node matrices are relative to their parent, the mesh's hierarchy turns them into world matrices
+    std::vector<CMatrix4x4> worldMatrices(mTransforms.Size());
+    CopyLocalMatrices(worldMatrices.data());
+    mMesh->Hierarchy().UpdateWorldMatrices(worldMatrices.data(), worldMatrices.data(), 1);
+
+    BoundingBox bounds;
+    for (int node = 0; node < mTransforms.Size(); ++node)
+    {
+        bounds.Add(TransformBox(mMesh->GetNodeBounds(node), worldMatrices[node]));
+    }
+    return bounds;
+}
+
 //----------------//
 //    New Code    //
 //----------------//
@@ -114,8 +146,21 @@ void Model::Setup(ID3D11VertexShader* VertexShader, ID3D11PixelShader* PixelShad
 }
 
 //Resizes the model with the new HeighMap values that are generated
-void Model::ResizeModel(std::vector<std::vector<float>>& heightMap, int Width, CVector3 MinX, CVector3 MaxX)
+void Model::ResizeModel(const HeightField& heightMap, int Width, CVector3 MinX, CVector3 MaxX, const HeightFieldGradient* gradient /*= nullptr*/)
 {
 	//Calls the UpdateVertices function from the Mesh to regenerate the mesh of the model
-	mMesh->UpdateVertices(MinX, MaxX, Width, Width, heightMap);
+	mMesh->UpdateVertices(MinX, MaxX, Width, Width, heightMap, gradient);
+}
+
+//Updates the model after the heights in the dirty region of the HeightMap have been edited
+void Model::UpdateHeights(const HeightField& heightMap, const GridRegion& dirty, const HeightFieldGradient* gradient /*= nullptr*/)
+{
+	mMesh->UpdateVertices(heightMap, dirty, gradient);
+}
+
+//Fills the HeightMap with the given generator then resizes the model to it
+void Model::ResizeModel(ITerrainGenerator& generator, HeightField& heightMap, int Width, CVector3 MinX, CVector3 MaxX)
+{
+	generator.Generate(heightMap);
+	ResizeModel(heightMap, Width, MinX, MaxX);
 }
@@ -2,17 +2,24 @@
 // Class encapsulating a model
 //--------------------------------------------------------------------------------------
 // Holds a pointer to a mesh as well as position, rotation and scaling, which are converted to a world matrix when required
+// Rotations are kept as quaternions, and each node's world matrix is only rebuilt when it is read after a change
 // This is more of a convenience class, the Mesh class does most of the difficult work.
 
 #include "Common/Common.h"
 #include "Math/CVector3.h"
 #include "Math/CMatrix4x4.h"
+#include "Math/CQuaternion.h"
+#include "Math/NodeTransforms.h"
+#include "Math/Bounds.h"
+#include "Math/HeightField.h"
+#include "Math/ITerrainGenerator.h"
 #include "Utility/Input.h"
 
 #ifndef _MODEL_H_INCLUDED_
 #define _MODEL_H_INCLUDED_
 
 class Mesh;
+struct GridRegion;
 
 class Model
 {
@@ -41,36 +48,36 @@ public:
     // All functions now accept a "node" parameter which specifies which node in the hierarchy to use. Defaults to 0, the root.
     // The hierarchy is stored in depth-first order
 
-	// Getters - model only stores matrices. Position, rotation and scale are extracted if requested.
-	CVector3 Position(int node = 0)  { return mWorldMatrices[node].GetRow(3); }         // Position is on bottom row of matrix
-	CVector3 Rotation(int node = 0)  { return mWorldMatrices[node].GetEulerAngles(); }  // Getting angles from a matrix is complex - see .cpp file
-	CVector3 Scale(int node = 0)     { return { Length(mWorldMatrices[node].GetRow(0)),
-                                                Length(mWorldMatrices[node].GetRow(1)), 
-                                                Length(mWorldMatrices[node].GetRow(2)) }; } // Scale is length of rows 0-2 in matrix
-	CMatrix4x4 WorldMatrix(int node = 0)  { return mWorldMatrices[node]; }
-
-    // Setters - model only stores matricies , so if user sets position, rotation or scale, just update those aspects of the matrix
-	void SetPosition(CVector3 position, int node = 0)  { mWorldMatrices[node].SetRow(3, position); }
-
-	void SetRotation(CVector3 rotation, int node = 0)
-    {
-        // To put rotation angles into a matrix we need to build the matrix from scratch to make sure we retain existing scaling and position
-        mWorldMatrices[node] = MatrixScaling(Scale(node)) *
-                               MatrixRotationZ(rotation.z) * MatrixRotationX(rotation.x) * MatrixRotationY(rotation.y) *
-                               MatrixTranslation(Position(node));
-    }
+	// Getters - model stores position, rotation (as a quaternion) and scale for each node, so these are cheap
+	CVector3    Position(int node = 0)            { return mTransforms.Position(node); }
+	CVector3    Rotation(int node = 0)            { return EulerAngles(mTransforms.Rotation(node)); } // Euler angles, converted from the quaternion
+	CQuaternion RotationQuaternion(int node = 0)  { return mTransforms.Rotation(node); }
+	CVector3    Scale(int node = 0)               { return mTransforms.Scale(node); }
+
+	// The matrix is only built from position, rotation and scale when it is read after any of them changed
+	const CMatrix4x4& WorldMatrix(int node = 0)  { return mTransforms.Matrix(node); }
+
+    // Setters - these only store the new value, the world matrix is rebuilt next time it is needed
+	void SetPosition(CVector3 position, int node = 0)  { mTransforms.SetPosition(node, position); }
+
+	// Two ways to set rotation: Euler angles (applied Z first, then X, then Y), or a quaternion
+	void SetRotation(CVector3 rotation, int node = 0)     { mTransforms.SetRotation(node, QuaternionFromEulerAngles(rotation)); }
+	void SetRotation(CQuaternion rotation, int node = 0)  { mTransforms.SetRotation(node, rotation); }
 
 	// Two ways to set scale: x,y,z separately, or all to the same value
-    // To set scale without affecting rotation, normalise each row, then multiply it by the scale value.
-	void SetScale(CVector3 scale, int node = 0)
-    {
-        mWorldMatrices[node].SetRow(0, Normalise(mWorldMatrices[node].GetRow(0)) * scale.x); 
-        mWorldMatrices[node].SetRow(1, Normalise(mWorldMatrices[node].GetRow(1)) * scale.y); 
-        mWorldMatrices[node].SetRow(2, Normalise(mWorldMatrices[node].GetRow(2)) * scale.z); 
-    }
+	void SetScale(CVector3 scale, int node = 0)  { mTransforms.SetScale(node, scale); }
 	void SetScale(float scale)  { SetScale({ scale, scale, scale });}
 
-    void SetWorldMatrix(CMatrix4x4 matrix, int node = 0)  { mWorldMatrices[node] = matrix; }
+    // The matrix must not have shearing, it is split into position, rotation and scale
+    void SetWorldMatrix(CMatrix4x4 matrix, int node = 0)  { mTransforms.SetMatrix(node, matrix); }
+
+    // Copy the matrix of every node into an array, in node order. These are relative to each node's parent, apart from the root's.
+    // Copy in all the models made from a mesh, one after another, then work out all their world matrices in one batch with
+    // the mesh's Hierarchy().UpdateWorldMatrices
+    void CopyLocalMatrices(CMatrix4x4* matrices);
+
+    // Box in world space around every part of the model, from the mesh's node bounds and the current matrices. For culling
+    BoundingBox WorldBounds();
 
     //----------------//
     //    New Code    //
@@ -92,7 +99,15 @@ public:
     void Setup(ID3D11VertexShader* VertexShader, ID3D11PixelShader* PixelShader);
 
     //Resizes the model with the new HeighMap values that are generated
-    void ResizeModel(std::vector<std::vector<float>>& heightMap, int Width, CVector3 MinX, CVector3 MaxX);
+    //Pass the gradient of the HeightMap to build the normals from its exact slopes
+    void ResizeModel(const HeightField& heightMap, int Width, CVector3 MinX, CVector3 MaxX, const HeightFieldGradient* gradient = nullptr);
+
+    //Updates the model after the heights in the dirty region of the HeightMap have been edited (e.g. by a sculpting brush)
+    //Only the affected rows of the terrain are rebuilt and uploaded, the size of the terrain must not have changed
+    void UpdateHeights(const HeightField& heightMap, const GridRegion& dirty, const HeightFieldGradient* gradient = nullptr);
+
+    //Fills the HeightMap with the given generator (Diamond-Square, fractal noise, ...) then resizes the model to it
+    void ResizeModel(ITerrainGenerator& generator, HeightField& heightMap, int Width, CVector3 MinX, CVector3 MaxX);
 
 	//-------------------------------------
 	// Private data / members
@@ -100,10 +115,10 @@ public:
 private:
     Mesh* mMesh;
 
-	// World matrices for the model
+	// Position, rotation and scale of each node, with their world matrices built on demand
     // Now that meshes have multiple parts, we need multiple matrices. The root matrix (the first one) is the world matrix
     // for the entire model. The remaining matrices are relative to their parent part. The hierarchy is defined in the mesh (nodes)
-	std::vector<CMatrix4x4> mWorldMatrices;
+	NodeTransforms mTransforms;
 };
 
 
@@ -0,0 +1,354 @@
+#include "epch.h"
+#include "AnimationClip.h"
+#include "Utility/ThreadPool.h"
+#include "Utility/BinaryStream.h"
+
+namespace
+{
+	//Roughly how many channels each thread pool task should sample, so small rigs are batched together
+	const int kChannelsPerChunk = 512;
+
+	//The three smallest components of a unit quaternion are within +-1/sqrt(2). An even number of steps puts 0 on a step
+	const float kMaxSmallComponent = 0.70710678f;
+	const float kQuantiseScale     = 32766.0f / (2.0f * kMaxSmallComponent);
+
+
+	//Index of the last key at or before the given time, 0 if the time is before the first key
+	//A binary search without branches on the comparisons, as the times of different instances are unrelated
+	inline int FindKey(const float* times, int numKeys, float time)
+	{
+		const float* first = times;
+		while (numKeys > 1)
+		{
+			int half = numKeys / 2;
+			first = first[half] <= time ? first + half : first;
+			numKeys -= half;
+		}
+		return static_cast<int>(first - times);
+	}
+
+	//How far between a key and the next one the given time is, 0 to 1
+	inline float KeyFraction(const float* times, int key, float time)
+	{
+		float gap = times[key + 1] - times[key];
+		return gap > 0.0f ? std::min(std::max((time - times[key]) / gap, 0.0f), 1.0f) : 0.0f;
+	}
+
+	inline CVector3 Lerp(const CVector3& v1, const CVector3& v2, float t)
+	{
+		return { v1.x + (v2.x - v1.x) * t, v1.y + (v2.y - v1.y) * t, v1.z + (v2.z - v1.z) * t };
+	}
+
+	//DequantiseRotation, inline for the sampling loop
+	inline CQuaternion Dequantise(const QuantisedRotation& rotation)
+	{
+		float a = (rotation.Packed[0] & 0x7fff) * (1.0f / kQuantiseScale) - kMaxSmallComponent;
+		float b = (rotation.Packed[1] & 0x7fff) * (1.0f / kQuantiseScale) - kMaxSmallComponent;
+		float c = rotation.Packed[2] * (1.0f / kQuantiseScale) - kMaxSmallComponent;
+		float largest = std::sqrt(std::max(1.0f - a * a - b * b - c * c, 0.0f));
+
+		//Slot the largest component back in with selects rather than a switch, which the CPU can't predict from key to key
+		int index = ((rotation.Packed[0] >> 15) << 1) | (rotation.Packed[1] >> 15);
+		return { index == 0 ? largest : a,
+		         index == 0 ? a : index == 1 ? largest : b,
+		         index <= 1 ? b : index == 2 ? largest : c,
+		         index == 3 ? largest : c };
+	}
+
+	//Same as the Nlerp in CQuaternion.cpp, inline for the sampling loop
+	inline CQuaternion FastNlerp(const CQuaternion& q1, const CQuaternion& q2, float t)
+	{
+		float w1 = 1.0f - t;
+		float w2 = std::copysign(t, q1.x*q2.x + q1.y*q2.y + q1.z*q2.z + q1.w*q2.w);
+		CQuaternion q(q1.x*w1 + q2.x*w2, q1.y*w1 + q2.y*w2, q1.z*w1 + q2.z*w2, q1.w*w1 + q2.w*w2);
+		float invLength = 1.0f / std::sqrt(q.x*q.x + q.y*q.y + q.z*q.z + q.w*q.w);
+		return { q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength };
+	}
+
+	//Angle between the rotations of two unit quaternions, in radians. From the distance between them rather than acos of
+	//their dot product, which loses most of its precision for the small angles the tolerances are about
+	inline float Angle(const CQuaternion& q1, const CQuaternion& q2)
+	{
+		float sign = Dot(q1, q2) < 0.0f ? -1.0f : 1.0f;
+		float x = q1.x - q2.x * sign, y = q1.y - q2.y * sign, z = q1.z - q2.z * sign, w = q1.w - q2.w * sign;
+		return 4.0f * std::asin(std::min(std::sqrt(x * x + y * y + z * z + w * w) * 0.5f, 1.0f));
+	}
+
+	//Indexes of the keys to keep so interpolating between them stays within the tolerance of every key of a track.
+	//Greedy: each kept key is followed by the furthest key that a straight line to it still fits
+	template <class Value, class Interpolate, class Error>
+	std::vector<int> ReduceKeys(const std::vector<float>& times, const std::vector<Value>& values, float tolerance,
+	                            Interpolate interpolate, Error error)
+	{
+		const int numKeys = static_cast<int>(values.size());
+		bool constant = true;
+		for (int key = 1; key < numKeys && constant; ++key)  constant = error(values[0], values[key]) <= tolerance;
+		if (constant)  return { 0 };
+
+		std::vector<int> kept = { 0 };
+		int start = 0;
+		for (int end = start + 2; end < numKeys; ++end)
+		{
+			for (int key = start + 1; key < end; ++key)
+			{
+				float gap = times[end] - times[start];
+				float t = gap > 0.0f ? (times[key] - times[start]) / gap : 0.0f;
+				if (error(interpolate(values[start], values[end], t), values[key]) > tolerance)
+				{
+					start = end - 1;
+					kept.push_back(start);
+					break;
+				}
+			}
+		}
+		kept.push_back(numKeys - 1);
+		return kept;
+	}
+
+	void CheckTrack(const std::vector<float>& times, size_t numValues, const std::string& clipName)
+	{
+		if (times.empty() || times.size() != numValues)  throw std::runtime_error("Animation track with no keys or missing values in " + clipName);
+		if (!std::is_sorted(times.begin(), times.end()))  throw std::runtime_error("Animation keys out of order in " + clipName);
+	}
+
+	//An array of keys as its size then its values
+	template <class T>
+	void WriteKeys(BinaryWriter& writer, const std::vector<T>& keys)
+	{
+		writer.Write(static_cast<uint32_t>(keys.size()));
+		writer.WriteArray(keys.data(), keys.size());
+	}
+
+	template <class T>
+	void ReadKeys(BinaryReader& reader, std::vector<T>& keys)
+	{
+		const uint32_t count = reader.Read<uint32_t>();
+		const T* values = reader.ReadArray<T>(count);
+		keys.assign(values, values + count);
+	}
+}
+
+
+//Smallest three: leave out the largest component, made positive so the other three say which of q and -q it is
+QuantisedRotation QuantiseRotation(const CQuaternion& rotation)
+{
+	const float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (std::abs(components[i]) > std::abs(components[largest]))  largest = i;
+	}
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint16_t small[3];
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest)  continue;
+		float value = std::min(std::max(components[i] * sign, -kMaxSmallComponent), kMaxSmallComponent);
+		small[j++] = static_cast<uint16_t>(std::lround((value + kMaxSmallComponent) * kQuantiseScale));
+	}
+
+	QuantisedRotation result;
+	result.Packed[0] = static_cast<uint16_t>(small[0] | ((largest >> 1) << 15));
+	result.Packed[1] = static_cast<uint16_t>(small[1] | ((largest & 1) << 15));
+	result.Packed[2] = small[2];
+	return result;
+}
+
+CQuaternion DequantiseRotation(const QuantisedRotation& rotation)
+{
+	return Dequantise(rotation);
+}
+
+
+//Constructor from the keys of every animated node, reduced within the given tolerances
+AnimationClip::AnimationClip(std::string name, float duration, unsigned int numNodes, const std::vector<AnimationChannelKeys>& channels,
+                             const AnimationCompression& compression /*= AnimationCompression()*/)
+	: m_Name(std::move(name)), m_Duration(std::max(duration, 0.0f)), m_NumNodes(numNodes)
+{
+	std::vector<const AnimationChannelKeys*> sorted;
+	for (const auto& keys : channels)  sorted.push_back(&keys);
+	std::sort(sorted.begin(), sorted.end(), [](const AnimationChannelKeys* a, const AnimationChannelKeys* b) { return a->Node < b->Node; });
+
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		const AnimationChannelKeys& keys = *sorted[i];
+		if (keys.Node >= numNodes)  throw std::runtime_error("Animation channel for a node that isn't in the mesh in " + m_Name);
+		if (i > 0 && keys.Node == sorted[i - 1]->Node)  throw std::runtime_error("Two animation channels for the same node in " + m_Name);
+		CheckTrack(keys.PositionTimes, keys.Positions.size(), m_Name);
+		CheckTrack(keys.RotationTimes, keys.Rotations.size(), m_Name);
+		CheckTrack(keys.ScaleTimes, keys.Scales.size(), m_Name);
+
+		Channel channel;
+		channel.Node = keys.Node;
+
+		auto vectorError = [](const CVector3& v1, const CVector3& v2) { return Length(v1 - v2); };
+		channel.Position = { static_cast<uint32_t>(m_PositionTimes.size()), 0 };
+		for (int key : ReduceKeys(keys.PositionTimes, keys.Positions, compression.PositionTolerance, Lerp, vectorError))
+		{
+			m_PositionTimes.push_back(keys.PositionTimes[key]);
+			m_Positions.push_back(keys.Positions[key]);
+			++channel.Position.NumKeys;
+		}
+
+		channel.Scale = { static_cast<uint32_t>(m_ScaleTimes.size()), 0 };
+		for (int key : ReduceKeys(keys.ScaleTimes, keys.Scales, compression.ScaleTolerance, Lerp, vectorError))
+		{
+			m_ScaleTimes.push_back(keys.ScaleTimes[key]);
+			m_Scales.push_back(keys.Scales[key]);
+			++channel.Scale.NumKeys;
+		}
+
+		//Reduce the rotations as they will be sampled, after quantisation, so the tolerance covers both
+		std::vector<CQuaternion> rotations;
+		std::vector<QuantisedRotation> quantised;
+		for (const CQuaternion& rotation : keys.Rotations)
+		{
+			quantised.push_back(QuantiseRotation(Normalise(rotation)));
+			rotations.push_back(DequantiseRotation(quantised.back()));
+		}
+		channel.Rotation = { static_cast<uint32_t>(m_RotationTimes.size()), 0 };
+		for (int key : ReduceKeys(keys.RotationTimes, rotations, compression.RotationTolerance, FastNlerp, Angle))
+		{
+			m_RotationTimes.push_back(keys.RotationTimes[key]);
+			m_Rotations.push_back(quantised[key]);
+			++channel.Rotation.NumKeys;
+		}
+
+		m_Channels.push_back(channel);
+	}
+}
+
+//Memory taken by the keys after reduction
+size_t AnimationClip::KeyBytes() const
+{
+	return NumberKeys() * sizeof(float) + m_Positions.size() * sizeof(CVector3) + m_Rotations.size() * sizeof(QuantisedRotation) +
+	       m_Scales.size() * sizeof(CVector3);
+}
+
+//Transform of a channel's node at the given time
+void AnimationClip::SampleChannel(int channel, float time, CVector3& position, CQuaternion& rotation, CVector3& scale) const
+{
+	SampleKeys(m_Channels[channel], WrapTime(time), position, rotation, scale);
+}
+
+
+//Local matrices of the animated nodes of many instances, each at its own time
+void AnimationClip::Sample(const float* times, int numInstances, CMatrix4x4* localMatrices, ThreadPool* threadPool /*= nullptr*/) const
+{
+	if (m_Channels.empty() || numInstances <= 0)  return;
+
+	auto sampleInstances = [&](int first, int last)
+	{
+		for (int instance = first; instance < last; ++instance)
+		{
+			SampleInstance(times[instance], localMatrices + static_cast<size_t>(instance) * m_NumNodes);
+		}
+	};
+
+	//Not worth waking the pool for a single chunk, e.g. one model on its own
+	int grainSize = std::max(1, kChannelsPerChunk / NumberChannels());
+	if (numInstances <= grainSize)
+	{
+		sampleInstances(0, numInstances);
+		return;
+	}
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+	threadPool->ParallelFor(0, numInstances, grainSize, sampleInstances);
+}
+
+
+//Write the reduced keys, to be read back by Read
+void AnimationClip::Write(BinaryWriter& writer) const
+{
+	writer.WriteString(m_Name);
+	writer.Write(m_Duration);
+	writer.Write(static_cast<uint32_t>(m_NumNodes));
+	WriteKeys(writer, m_Channels);
+	WriteKeys(writer, m_PositionTimes);
+	WriteKeys(writer, m_Positions);
+	WriteKeys(writer, m_RotationTimes);
+	WriteKeys(writer, m_Rotations);
+	WriteKeys(writer, m_ScaleTimes);
+	WriteKeys(writer, m_Scales);
+}
+
+//Read a clip written by Write. The keys are already reduced, but the channels are checked as the constructor would
+AnimationClip AnimationClip::Read(BinaryReader& reader)
+{
+	AnimationClip clip;
+	clip.m_Name = std::string(reader.ReadString());
+	clip.m_Duration = std::max(reader.Read<float>(), 0.0f);
+	clip.m_NumNodes = reader.Read<uint32_t>();
+	ReadKeys(reader, clip.m_Channels);
+	ReadKeys(reader, clip.m_PositionTimes);
+	ReadKeys(reader, clip.m_Positions);
+	ReadKeys(reader, clip.m_RotationTimes);
+	ReadKeys(reader, clip.m_Rotations);
+	ReadKeys(reader, clip.m_ScaleTimes);
+	ReadKeys(reader, clip.m_Scales);
+
+	auto checkTrack = [&](const Track& track, size_t numTimes, size_t numValues)
+	{
+		if (numTimes != numValues || track.NumKeys == 0 || track.FirstKey > numTimes || track.NumKeys > numTimes - track.FirstKey)
+		{
+			throw std::runtime_error("Animation track outside its keys in " + reader.Name());
+		}
+	};
+	for (size_t i = 0; i < clip.m_Channels.size(); ++i)
+	{
+		const Channel& channel = clip.m_Channels[i];
+		if (channel.Node >= clip.m_NumNodes)  throw std::runtime_error("Animation channel for a node that isn't in the mesh in " + reader.Name());
+		if (i > 0 && channel.Node <= clip.m_Channels[i - 1].Node)  throw std::runtime_error("Animation channels out of order in " + reader.Name());
+		checkTrack(channel.Position, clip.m_PositionTimes.size(), clip.m_Positions.size());
+		checkTrack(channel.Rotation, clip.m_RotationTimes.size(), clip.m_Rotations.size());
+		checkTrack(channel.Scale,    clip.m_ScaleTimes.size(),    clip.m_Scales.size());
+	}
+	return clip;
+}
+
+//Loop a time round the clip's duration
+float AnimationClip::WrapTime(float time) const
+{
+	if (m_Duration <= 0.0f)  return 0.0f;
+	time = std::fmod(time, m_Duration);
+	return time < 0.0f ? time + m_Duration : time;
+}
+
+//The animated nodes of one instance
+void AnimationClip::SampleInstance(float time, CMatrix4x4* localMatrices) const
+{
+	time = WrapTime(time);
+	CVector3 position, scale;
+	CQuaternion rotation;
+	for (const Channel& channel : m_Channels)
+	{
+		SampleKeys(channel, time, position, rotation, scale);
+		localMatrices[channel.Node] = MatrixFromTransform(position, rotation, scale);
+	}
+}
+
+//Interpolate a channel's keys at a time within the clip
+void AnimationClip::SampleKeys(const Channel& channel, float time, CVector3& position, CQuaternion& rotation, CVector3& scale) const
+{
+	//Between the key at or before the time and the next one. Before the first key or after the last, the nearest key
+	const float* times = m_PositionTimes.data() + channel.Position.FirstKey;
+	const CVector3* positions = m_Positions.data() + channel.Position.FirstKey;
+	int key = FindKey(times, channel.Position.NumKeys, time);
+	position = key + 1 < static_cast<int>(channel.Position.NumKeys) ? Lerp(positions[key], positions[key + 1], KeyFraction(times, key, time)) : positions[key];
+
+	times = m_ScaleTimes.data() + channel.Scale.FirstKey;
+	const CVector3* scales = m_Scales.data() + channel.Scale.FirstKey;
+	key = FindKey(times, channel.Scale.NumKeys, time);
+	scale = key + 1 < static_cast<int>(channel.Scale.NumKeys) ? Lerp(scales[key], scales[key + 1], KeyFraction(times, key, time)) : scales[key];
+
+	//The keys were reduced against normalised lerp, so it stays within tolerance of the source and is much cheaper than slerp
+	times = m_RotationTimes.data() + channel.Rotation.FirstKey;
+	const QuantisedRotation* rotations = m_Rotations.data() + channel.Rotation.FirstKey;
+	key = FindKey(times, channel.Rotation.NumKeys, time);
+	rotation = Dequantise(rotations[key]);
+	if (key + 1 < static_cast<int>(channel.Rotation.NumKeys))
+	{
+		rotation = FastNlerp(rotation, Dequantise(rotations[key + 1]), KeyFraction(times, key, time));
+	}
+}
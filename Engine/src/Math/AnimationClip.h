@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------------
+// Animation clip - compressed keyframes for the nodes of a mesh
+//--------------------------------------------------------------------------------------
+// A clip holds position, rotation and scale keys for the nodes it animates. When it is built
+// the keys are reduced: keys that interpolating between their neighbours reproduces within a
+// tolerance are dropped, and tracks that don't change collapse to a single key. Rotations are
+// quantised to 6 bytes each (the three smallest components at 15 bits). All keys of a kind
+// sit in one array, so sampling walks a few contiguous arrays.
+// Sample evaluates many instances at once, each at its own time, into the same arrays of
+// local matrices TransformHierarchy::UpdateWorldMatrices works from, spread over the thread pool.
+
+#pragma once
+#include "epch.h"
+#include "CQuaternion.h"
+
+class ThreadPool;
+class BinaryWriter;
+class BinaryReader;
+
+//A unit quaternion in 6 bytes. The largest component is left out (it is rebuilt from the other three) and its index
+//is held in the top bits of the first two values, the other three components are 15 bits each
+struct QuantisedRotation
+{
+	uint16_t Packed[3];
+};
+
+QuantisedRotation QuantiseRotation(const CQuaternion& rotation);
+CQuaternion       DequantiseRotation(const QuantisedRotation& rotation);
+
+
+//Keys for one node as they are imported, before reduction. Times are in seconds and in order. Each track needs at
+//least one key (use the node's default transform for tracks the source doesn't have)
+struct AnimationChannelKeys
+{
+	unsigned int             Node = 0;
+	std::vector<float>       PositionTimes;
+	std::vector<CVector3>    Positions;
+	std::vector<float>       RotationTimes;
+	std::vector<CQuaternion> Rotations;
+	std::vector<float>       ScaleTimes;
+	std::vector<CVector3>    Scales;
+};
+
+//How far the reduced keys may stray from the imported ones
+struct AnimationCompression
+{
+	float PositionTolerance = 0.001f; //Distance, in the node's parent space
+	float RotationTolerance = 0.001f; //Angle in radians
+	float ScaleTolerance    = 0.001f;
+};
+
+class AnimationClip
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor from the keys of every animated node of a mesh with the given number of nodes. Throws a
+	//std::runtime_error for a node out of range, a node with two channels, an empty track or keys out of order
+	AnimationClip(std::string name, float duration, unsigned int numNodes, const std::vector<AnimationChannelKeys>& channels,
+	              const AnimationCompression& compression = AnimationCompression());
+
+	const std::string& Name() const { return m_Name; }
+	float Duration() const { return m_Duration; }
+
+	//Number of nodes in the meshes this clip is for, and how many of them it animates
+	unsigned int NumberNodes() const { return m_NumNodes; }
+	int NumberChannels() const { return static_cast<int>(m_Channels.size()); }
+	unsigned int ChannelNode(int channel) const { return m_Channels[channel].Node; }
+
+	//Keys left after reduction, over all channels, and the memory they take
+	size_t NumberKeys() const { return m_PositionTimes.size() + m_RotationTimes.size() + m_ScaleTimes.size(); }
+	size_t KeyBytes() const;
+
+	//Transform of a channel's node at the given time. Times loop round the clip's duration
+	void SampleChannel(int channel, float time, CVector3& position, CQuaternion& rotation, CVector3& scale) const;
+
+	//Local matrices (relative to each node's parent) of the animated nodes of a number of instances, each at its own time.
+	//The matrices are NumberNodes() per instance, one instance after another, as TransformHierarchy uses them. Nodes this
+	//clip doesn't animate are left as they are, so fill the array with the models' own matrices first (Model::CopyLocalMatrices)
+	//Instances are spread over the given thread pool (the shared pool by default)
+	void Sample(const float* times, int numInstances, CMatrix4x4* localMatrices, ThreadPool* threadPool = nullptr) const;
+
+	//Write the reduced keys (e.g. into a cooked mesh), and read them back as they are, without reducing them again
+	//Read throws a std::runtime_error if the data doesn't make a valid clip
+	void Write(BinaryWriter& writer) const;
+	static AnimationClip Read(BinaryReader& reader);
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	struct Channel;
+
+	//Empty clip for Read to fill in
+	AnimationClip() {}
+
+	//Loop a time round the clip's duration
+	float WrapTime(float time) const;
+
+	//The animated nodes of one instance
+	void SampleInstance(float time, CMatrix4x4* localMatrices) const;
+
+	//Interpolate a channel's keys at a time within the clip
+	void SampleKeys(const Channel& channel, float time, CVector3& position, CQuaternion& rotation, CVector3& scale) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	//A run of keys in one of the key arrays
+	struct Track
+	{
+		uint32_t FirstKey;
+		uint32_t NumKeys;
+	};
+
+	struct Channel
+	{
+		unsigned int Node;
+		Track        Position;
+		Track        Rotation;
+		Track        Scale;
+	};
+
+	std::string  m_Name;
+	float        m_Duration = 0.0f;
+	unsigned int m_NumNodes = 0;
+
+	std::vector<Channel> m_Channels; //In node order
+
+	//Keys of every channel, one track after another
+	std::vector<float>             m_PositionTimes;
+	std::vector<CVector3>          m_Positions;
+	std::vector<float>             m_RotationTimes;
+	std::vector<QuantisedRotation> m_Rotations;
+	std::vector<float>             m_ScaleTimes;
+	std::vector<CVector3>          m_Scales;
+};
@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------
+// Bounding volumes - axis aligned boxes and spheres
+//--------------------------------------------------------------------------------------
+
+#pragma once
+#include "epch.h"
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+#include <cfloat>
+
+//Axis aligned bounding box
+struct BoundingBox
+{
+	CVector3 Min = CVector3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+	CVector3 Max = CVector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	BoundingBox() {}
+	BoundingBox(const CVector3& min, const CVector3& max) : Min(min), Max(max) {}
+
+	//A box starts empty, and stays empty until a point is added
+	bool Empty() const { return Min.x > Max.x; }
+
+	CVector3 Centre()  const { return (Min + Max) * 0.5f; }
+	CVector3 Extents() const { return (Max - Min) * 0.5f; }
+
+	//Grow the box to include the given point / box
+	void Add(const CVector3& point)
+	{
+		Min = CVector3(std::min(Min.x, point.x), std::min(Min.y, point.y), std::min(Min.z, point.z));
+		Max = CVector3(std::max(Max.x, point.x), std::max(Max.y, point.y), std::max(Max.z, point.z));
+	}
+	void Add(const BoundingBox& box)
+	{
+		if (box.Empty())  return;
+		Add(box.Min);
+		Add(box.Max);
+	}
+
+	//Squared distance from the point to the nearest point in the box, 0 if the point is inside
+	float DistanceSquared(const CVector3& point) const
+	{
+		float dx = std::max({ Min.x - point.x, 0.0f, point.x - Max.x });
+		float dy = std::max({ Min.y - point.y, 0.0f, point.y - Max.y });
+		float dz = std::max({ Min.z - point.z, 0.0f, point.z - Max.z });
+		return dx * dx + dy * dy + dz * dz;
+	}
+};
+
+//Bounding sphere
+struct BoundingSphere
+{
+	CVector3 Centre = CVector3(0, 0, 0);
+	float    Radius = 0.0f;
+
+	BoundingSphere() {}
+	BoundingSphere(const CVector3& centre, float radius) : Centre(centre), Radius(radius) {}
+
+	//Sphere enclosing the given box
+	explicit BoundingSphere(const BoundingBox& box) : Centre(box.Centre()), Radius(Length(box.Extents())) {}
+};
+
+//Box enclosing the given box after it has been transformed by an affine matrix
+//Each axis of the new box reaches as far as the transformed axes of the old box do along it (Arvo)
+inline BoundingBox TransformBox(const BoundingBox& box, const CMatrix4x4& m)
+{
+	if (box.Empty())  return box;
+
+	CVector3 c = box.Centre();
+	CVector3 e = box.Extents();
+	CVector3 centre(c.x * m.e00 + c.y * m.e10 + c.z * m.e20 + m.e30,
+	                c.x * m.e01 + c.y * m.e11 + c.z * m.e21 + m.e31,
+	                c.x * m.e02 + c.y * m.e12 + c.z * m.e22 + m.e32);
+	CVector3 extents(e.x * std::abs(m.e00) + e.y * std::abs(m.e10) + e.z * std::abs(m.e20),
+	                 e.x * std::abs(m.e01) + e.y * std::abs(m.e11) + e.z * std::abs(m.e21),
+	                 e.x * std::abs(m.e02) + e.y * std::abs(m.e12) + e.z * std::abs(m.e22));
+	return BoundingBox(centre - extents, centre + extents);
+}
@@ -4,6 +4,63 @@
 
 #include "epch.h"
 #include "CMatrix4x4.h"
+#include "MatrixKernels.h"
+#include "Utility/CpuFeatures.h"
+#include <emmintrin.h>
+
+
+namespace
+{
+    // One row of a matrix product: each element of the row of m1 scales the matching row of m2, and the results are added
+    inline __m128 MultiplyRow(__m128 row, __m128 m2Row0, __m128 m2Row1, __m128 m2Row2, __m128 m2Row3)
+    {
+        __m128 result = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), m2Row0);
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), m2Row1));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), m2Row2));
+        return _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), m2Row3));
+    }
+
+    // out = m1 * m2 for aligned matrices. All of m1 and m2 is loaded before anything is written, so out can be m1 or m2
+    inline void MultiplySSE2(const float* m1, const float* m2, float* out)
+    {
+        __m128 m2Row0 = _mm_load_ps(m2);
+        __m128 m2Row1 = _mm_load_ps(m2 + 4);
+        __m128 m2Row2 = _mm_load_ps(m2 + 8);
+        __m128 m2Row3 = _mm_load_ps(m2 + 12);
+        __m128 row0 = MultiplyRow(_mm_load_ps(m1),      m2Row0, m2Row1, m2Row2, m2Row3);
+        __m128 row1 = MultiplyRow(_mm_load_ps(m1 + 4),  m2Row0, m2Row1, m2Row2, m2Row3);
+        __m128 row2 = MultiplyRow(_mm_load_ps(m1 + 8),  m2Row0, m2Row1, m2Row2, m2Row3);
+        __m128 row3 = MultiplyRow(_mm_load_ps(m1 + 12), m2Row0, m2Row1, m2Row2, m2Row3);
+        _mm_store_ps(out,      row0);
+        _mm_store_ps(out + 4,  row1);
+        _mm_store_ps(out + 8,  row2);
+        _mm_store_ps(out + 12, row3);
+    }
+
+    using MultiplyMatricesKernel = void (*)(const float*, const float*, float*, size_t);
+    using TransformPointsKernel = void (*)(const float*, const float*, float*, size_t);
+
+    // The batch kernels for the SIMD level in use, see GetSimdLevel
+    struct MatrixKernels
+    {
+        const char*            name;
+        MultiplyMatricesKernel multiplyMatrices;
+        TransformPointsKernel  transformPoints;
+    };
+
+    MatrixKernels SelectKernels()
+    {
+        if (GetSimdLevel() >= SimdLevel::AVX2)  return { "AVX2", MultiplyMatricesAVX2, TransformPointsAVX2 };
+        return { "SSE2", MultiplyMatricesSSE2, TransformPointsSSE2 };
+    }
+
+    // Picked on first use, like GetSimdLevel, so it is there even for another file's static initialisers
+    const MatrixKernels& Kernels()
+    {
+        static const MatrixKernels kernels = SelectKernels();
+        return kernels;
+    }
+}
 
 
 /*-----------------------------------------------------------------------------------------
@@ -31,47 +88,8 @@ CVector3 CMatrix4x4::GetRow(int iRow) const
 // Post-multiply this matrix by the given one
 CMatrix4x4& CMatrix4x4::operator*=(const CMatrix4x4& m)
 {
-    if (this == &m)
-    {
-        // Special case of multiplying by self - no copy optimisations so use binary version
-        *this = m * m;
-    }
-    else
-    {
-        float t0, t1, t2;
-
-        t0 = e00 * m.e00 + e01 * m.e10 + e02 * m.e20 + e03 * m.e30;
-        t1 = e00 * m.e01 + e01 * m.e11 + e02 * m.e21 + e03 * m.e31;
-        t2 = e00 * m.e02 + e01 * m.e12 + e02 * m.e22 + e03 * m.e32;
-        e03 = e00 * m.e03 + e01 * m.e13 + e02 * m.e23 + e03 * m.e33;
-        e00 = t0;
-        e01 = t1;
-        e02 = t2;
-
-        t0 = e10 * m.e00 + e11 * m.e10 + e12 * m.e20 + e13 * m.e30;
-        t1 = e10 * m.e01 + e11 * m.e11 + e12 * m.e21 + e13 * m.e31;
-        t2 = e10 * m.e02 + e11 * m.e12 + e12 * m.e22 + e13 * m.e32;
-        e13 = e10 * m.e03 + e11 * m.e13 + e12 * m.e23 + e13 * m.e33;
-        e10 = t0;
-        e11 = t1;
-        e12 = t2;
-
-        t0 = e20 * m.e00 + e21 * m.e10 + e22 * m.e20 + e23 * m.e30;
-        t1 = e20 * m.e01 + e21 * m.e11 + e22 * m.e21 + e23 * m.e31;
-        t2 = e20 * m.e02 + e21 * m.e12 + e22 * m.e22 + e23 * m.e32;
-        e23 = e20 * m.e03 + e21 * m.e13 + e22 * m.e23 + e23 * m.e33;
-        e20 = t0;
-        e21 = t1;
-        e22 = t2;
-
-        t0 = e30 * m.e00 + e31 * m.e10 + e32 * m.e20 + e33 * m.e30;
-        t1 = e30 * m.e01 + e31 * m.e11 + e32 * m.e21 + e33 * m.e31;
-        t2 = e30 * m.e02 + e31 * m.e12 + e32 * m.e22 + e33 * m.e32;
-        e33 = e30 * m.e03 + e31 * m.e13 + e32 * m.e23 + e33 * m.e33;
-        e30 = t0;
-        e31 = t1;
-        e32 = t2;
-    }
+    // Safe even when multiplying by self, all of m is loaded before anything is written
+    MultiplySSE2(&e00, &m.e00, &e00);
     return *this;
 }
 
@@ -80,8 +98,16 @@ CMatrix4x4& CMatrix4x4::operator*=(const CMatrix4x4& m)
     Operators
 -----------------------------------------------------------------------------------------*/
 
-// Matrix-matrix multiplication
+// Matrix-matrix multiplication, using SSE
 CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2)
+{
+    CMatrix4x4 mOut;
+    MultiplySSE2(&m1.e00, &m2.e00, &mOut.e00);
+    return mOut;
+}
+
+// Matrix-matrix multiplication written out in plain C++, the reference the SIMD versions are checked against
+CMatrix4x4 MultiplyReference(const CMatrix4x4& m1, const CMatrix4x4& m2)
 {
     CMatrix4x4 mOut;
 
@@ -234,6 +260,107 @@ CMatrix4x4 InverseAffine(const CMatrix4x4& m)
 }
 
 
+// Return a perspective projection matrix (DirectX conventions, clip space z from 0 to 1) with the given field of view across
+// the screen (in radians), aspect ratio (width / height) and near / far clip distances
+CMatrix4x4 MatrixPerspectiveFOVx(float fovX, float aspectRatio, float nearClip, float farClip)
+{
+    float tanFOVx = std::tan(fovX * 0.5f);
+    float scaleX = 1.0f / tanFOVx;
+    float scaleY = aspectRatio / tanFOVx;
+    float scaleZa = farClip / (farClip - nearClip);
+    float scaleZb = -nearClip * scaleZa;
+
+    return CMatrix4x4{ scaleX,   0.0f,    0.0f,   0.0f,
+                         0.0f, scaleY,    0.0f,   0.0f,
+                         0.0f,   0.0f, scaleZa,   1.0f,
+                         0.0f,   0.0f, scaleZb,   0.0f };
+}
+
+// Return the inverse of a perspective projection matrix made by MatrixPerspectiveFOVx
+CMatrix4x4 InversePerspective(const CMatrix4x4& projection)
+{
+    // The projection takes (x, y, z, 1) to (x*e00, y*e11, z*e22 + e32, z), so going back x and y are divided by their scales,
+    // z is the clip space w, and the original w of 1 is (clip z - e22 * clip w) / e32
+    float invScaleZb = 1.0f / projection.e32;
+    return CMatrix4x4{ 1.0f / projection.e00,                  0.0f, 0.0f,                             0.0f,
+                                        0.0f, 1.0f / projection.e11, 0.0f,                             0.0f,
+                                        0.0f,                  0.0f, 0.0f,                       invScaleZb,
+                                        0.0f,                  0.0f, 1.0f, -projection.e22 * invScaleZb };
+}
+
+
+// Transform a point by the given matrix (the point is treated as having w = 1)
+CVector3 TransformPoint(const CVector3& p, const CMatrix4x4& m)
+{
+    return { p.x*m.e00 + p.y*m.e10 + p.z*m.e20 + m.e30,
+             p.x*m.e01 + p.y*m.e11 + p.z*m.e21 + m.e31,
+             p.x*m.e02 + p.y*m.e12 + p.z*m.e22 + m.e32 };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+  Batch functions
+-----------------------------------------------------------------------------------------*/
+
+// Multiply many matrices by the same matrix: out[i] = in[i] * m
+void MultiplyMatrices(const CMatrix4x4* in, const CMatrix4x4& m, CMatrix4x4* out, size_t count)
+{
+    Kernels().multiplyMatrices(&in->e00, &m.e00, &out->e00, count);
+}
+
+// Convert the matrices of a hierarchy from relative to their parent to absolute
+void ConcatenateHierarchy(const CMatrix4x4* relative, const unsigned int* parents, CMatrix4x4* absolute, size_t count)
+{
+    if (count == 0)  return;
+
+    // Each matrix needs its parent's result, so they have to be done one at a time, in order
+    absolute[0] = relative[0];
+    for (size_t i = 1; i < count; ++i)
+    {
+        MultiplySSE2(&relative[i].e00, &absolute[parents[i]].e00, &absolute[i].e00);
+    }
+}
+
+// Transform many points by the same matrix (w = 1)
+void TransformPoints(const CVector3* in, const CMatrix4x4& m, CVector3* out, size_t count)
+{
+    Kernels().transformPoints(&in->x, &m.e00, &out->x, count);
+}
+
+// Name of the instruction set the batch functions use on this CPU
+const char* MatrixKernelName()
+{
+    return Kernels().name;
+}
+
+// SSE2 batch kernels, used when the CPU has nothing wider (see MatrixKernels.h)
+void MultiplyMatricesSSE2(const float* in, const float* m, float* out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        MultiplySSE2(in + i * 16, m, out + i * 16);
+    }
+}
+
+void TransformPointsSSE2(const float* in, const float* m, float* out, size_t count)
+{
+    __m128 row0 = _mm_load_ps(m);
+    __m128 row1 = _mm_load_ps(m + 4);
+    __m128 row2 = _mm_load_ps(m + 8);
+    __m128 row3 = _mm_load_ps(m + 12);
+    for (size_t i = 0; i < count * 3; i += 3)
+    {
+        __m128 result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(in[i]), row0), _mm_mul_ps(_mm_set1_ps(in[i + 1]), row1));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(in[i + 2]), row2));
+        result = _mm_add_ps(result, row3);
+
+        // Points are only 3 floats, so write x and y together then z on its own
+        _mm_storel_pi(reinterpret_cast<__m64*>(out + i), result);
+        _mm_store_ss(out + i + 2, _mm_movehl_ps(result, result));
+    }
+}
+
+
 // Make this matrix an affine 3D transformation matrix to face from current position to given target (in the Z direction)
 // Will retain the matrix's current scaling
 void CMatrix4x4::FaceTarget(const CVector3& target)
@@ -7,9 +7,12 @@
 #define _CMATRIX4X4_H_DEFINED_
 
 #include "CVector3.h"
+#include <cstddef>
+#include <cstring>
 
 // Matrix class
-class CMatrix4x4
+// Aligned to 16 bytes so each row can be loaded straight into an SSE register
+class alignas(16) CMatrix4x4
 {
 // Concrete class - public access
 public:
@@ -32,8 +35,8 @@ public:
     // Can be used to access position or x,y,z axes from a matrix
     CVector3 GetRow(int iRow) const;
 
-    // Initialise this matrix with a pointer to 16 floats 
-    void SetValues(float* matrixValues)  { *this = *reinterpret_cast<CMatrix4x4*>(matrixValues); }
+    // Initialise this matrix with a pointer to 16 floats. The floats don't need to be aligned
+    void SetValues(const float* matrixValues)  { std::memcpy(&e00, matrixValues, 16 * sizeof(float)); }
 
  
     // Helper functions
@@ -64,9 +67,12 @@ public:
     Operators
 -----------------------------------------------------------------------------------------*/
 
-// Matrix-matrix multiplication
+// Matrix-matrix multiplication, using SSE
 CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2);
 
+// Matrix-matrix multiplication written out in plain C++, the reference the SIMD versions are checked against
+CMatrix4x4 MultiplyReference(const CMatrix4x4& m1, const CMatrix4x4& m2);
+
 
 /*-----------------------------------------------------------------------------------------
   Non-member functions
@@ -106,4 +112,38 @@ CMatrix4x4 MatrixScaling(const float s);
 CMatrix4x4 InverseAffine(const CMatrix4x4& m);
 
 
+// Return a perspective projection matrix (DirectX conventions, clip space z from 0 to 1) with the given field of view across
+// the screen (in radians), aspect ratio (width / height) and near / far clip distances
+CMatrix4x4 MatrixPerspectiveFOVx(float fovX, float aspectRatio, float nearClip, float farClip);
+
+// Return the inverse of a perspective projection matrix made by MatrixPerspectiveFOVx. Much cheaper than a general inverse
+// Used to take points from clip space back to view space, e.g. to get a picking ray from the mouse position
+CMatrix4x4 InversePerspective(const CMatrix4x4& projection);
+
+
+// Transform a point by the given matrix (the point is treated as having w = 1)
+CVector3 TransformPoint(const CVector3& p, const CMatrix4x4& m);
+
+
+/*-----------------------------------------------------------------------------------------
+  Batch functions
+-----------------------------------------------------------------------------------------*/
+
+// These work on whole arrays at a time, using the widest instruction set the CPU supports (AVX2 or SSE)
+
+// Multiply many matrices by the same matrix: out[i] = in[i] * m. The output can be the same array as the input
+void MultiplyMatrices(const CMatrix4x4* in, const CMatrix4x4& m, CMatrix4x4* out, size_t count);
+
+// Convert the matrices of a hierarchy from relative to their parent to absolute: absolute[i] = relative[i] * absolute[parents[i]]
+// The hierarchy must be stored parents first (e.g. depth-first), entry 0 is the root and is copied as it is
+// The output can be the same array as the input
+void ConcatenateHierarchy(const CMatrix4x4* relative, const unsigned int* parents, CMatrix4x4* absolute, size_t count);
+
+// Transform many points by the same matrix (w = 1). The output can be the same array as the input
+void TransformPoints(const CVector3* in, const CMatrix4x4& m, CVector3* out, size_t count);
+
+// Name of the instruction set the batch functions use on this CPU
+const char* MatrixKernelName();
+
+
 #endif // _CMATRIX4X4_H_DEFINED_
\ No newline at end of file
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// AVX2 batch kernels for CMatrix4x4, two rows or two points at a time
+//--------------------------------------------------------------------------------------
+// Compiled with AVX2 enabled and without the precompiled header, see MatrixKernels.h.
+// Only called when the CPU supports AVX2 and FMA.
+
+#include "MatrixKernels.h"
+#include <immintrin.h>
+
+void MultiplyMatricesAVX2(const float* in, const float* m, float* out, size_t count)
+{
+    // Each row of m repeated in both halves of a register
+    __m256 mRow0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+    __m256 mRow1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+    __m256 mRow2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+    __m256 mRow3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+
+    for (size_t i = 0; i < count; ++i, in += 16, out += 16)
+    {
+        // Two rows of the input in each register, the permutes spread each element across its own half
+        __m256 rows01 = _mm256_loadu_ps(in);
+        __m256 rows23 = _mm256_loadu_ps(in + 8);
+
+        __m256 result01 = _mm256_mul_ps(_mm256_permute_ps(rows01, _MM_SHUFFLE(0, 0, 0, 0)), mRow0);
+        __m256 result23 = _mm256_mul_ps(_mm256_permute_ps(rows23, _MM_SHUFFLE(0, 0, 0, 0)), mRow0);
+        result01 = _mm256_fmadd_ps(_mm256_permute_ps(rows01, _MM_SHUFFLE(1, 1, 1, 1)), mRow1, result01);
+        result23 = _mm256_fmadd_ps(_mm256_permute_ps(rows23, _MM_SHUFFLE(1, 1, 1, 1)), mRow1, result23);
+        result01 = _mm256_fmadd_ps(_mm256_permute_ps(rows01, _MM_SHUFFLE(2, 2, 2, 2)), mRow2, result01);
+        result23 = _mm256_fmadd_ps(_mm256_permute_ps(rows23, _MM_SHUFFLE(2, 2, 2, 2)), mRow2, result23);
+        result01 = _mm256_fmadd_ps(_mm256_permute_ps(rows01, _MM_SHUFFLE(3, 3, 3, 3)), mRow3, result01);
+        result23 = _mm256_fmadd_ps(_mm256_permute_ps(rows23, _MM_SHUFFLE(3, 3, 3, 3)), mRow3, result23);
+
+        _mm256_storeu_ps(out, result01);
+        _mm256_storeu_ps(out + 8, result23);
+    }
+}
+
+void TransformPointsAVX2(const float* in, const float* m, float* out, size_t count)
+{
+    __m256 mRow0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+    __m256 mRow1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+    __m256 mRow2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+    __m256 mRow3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+
+    // Points are only 3 floats, so only x, y and z of each result are written
+    const __m128i xyz = _mm_setr_epi32(-1, -1, -1, 0);
+
+    // A point in each half. Loading 4 floats per point reads the x of the next point, so stop while there is a point after the pair
+    size_t i = 0;
+    for (; i + 2 < count; i += 2)
+    {
+        __m256 points = _mm256_set_m128(_mm_loadu_ps(in + i * 3 + 3), _mm_loadu_ps(in + i * 3));
+
+        __m256 result = _mm256_fmadd_ps(_mm256_permute_ps(points, _MM_SHUFFLE(0, 0, 0, 0)), mRow0, mRow3);
+        result = _mm256_fmadd_ps(_mm256_permute_ps(points, _MM_SHUFFLE(1, 1, 1, 1)), mRow1, result);
+        result = _mm256_fmadd_ps(_mm256_permute_ps(points, _MM_SHUFFLE(2, 2, 2, 2)), mRow2, result);
+
+        _mm_maskstore_ps(out + i * 3, xyz, _mm256_castps256_ps128(result));
+        _mm_maskstore_ps(out + i * 3 + 3, xyz, _mm256_extractf128_ps(result, 1));
+    }
+
+    // The last one or two points, one at a time without reading past the end
+    for (; i < count; ++i)
+    {
+        __m128 result = _mm_fmadd_ps(_mm_set1_ps(in[i * 3]), _mm256_castps256_ps128(mRow0), _mm256_castps256_ps128(mRow3));
+        result = _mm_fmadd_ps(_mm_set1_ps(in[i * 3 + 1]), _mm256_castps256_ps128(mRow1), result);
+        result = _mm_fmadd_ps(_mm_set1_ps(in[i * 3 + 2]), _mm256_castps256_ps128(mRow2), result);
+        _mm_maskstore_ps(out + i * 3, xyz, result);
+    }
+}
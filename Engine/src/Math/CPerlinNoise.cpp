@@ -1,4 +1,122 @@
 #include "CPerlinNoise.h"
+#include "HeightField.h"
+#include "PerlinNoiseKernels.h"
+#include "Utility/CpuFeatures.h"
+#include "Utility/ThreadPool.h"
+
+namespace
+{
+	//Aim for at least this many points in each chunk of work handed to the thread pool
+	const int kPointsPerChunk = 16384;
+
+	using PerlinRowKernel = void (*)(const PerlinRowArgs&);
+
+	//The kernels for the SIMD level in use, see GetSimdLevel
+	struct PerlinKernels
+	{
+		const char*     name;
+		PerlinRowKernel row;
+		PerlinRowKernel rowDerivatives;
+	};
+
+	PerlinKernels SelectKernels()
+	{
+		switch (GetSimdLevel())
+		{
+		case SimdLevel::AVX512: return { "AVX-512", PerlinRowAVX512, PerlinRowDerivativesAVX512 };
+		case SimdLevel::AVX2:   return { "AVX2",    PerlinRowAVX2,   PerlinRowDerivativesAVX2 };
+		default:                return { "SSE2",    PerlinRowSSE2,   PerlinRowDerivativesSSE2 };
+		}
+	}
+
+	const PerlinKernels& Kernels()
+	{
+		static const PerlinKernels kernels = SelectKernels();
+		return kernels;
+	}
+
+	//Everything about the columns of a row that stays the same from row to row
+	struct PerlinColumns
+	{
+		std::vector<int>   hashX0;
+		std::vector<int>   hashX1;
+		std::vector<float> fractionX;
+		std::vector<float> fadeX;
+		std::vector<float> fadeSlopeX;
+	};
+
+	//Split a coordinate into its unit cube and the position within that cube, the same way noise() does
+	void SplitCoordinate(double position, int* unit, double* fraction)
+	{
+		double whole = floor(position);
+		*unit = static_cast<int>(whole) & 255;
+		*fraction = position - whole;
+	}
+
+	//Same fade curve as CPerlinNoise::fade
+	double Fade(double t)
+	{
+		return t * t * t * (t * (t * 6 - 15) + 10);
+	}
+
+	//Same as CPerlinNoise::fadeSlope
+	double FadeSlope(double t)
+	{
+		return 30 * t * t * (t - 1) * (t - 1);
+	}
+
+	void BuildColumns(PerlinColumns& columns, const std::vector<int>& permutation, int count, double x, double xStep)
+	{
+		//Padding columns repeat the last column so the kernels can read whole blocks
+		int paddedCount = (count + kPerlinColumnPadding - 1) / kPerlinColumnPadding * kPerlinColumnPadding;
+		columns.hashX0.resize(paddedCount);
+		columns.hashX1.resize(paddedCount);
+		columns.fractionX.resize(paddedCount);
+		columns.fadeX.resize(paddedCount);
+		columns.fadeSlopeX.resize(paddedCount);
+
+		for (int i = 0; i < paddedCount; ++i)
+		{
+			int unit;
+			double fraction;
+			SplitCoordinate(x + std::min(i, count - 1) * xStep, &unit, &fraction);
+			columns.hashX0[i] = permutation[unit];
+			columns.hashX1[i] = permutation[unit + 1];
+			columns.fractionX[i] = static_cast<float>(fraction);
+			columns.fadeX[i] = static_cast<float>(Fade(fraction));
+			columns.fadeSlopeX[i] = static_cast<float>(FadeSlope(fraction));
+		}
+	}
+
+	//Fill in the arguments for one row of points using the columns worked out beforehand
+	PerlinRowArgs RowArgs(const PerlinColumns& columns, const std::vector<int>& permutation, const std::vector<int>& gradients,
+	                      int count, double y, double z)
+	{
+		PerlinRowArgs args;
+		args.permutation = permutation.data();
+		args.gradients = gradients.data();
+		args.hashX0 = columns.hashX0.data();
+		args.hashX1 = columns.hashX1.data();
+		args.fractionX = columns.fractionX.data();
+		args.fadeX = columns.fadeX.data();
+		args.fadeSlopeX = columns.fadeSlopeX.data();
+
+		double fraction;
+		SplitCoordinate(y, &args.unitY, &fraction);
+		args.fractionY = static_cast<float>(fraction);
+		args.fadeY = static_cast<float>(Fade(fraction));
+		args.fadeSlopeY = static_cast<float>(FadeSlope(fraction));
+		SplitCoordinate(z, &args.unitZ, &fraction);
+		args.fractionZ = static_cast<float>(fraction);
+		args.fadeZ = static_cast<float>(Fade(fraction));
+
+		args.out = nullptr;
+		args.outDX = nullptr;
+		args.outDY = nullptr;
+		args.count = count;
+		return args;
+	}
+}
 
 CPerlinNoise::CPerlinNoise(unsigned int seed)
 {
@@ -16,9 +134,19 @@ CPerlinNoise::CPerlinNoise(unsigned int seed)
 
 	// Duplicate the permutation vector
 	permutationList.insert(permutationList.end(), permutationList.begin(), permutationList.end());
+
+	// grad() is linear in x, y and z, so passing in each axis gives the components of the gradient it uses
+	gradientList.resize(permutationList.size());
+	for (size_t i = 0; i < permutationList.size(); ++i)
+	{
+		int gradientX = static_cast<int>(grad(permutationList[i], 1, 0, 0));
+		int gradientY = static_cast<int>(grad(permutationList[i], 0, 1, 0));
+		int gradientZ = static_cast<int>(grad(permutationList[i], 0, 0, 1));
+		gradientList[i] = (gradientX & 3) | ((gradientY & 3) << 2) | ((gradientZ & 3) << 4);
+	}
 }
 
-double CPerlinNoise::noise(double x, double y, double z)
+double CPerlinNoise::noise(double x, double y, double z) const
 {
 	// Find the unit cube that contains the point
 	int X = (int)floor(x) & 255;
@@ -48,17 +176,159 @@ double CPerlinNoise::noise(double x, double y, double z)
 	return (res + 1.0) / 2.0;
 }
 
-double CPerlinNoise::fade(double t)
+//The Noise function that also gives the partial derivatives of the noise value along x, y and z
+double CPerlinNoise::noise(double x, double y, double z, double& dx, double& dy, double& dz) const
+{
+	// Same unit cube, position and hashes as noise()
+	int X = (int)floor(x) & 255;
+	int Y = (int)floor(y) & 255;
+	int Z = (int)floor(z) & 255;
+
+	x -= floor(x);
+	y -= floor(y);
+	z -= floor(z);
+
+	double u = fade(x);
+	double v = fade(y);
+	double w = fade(z);
+
+	int A = permutationList[X] + Y;
+	int AA = permutationList[A] + Z;
+	int AB = permutationList[A + 1] + Z;
+	int B = permutationList[X + 1] + Y;
+	int BA = permutationList[B] + Z;
+	int BB = permutationList[B + 1] + Z;
+
+	// Hash of each corner, then the gradient dotted with the offset to that corner
+	int h000 = permutationList[AA], h100 = permutationList[BA], h010 = permutationList[AB], h110 = permutationList[BB];
+	int h001 = permutationList[AA + 1], h101 = permutationList[BA + 1], h011 = permutationList[AB + 1], h111 = permutationList[BB + 1];
+
+	double n000 = grad(h000, x, y, z),         n100 = grad(h100, x - 1, y, z);
+	double n010 = grad(h010, x, y - 1, z),     n110 = grad(h110, x - 1, y - 1, z);
+	double n001 = grad(h001, x, y, z - 1),     n101 = grad(h101, x - 1, y, z - 1);
+	double n011 = grad(h011, x, y - 1, z - 1), n111 = grad(h111, x - 1, y - 1, z - 1);
+
+	// Blend a value from the 8 corners, in the same order as noise()
+	auto trilinear = [u, v, w](double c000, double c100, double c010, double c110, double c001, double c101, double c011, double c111)
+	{
+		double x00 = LERP(u, c000, c100), x10 = LERP(u, c010, c110);
+		double x01 = LERP(u, c001, c101), x11 = LERP(u, c011, c111);
+		double y0 = LERP(v, x00, x10), y1 = LERP(v, x01, x11);
+		return LERP(w, y0, y1);
+	};
+
+	// grad() is linear, so each component of a corner's gradient is grad() along that axis
+	auto blendAxis = [&](double axisX, double axisY, double axisZ)
+	{
+		return trilinear(grad(h000, axisX, axisY, axisZ), grad(h100, axisX, axisY, axisZ), grad(h010, axisX, axisY, axisZ), grad(h110, axisX, axisY, axisZ),
+		                 grad(h001, axisX, axisY, axisZ), grad(h101, axisX, axisY, axisZ), grad(h011, axisX, axisY, axisZ), grad(h111, axisX, axisY, axisZ));
+	};
+
+	// Each derivative is the blended gradient component, plus the slope of the fade curve times the change in value across the cube
+	double changeX0 = LERP(v, (n100 - n000), (n110 - n010)), changeX1 = LERP(v, (n101 - n001), (n111 - n011));
+	double changeY0 = LERP(u, (n010 - n000), (n110 - n100)), changeY1 = LERP(u, (n011 - n001), (n111 - n101));
+	double changeZ0 = LERP(u, (n001 - n000), (n101 - n100)), changeZ1 = LERP(u, (n011 - n010), (n111 - n110));
+
+	dx = (blendAxis(1, 0, 0) + fadeSlope(x) * LERP(w, changeX0, changeX1)) / 2.0;
+	dy = (blendAxis(0, 1, 0) + fadeSlope(y) * LERP(w, changeY0, changeY1)) / 2.0;
+	dz = (blendAxis(0, 0, 1) + fadeSlope(z) * LERP(v, changeZ0, changeZ1)) / 2.0;
+
+	double res = trilinear(n000, n100, n010, n110, n001, n101, n011, n111);
+	return (res + 1.0) / 2.0;
+}
+
+//Fill count values of a row of points: out[i] = noise(x + i * xStep, y, z)
+void CPerlinNoise::GenerateRow(float* out, int count, double x, double xStep, double y, double z) const
+{
+	if (count <= 0)  return;
+
+	PerlinColumns columns;
+	BuildColumns(columns, permutationList, count, x, xStep);
+
+	PerlinRowArgs args = RowArgs(columns, permutationList, gradientList, count, y, z);
+	args.out = out;
+	Kernels().row(args);
+}
+
+//Fill a grid of points: out[row * stride + column] = noise(x + column * xStep, y + row * yStep, z)
+void CPerlinNoise::GenerateGrid(float* out, int width, int height, int stride, double x, double y, double xStep, double yStep, double z,
+                                ThreadPool* threadPool /*= nullptr*/) const
+{
+	if (width <= 0 || height <= 0)  return;
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	//The columns are the same for every row, so only work them out once
+	PerlinColumns columns;
+	BuildColumns(columns, permutationList, width, x, xStep);
+
+	int grainSize = std::max(kPointsPerChunk / width, 1);
+	threadPool->ParallelFor(0, height, grainSize, [&](int first, int last)
+	{
+		for (int row = first; row < last; ++row)
+		{
+			PerlinRowArgs args = RowArgs(columns, permutationList, gradientList, width, y + row * yStep, z);
+			args.out = out + static_cast<size_t>(row) * stride;
+			Kernels().row(args);
+		}
+	});
+}
+
+//As GenerateGrid, also filling outDX and outDY (laid out like out) with the partial derivatives along noise x and y
+void CPerlinNoise::GenerateGridDerivatives(float* out, float* outDX, float* outDY, int width, int height, int stride,
+                                           double x, double y, double xStep, double yStep, double z, ThreadPool* threadPool /*= nullptr*/) const
+{
+	if (width <= 0 || height <= 0)  return;
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	PerlinColumns columns;
+	BuildColumns(columns, permutationList, width, x, xStep);
+
+	int grainSize = std::max(kPointsPerChunk / width, 1);
+	threadPool->ParallelFor(0, height, grainSize, [&](int first, int last)
+	{
+		for (int row = first; row < last; ++row)
+		{
+			size_t rowStart = static_cast<size_t>(row) * stride;
+			PerlinRowArgs args = RowArgs(columns, permutationList, gradientList, width, y + row * yStep, z);
+			args.out = out + rowStart;
+			args.outDX = outDX + rowStart;
+			args.outDY = outDY + rowStart;
+			Kernels().rowDerivatives(args);
+		}
+	});
+}
+
+//Fill every point of the HeightField, with columns along the noise x axis and rows along the noise y axis
+void CPerlinNoise::GenerateGrid(HeightField& heightMap, double x, double y, double xStep, double yStep, double z,
+                                ThreadPool* threadPool /*= nullptr*/) const
+{
+	GenerateGrid(heightMap.Data(), heightMap.Width(), heightMap.Height(), heightMap.Stride(), x, y, xStep, yStep, z, threadPool);
+}
+
+//Name of the instruction set used by the batch functions on this CPU
+const char* CPerlinNoise::BatchInstructionSet()
+{
+	return Kernels().name;
+}
+
+double CPerlinNoise::fade(double t) const
 {
 	return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
+//Slope of the fade curve
+double CPerlinNoise::fadeSlope(double t) const
+{
+	return 30 * t * t * (t - 1) * (t - 1);
+}
+
 //Create a gradient with the position
-double CPerlinNoise::grad(int hash, double x, double y, double z)
+double CPerlinNoise::grad(int hash, double x, double y, double z) const
 {
 	int h = hash & 15;
 	// Convert lower 4 bits of hash into 12 gradient directions
 	double u = h < 8 ? x : y,
 		v = h < 4 ? y : h == 12 || h == 14 ? x : z;
 	return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
-}
\ No newline at end of file
+}
+
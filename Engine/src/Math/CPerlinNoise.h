@@ -4,6 +4,9 @@
 #pragma once
 #include "epch.h"
 
+class HeightField;
+class ThreadPool;
+
 //Linear Interpolate between two points with reference to time
 #define LERP(t, a, b) (a + t * (b-a)) 
 
@@ -14,8 +17,15 @@ class CPerlinNoise
 {
 	//The permutation List that will be used to get the noise values
 	std::vector<int> permutationList;
+
+	//The gradient picked by grad() for each entry of the permutation List, packed as three signed 2-bit values (x, y, z)
+	std::vector<int> gradientList;
 public:
 
+	//Largest difference allowed between the batch functions and noise() at the same point.
+	//The batch functions work in float rather than double, so results are not bit-identical.
+	static constexpr float kBatchTolerance = 1e-6f;
+
 	//Constructor with a Seed 
 	CPerlinNoise(unsigned int seed);
 
@@ -23,12 +33,39 @@ public:
 	~CPerlinNoise() {}
 
 	//The Noise function to generate a value at the selected position
-	double noise(double x, double y, double z);
+	//This is the reference implementation the batch functions below are checked against
+	double noise(double x, double y, double z) const;
+
+	//The Noise function that also gives the partial derivatives of the noise value along x, y and z
+	double noise(double x, double y, double z, double& dx, double& dy, double& dz) const;
+
+	//Fill count values of a row of points: out[i] = noise(x + i * xStep, y, z)
+	void GenerateRow(float* out, int count, double x, double xStep, double y, double z) const;
+
+	//Fill a grid of points: out[row * stride + column] = noise(x + column * xStep, y + row * yStep, z)
+	//Rows are split across the given thread pool (the shared pool by default) and each row is
+	//evaluated 16, 8 or 4 points at a time depending on the instruction sets the CPU supports
+	void GenerateGrid(float* out, int width, int height, int stride, double x, double y, double xStep, double yStep, double z,
+	                  ThreadPool* threadPool = nullptr) const;
+
+	//As GenerateGrid, also filling outDX and outDY (laid out like out) with the partial derivatives along noise x and y
+	void GenerateGridDerivatives(float* out, float* outDX, float* outDY, int width, int height, int stride,
+	                             double x, double y, double xStep, double yStep, double z, ThreadPool* threadPool = nullptr) const;
+
+	//Fill every point of the HeightField, with columns along the noise x axis and rows along the noise y axis
+	void GenerateGrid(HeightField& heightMap, double x, double y, double xStep, double yStep, double z,
+	                  ThreadPool* threadPool = nullptr) const;
+
+	//Name of the instruction set used by the batch functions on this CPU
+	static const char* BatchInstructionSet();
 
 private:
 
-	double fade(double t);
+	double fade(double t) const;
+
+	//Slope of the fade curve
+	double fadeSlope(double t) const;
 
 	//Create a gradient with the position
-	double grad(int hash, double x, double y, double z);
+	double grad(int hash, double x, double y, double z) const;
 };
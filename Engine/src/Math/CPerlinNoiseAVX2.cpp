@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// AVX2 row kernels for CPerlinNoise, 8 points at a time
+//--------------------------------------------------------------------------------------
+// Compiled with AVX2 enabled and without the precompiled header, see PerlinNoiseKernels.h.
+// Only called when the CPU supports AVX2 and FMA.
+
+#include <immintrin.h>
+
+namespace
+{
+	struct SimdAVX2
+	{
+		using Float = __m256;
+		using Int = __m256i;
+		static const int kWidth = 8;
+
+		static Float LoadFloat(const float* p)         { return _mm256_loadu_ps(p); }
+		static Int   LoadInt(const int* p)             { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static Float SetFloat(float f)                 { return _mm256_set1_ps(f); }
+		static Int   SetInt(int i)                     { return _mm256_set1_epi32(i); }
+		static Float Add(Float a, Float b)             { return _mm256_add_ps(a, b); }
+		static Float Sub(Float a, Float b)             { return _mm256_sub_ps(a, b); }
+		static Float Mul(Float a, Float b)             { return _mm256_mul_ps(a, b); }
+		static Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+		static Int   AddInt(Int a, Int b)              { return _mm256_add_epi32(a, b); }
+		static Int   Gather(const int* table, Int index) { return _mm256_i32gather_epi32(table, index, 4); }
+
+		template <int kShift>
+		static Float Field(Int packed) { return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(packed, 30 - kShift), 30)); }
+
+		//Only write the points that are left at the end of the row
+		static void Store(float* out, Float value, int count)
+		{
+			if (count >= kWidth)
+			{
+				_mm256_storeu_ps(out, value);
+				return;
+			}
+			__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			_mm256_maskstore_ps(out, mask, value);
+		}
+	};
+}
+
+#include "PerlinNoiseKernels.inl"
+
+void PerlinRowAVX2(const PerlinRowArgs& args)            { PerlinRow<SimdAVX2>(args); }
+void PerlinRowDerivativesAVX2(const PerlinRowArgs& args) { PerlinRowDerivatives<SimdAVX2>(args); }
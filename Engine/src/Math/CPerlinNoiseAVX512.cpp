@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// AVX-512 row kernels for CPerlinNoise, 16 points at a time
+//--------------------------------------------------------------------------------------
+// Compiled with AVX-512 enabled and without the precompiled header, see PerlinNoiseKernels.h.
+// Only called when the CPU supports AVX-512F.
+
+#include <immintrin.h>
+
+namespace
+{
+	struct SimdAVX512
+	{
+		using Float = __m512;
+		using Int = __m512i;
+		static const int kWidth = 16;
+
+		static Float LoadFloat(const float* p)         { return _mm512_loadu_ps(p); }
+		static Int   LoadInt(const int* p)             { return _mm512_loadu_si512(p); }
+		static Float SetFloat(float f)                 { return _mm512_set1_ps(f); }
+		static Int   SetInt(int i)                     { return _mm512_set1_epi32(i); }
+		static Float Add(Float a, Float b)             { return _mm512_add_ps(a, b); }
+		static Float Sub(Float a, Float b)             { return _mm512_sub_ps(a, b); }
+		static Float Mul(Float a, Float b)             { return _mm512_mul_ps(a, b); }
+		static Float MulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+		static Int   AddInt(Int a, Int b)              { return _mm512_add_epi32(a, b); }
+		static Int   Gather(const int* table, Int index) { return _mm512_i32gather_epi32(index, table, 4); }
+
+		template <int kShift>
+		static Float Field(Int packed) { return _mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(packed, 30 - kShift), 30)); }
+
+		//Only write the points that are left at the end of the row
+		static void Store(float* out, Float value, int count)
+		{
+			if (count >= kWidth)
+			{
+				_mm512_storeu_ps(out, value);
+				return;
+			}
+			_mm512_mask_storeu_ps(out, static_cast<__mmask16>((1u << count) - 1), value);
+		}
+	};
+}
+
+#include "PerlinNoiseKernels.inl"
+
+void PerlinRowAVX512(const PerlinRowArgs& args)            { PerlinRow<SimdAVX512>(args); }
+void PerlinRowDerivativesAVX512(const PerlinRowArgs& args) { PerlinRowDerivatives<SimdAVX512>(args); }
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// SSE2 row kernels for CPerlinNoise, 4 points at a time
+//--------------------------------------------------------------------------------------
+// SSE2 is always available on x64, so these are built with the same settings as the rest
+// of the engine and used whenever the CPU has nothing wider.
+
+#include "epch.h"
+#include <emmintrin.h>
+
+namespace
+{
+	struct SimdSSE2
+	{
+		using Float = __m128;
+		using Int = __m128i;
+		static const int kWidth = 4;
+
+		static Float LoadFloat(const float* p)         { return _mm_loadu_ps(p); }
+		static Int   LoadInt(const int* p)             { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static Float SetFloat(float f)                 { return _mm_set1_ps(f); }
+		static Int   SetInt(int i)                     { return _mm_set1_epi32(i); }
+		static Float Add(Float a, Float b)             { return _mm_add_ps(a, b); }
+		static Float Sub(Float a, Float b)             { return _mm_sub_ps(a, b); }
+		static Float Mul(Float a, Float b)             { return _mm_mul_ps(a, b); }
+		static Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static Int   AddInt(Int a, Int b)              { return _mm_add_epi32(a, b); }
+
+		//SSE2 has no gather instruction, so load each lane on its own
+		static Int Gather(const int* table, Int index)
+		{
+			alignas(16) int lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+			return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+		}
+
+		template <int kShift>
+		static Float Field(Int packed) { return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 30 - kShift), 30)); }
+
+		//Only write the points that are left at the end of the row
+		static void Store(float* out, Float value, int count)
+		{
+			if (count >= kWidth)
+			{
+				_mm_storeu_ps(out, value);
+				return;
+			}
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, value);
+			for (int i = 0; i < count; ++i)  out[i] = lanes[i];
+		}
+	};
+}
+
+#include "PerlinNoiseKernels.inl"
+
+void PerlinRowSSE2(const PerlinRowArgs& args)            { PerlinRow<SimdSSE2>(args); }
+void PerlinRowDerivativesSSE2(const PerlinRowArgs& args) { PerlinRowDerivatives<SimdSSE2>(args); }
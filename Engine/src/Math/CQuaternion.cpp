@@ -0,0 +1,180 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class (cut down version) to hold rotations for 3D
+//--------------------------------------------------------------------------------------
+
+#include "epch.h"
+#include "CQuaternion.h"
+
+
+/*-----------------------------------------------------------------------------------------
+    Operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two rotations, rotate by q1 then by q2 (same order as matrix multiplication)
+// That is the quaternion product q2q1, as quaternions rotate right to left
+CQuaternion operator*(const CQuaternion& q1, const CQuaternion& q2)
+{
+    return { q2.w*q1.x + q2.x*q1.w + q2.y*q1.z - q2.z*q1.y,
+             q2.w*q1.y - q2.x*q1.z + q2.y*q1.w + q2.z*q1.x,
+             q2.w*q1.z + q2.x*q1.y - q2.y*q1.x + q2.z*q1.w,
+             q2.w*q1.w - q2.x*q1.x - q2.y*q1.y - q2.z*q1.z };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Rotation of the given angle (in radians) around the given axis, which must be unit length
+CQuaternion QuaternionFromAxisAngle(const CVector3& axis, float angle)
+{
+    float s = std::sin(angle * 0.5f);
+    return { axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) };
+}
+
+// Rotation from Euler angles (in radians), same order as the matrices: Z first, then X, then Y
+CQuaternion QuaternionFromEulerAngles(const CVector3& angles)
+{
+    return QuaternionFromAxisAngle({ 0, 0, 1 }, angles.z) *
+           QuaternionFromAxisAngle({ 1, 0, 0 }, angles.x) *
+           QuaternionFromAxisAngle({ 0, 1, 0 }, angles.y);
+}
+
+// Rotation held in the top-left 3x3 of a matrix. The rows must be unit length (no scaling)
+// Works from the largest of w, x, y and z to keep precision (Shepperd's method)
+CQuaternion QuaternionFromMatrix(const CMatrix4x4& m)
+{
+    float trace = m.e00 + m.e11 + m.e22;
+    if (trace > 0.0f)
+    {
+        float s = 0.5f / std::sqrt(trace + 1.0f);
+        return { (m.e12 - m.e21) * s, (m.e20 - m.e02) * s, (m.e01 - m.e10) * s, 0.25f / s };
+    }
+    else if (m.e00 > m.e11 && m.e00 > m.e22)
+    {
+        float s = 2.0f * std::sqrt(1.0f + m.e00 - m.e11 - m.e22);
+        return { 0.25f * s, (m.e01 + m.e10) / s, (m.e20 + m.e02) / s, (m.e12 - m.e21) / s };
+    }
+    else if (m.e11 > m.e22)
+    {
+        float s = 2.0f * std::sqrt(1.0f + m.e11 - m.e00 - m.e22);
+        return { (m.e01 + m.e10) / s, 0.25f * s, (m.e12 + m.e21) / s, (m.e20 - m.e02) / s };
+    }
+    else
+    {
+        float s = 2.0f * std::sqrt(1.0f + m.e22 - m.e00 - m.e11);
+        return { (m.e20 + m.e02) / s, (m.e12 + m.e21) / s, 0.25f * s, (m.e01 - m.e10) / s };
+    }
+}
+
+// Rotation matrix of a unit quaternion
+CMatrix4x4 MatrixFromQuaternion(const CQuaternion& q)
+{
+    return MatrixFromTransform({ 0, 0, 0 }, q, { 1, 1, 1 });
+}
+
+// Euler angles (in radians) of a unit quaternion, the angles QuaternionFromEulerAngles would need to make it
+CVector3 EulerAngles(const CQuaternion& q)
+{
+    return MatrixFromQuaternion(q).GetEulerAngles();
+}
+
+// Dot product of two quaternions, the cosine of half the angle between two unit quaternions
+float Dot(const CQuaternion& q1, const CQuaternion& q2)
+{
+    return q1.x*q2.x + q1.y*q2.y + q1.z*q2.z + q1.w*q2.w;
+}
+
+// Return unit length quaternion. A zero length quaternion becomes the identity
+CQuaternion Normalise(const CQuaternion& q)
+{
+    float lengthSq = Dot(q, q);
+    if (IsZero(lengthSq))  return QuaternionIdentity();
+
+    float invLength = InvSqrt(lengthSq);
+    return { q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength };
+}
+
+// Rotate a vector by a unit quaternion
+CVector3 Rotate(const CVector3& v, const CQuaternion& q)
+{
+    // v + 2w(u x v) + 2u x (u x v), where u is the vector part of q
+    CVector3 u = { q.x, q.y, q.z };
+    CVector3 t = Cross(u, v) * 2.0f;
+    return v + t * q.w + Cross(u, t);
+}
+
+
+// Spherical linear interpolation - constant speed, use for animation
+CQuaternion Slerp(const CQuaternion& q1, const CQuaternion& q2, float t)
+{
+    // q and -q are the same rotation, pick the one nearer q1 to go the short way round
+    float cosAngle = Dot(q1, q2);
+    float sign = 1.0f;
+    if (cosAngle < 0.0f)
+    {
+        cosAngle = -cosAngle;
+        sign = -1.0f;
+    }
+
+    // Nearly the same rotation, sin(angle) is too small to divide by but a straight line is just as good
+    if (cosAngle > 0.9995f)  return Nlerp(q1, q2, t);
+
+    float angle = std::acos(cosAngle);
+    float invSin = 1.0f / std::sin(angle);
+    float w1 = std::sin((1.0f - t) * angle) * invSin;
+    float w2 = std::sin(t * angle) * invSin * sign;
+    return { q1.x*w1 + q2.x*w2, q1.y*w1 + q2.y*w2, q1.z*w1 + q2.z*w2, q1.w*w1 + q2.w*w2 };
+}
+
+// Normalised linear interpolation - cheaper, speeds up slightly towards the middle
+CQuaternion Nlerp(const CQuaternion& q1, const CQuaternion& q2, float t)
+{
+    float w1 = 1.0f - t;
+    float w2 = Dot(q1, q2) < 0.0f ? -t : t;
+    return Normalise({ q1.x*w1 + q2.x*w2, q1.y*w1 + q2.y*w2, q1.z*w1 + q2.z*w2, q1.w*w1 + q2.w*w2 });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Transforms - position, rotation and scale
+-----------------------------------------------------------------------------------------*/
+
+// World matrix that scales, then rotates, then translates
+CMatrix4x4 MatrixFromTransform(const CVector3& position, const CQuaternion& q, const CVector3& scale)
+{
+    float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+    float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+    float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+
+    return CMatrix4x4{ (1 - 2*(yy + zz)) * scale.x,       2*(xy + wz)  * scale.x,       2*(xz - wy)  * scale.x,  0,
+                             2*(xy - wz)  * scale.y, (1 - 2*(xx + zz)) * scale.y,       2*(yz + wx)  * scale.y,  0,
+                             2*(xz + wy)  * scale.z,       2*(yz - wx)  * scale.z, (1 - 2*(xx + yy)) * scale.z,  0,
+                                         position.x,                   position.y,                   position.z,  1 };
+}
+
+// Split an affine matrix (no shearing) into position, rotation and scale. A mirroring matrix gets a negative x scale
+void DecomposeTransform(const CMatrix4x4& m, CVector3& position, CQuaternion& rotation, CVector3& scale)
+{
+    position = m.GetRow(3);
+
+    CVector3 xAxis = m.GetRow(0);
+    CVector3 yAxis = m.GetRow(1);
+    CVector3 zAxis = m.GetRow(2);
+    scale = { Length(xAxis), Length(yAxis), Length(zAxis) };
+    if (IsZero(scale.x) || IsZero(scale.y) || IsZero(scale.z))
+    {
+        // Flattened, there's no rotation to find
+        rotation = QuaternionIdentity();
+        return;
+    }
+
+    // A rotation keeps x cross y pointing along z, if it points the other way the matrix mirrors
+    if (Dot(Cross(xAxis, yAxis), zAxis) < 0.0f)  scale.x = -scale.x;
+
+    CMatrix4x4 rotationMatrix = MatrixIdentity();
+    rotationMatrix.SetRow(0, xAxis * (1.0f / scale.x));
+    rotationMatrix.SetRow(1, yAxis * (1.0f / scale.y));
+    rotationMatrix.SetRow(2, zAxis * (1.0f / scale.z));
+    rotation = Normalise(QuaternionFromMatrix(rotationMatrix));
+}
@@ -0,0 +1,103 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class (cut down version) to hold rotations for 3D
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+// Quaternions follow the same conventions as CMatrix4x4: they rotate the same way as the
+// matching rotation matrices, and q1 * q2 means rotate by q1 then by q2, just as m1 * m2 does.
+
+#ifndef _CQUATERNION_H_DEFINED_
+#define _CQUATERNION_H_DEFINED_
+
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+
+// Quaternion class
+class CQuaternion
+{
+// Concrete class - public access
+public:
+    // Quaternion components, (x, y, z) is the axis of rotation scaled by sin(angle / 2), w is cos(angle / 2)
+    float x;
+    float y;
+    float z;
+    float w;
+
+    /*-----------------------------------------------------------------------------------------
+        Constructors
+    -----------------------------------------------------------------------------------------*/
+
+    // Default constructor - leaves values uninitialised (for performance)
+    CQuaternion() {}
+
+    // Construct with 4 values
+    CQuaternion(const float xIn, const float yIn, const float zIn, const float wIn)
+        : x(xIn), y(yIn), z(zIn), w(wIn) {}
+};
+
+
+/*-----------------------------------------------------------------------------------------
+    Operators
+-----------------------------------------------------------------------------------------*/
+
+// Combine two rotations, rotate by q1 then by q2 (same order as matrix multiplication)
+CQuaternion operator*(const CQuaternion& q1, const CQuaternion& q2);
+
+
+/*-----------------------------------------------------------------------------------------
+    Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Quaternion that doesn't rotate
+inline CQuaternion QuaternionIdentity()  { return { 0, 0, 0, 1 }; }
+
+// Rotation of the given angle (in radians) around the given axis, which must be unit length
+CQuaternion QuaternionFromAxisAngle(const CVector3& axis, float angle);
+
+// Rotation from Euler angles (in radians), same order as the matrices: Z first, then X, then Y
+CQuaternion QuaternionFromEulerAngles(const CVector3& angles);
+
+// Rotation held in the top-left 3x3 of a matrix. The rows must be unit length (no scaling)
+CQuaternion QuaternionFromMatrix(const CMatrix4x4& m);
+
+// Rotation matrix of a unit quaternion
+CMatrix4x4 MatrixFromQuaternion(const CQuaternion& q);
+
+// Euler angles (in radians) of a unit quaternion, the angles QuaternionFromEulerAngles would need to make it
+CVector3 EulerAngles(const CQuaternion& q);
+
+// Dot product of two quaternions, the cosine of half the angle between two unit quaternions
+float Dot(const CQuaternion& q1, const CQuaternion& q2);
+
+// Return unit length quaternion. A zero length quaternion becomes the identity
+CQuaternion Normalise(const CQuaternion& q);
+
+// Opposite rotation of a unit quaternion
+inline CQuaternion Inverse(const CQuaternion& q)  { return { -q.x, -q.y, -q.z, q.w }; }
+
+// Rotate a vector by a unit quaternion
+CVector3 Rotate(const CVector3& v, const CQuaternion& q);
+
+
+// Interpolation between two unit quaternions, t from 0 to 1. Both take the shortest way round
+
+// Spherical linear interpolation - constant speed, use for animation
+CQuaternion Slerp(const CQuaternion& q1, const CQuaternion& q2, float t);
+
+// Normalised linear interpolation - cheaper, speeds up slightly towards the middle. Good enough for small steps
+// (e.g. blending between nearby animation keys)
+CQuaternion Nlerp(const CQuaternion& q1, const CQuaternion& q2, float t);
+
+
+/*-----------------------------------------------------------------------------------------
+    Transforms - position, rotation and scale
+-----------------------------------------------------------------------------------------*/
+
+// World matrix that scales, then rotates, then translates. Same as MatrixScaling(scale) * MatrixFromQuaternion(rotation) *
+// MatrixTranslation(position) but without the matrix multiplications
+CMatrix4x4 MatrixFromTransform(const CVector3& position, const CQuaternion& rotation, const CVector3& scale);
+
+// Split an affine matrix (no shearing) into position, rotation and scale. A mirroring matrix gets a negative x scale
+void DecomposeTransform(const CMatrix4x4& m, CVector3& position, CQuaternion& rotation, CVector3& scale);
+
+
+#endif // _CQUATERNION_H_DEFINED_
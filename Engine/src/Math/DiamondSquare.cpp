@@ -1,67 +1,96 @@
 #include "DiamondSquare.h"
-#include <stdlib.h>
+#include "MathHelpers.h"
+#include "Utility/ThreadPool.h"
 #include <time.h>
 
+namespace
+{
+	//Aim for at least this many cells in each chunk of work handed to the thread pool
+	const int kCellsPerChunk = 16384;
+
+	//Level used for the random values of the four corners, every other level is the side length of that pass
+	const uint32_t kCornerLevel = 0;
+}
+
 //Constructor to initialise the data
-DiamondSquare::DiamondSquare(int size, float spread, float spreadReduction)
+DiamondSquare::DiamondSquare(int size, float spread, float spreadReduction, uint32_t seed /*= 0*/)
 {
 	m_Size = size + 1;
 	m_Spread = spread;
 	m_SpreadReduction = spreadReduction;
+	m_Seed = seed;
 }
 
-//Deconstructor 
+//Deconstructor
 DiamondSquare::~DiamondSquare()
 {
 }
 
-//Function to reset the time to generate a new seed for the random function
+//Function to pick a new seed from the current time, so the next HeightMap generated is different
 void DiamondSquare::timeReset()
 {
-	srand(time(0));
+	m_Seed = static_cast<uint32_t>(time(0));
 }
 
 //Function to go through the Diamond Square Algorithm and generate the new HeightMap
-void DiamondSquare::process(std::vector<std::vector<float>>& HeightMap)
+void DiamondSquare::process(HeightField& HeightMap, ThreadPool* threadPool /*= nullptr*/)
 {
-	//Reset the Seed of the random generator
-	timeReset();
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	//Make sure the HeightMap is the size this generator was created for
+	if (HeightMap.Width() != m_Size || HeightMap.Height() != m_Size)
+	{
+		HeightMap.Resize(m_Size, m_Size);
+	}
 
 	//Set the corners of the HeightMap
 	_on_start(HeightMap);
 
+	//Spread is reduced every pass, use a local copy so process can be called again with the same result
+	float spread = m_Spread;
+
 	//side length is distance of a single square side
-	for (int sideLength = m_Size - 1; sideLength >= 2; sideLength /= 2, m_Spread /= m_SpreadReduction)
+	for (int sideLength = m_Size - 1; sideLength >= 2; sideLength /= 2, spread /= m_SpreadReduction)
 	{
 		//side length must be >= 2 so we always have
 		//a new value (if its 1 we overwrite existing values
 		//on the last iteration)
-		
+
 		//each iteration we are looking at smaller squares
 		//diamonds, and we decrease the variation of the offset
-		 
+
 		//half the length of the side of a square
 		//or distance from diamond center to one corner
 		//(just to make calcs below a little clearer)
 		int halfSide = sideLength / 2;
 
+		//The number of cells written for each x is the same in both passes
+		int cellsPerLine = std::max((m_Size - 1) / sideLength, 1);
+		int grainSize = std::max(kCellsPerChunk / cellsPerLine, 1);
+
 		//SQUARE STEP
-		for (int x = 0; x < m_Size - 1; x += sideLength) 
+		//Every square centre only reads the corners of its own square, so each line of squares can run in parallel
+		int numSquareLines = (m_Size - 1) / sideLength;
+		threadPool->ParallelFor(0, numSquareLines, grainSize, [&](int first, int last)
 		{
-			for (int y = 0; y < m_Size - 1; y += sideLength) 
+			for (int line = first; line < last; ++line)
 			{
-				//x, y is upper left corner of square
-				//calculate average of existing corners
-				double avg = HeightMap[x][y] //top left
-						   + HeightMap[x + sideLength][y]//top right
-					       + HeightMap[x][y + sideLength]//lower left
-						   + HeightMap[x + sideLength][y + sideLength];//lower right
-				avg /= 4.0;
-
-				//add a random value on to the average
-				HeightMap[x + halfSide][y + halfSide] = abs(avg + fRand2(-m_Spread, m_Spread));
+				int x = line * sideLength;
+				for (int y = 0; y < m_Size - 1; y += sideLength)
+				{
+					//x, y is upper left corner of square
+					//calculate average of existing corners
+					double avg = HeightMap[x][y] //top left
+							   + HeightMap[x + sideLength][y]//top right
+							   + HeightMap[x][y + sideLength]//lower left
+							   + HeightMap[x + sideLength][y + sideLength];//lower right
+					avg /= 4.0;
+
+					//add a random value on to the average
+					HeightMap[x + halfSide][y + halfSide] = static_cast<float>(std::abs(avg + RandomOffset(sideLength, x + halfSide, y + halfSide, spread)));
+				}
 			}
-		}
+		});
 
 		//generate the diamond values
 		//since the diamonds are staggered we only move x
@@ -70,51 +99,58 @@ void DiamondSquare::process(std::vector<std::vector<float>>& HeightMap)
 		//to generate the far edge values
 
 		//DIAMOND STEP
-		for (int x = 0; x < m_Size - 1; x += halfSide) 
+		//Diamond centres only read square centres and corners, never another diamond centre,
+		//and the wrapped edge values are written by the line that owns them, so lines can run in parallel
+		int numDiamondLines = (m_Size - 1) / halfSide;
+		threadPool->ParallelFor(0, numDiamondLines, grainSize, [&](int first, int last)
 		{
-			//and y is x offset by half a side, but moved by
-			//the full side length
-			//NOTE: if the data shouldn't wrap then y < DATA_SIZE
-			//to generate the far edge values
-			for (int y = (x + halfSide) % sideLength; y < m_Size - 1; y += sideLength) 
+			for (int line = first; line < last; ++line)
 			{
-				//x, y is center of diamond
-				//note we must use mod  and add DATA_SIZE for subtraction 
-				//so that we can wrap around the array to find the corners
-				double avg = HeightMap[(x - halfSide + m_Size - 1) % (m_Size - 1)][y] //left of center
-						   + HeightMap[(x + halfSide) % (m_Size - 1)][y]  //right of center
-						   + HeightMap[x][(y + halfSide) % (m_Size - 1)]  //below center
-						   + HeightMap[x][(y - halfSide + m_Size - 1) % (m_Size - 1)]; //above center
-
-
-				avg /= 4.0;
-
-				//add a random value on to the average
-				avg = abs(avg + fRand2(-m_Spread, m_Spread));
-				//update value for center of diamond
-				HeightMap[x][y] = avg;
-
-				//wrap values on the edges, remove
-				//this and adjust loop condition above
-				//for non-wrapping values.
-				if (x == 0)  HeightMap[m_Size - 1][y] = avg;
-				if (y == 0)  HeightMap[x][m_Size - 1] = avg;	              
+				int x = line * halfSide;
+
+				//and y is x offset by half a side, but moved by
+				//the full side length
+				//NOTE: if the data shouldn't wrap then y < DATA_SIZE
+				//to generate the far edge values
+				for (int y = (x + halfSide) % sideLength; y < m_Size - 1; y += sideLength)
+				{
+					//x, y is center of diamond
+					//note we must use mod  and add DATA_SIZE for subtraction
+					//so that we can wrap around the array to find the corners
+					double avg = HeightMap[(x - halfSide + m_Size - 1) % (m_Size - 1)][y] //left of center
+							   + HeightMap[(x + halfSide) % (m_Size - 1)][y]  //right of center
+							   + HeightMap[x][(y + halfSide) % (m_Size - 1)]  //below center
+							   + HeightMap[x][(y - halfSide + m_Size - 1) % (m_Size - 1)]; //above center
+
+					avg /= 4.0;
+
+					//add a random value on to the average
+					float value = static_cast<float>(std::abs(avg + RandomOffset(sideLength, x, y, spread)));
+					//update value for center of diamond
+					HeightMap[x][y] = value;
+
+					//wrap values on the edges, remove
+					//this and adjust loop condition above
+					//for non-wrapping values.
+					if (x == 0)  HeightMap[m_Size - 1][y] = value;
+					if (y == 0)  HeightMap[x][m_Size - 1] = value;
+				}
 			}
-		}
+		});
 	}
 }
 
 //Function to set the corners of the HeightMap to a random value of the Spread
-void DiamondSquare::_on_start(std::vector<std::vector<float>>& HeightMap)
+void DiamondSquare::_on_start(HeightField& HeightMap)
 {
-	HeightMap[0][0] = fRand2(-m_Spread, m_Spread);
-	HeightMap[0][m_Size - 1] = fRand2(-m_Spread, m_Spread);
-	HeightMap[m_Size - 1][0] = fRand2(-m_Spread, m_Spread);
-	HeightMap[m_Size - 1][m_Size - 1] = fRand2(-m_Spread, m_Spread);
+	HeightMap[0][0] = RandomOffset(kCornerLevel, 0, 0, m_Spread);
+	HeightMap[0][m_Size - 1] = RandomOffset(kCornerLevel, 0, m_Size - 1, m_Spread);
+	HeightMap[m_Size - 1][0] = RandomOffset(kCornerLevel, m_Size - 1, 0, m_Spread);
+	HeightMap[m_Size - 1][m_Size - 1] = RandomOffset(kCornerLevel, m_Size - 1, m_Size - 1, m_Spread);
 }
 
-//Function to generate a random value between two values
-double DiamondSquare::fRand2(float dMin, float dMax)
+//Random offset between -spread and spread for the given cell. Each pass of the algorithm is its own level
+float DiamondSquare::RandomOffset(uint32_t level, int x, int y, float spread) const
 {
-	return dMin + (dMax - dMin) * (static_cast<double>(rand()) / RAND_MAX);
-}
\ No newline at end of file
+	return RandomFromHash(HashRandom(m_Seed, level, static_cast<uint32_t>(x), static_cast<uint32_t>(y)), -spread, spread);
+}
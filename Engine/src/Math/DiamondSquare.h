@@ -1,30 +1,46 @@
 #pragma once
 #include "epch.h"
-#include <wincrypt.h>
-class DiamondSquare
+#include "HeightField.h"
+#include "ITerrainGenerator.h"
+
+class ThreadPool;
+
+class DiamondSquare : public ITerrainGenerator
 {
 //----------------------//
 // Construction / Usage	//
 //----------------------//
 public:
 	//Constructor
-	DiamondSquare(int size, float spread, float spreadReduction);
+	DiamondSquare(int size, float spread, float spreadReduction, uint32_t seed = 0);
 
 	//Destructor
 	~DiamondSquare();
-	
-	//Function to reset the time to generate a new seed for the random function
+
+	//Function to pick a new seed from the current time, so the next HeightMap generated is different
 	void timeReset();
 
+	//The seed used to generate the HeightMap, the same seed always generates the same HeightMap
+	uint32_t Seed() const { return m_Seed; }
+	void SetSeed(uint32_t seed) { m_Seed = seed; }
+
 	//Function to go through the Diamond Square Algorithm and generate the new HeightMap
-	void process(std::vector<std::vector<float>>& HeightMap);
+	//Each square and diamond pass is spread over the given thread pool (the shared pool by default).
+	//The result only depends on the seed, never on the number of threads used.
+	void process(HeightField& HeightMap, ThreadPool* threadPool = nullptr);
+
+	//Same as process, the HeightMap is always resized to the size this generator was created for
+	void Generate(HeightField& heightMap, ThreadPool* threadPool = nullptr) override { process(heightMap, threadPool); }
 
 	//Function to set the corners of the HeightMap to a random value of the Spread
-	void _on_start(std::vector<std::vector<float>>& HeightMap);
+	void _on_start(HeightField& HeightMap);
 
-	//Function to generate a random value between two values
-	double fRand2(float fMin, float dMax);
-	
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Random offset between -spread and spread for the given cell. Each pass of the algorithm is its own level
+	float RandomOffset(uint32_t level, int x, int y, float spread) const;
 
 //-------------//
 // Member data //
@@ -38,4 +54,7 @@ private:
 
 	//The amount the Spread gets divided by each loop
 	float m_SpreadReduction;
+
+	//Seed for the random offsets
+	uint32_t m_Seed = 0;
 };
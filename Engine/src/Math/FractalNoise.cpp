@@ -0,0 +1,344 @@
+#include "epch.h"
+#include "FractalNoise.h"
+#include "HeightField.h"
+#include "Utility/ThreadPool.h"
+
+namespace
+{
+	//Size of the tiles Generate works on. A tile of heights plus the noise for one octave is 32KB.
+	//Wide, short tiles spread the per-row and per-column setup of the batch noise over more points
+	const int kTileWidth = 256;
+	const int kTileHeight = 16;
+
+	//Each octave is moved this far in noise space so the octaves don't all line up at the lattice points
+	const double kOctaveShift = 57.31;
+
+	//A pool with no workers, so the noise for a tile is made on the thread working on the tile. With no workers a
+	//ParallelFor runs every chunk on the calling thread and shares nothing, so every thread can use the one pool
+	ThreadPool& CallingThreadPool()
+	{
+		static ThreadPool pool(0);
+		return pool;
+	}
+
+	//Turn a noise value from 0 to 1 into the contribution of one octave before its amplitude is applied
+	//Ridged also uses and updates a per-point weight so detail fades out in the valleys
+	inline float FBmOctave(float noise)
+	{
+		return noise * 2.0f - 1.0f;
+	}
+
+	inline float BillowOctave(float noise)
+	{
+		return std::abs(noise * 2.0f - 1.0f) * 2.0f - 1.0f;
+	}
+
+	inline float RidgedOctave(float noise, float& weight)
+	{
+		float ridge = 1.0f - std::abs(noise * 2.0f - 1.0f);
+		ridge = ridge * ridge * weight;
+		weight = std::min(std::max(ridge * 2.0f, 0.0f), 1.0f);
+		return ridge;
+	}
+
+	//Turn the sum of the octaves into a height from 0 to height
+	inline float FinalHeight(EFractalType type, float sum, float amplitudeSum, float height)
+	{
+		float value = sum / amplitudeSum;
+		if (type != EFractalType::Ridged)  value = value * 0.5f + 0.5f;
+		return value * height;
+	}
+
+	//A value along with its slope along x and z, for working out heights and their derivatives together
+	struct SlopedValue
+	{
+		float value;
+		float dX;
+		float dZ;
+	};
+
+	//The octave functions above, also carrying the derivatives through with the chain rule
+	inline SlopedValue FBmOctave(SlopedValue noise)
+	{
+		return { FBmOctave(noise.value), noise.dX * 2.0f, noise.dZ * 2.0f };
+	}
+
+	inline SlopedValue BillowOctave(SlopedValue noise)
+	{
+		float slope = noise.value < 0.5f ? -4.0f : 4.0f;
+		return { BillowOctave(noise.value), noise.dX * slope, noise.dZ * slope };
+	}
+
+	inline SlopedValue RidgedOctave(SlopedValue noise, SlopedValue& weight)
+	{
+		float ridge = 1.0f - std::abs(noise.value * 2.0f - 1.0f);
+		float ridgeSlope = noise.value < 0.5f ? 2.0f : -2.0f;
+
+		//ridge * ridge * weight, where the weight came from the previous octave and has a slope of its own
+		SlopedValue result;
+		result.value = ridge * ridge * weight.value;
+		result.dX = 2.0f * ridge * ridgeSlope * noise.dX * weight.value + ridge * ridge * weight.dX;
+		result.dZ = 2.0f * ridge * ridgeSlope * noise.dZ * weight.value + ridge * ridge * weight.dZ;
+
+		//The weight is clamped, so it is flat wherever the clamp applies
+		float nextWeight = result.value * 2.0f;
+		if (nextWeight > 0.0f && nextWeight < 1.0f)  weight = { nextWeight, result.dX * 2.0f, result.dZ * 2.0f };
+		else                                         weight = { std::min(std::max(nextWeight, 0.0f), 1.0f), 0.0f, 0.0f };
+		return result;
+	}
+
+	//Scale of the height relative to the sum of the octaves, the derivatives of the sum are scaled the same way
+	inline float FinalSlopeScale(EFractalType type, float amplitudeSum, float height)
+	{
+		return (type == EFractalType::Ridged ? 1.0f : 0.5f) * height / amplitudeSum;
+	}
+
+	//Split a width x height HeightField into tiles and call function(x, z, width, height) for each tile across the thread pool
+	void ForEachTile(int width, int height, ThreadPool* threadPool, const std::function<void(int, int, int, int)>& function)
+	{
+		int tilesX = (width + kTileWidth - 1) / kTileWidth;
+		int tilesZ = (height + kTileHeight - 1) / kTileHeight;
+
+		threadPool->ParallelFor(0, tilesX * tilesZ, 1, [&](int first, int last)
+		{
+			for (int tile = first; tile < last; ++tile)
+			{
+				int x = (tile % tilesX) * kTileWidth;
+				int z = (tile / tilesX) * kTileHeight;
+				function(x, z, std::min(kTileWidth, width - x), std::min(kTileHeight, height - z));
+			}
+		});
+	}
+}
+
+//Constructor, the seed picks the underlying Perlin noise
+FractalNoise::FractalNoise(unsigned int seed, const FractalNoiseSettings& settings /*= FractalNoiseSettings()*/)
+	: m_Perlin(seed), m_Settings(settings)
+{
+}
+
+//Fill the HeightField at its current size, heightMap(x, z) = Sample(x, z)
+void FractalNoise::Generate(HeightField& heightMap, ThreadPool* threadPool /*= nullptr*/)
+{
+	if (heightMap.Empty())  return;
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	ForEachTile(heightMap.Width(), heightMap.Height(), threadPool, [&](int x, int z, int width, int height)
+	{
+		GenerateRegion(heightMap.RowData(z) + x, width, height, heightMap.Stride(), m_Settings.OriginX + x, m_Settings.OriginZ + z);
+	});
+}
+
+//Fill the HeightField at its current size, and the gradient with the slope of the heights at every cell
+void FractalNoise::Generate(HeightField& heightMap, HeightFieldGradient& gradient, ThreadPool* threadPool /*= nullptr*/)
+{
+	if (heightMap.Empty())  return;
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+	gradient.Resize(heightMap.Width(), heightMap.Height());
+
+	//The HeightFields are the same size so share the same stride
+	ForEachTile(heightMap.Width(), heightMap.Height(), threadPool, [&](int x, int z, int width, int height)
+	{
+		GenerateRegion(heightMap.RowData(z) + x, gradient.DX.RowData(z) + x, gradient.DZ.RowData(z) + x, width, height, heightMap.Stride(),
+		               m_Settings.OriginX + x, m_Settings.OriginZ + z);
+	});
+}
+
+//Fill a region of cells on the calling thread: out[row * stride + column] = Sample(x + column, z + row)
+void FractalNoise::GenerateRegion(float* out, int width, int height, int stride, double x, double z) const
+{
+	if (width <= 0 || height <= 0)  return;
+
+	std::vector<float> octaveNoise(static_cast<size_t>(width) * height);
+	std::vector<float> ridgeWeight;
+	if (m_Settings.Type == EFractalType::Ridged)  ridgeWeight.assign(octaveNoise.size(), 1.0f);
+
+	//The sum of the octaves is built up in the output itself, which stays in cache for a tile sized region
+	for (int row = 0; row < height; ++row)
+	{
+		std::fill(out + static_cast<size_t>(row) * stride, out + static_cast<size_t>(row) * stride + width, 0.0f);
+	}
+
+	ThreadPool& singleThread = CallingThreadPool();
+	double frequency = m_Settings.Frequency;
+	float amplitude = 1.0f;
+	float amplitudeSum = 0.0f;
+	for (int octave = 0; octave < m_Settings.Octaves; ++octave)
+	{
+		double shift = octave * kOctaveShift;
+		m_Perlin.GenerateGrid(octaveNoise.data(), width, height, width, x * frequency + shift, z * frequency + shift, frequency, frequency, 0.0, &singleThread);
+
+		for (int row = 0; row < height; ++row)
+		{
+			float* sumRow = out + static_cast<size_t>(row) * stride;
+			const float* noiseRow = octaveNoise.data() + static_cast<size_t>(row) * width;
+			switch (m_Settings.Type)
+			{
+			case EFractalType::FBm:
+				for (int column = 0; column < width; ++column)  sumRow[column] += amplitude * FBmOctave(noiseRow[column]);
+				break;
+			case EFractalType::Billow:
+				for (int column = 0; column < width; ++column)  sumRow[column] += amplitude * BillowOctave(noiseRow[column]);
+				break;
+			case EFractalType::Ridged:
+			{
+				float* weightRow = ridgeWeight.data() + static_cast<size_t>(row) * width;
+				for (int column = 0; column < width; ++column)  sumRow[column] += amplitude * RidgedOctave(noiseRow[column], weightRow[column]);
+				break;
+			}
+			}
+		}
+
+		amplitudeSum += amplitude;
+		frequency *= m_Settings.Lacunarity;
+		amplitude *= m_Settings.Gain;
+	}
+
+	if (amplitudeSum <= 0.0f)  return;
+	for (int row = 0; row < height; ++row)
+	{
+		float* sumRow = out + static_cast<size_t>(row) * stride;
+		for (int column = 0; column < width; ++column)
+		{
+			sumRow[column] = FinalHeight(m_Settings.Type, sumRow[column], amplitudeSum, m_Settings.Height);
+		}
+	}
+}
+
+//As GenerateRegion, also filling outDX and outDZ (laid out like out) with the change in height per cell along x and z
+void FractalNoise::GenerateRegion(float* out, float* outDX, float* outDZ, int width, int height, int stride, double x, double z) const
+{
+	if (width <= 0 || height <= 0)  return;
+
+	size_t size = static_cast<size_t>(width) * height;
+	std::vector<float> octaveNoise(size), octaveDX(size), octaveDZ(size);
+	std::vector<SlopedValue> ridgeWeight;
+	if (m_Settings.Type == EFractalType::Ridged)  ridgeWeight.assign(size, { 1.0f, 0.0f, 0.0f });
+
+	for (int row = 0; row < height; ++row)
+	{
+		for (float* output : { out, outDX, outDZ })
+		{
+			std::fill(output + static_cast<size_t>(row) * stride, output + static_cast<size_t>(row) * stride + width, 0.0f);
+		}
+	}
+
+	ThreadPool& singleThread = CallingThreadPool();
+	double frequency = m_Settings.Frequency;
+	float amplitude = 1.0f;
+	float amplitudeSum = 0.0f;
+	for (int octave = 0; octave < m_Settings.Octaves; ++octave)
+	{
+		double shift = octave * kOctaveShift;
+		m_Perlin.GenerateGridDerivatives(octaveNoise.data(), octaveDX.data(), octaveDZ.data(), width, height, width,
+		                                 x * frequency + shift, z * frequency + shift, frequency, frequency, 0.0, &singleThread);
+
+		//Noise derivatives are per unit of noise space, convert them to per cell
+		float cellScale = static_cast<float>(frequency);
+		for (int row = 0; row < height; ++row)
+		{
+			size_t outStart = static_cast<size_t>(row) * stride;
+			size_t noiseStart = static_cast<size_t>(row) * width;
+			for (int column = 0; column < width; ++column)
+			{
+				SlopedValue noise = { octaveNoise[noiseStart + column], octaveDX[noiseStart + column] * cellScale, octaveDZ[noiseStart + column] * cellScale };
+
+				SlopedValue contribution;
+				switch (m_Settings.Type)
+				{
+				case EFractalType::FBm:    contribution = FBmOctave(noise); break;
+				case EFractalType::Billow: contribution = BillowOctave(noise); break;
+				default:                   contribution = RidgedOctave(noise, ridgeWeight[noiseStart + column]); break;
+				}
+				out[outStart + column]   += amplitude * contribution.value;
+				outDX[outStart + column] += amplitude * contribution.dX;
+				outDZ[outStart + column] += amplitude * contribution.dZ;
+			}
+		}
+
+		amplitudeSum += amplitude;
+		frequency *= m_Settings.Lacunarity;
+		amplitude *= m_Settings.Gain;
+	}
+
+	if (amplitudeSum <= 0.0f)  return;
+	float slopeScale = FinalSlopeScale(m_Settings.Type, amplitudeSum, m_Settings.Height);
+	for (int row = 0; row < height; ++row)
+	{
+		size_t outStart = static_cast<size_t>(row) * stride;
+		for (int column = 0; column < width; ++column)
+		{
+			out[outStart + column] = FinalHeight(m_Settings.Type, out[outStart + column], amplitudeSum, m_Settings.Height);
+			outDX[outStart + column] *= slopeScale;
+			outDZ[outStart + column] *= slopeScale;
+		}
+	}
+}
+
+//Height at a single cell position, using the scalar CPerlinNoise::noise
+float FractalNoise::Sample(double x, double z) const
+{
+	double frequency = m_Settings.Frequency;
+	float amplitude = 1.0f;
+	float amplitudeSum = 0.0f;
+	float sum = 0.0f;
+	float weight = 1.0f;
+	for (int octave = 0; octave < m_Settings.Octaves; ++octave)
+	{
+		double shift = octave * kOctaveShift;
+		float noise = static_cast<float>(m_Perlin.noise(x * frequency + shift, z * frequency + shift, 0.0));
+		switch (m_Settings.Type)
+		{
+		case EFractalType::FBm:    sum += amplitude * FBmOctave(noise); break;
+		case EFractalType::Billow: sum += amplitude * BillowOctave(noise); break;
+		case EFractalType::Ridged: sum += amplitude * RidgedOctave(noise, weight); break;
+		}
+
+		amplitudeSum += amplitude;
+		frequency *= m_Settings.Lacunarity;
+		amplitude *= m_Settings.Gain;
+	}
+
+	if (amplitudeSum <= 0.0f)  return 0.0f;
+	return FinalHeight(m_Settings.Type, sum, amplitudeSum, m_Settings.Height);
+}
+
+//As Sample, also giving the change in height per cell along x and z
+float FractalNoise::Sample(double x, double z, float& dX, float& dZ) const
+{
+	double frequency = m_Settings.Frequency;
+	float amplitude = 1.0f;
+	float amplitudeSum = 0.0f;
+	SlopedValue sum = { 0.0f, 0.0f, 0.0f };
+	SlopedValue weight = { 1.0f, 0.0f, 0.0f };
+	for (int octave = 0; octave < m_Settings.Octaves; ++octave)
+	{
+		double shift = octave * kOctaveShift;
+		//Noise y runs along the HeightField z, the noise z derivative is not needed
+		double noiseDX, noiseDZ, unused;
+		double value = m_Perlin.noise(x * frequency + shift, z * frequency + shift, 0.0, noiseDX, noiseDZ, unused);
+		SlopedValue noise = { static_cast<float>(value), static_cast<float>(noiseDX * frequency), static_cast<float>(noiseDZ * frequency) };
+
+		SlopedValue contribution;
+		switch (m_Settings.Type)
+		{
+		case EFractalType::FBm:    contribution = FBmOctave(noise); break;
+		case EFractalType::Billow: contribution = BillowOctave(noise); break;
+		default:                   contribution = RidgedOctave(noise, weight); break;
+		}
+		sum.value += amplitude * contribution.value;
+		sum.dX += amplitude * contribution.dX;
+		sum.dZ += amplitude * contribution.dZ;
+
+		amplitudeSum += amplitude;
+		frequency *= m_Settings.Lacunarity;
+		amplitude *= m_Settings.Gain;
+	}
+
+	dX = dZ = 0.0f;
+	if (amplitudeSum <= 0.0f)  return 0.0f;
+	float slopeScale = FinalSlopeScale(m_Settings.Type, amplitudeSum, m_Settings.Height);
+	dX = sum.dX * slopeScale;
+	dZ = sum.dZ * slopeScale;
+	return FinalHeight(m_Settings.Type, sum.value, amplitudeSum, m_Settings.Height);
+}
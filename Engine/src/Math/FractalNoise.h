@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// Multi-octave Perlin noise terrain - fBm, ridged and billow
+//--------------------------------------------------------------------------------------
+// Generate splits the HeightField into tiles small enough to stay in cache while every
+// octave is added in, and spreads the tiles over the thread pool. Each octave of a tile
+// is filled with the batch CPerlinNoise::GenerateGrid.
+
+#pragma once
+#include "epch.h"
+#include "CPerlinNoise.h"
+#include "HeightField.h"
+#include "ITerrainGenerator.h"
+
+enum class EFractalType
+{
+	FBm = 0,  //Sum of octaves, rolling hills
+	Ridged,   //Inverted absolute value of each octave squared, sharp ridges with smooth valleys
+	Billow    //Absolute value of each octave, rounded lumps
+};
+
+struct FractalNoiseSettings
+{
+	EFractalType Type = EFractalType::FBm;
+
+	//Number of layers of noise added together
+	int Octaves = 6;
+
+	//Noise cycles per HeightField cell for the first octave
+	double Frequency = 1.0 / 256.0;
+
+	//Each octave's frequency is the previous one multiplied by the lacunarity
+	double Lacunarity = 2.0;
+
+	//Each octave's amplitude is the previous one multiplied by the gain
+	float Gain = 0.5f;
+
+	//Heights go from 0 to this value
+	float Height = 1.0f;
+
+	//Position of the first cell of the HeightField, in cells, to generate neighbouring pieces of terrain
+	double OriginX = 0.0;
+	double OriginZ = 0.0;
+};
+
+class FractalNoise : public ITerrainGenerator
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Largest difference allowed between Generate and Sample, as a fraction of the Height setting
+	static constexpr float kSampleTolerance = 1e-5f;
+
+	//Constructor, the seed picks the underlying Perlin noise
+	FractalNoise(unsigned int seed, const FractalNoiseSettings& settings = FractalNoiseSettings());
+
+	const FractalNoiseSettings& Settings() const { return m_Settings; }
+	void SetSettings(const FractalNoiseSettings& settings) { m_Settings = settings; }
+
+	//Fill the HeightField at its current size, heightMap(x, z) = Sample(x, z)
+	void Generate(HeightField& heightMap, ThreadPool* threadPool = nullptr) override;
+
+	//As above, also filling the gradient with the slope of the heights at every cell, worked out
+	//analytically alongside the heights, ready for Mesh to build normals from
+	void Generate(HeightField& heightMap, HeightFieldGradient& gradient, ThreadPool* threadPool = nullptr);
+
+	//Fill a region of cells on the calling thread: out[row * stride + column] = Sample(x + column, z + row)
+	void GenerateRegion(float* out, int width, int height, int stride, double x, double z) const;
+
+	//As above, also filling outDX and outDZ (laid out like out) with the change in height per cell along x and z
+	void GenerateRegion(float* out, float* outDX, float* outDZ, int width, int height, int stride, double x, double z) const;
+
+	//Height at a single cell position, using the scalar CPerlinNoise::noise. Slow, but useful
+	//for one-off queries and as the reference the batch functions are checked against
+	float Sample(double x, double z) const;
+
+	//As above, also giving the change in height per cell along x and z
+	float Sample(double x, double z, float& dX, float& dZ) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	CPerlinNoise m_Perlin;
+	FractalNoiseSettings m_Settings;
+};
@@ -0,0 +1,54 @@
+#include "epch.h"
+#include "Frustum.h"
+
+namespace
+{
+	//Plane from a combination of the matrix columns, scaled so the normal is unit length
+	FrustumPlane MakePlane(float a, float b, float c, float d)
+	{
+		float scale = InvSqrt(a * a + b * b + c * c);
+
+		FrustumPlane plane;
+		plane.Normal = CVector3(a * scale, b * scale, c * scale);
+		plane.D = d * scale;
+		return plane;
+	}
+}
+
+//Constructor to extract the planes from a view-projection matrix
+Frustum::Frustum(const CMatrix4x4& viewProjection)
+{
+	//A world point p is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w in clip space,
+	//where clip = (p, 1) * viewProjection, so each clip component is p dotted with a column of the matrix
+	const CMatrix4x4& m = viewProjection;
+	m_Planes[Left]   = MakePlane(m.e03 + m.e00, m.e13 + m.e10, m.e23 + m.e20, m.e33 + m.e30);
+	m_Planes[Right]  = MakePlane(m.e03 - m.e00, m.e13 - m.e10, m.e23 - m.e20, m.e33 - m.e30);
+	m_Planes[Bottom] = MakePlane(m.e03 + m.e01, m.e13 + m.e11, m.e23 + m.e21, m.e33 + m.e31);
+	m_Planes[Top]    = MakePlane(m.e03 - m.e01, m.e13 - m.e11, m.e23 - m.e21, m.e33 - m.e31);
+	m_Planes[Near]   = MakePlane(m.e02,         m.e12,         m.e22,         m.e32);
+	m_Planes[Far]    = MakePlane(m.e03 - m.e02, m.e13 - m.e12, m.e23 - m.e22, m.e33 - m.e32);
+}
+
+//False only if the box is entirely outside the frustum
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+	//Test the corner of the box furthest along each plane normal, if even that is outside then the whole box is
+	for (const auto& plane : m_Planes)
+	{
+		CVector3 corner(plane.Normal.x >= 0.0f ? box.Max.x : box.Min.x,
+		                plane.Normal.y >= 0.0f ? box.Max.y : box.Min.y,
+		                plane.Normal.z >= 0.0f ? box.Max.z : box.Min.z);
+		if (plane.Distance(corner) < 0.0f)  return false;
+	}
+	return true;
+}
+
+//False only if the sphere is entirely outside the frustum
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	for (const auto& plane : m_Planes)
+	{
+		if (plane.Distance(sphere.Centre) < -sphere.Radius)  return false;
+	}
+	return true;
+}
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Frustum - the six planes bounding what a camera can see
+//--------------------------------------------------------------------------------------
+// The planes are pulled straight out of a view-projection matrix (Gribb / Hartmann), so a
+// frustum can be built for any camera without knowing its field of view or clip distances.
+// Plane normals point into the frustum and are unit length, so the distance from a plane is
+// in world units and spheres can be tested directly.
+
+#pragma once
+#include "epch.h"
+#include "Bounds.h"
+#include "CMatrix4x4.h"
+
+//A plane, points p on it satisfy Dot(Normal, p) + D = 0
+struct FrustumPlane
+{
+	CVector3 Normal = CVector3(0, 0, 0);
+	float    D = 0.0f;
+
+	//Signed distance from the plane, positive on the inside of the frustum
+	float Distance(const CVector3& point) const { return Dot(Normal, point) + D; }
+};
+
+class Frustum
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	enum EPlane { Left = 0, Right, Bottom, Top, Near, Far, NumPlanes };
+
+	//Constructor for a frustum with no planes set
+	Frustum() {}
+
+	//Constructor to extract the planes from a view-projection matrix, using the DirectX conventions:
+	//row vectors (clip = world * viewProjection) and clip space z from 0 to 1
+	explicit Frustum(const CMatrix4x4& viewProjection);
+
+	const FrustumPlane& Plane(int plane) const { return m_Planes[plane]; }
+
+	//False only if the box / sphere is entirely outside the frustum. Boxes near the corners of the frustum can be
+	//outside it but still give true, which is fine for culling
+	bool Intersects(const BoundingBox& box) const;
+	bool Intersects(const BoundingSphere& sphere) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	FrustumPlane m_Planes[NumPlanes];
+};
@@ -0,0 +1,134 @@
+#include "epch.h"
+#include "FrustumCulling.h"
+#include "FrustumCullingKernels.h"
+#include "Utility/CpuFeatures.h"
+
+namespace
+{
+	using FrustumCullKernel = void (*)(const FrustumCullArgs&);
+
+	//The kernels for the SIMD level in use, see GetSimdLevel
+	struct FrustumCullingKernels
+	{
+		const char*       name;
+		FrustumCullKernel boxes;
+		FrustumCullKernel spheres;
+	};
+
+	FrustumCullingKernels SelectKernels()
+	{
+		if (GetSimdLevel() >= SimdLevel::AVX2)  return { "AVX2", CullBoxesAVX2, CullSpheresAVX2 };
+		return { "SSE2", CullBoxesSSE2, CullSpheresSSE2 };
+	}
+
+	const FrustumCullingKernels& Kernels()
+	{
+		static const FrustumCullingKernels kernels = SelectKernels();
+		return kernels;
+	}
+
+	//Run a kernel over every bound
+	void Cull(FrustumCullKernel kernel, const Frustum& frustum, const BoundsArray& bounds, std::vector<uint32_t>& visible)
+	{
+		visible.resize(VisibilityMaskWords(bounds.Size()));
+		if (bounds.Size() == 0)  return;
+
+		float planes[Frustum::NumPlanes * 4];
+		for (int i = 0; i < Frustum::NumPlanes; ++i)
+		{
+			const FrustumPlane& plane = frustum.Plane(i);
+			planes[i * 4 + 0] = plane.Normal.x;
+			planes[i * 4 + 1] = plane.Normal.y;
+			planes[i * 4 + 2] = plane.Normal.z;
+			planes[i * 4 + 3] = plane.D;
+		}
+
+		FrustumCullArgs args;
+		args.planes = planes;
+		args.centreX = bounds.CentreX();
+		args.centreY = bounds.CentreY();
+		args.centreZ = bounds.CentreZ();
+		args.extentX = bounds.ExtentX();
+		args.extentY = bounds.ExtentY();
+		args.extentZ = bounds.ExtentZ();
+		args.radius = bounds.Radius();
+		args.count = bounds.Size();
+		args.visible = visible.data();
+		kernel(args);
+	}
+}
+
+//Make room for the given number of bounds without reallocating
+void BoundsArray::Reserve(int count)
+{
+	size_t padded = (count + kBoundsArrayPadding - 1) / kBoundsArrayPadding * kBoundsArrayPadding;
+	for (auto array : { &m_CentreX, &m_CentreY, &m_CentreZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ, &m_Radius })
+	{
+		array->reserve(padded);
+	}
+}
+
+//Add a bound and return its index
+int BoundsArray::Add(const BoundingBox& box)
+{
+	//Grow a whole block at a time, the padding is zeroes and never reported as visible
+	if (m_Size == static_cast<int>(m_CentreX.size()))
+	{
+		for (auto array : { &m_CentreX, &m_CentreY, &m_CentreZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ, &m_Radius })
+		{
+			array->resize(m_Size + kBoundsArrayPadding, 0.0f);
+		}
+	}
+	Set(m_Size, box);
+	return m_Size++;
+}
+
+int BoundsArray::Add(const BoundingSphere& sphere)
+{
+	int index = Add(BoundingBox(sphere.Centre, sphere.Centre));
+	Set(index, sphere);
+	return index;
+}
+
+//Replace an existing bound
+void BoundsArray::Set(int index, const BoundingBox& box)
+{
+	CVector3 centre = box.Centre();
+	CVector3 extents = box.Extents();
+	m_CentreX[index] = centre.x;
+	m_CentreY[index] = centre.y;
+	m_CentreZ[index] = centre.z;
+	m_ExtentX[index] = extents.x;
+	m_ExtentY[index] = extents.y;
+	m_ExtentZ[index] = extents.z;
+	m_Radius[index] = Length(extents);
+}
+
+void BoundsArray::Set(int index, const BoundingSphere& sphere)
+{
+	m_CentreX[index] = sphere.Centre.x;
+	m_CentreY[index] = sphere.Centre.y;
+	m_CentreZ[index] = sphere.Centre.z;
+	m_ExtentX[index] = sphere.Radius;
+	m_ExtentY[index] = sphere.Radius;
+	m_ExtentZ[index] = sphere.Radius;
+	m_Radius[index] = sphere.Radius;
+}
+
+//Set a bit in the visibility mask for each box that is at least partly inside the frustum
+void CullBoxes(const Frustum& frustum, const BoundsArray& bounds, std::vector<uint32_t>& visible)
+{
+	Cull(Kernels().boxes, frustum, bounds, visible);
+}
+
+//Set a bit in the visibility mask for each sphere that is at least partly inside the frustum
+void CullSpheres(const Frustum& frustum, const BoundsArray& bounds, std::vector<uint32_t>& visible)
+{
+	Cull(Kernels().spheres, frustum, bounds, visible);
+}
+
+//Name of the instruction set the culling kernels use on this CPU
+const char* FrustumCullingKernelName()
+{
+	return Kernels().name;
+}
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling - testing many bounding volumes against a frustum at once
+//--------------------------------------------------------------------------------------
+// Bounds are kept as a structure of arrays (all centre x values together, and so on), so
+// the culling kernels test 4 (SSE2) or 8 (AVX2) boxes or spheres with each instruction.
+// The result is a bitmask with one bit per bound, set if the bound is visible. The tests
+// agree with Frustum::Intersects, other than rounding for bounds that just touch a plane.
+
+#pragma once
+#include "epch.h"
+#include "Bounds.h"
+#include "Frustum.h"
+
+//Bounding volumes stored as a structure of arrays. Each entry holds a box (centre and extents) and
+//the sphere enclosing it, so the same array can be culled either way
+class BoundsArray
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Remove every bound, keeping the memory
+	void Clear() { m_Size = 0; }
+
+	//Make room for the given number of bounds without reallocating
+	void Reserve(int count);
+
+	//Add a bound and return its index. Boxes must not be empty
+	int Add(const BoundingBox& box);
+	int Add(const BoundingSphere& sphere);
+
+	//Replace an existing bound
+	void Set(int index, const BoundingBox& box);
+	void Set(int index, const BoundingSphere& sphere);
+
+	int Size() const { return m_Size; }
+
+	const float* CentreX() const { return m_CentreX.data(); }
+	const float* CentreY() const { return m_CentreY.data(); }
+	const float* CentreZ() const { return m_CentreZ.data(); }
+	const float* ExtentX() const { return m_ExtentX.data(); }
+	const float* ExtentY() const { return m_ExtentY.data(); }
+	const float* ExtentZ() const { return m_ExtentZ.data(); }
+	const float* Radius()  const { return m_Radius.data(); }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	//Padded beyond m_Size so the kernels can always work on whole blocks
+	std::vector<float> m_CentreX, m_CentreY, m_CentreZ;
+	std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+	std::vector<float> m_Radius;
+	int m_Size = 0;
+};
+
+//Number of 32 bit words in a visibility mask for the given number of bounds
+inline int VisibilityMaskWords(int count) { return (count + 31) / 32; }
+
+//True if bound number index is visible in the mask
+inline bool IsVisible(const std::vector<uint32_t>& visible, int index) { return (visible[index / 32] >> (index % 32)) & 1; }
+
+//Set a bit in the visibility mask for each box that is at least partly inside the frustum. The mask is resized to fit
+void CullBoxes(const Frustum& frustum, const BoundsArray& bounds, std::vector<uint32_t>& visible);
+
+//Set a bit in the visibility mask for each sphere that is at least partly inside the frustum. The mask is resized to fit
+void CullSpheres(const Frustum& frustum, const BoundsArray& bounds, std::vector<uint32_t>& visible);
+
+//Name of the instruction set the culling kernels use on this CPU
+const char* FrustumCullingKernelName();
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// AVX2 frustum culling kernels, 8 bounds at a time
+//--------------------------------------------------------------------------------------
+// Compiled with AVX2 enabled and without the precompiled header, see FrustumCullingKernels.h.
+// Only called when the CPU supports AVX2 and FMA.
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace
+{
+	struct SimdAVX2
+	{
+		using Float = __m256;
+		static const int kWidth = 8;
+
+		static Float LoadFloat(const float* p)         { return _mm256_loadu_ps(p); }
+		static Float SetFloat(float f)                 { return _mm256_set1_ps(f); }
+		static Float Add(Float a, Float b)             { return _mm256_add_ps(a, b); }
+		static Float Mul(Float a, Float b)             { return _mm256_mul_ps(a, b); }
+		static Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+		static Float Abs(Float a)                      { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static Float And(Float a, Float b)             { return _mm256_and_ps(a, b); }
+		static Float NotLess(Float a, Float b)         { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static uint32_t MoveMask(Float a)              { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+	};
+}
+
+#include "FrustumCullingKernels.inl"
+
+void CullBoxesAVX2(const FrustumCullArgs& args)   { CullBoxes<SimdAVX2>(args); }
+void CullSpheresAVX2(const FrustumCullArgs& args) { CullSpheres<SimdAVX2>(args); }
@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Kernels behind CullBoxes and CullSpheres
+//--------------------------------------------------------------------------------------
+// One set of kernels per instruction set, each in its own file so it can be compiled for
+// that instruction set, following the same scheme as the Perlin noise kernels. The kernels
+// are written once in FrustumCullingKernels.inl. FrustumCulling.cpp picks them once, for
+// the level given by GetSimdLevel.
+
+#pragma once
+#include <cstdint>
+
+//BoundsArray pads its arrays to a multiple of this, so kernels can always load whole blocks
+const int kBoundsArrayPadding = 8;
+
+struct FrustumCullArgs
+{
+	//Six planes, each the unit normal x, y, z followed by D
+	const float* planes;
+
+	//Bounds from a BoundsArray, count of them, each array padded to a multiple of kBoundsArrayPadding
+	const float* centreX;
+	const float* centreY;
+	const float* centreZ;
+	const float* extentX;
+	const float* extentY;
+	const float* extentZ;
+	const float* radius;
+	int count;
+
+	//One bit per bound, set if it is visible. Bit i is bit (i % 32) of word (i / 32)
+	uint32_t* visible;
+};
+
+void CullBoxesSSE2(const FrustumCullArgs& args);
+void CullBoxesAVX2(const FrustumCullArgs& args);
+
+void CullSpheresSSE2(const FrustumCullArgs& args);
+void CullSpheresAVX2(const FrustumCullArgs& args);
@@ -0,0 +1,120 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling kernels, written once for every instruction set
+//--------------------------------------------------------------------------------------
+// Included by each kernel file after it defines a Simd type with the operations below for
+// its register width. Everything is in an anonymous namespace, so each file gets its own
+// copy compiled for its own instruction set.
+//
+//   Float, kWidth (a factor of 32)
+//   LoadFloat, SetFloat, Add, Mul, MulAdd (a * b + c), Abs, And,
+//   NotLess(a, b) (all bits set where a >= b), MoveMask (one bit per lane)
+
+#include "FrustumCullingKernels.h"
+
+namespace
+{
+	const int kNumFrustumPlanes = 6;
+
+	//Each plane broadcast to every lane
+	template <class Simd>
+	struct FrustumPlanes
+	{
+		typename Simd::Float normalX[kNumFrustumPlanes];
+		typename Simd::Float normalY[kNumFrustumPlanes];
+		typename Simd::Float normalZ[kNumFrustumPlanes];
+		typename Simd::Float d[kNumFrustumPlanes];
+	};
+
+	template <class Simd>
+	inline FrustumPlanes<Simd> LoadPlanes(const float* planes)
+	{
+		FrustumPlanes<Simd> result;
+		for (int plane = 0; plane < kNumFrustumPlanes; ++plane)
+		{
+			result.normalX[plane] = Simd::SetFloat(planes[plane * 4 + 0]);
+			result.normalY[plane] = Simd::SetFloat(planes[plane * 4 + 1]);
+			result.normalZ[plane] = Simd::SetFloat(planes[plane * 4 + 2]);
+			result.d[plane]       = Simd::SetFloat(planes[plane * 4 + 3]);
+		}
+		return result;
+	}
+
+	//Write the visibility bits for the block of bounds starting at first, which is a multiple of the SIMD width
+	//Every word is written by its first block, so the mask doesn't need clearing beforehand
+	inline void StoreVisibility(uint32_t* visible, int first, uint32_t bits, int count)
+	{
+		int remaining = count - first;
+		if (remaining < 32)  bits &= (1u << remaining) - 1; // Padding at the end of the arrays is never visible
+
+		int shift = first % 32;
+		if (shift == 0)  visible[first / 32] = bits;
+		else             visible[first / 32] |= bits << shift;
+	}
+
+	//A box is outside if it is entirely behind any plane: its centre is further behind the plane than the box's
+	//extents reach along the plane normal. Same result as testing the corner furthest along the normal
+	template <class Simd>
+	void CullBoxes(const FrustumCullArgs& args)
+	{
+		using Float = typename Simd::Float;
+		const Float zero = Simd::SetFloat(0.0f);
+
+		FrustumPlanes<Simd> planes = LoadPlanes<Simd>(args.planes);
+		Float absX[kNumFrustumPlanes], absY[kNumFrustumPlanes], absZ[kNumFrustumPlanes];
+		for (int plane = 0; plane < kNumFrustumPlanes; ++plane)
+		{
+			absX[plane] = Simd::Abs(planes.normalX[plane]);
+			absY[plane] = Simd::Abs(planes.normalY[plane]);
+			absZ[plane] = Simd::Abs(planes.normalZ[plane]);
+		}
+
+		for (int i = 0; i < args.count; i += Simd::kWidth)
+		{
+			Float centreX = Simd::LoadFloat(args.centreX + i);
+			Float centreY = Simd::LoadFloat(args.centreY + i);
+			Float centreZ = Simd::LoadFloat(args.centreZ + i);
+			Float extentX = Simd::LoadFloat(args.extentX + i);
+			Float extentY = Simd::LoadFloat(args.extentY + i);
+			Float extentZ = Simd::LoadFloat(args.extentZ + i);
+
+			Float inside = Simd::NotLess(zero, zero);
+			for (int plane = 0; plane < kNumFrustumPlanes; ++plane)
+			{
+				Float distance = Simd::MulAdd(planes.normalX[plane], centreX,
+				                 Simd::MulAdd(planes.normalY[plane], centreY,
+				                 Simd::MulAdd(planes.normalZ[plane], centreZ, planes.d[plane])));
+				Float reach = Simd::MulAdd(absX[plane], extentX, Simd::MulAdd(absY[plane], extentY, Simd::Mul(absZ[plane], extentZ)));
+				inside = Simd::And(inside, Simd::NotLess(Simd::Add(distance, reach), zero));
+			}
+			StoreVisibility(args.visible, i, Simd::MoveMask(inside), args.count);
+		}
+	}
+
+	//A sphere is outside if its centre is more than its radius behind any plane
+	template <class Simd>
+	void CullSpheres(const FrustumCullArgs& args)
+	{
+		using Float = typename Simd::Float;
+		const Float zero = Simd::SetFloat(0.0f);
+
+		FrustumPlanes<Simd> planes = LoadPlanes<Simd>(args.planes);
+
+		for (int i = 0; i < args.count; i += Simd::kWidth)
+		{
+			Float centreX = Simd::LoadFloat(args.centreX + i);
+			Float centreY = Simd::LoadFloat(args.centreY + i);
+			Float centreZ = Simd::LoadFloat(args.centreZ + i);
+			Float radius  = Simd::LoadFloat(args.radius + i);
+
+			Float inside = Simd::NotLess(zero, zero);
+			for (int plane = 0; plane < kNumFrustumPlanes; ++plane)
+			{
+				Float distance = Simd::MulAdd(planes.normalX[plane], centreX,
+				                 Simd::MulAdd(planes.normalY[plane], centreY,
+				                 Simd::MulAdd(planes.normalZ[plane], centreZ, planes.d[plane])));
+				inside = Simd::And(inside, Simd::NotLess(Simd::Add(distance, radius), zero));
+			}
+			StoreVisibility(args.visible, i, Simd::MoveMask(inside), args.count);
+		}
+	}
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// SSE2 frustum culling kernels, 4 bounds at a time
+//--------------------------------------------------------------------------------------
+// SSE2 is always available on x64, so these are built with the same settings as the rest
+// of the engine and used whenever the CPU has nothing wider.
+
+#include "epch.h"
+#include <emmintrin.h>
+
+namespace
+{
+	struct SimdSSE2
+	{
+		using Float = __m128;
+		static const int kWidth = 4;
+
+		static Float LoadFloat(const float* p)         { return _mm_loadu_ps(p); }
+		static Float SetFloat(float f)                 { return _mm_set1_ps(f); }
+		static Float Add(Float a, Float b)             { return _mm_add_ps(a, b); }
+		static Float Mul(Float a, Float b)             { return _mm_mul_ps(a, b); }
+		static Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static Float Abs(Float a)                      { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static Float And(Float a, Float b)             { return _mm_and_ps(a, b); }
+		static Float NotLess(Float a, Float b)         { return _mm_cmpge_ps(a, b); }
+		static uint32_t MoveMask(Float a)              { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+	};
+}
+
+#include "FrustumCullingKernels.inl"
+
+void CullBoxesSSE2(const FrustumCullArgs& args)   { CullBoxes<SimdSSE2>(args); }
+void CullSpheresSSE2(const FrustumCullArgs& args) { CullSpheres<SimdSSE2>(args); }
@@ -0,0 +1,73 @@
+#include "epch.h"
+#include "GridVertexData.h"
+#include "Utility/BufferUpdater.h"
+
+namespace
+{
+	//Grow the box to include the vertices in rows [firstRow, lastRow) of the grid, which get their heights from the HeightField
+	void AddRowBounds(BoundingBox& bounds, const HeightField& heightMap, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ,
+	                  int firstRow, int lastRow)
+	{
+		float minHeight = FLT_MAX;
+		float maxHeight = -FLT_MAX;
+		for (int z = firstRow; z < lastRow; ++z)
+		{
+			const float* row = heightMap.RowData(z);
+			for (int x = 0; x <= subDivX; ++x)
+			{
+				minHeight = std::min(minHeight, row[x]);
+				maxHeight = std::max(maxHeight, row[x]);
+			}
+		}
+
+		float zStep = (maxPt.z - minPt.z) / subDivZ;
+		bounds.Add(CVector3(minPt.x, minHeight, minPt.z + firstRow * zStep));
+		bounds.Add(CVector3(maxPt.x, maxHeight, minPt.z + (lastRow - 1) * zStep));
+	}
+}
+
+//Write every vertex of a (subDivX + 1) x (subDivZ + 1) grid running from minPt to maxPt
+void GridVertexData::Build(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap,
+                           const HeightFieldGradient* gradient /*= nullptr*/, ThreadPool* threadPool /*= nullptr*/)
+{
+	size_t oldSize = SizeInBytes();
+
+	m_MinPt = minPt;
+	m_MaxPt = maxPt;
+	m_SubDivX = subDivX;
+	m_SubDivZ = subDivZ;
+
+	// Every byte is about to be written, so there is no need to clear new memory first
+	if (m_Data == nullptr || SizeInBytes() != oldSize)  m_Data.reset(new char[SizeInBytes()]);
+
+	WriteGridVertices(m_Data.get(), m_Layout, minPt, maxPt, subDivX, subDivZ, heightMap, gradient, threadPool);
+
+	m_Bounds = BoundingBox();
+	AddRowBounds(m_Bounds, heightMap, minPt, maxPt, subDivX, subDivZ, 0, subDivZ + 1);
+}
+
+//Rewrite the vertices affected by a change to the heights in the given region and upload them
+int GridVertexData::Update(const HeightField& heightMap, const HeightFieldGradient* gradient, const GridRegion& dirty, IBufferUpdater& target,
+                           ThreadPool* threadPool /*= nullptr*/)
+{
+	if (m_Data == nullptr)  throw std::runtime_error("Grid vertex data updated before it was built");
+
+	// Heights just past the last column still change its normals, beyond that the grid doesn't see them
+	if (dirty.MaxX < 0 || dirty.MinX > m_SubDivX + 1)  return 0;
+
+	// Normals in the rows either side use central differences across the changed heights
+	int firstRow = std::max(dirty.MinZ - 1, 0);
+	int lastRow = std::min(dirty.MaxZ + 2, m_SubDivZ + 1);
+	if (lastRow <= firstRow)  return 0;
+
+	WriteGridVertexRows(m_Data.get(), m_Layout, m_MinPt, m_MaxPt, m_SubDivX, m_SubDivZ, heightMap, gradient, firstRow, lastRow, threadPool);
+	AddRowBounds(m_Bounds, heightMap, m_MinPt, m_MaxPt, m_SubDivX, m_SubDivZ, firstRow, lastRow);
+	target.Update(m_Data.get(), firstRow * RowSizeInBytes(), (lastRow - firstRow) * RowSizeInBytes());
+	return lastRow - firstRow;
+}
+
+//Upload every vertex
+void GridVertexData::UploadAll(IBufferUpdater& target) const
+{
+	target.Update(m_Data.get(), 0, SizeInBytes());
+}
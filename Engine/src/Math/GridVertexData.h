@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------
+// Grid vertex data - a persistent CPU-side copy of a grid mesh's vertices
+//--------------------------------------------------------------------------------------
+// Keeping the vertices after they have been sent to the GPU means an edit to a small part
+// of the HeightField (a sculpting brush, local erosion) only has to rewrite and upload the
+// rows of vertices it touched, rather than rebuilding the whole grid. Uploads go through an
+// IBufferUpdater so the same code drives the GPU buffer and CPU-side checks.
+
+#pragma once
+#include "epch.h"
+#include "Bounds.h"
+#include "GridVertices.h"
+
+class IBufferUpdater;
+class ThreadPool;
+
+//A rectangle of HeightField cells, both corners included
+struct GridRegion
+{
+	int MinX = 0;
+	int MinZ = 0;
+	int MaxX = 0;
+	int MaxZ = 0;
+
+	GridRegion() {}
+	GridRegion(int minX, int minZ, int maxX, int maxZ) : MinX(minX), MinZ(minZ), MaxX(maxX), MaxZ(maxZ) {}
+};
+
+class GridVertexData
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor, vertices will be written with the given layout
+	explicit GridVertexData(const GridVertexLayout& layout) : m_Layout(layout) {}
+
+	//Write every vertex of a (subDivX + 1) x (subDivZ + 1) grid running from minPt to maxPt
+	//The memory is only reallocated if the number of vertices changes
+	void Build(CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& heightMap,
+	           const HeightFieldGradient* gradient = nullptr, ThreadPool* threadPool = nullptr);
+
+	//Rewrite the vertices affected by a change to the heights in the given region (and the gradient, if there is one)
+	//and upload them. Heights affect the normals of their neighbours, so the rows either side are rewritten too.
+	//Whole rows are rewritten, the rows are contiguous so they go up in a single upload. Returns the rows rewritten
+	int Update(const HeightField& heightMap, const HeightFieldGradient* gradient, const GridRegion& dirty, IBufferUpdater& target,
+	           ThreadPool* threadPool = nullptr);
+
+	//Upload every vertex
+	void UploadAll(IBufferUpdater& target) const;
+
+	const GridVertexLayout& Layout() const { return m_Layout; }
+
+	int SubDivX() const { return m_SubDivX; }
+	int SubDivZ() const { return m_SubDivZ; }
+
+	unsigned int NumVertices() const { return static_cast<unsigned int>((m_SubDivX + 1) * (m_SubDivZ + 1)); }
+	size_t RowSizeInBytes() const { return static_cast<size_t>(m_SubDivX + 1) * m_Layout.VertexSize; }
+	size_t SizeInBytes()    const { return RowSizeInBytes() * (m_SubDivZ + 1); }
+
+	const char* Data() const { return m_Data.get(); }
+
+	//Box around every vertex position. Exact after Build, Update only ever grows it, so after edits that
+	//lower the terrain it can be taller than it needs to be until the next Build
+	const BoundingBox& Bounds() const { return m_Bounds; }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	GridVertexLayout m_Layout;
+
+	//Extents of the grid from the last Build
+	CVector3 m_MinPt = CVector3(0, 0, 0);
+	CVector3 m_MaxPt = CVector3(0, 0, 0);
+	int m_SubDivX = 0;
+	int m_SubDivZ = 0;
+
+	std::unique_ptr<char[]> m_Data;
+	BoundingBox m_Bounds; // Kept up to date as the vertices are written
+
+};
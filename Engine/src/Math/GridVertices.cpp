@@ -0,0 +1,214 @@
+#include "epch.h"
+#include "GridVertices.h"
+#include "GridVerticesKernels.h"
+#include "Utility/CpuFeatures.h"
+#include "Utility/ThreadPool.h"
+
+namespace
+{
+	//Aim for at least this many vertices in each chunk of work handed to the thread pool
+	const int kVerticesPerChunk = 16384;
+
+	//Round a vertex count up to a whole number of the groups the kernels work on
+	int RoundUpToLanes(int count)
+	{
+		return (count + kGridRowPadding - 1) / kGridRowPadding * kGridRowPadding;
+	}
+
+	using GridRowKernel = void (*)(const GridRowArgs&);
+
+	//The kernel for the SIMD level in use, see GetSimdLevel
+	struct GridVerticesKernels
+	{
+		const char*   name;
+		GridRowKernel row;
+	};
+
+	GridVerticesKernels SelectKernels()
+	{
+		if (GetSimdLevel() >= SimdLevel::AVX2)  return { "AVX2", WriteGridRowAVX2 };
+		return { "SSE2", WriteGridRowSSE2 };
+	}
+
+	const GridVerticesKernels& Kernels()
+	{
+		static const GridVerticesKernels kernels = SelectKernels();
+		return kernels;
+	}
+
+	template <class Index>
+	void WriteGridIndicesOfType(Index* out, int subDivX, int subDivZ)
+	{
+		Index tlIndex = 0;
+		Index rowVertices = static_cast<Index>(subDivX + 1);
+
+		//Go through each z coordinate of the grid
+		for (int z = 0; z < subDivZ; ++z)
+		{
+			//Go through each x coordinate of the grid
+			for (int x = 0; x < subDivX; ++x)
+			{
+				// Bottom-left triangle in grid square (looking down on the grid)
+				*out++ = tlIndex;
+				*out++ = tlIndex + rowVertices;
+				*out++ = tlIndex + 1;
+
+				// Top-right triangle in grid square
+				*out++ = tlIndex + 1;
+				*out++ = tlIndex + rowVertices;
+				*out++ = tlIndex + rowVertices + 1;
+
+				++tlIndex;
+			}
+			++tlIndex;
+		}
+	}
+}
+
+//Layout holding the given elements. Tangents are only useful alongside normals, so asking for tangents adds normals too
+GridVertexLayout GridVertexLayout::Make(bool normals, bool tangents, bool uvs)
+{
+	GridVertexLayout layout;
+	unsigned int offset = sizeof(CVector3);
+
+	if (normals || tangents)
+	{
+		layout.NormalOffset = offset;
+		offset += sizeof(CVector3);
+	}
+	if (tangents)
+	{
+		layout.TangentOffset = offset;
+		offset += sizeof(CVector3);
+	}
+	if (uvs)
+	{
+		layout.UVOffset = offset;
+		offset += sizeof(CVector2);
+	}
+
+	layout.VertexSize = offset;
+	return layout;
+}
+
+//Fill the vertices of a (subDivX + 1) x (subDivZ + 1) grid running from minPt to maxPt, heights taken from heightMap(x, z)
+void WriteGridVertices(char* vertexData, const GridVertexLayout& layout, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ,
+                       const HeightField& heightMap, const HeightFieldGradient* gradient /*= nullptr*/, ThreadPool* threadPool /*= nullptr*/)
+{
+	WriteGridVertexRows(vertexData, layout, minPt, maxPt, subDivX, subDivZ, heightMap, gradient, 0, subDivZ + 1, threadPool);
+}
+
+//As WriteGridVertices, but only rewrite the rows of vertices [firstRow, lastRow)
+void WriteGridVertexRows(char* vertexData, const GridVertexLayout& layout, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ,
+                         const HeightField& heightMap, const HeightFieldGradient* gradient, int firstRow, int lastRow, ThreadPool* threadPool /*= nullptr*/)
+{
+	if (heightMap.Width() <= subDivX || heightMap.Height() <= subDivZ)
+	{
+		throw std::runtime_error("HeightField is smaller than the grid being built from it");
+	}
+	if (gradient != nullptr && layout.HasNormals() &&
+	    (gradient->DX.Width() != heightMap.Width() || gradient->DX.Height() != heightMap.Height() ||
+	     gradient->DZ.Width() != heightMap.Width() || gradient->DZ.Height() != heightMap.Height()))
+	{
+		throw std::runtime_error("HeightFieldGradient is not the same size as the HeightField");
+	}
+	firstRow = std::max(firstRow, 0);
+	lastRow = std::min(lastRow, subDivZ + 1);
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	float xStep = (maxPt.x - minPt.x) / subDivX; // X-size of a single grid square
+	float zStep = (maxPt.z - minPt.z) / subDivZ; // Z-size of a single grid square
+	float vStep = 1.0f / subDivZ;                // V-size of a single grid square (UVs go from 0 to 1 over the whole grid)
+
+	int rowVertices = subDivX + 1;
+	int grainSize = std::max(kVerticesPerChunk / rowVertices, 1);
+	bool centralDifferences = layout.HasNormals() && gradient == nullptr;
+
+	threadPool->ParallelFor(firstRow, lastRow, grainSize, [&](int first, int last)
+	{
+		//Slopes of the row being written, padded to whole groups so the kernel never reads past the end
+		std::vector<float> slopes(centralDifferences ? 2 * RoundUpToLanes(rowVertices) : 0);
+
+		GridRowArgs args;
+		args.vertexSize = layout.VertexSize;
+		args.positionOffset = layout.PositionOffset;
+		args.normalOffset = layout.NormalOffset;
+		args.tangentOffset = layout.TangentOffset;
+		args.uvOffset = layout.UVOffset;
+		args.width = heightMap.Width();
+		args.gradientX = nullptr;
+		args.gradientZ = nullptr;
+		args.scratchX = slopes.data();
+		args.scratchZ = slopes.data() + (slopes.size() / 2);
+		args.count = rowVertices;
+		args.startX = minPt.x;
+		args.xStep = xStep;
+		args.zStep = zStep;
+
+		for (int z = first; z < last; ++z)
+		{
+			int previous = std::max(z - 1, 0);
+			int next = std::min(z + 1, heightMap.Height() - 1);
+
+			args.vertex = vertexData + static_cast<size_t>(z) * rowVertices * layout.VertexSize;
+			args.heights = heightMap.RowData(z);
+			args.previousHeights = heightMap.RowData(previous);
+			args.nextHeights = heightMap.RowData(next);
+			args.acrossRowsScale = next - previous == 2 ? 0.5f : (next == previous ? 0.0f : 1.0f);
+			if (!centralDifferences && layout.HasNormals())
+			{
+				//The gradient is laid out like the heights, rows padded to a multiple of 16 floats
+				args.gradientX = gradient->DX.RowData(z);
+				args.gradientZ = gradient->DZ.RowData(z);
+			}
+			args.z = minPt.z + z * zStep;
+			args.v = 1.0f - z * vStep; // V axis is opposite direction to Z
+			Kernels().row(args);
+		}
+	});
+}
+
+//Name of the instruction set WriteGridVertices uses on this CPU
+const char* GridVerticesKernelName()
+{
+	return Kernels().name;
+}
+
+//Normal and tangent of a single grid vertex worked out one at a time
+void GridNormalAt(const HeightField& heightMap, const HeightFieldGradient* gradient, int x, int z, float xStep, float zStep,
+                  CVector3& normal, CVector3& tangent)
+{
+	float slopeX;
+	float slopeZ;
+	if (gradient != nullptr)
+	{
+		slopeX = gradient->DX(x, z);
+		slopeZ = gradient->DZ(x, z);
+	}
+	else
+	{
+		//Central differences, one-sided at the edges
+		int left = std::max(x - 1, 0);
+		int right = std::min(x + 1, heightMap.Width() - 1);
+		int back = std::max(z - 1, 0);
+		int front = std::min(z + 1, heightMap.Height() - 1);
+		slopeX = right == left ? 0.0f : (heightMap(right, z) - heightMap(left, z)) / (right - left);
+		slopeZ = front == back ? 0.0f : (heightMap(x, front) - heightMap(x, back)) / (front - back);
+	}
+
+	float dhdx = slopeX / xStep;
+	float dhdz = slopeZ / zStep;
+	normal = Normalise(CVector3(-dhdx, 1.0f, -dhdz));
+	tangent = Normalise(CVector3(1.0f, dhdx, 0.0f));
+}
+
+//Fill GridIndexCount(subDivX, subDivZ) indices for the vertices written by WriteGridVertices
+void WriteGridIndices(uint16_t* out, int subDivX, int subDivZ)
+{
+	WriteGridIndicesOfType(out, subDivX, subDivZ);
+}
+
+void WriteGridIndices(uint32_t* out, int subDivX, int subDivZ)
+{
+	WriteGridIndicesOfType(out, subDivX, subDivZ);
+}
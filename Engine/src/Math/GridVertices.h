@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------
+// Grid vertices - positions, normals, tangents and uvs for a heightfield grid mesh
+//--------------------------------------------------------------------------------------
+// WriteGridVertices writes straight into the interleaved vertex data handed to the GPU.
+// Each row works out the slope of every vertex with central differences of the heights
+// (or takes it from a HeightFieldGradient), then turns the slopes into normals and
+// tangents eight at a time with Vec3SoA, using AVX2 where the CPU has it (see
+// GridVerticesKernels.h). Rows are spread over the thread pool.
+// The indices of a grid only depend on its size, see GridIndexCache for sharing them.
+
+#pragma once
+#include "epch.h"
+#include "CVector2.h"
+#include "CVector3.h"
+#include "HeightField.h"
+
+class ThreadPool;
+
+//Byte offsets of each element of a single grid vertex, -1 if the vertex doesn't have that element
+//Elements are in the same order as the assimp loader uses: position, normal, tangent, uv
+struct GridVertexLayout
+{
+	unsigned int VertexSize = sizeof(CVector3);
+
+	int PositionOffset = 0;
+	int NormalOffset   = -1;
+	int TangentOffset  = -1;
+	int UVOffset       = -1;
+
+	//Layout holding the given elements. Tangents are only useful alongside normals, so asking for tangents adds normals too
+	static GridVertexLayout Make(bool normals, bool tangents, bool uvs);
+
+	bool HasNormals()  const { return NormalOffset  >= 0; }
+	bool HasTangents() const { return TangentOffset >= 0; }
+	bool HasUVs()      const { return UVOffset      >= 0; }
+};
+
+//Largest difference allowed between the normals / tangents of WriteGridVertices and GridNormalAt
+const float kGridNormalTolerance = 1e-5f;
+
+//Fill the vertices of a (subDivX + 1) x (subDivZ + 1) grid running from minPt to maxPt, heights taken from heightMap(x, z)
+//The HeightField must be at least that size. Without a gradient the slopes come from central differences of
+//the heights (one-sided at the edges of the HeightField), so any HeightField gets real normals, including
+//imported or eroded ones. A gradient must be the same size as the HeightField (see FractalNoise::Generate).
+//The tangent points along +x across the surface, matching the U direction of the uvs.
+//Throws a std::runtime_error if the HeightField is too small or the gradient is the wrong size
+void WriteGridVertices(char* vertexData, const GridVertexLayout& layout, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ,
+                       const HeightField& heightMap, const HeightFieldGradient* gradient = nullptr, ThreadPool* threadPool = nullptr);
+
+//As WriteGridVertices, but only rewrite the rows of vertices [firstRow, lastRow). vertexData is still the start of the whole grid
+//Changing a height changes the normals of the rows either side of it too, so include those rows when heights have been edited
+void WriteGridVertexRows(char* vertexData, const GridVertexLayout& layout, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ,
+                         const HeightField& heightMap, const HeightFieldGradient* gradient, int firstRow, int lastRow, ThreadPool* threadPool = nullptr);
+
+//Name of the instruction set WriteGridVertices uses on this CPU
+const char* GridVerticesKernelName();
+
+//Normal and tangent of a single grid vertex worked out one at a time. Slow, but it is the reference WriteGridVertices is checked against
+void GridNormalAt(const HeightField& heightMap, const HeightFieldGradient* gradient, int x, int z, float xStep, float zStep,
+                  CVector3& normal, CVector3& tangent);
+
+//Number of indices in a subDivX x subDivZ grid drawn as a triangle list, two triangles for each grid square
+inline size_t GridIndexCount(int subDivX, int subDivZ)
+{
+	return static_cast<size_t>(subDivX) * subDivZ * 6;
+}
+
+//True if every vertex of the grid can be reached with a 16-bit index
+inline bool GridFitsSixteenBitIndices(int subDivX, int subDivZ)
+{
+	return (subDivX + 1LL) * (subDivZ + 1LL) <= 0x10000;
+}
+
+//Fill GridIndexCount(subDivX, subDivZ) indices for the vertices written by WriteGridVertices
+//The 16-bit version must only be used when GridFitsSixteenBitIndices is true
+void WriteGridIndices(uint16_t* out, int subDivX, int subDivZ);
+void WriteGridIndices(uint32_t* out, int subDivX, int subDivZ);
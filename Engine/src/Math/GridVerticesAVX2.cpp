@@ -0,0 +1,9 @@
+//--------------------------------------------------------------------------------------
+// AVX2 grid vertex row kernel, eight vertices at a time in AVX registers
+//--------------------------------------------------------------------------------------
+// Compiled with AVX2 enabled and without the precompiled header, see GridVerticesKernels.h.
+// Only called when the CPU supports AVX2 and FMA.
+
+#include "GridVerticesKernels.inl"
+
+void WriteGridRowAVX2(const GridRowArgs& args) { WriteGridRow(args); }
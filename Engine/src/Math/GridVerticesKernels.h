@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Row kernel behind WriteGridVertices
+//--------------------------------------------------------------------------------------
+// One kernel per instruction set, each in its own file so it can be compiled for that
+// instruction set, following the same scheme as the Perlin noise kernels. The kernel is
+// written once in GridVerticesKernels.inl against Vec3SoA, which is eight vectors wide in
+// both versions, so padding and results are the same whichever is used.
+// GridVertices.cpp picks the kernel once, for the level given by GetSimdLevel.
+
+#pragma once
+
+//The slope buffers are padded to a multiple of this many vertices
+const int kGridRowPadding = 8;
+
+struct GridRowArgs
+{
+	//First vertex of the row, and byte offsets of each element within a vertex (-1 if the vertices don't have it)
+	char*        vertex;
+	unsigned int vertexSize;
+	int          positionOffset;
+	int          normalOffset;
+	int          tangentOffset;
+	int          uvOffset;
+
+	//Heights of this row and of the rows either side (this row again at the edge of the HeightField). Rows are
+	//padded to a multiple of 16 floats. acrossRowsScale turns the difference of the rows either side into a slope
+	//per cell: 0.5 for a central difference, 1 at an edge, 0 if the HeightField is a single row
+	const float* heights;
+	const float* previousHeights;
+	const float* nextHeights;
+	float        acrossRowsScale;
+	int          width; // Width of the HeightField
+
+	//Slopes per cell from a HeightFieldGradient, or null to work them out from the heights into the scratch buffers
+	//(padded to a multiple of kGridRowPadding). Only used when the vertices have normals
+	const float* gradientX;
+	const float* gradientZ;
+	float*       scratchX;
+	float*       scratchZ;
+
+	//Number of vertices in the row, and where they are
+	int   count;
+	float startX;
+	float z;
+	float xStep;
+	float zStep;
+	float v;
+};
+
+void WriteGridRowSSE2(const GridRowArgs& args);
+void WriteGridRowAVX2(const GridRowArgs& args);
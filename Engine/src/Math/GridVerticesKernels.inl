@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------
+// Grid vertex row kernel, written once for every instruction set
+//--------------------------------------------------------------------------------------
+// Included by each kernel file. Vec3SoA picks its registers from the settings the file is
+// compiled with, and everything here is in an anonymous namespace, so each file gets its
+// own copy compiled for its own instruction set. No standard library here, for the same
+// reason the AVX2 files don't use the precompiled header.
+
+#include "GridVerticesKernels.h"
+#include "Vec3SoA.h"
+
+namespace
+{
+	const int kLanes = kFloat8Width;
+
+	//Change in height per cell along x at every vertex of a row, from central differences of the heights
+	//Falls back to one-sided differences at the edges of the HeightField
+	void SlopeAlongRow(const float* heights, int width, int count, float* slopeX)
+	{
+		if (width < 2)
+		{
+			for (int x = 0; x < count; ++x)  slopeX[x] = 0.0f;
+			return;
+		}
+
+		//Vertices with a neighbour on both sides
+		int interiorEnd = count < width - 1 ? count : width - 1;
+		int x = 1;
+		const float8 half = Splat(0.5f);
+		for (; x + kLanes <= interiorEnd; x += kLanes)
+		{
+			Store(slopeX + x, (Load(heights + x + 1) - Load(heights + x - 1)) * half);
+		}
+		for (; x < interiorEnd; ++x)
+		{
+			slopeX[x] = (heights[x + 1] - heights[x - 1]) * 0.5f;
+		}
+
+		slopeX[0] = heights[1] - heights[0];
+		if (count == width)  slopeX[width - 1] = heights[width - 1] - heights[width - 2];
+	}
+
+	//Change in height per cell along z at every vertex of a row, from central differences of the rows either side
+	void SlopeAcrossRows(const float* previousRow, const float* nextRow, float scale, int count, float* slopeZ)
+	{
+		const float8 scaleVector = Splat(scale);
+
+		//Rows are padded to a multiple of 16 floats, so whole groups can be read past the last vertex
+		for (int x = 0; x < count; x += kLanes)
+		{
+			Store(slopeZ + x, (Load(nextRow + x) - Load(previousRow + x)) * scaleVector);
+		}
+	}
+
+	//Write a single row of vertices, eight at a time
+	void WriteGridRow(const GridRowArgs& args)
+	{
+		const float* slopeX = args.gradientX;
+		const float* slopeZ = args.gradientZ;
+		bool normals = args.normalOffset >= 0;
+		if (normals && slopeX == nullptr)
+		{
+			SlopeAlongRow(args.heights, args.width, args.count, args.scratchX);
+			SlopeAcrossRows(args.previousHeights, args.nextHeights, args.acrossRowsScale, args.count, args.scratchZ);
+			slopeX = args.scratchX;
+			slopeZ = args.scratchZ;
+		}
+
+		//The slopes are per cell, the normal needs the change in height per unit of distance
+		const float8 xSlopeScale = Splat(1.0f / args.xStep);
+		const float8 zSlopeScale = Splat(1.0f / args.zStep);
+		const float8 zero = Splat(0.0f);
+		const float8 one = Splat(1.0f);
+
+		float uStep = 1.0f / (args.count - 1);
+
+		char* vertex = args.vertex;
+		for (int first = 0; first < args.count; first += kLanes, vertex += kLanes * args.vertexSize)
+		{
+			int groupSize = args.count - first < kLanes ? args.count - first : kLanes;
+
+			Vec3SoA position = { (Splat(static_cast<float>(first)) + LaneIndices()) * Splat(args.xStep) + Splat(args.startX),
+			                     Load(args.heights + first), Splat(args.z) };
+			ScatterVec3(vertex + args.positionOffset, args.vertexSize, position, groupSize);
+
+			if (normals)
+			{
+				//The surface y = h(x, z) has the normal (-dh/dx, 1, -dh/dz) and the tangent along x (1, dh/dx, 0)
+				//Normalise uses a full precision square root and divide rather than the approximate reciprocal square root,
+				//which is only good to 12 bits and would show up as banding in the lighting
+				float8 dhdx = Load(slopeX + first) * xSlopeScale;
+				float8 dhdz = Load(slopeZ + first) * zSlopeScale;
+				ScatterVec3(vertex + args.normalOffset, args.vertexSize, Normalise(Vec3SoA{ -dhdx, one, -dhdz }), groupSize);
+				if (args.tangentOffset >= 0)
+				{
+					ScatterVec3(vertex + args.tangentOffset, args.vertexSize, Normalise(Vec3SoA{ one, dhdx, zero }), groupSize);
+				}
+			}
+
+			if (args.uvOffset >= 0)
+			{
+				char* uv = vertex + args.uvOffset;
+				for (int lane = 0; lane < groupSize; ++lane, uv += args.vertexSize)
+				{
+					float* u = reinterpret_cast<float*>(uv);
+					u[0] = (first + lane) * uStep;
+					u[1] = args.v;
+				}
+			}
+		}
+	}
+}
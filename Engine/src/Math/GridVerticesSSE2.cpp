@@ -0,0 +1,10 @@
+//--------------------------------------------------------------------------------------
+// SSE2 grid vertex row kernel, eight vertices at a time in pairs of SSE registers
+//--------------------------------------------------------------------------------------
+// SSE2 is always available on x64, so this is built with the same settings as the rest
+// of the engine and used whenever the CPU has nothing wider.
+
+#include "epch.h"
+#include "GridVerticesKernels.inl"
+
+void WriteGridRowSSE2(const GridRowArgs& args) { WriteGridRow(args); }
@@ -0,0 +1,152 @@
+#include "epch.h"
+#include "HeightField.h"
+#include <cstring>
+
+namespace
+{
+	//Allocate memory aligned to the given number of bytes
+	float* AlignedAllocate(size_t bytes, size_t alignment)
+	{
+#ifdef _MSC_VER
+		void* memory = _aligned_malloc(bytes, alignment);
+#else
+		void* memory = std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+#endif
+		if (memory == nullptr)  throw std::bad_alloc();
+		return static_cast<float*>(memory);
+	}
+
+	//Free memory that was allocated with AlignedAllocate
+	void AlignedFree(float* memory)
+	{
+#ifdef _MSC_VER
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+//Constructor to allocate a width x height HeightField with every height set to the given value
+HeightField::HeightField(int width, int height, float value /*= 0.0f*/)
+{
+	Resize(width, height, value);
+}
+
+HeightField::HeightField(const HeightField& other)
+{
+	*this = other;
+}
+
+HeightField::HeightField(HeightField&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+HeightField& HeightField::operator=(const HeightField& other)
+{
+	if (this != &other)
+	{
+		if (m_Width != other.m_Width || m_Height != other.m_Height)
+		{
+			Resize(other.m_Width, other.m_Height);
+		}
+		if (other.m_Data)
+		{
+			memcpy(m_Data, other.m_Data, other.SizeInBytes());
+		}
+	}
+	return *this;
+}
+
+HeightField& HeightField::operator=(HeightField&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_Data     = other.m_Data;
+		m_Capacity = other.m_Capacity;
+		m_Width    = other.m_Width;
+		m_Height   = other.m_Height;
+		m_Stride   = other.m_Stride;
+
+		other.m_Data = nullptr;
+		other.m_Capacity = 0;
+		other.m_Width = other.m_Height = other.m_Stride = 0;
+	}
+	return *this;
+}
+
+//Destructor
+HeightField::~HeightField()
+{
+	Release();
+}
+
+//Resize the HeightField, existing heights are discarded. The allocation is kept if it is big enough
+void HeightField::Resize(int width, int height, float value /*= 0.0f*/)
+{
+	if (width <= 0 || height <= 0)
+	{
+		Release();
+		return;
+	}
+
+	//Pad each row to a whole number of alignment blocks so every row starts aligned
+	const int floatsPerBlock = kAlignment / static_cast<int>(sizeof(float));
+	const int stride = (width + floatsPerBlock - 1) / floatsPerBlock * floatsPerBlock;
+	const size_t numFloats = static_cast<size_t>(stride) * height;
+	if (numFloats > m_Capacity)
+	{
+		Release();
+		m_Data = AlignedAllocate(numFloats * sizeof(float), kAlignment);
+		m_Capacity = numFloats;
+	}
+	m_Width  = width;
+	m_Height = height;
+	m_Stride = stride;
+	Fill(value);
+}
+
+//Set every height (including the row padding) to the given value
+void HeightField::Fill(float value)
+{
+	//Zero, what nearly every HeightField starts as, is cleared by memset, which streams past the cache for large sizes
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	if (bits == 0)  memset(m_Data, 0, SizeInBytes());
+	else            std::fill(m_Data, m_Data + static_cast<size_t>(m_Stride) * m_Height, value);
+}
+
+//Get a single height with the coordinates clamped to the edges of the HeightField
+float HeightField::ClampedAt(int x, int z) const
+{
+	x = std::min(std::max(x, 0), m_Width - 1);
+	z = std::min(std::max(z, 0), m_Height - 1);
+	return RowData(z)[x];
+}
+
+//Find the lowest and highest heights in the HeightField
+void HeightField::MinMax(float& minHeight, float& maxHeight) const
+{
+	minHeight = std::numeric_limits<float>::max();
+	maxHeight = std::numeric_limits<float>::lowest();
+	for (int z = 0; z < m_Height; ++z)
+	{
+		const float* row = RowData(z);
+		for (int x = 0; x < m_Width; ++x)
+		{
+			minHeight = std::min(minHeight, row[x]);
+			maxHeight = std::max(maxHeight, row[x]);
+		}
+	}
+}
+
+//Free the current allocation and reset the size to 0 x 0
+void HeightField::Release()
+{
+	if (m_Data)  AlignedFree(m_Data);
+	m_Data = nullptr;
+	m_Capacity = 0;
+	m_Width = m_Height = m_Stride = 0;
+}
@@ -0,0 +1,129 @@
+//--------------------------------------------------------------------------------------
+// HeightField class - a flat, 2D array of heights used by the terrain pipeline
+//--------------------------------------------------------------------------------------
+// All rows live in a single 64-byte aligned allocation. Each row is padded out to a
+// multiple of 16 floats (the stride) so that every row also starts on a 64-byte boundary,
+// which lets SIMD code stream through a row without any unaligned loads.
+// Heights are indexed as (x, z), x being the column and z being the row.
+
+#pragma once
+#include "epch.h"
+
+class HeightField
+{
+//----------------------//
+// Row access types		//
+//----------------------//
+public:
+	//A view of a single row in the HeightField, allows the old heightMap[z][x] syntax to keep working
+	template <class T>
+	struct TRowView
+	{
+		T*  data  = nullptr;
+		int width = 0;
+
+		T& operator[](int x) const { return data[x]; }
+
+		T* begin() const { return data; }
+		T* end()   const { return data + width; }
+	};
+
+	using RowView      = TRowView<float>;
+	using ConstRowView = TRowView<const float>;
+
+	//Every row begins on a boundary of this many bytes
+	static const int kAlignment = 64;
+
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor for an empty HeightField
+	HeightField() {}
+
+	//Constructor to allocate a width x height HeightField with every height set to the given value
+	HeightField(int width, int height, float value = 0.0f);
+
+	HeightField(const HeightField& other);
+	HeightField(HeightField&& other) noexcept;
+	HeightField& operator=(const HeightField& other);
+	HeightField& operator=(HeightField&& other) noexcept;
+
+	//Destructor
+	~HeightField();
+
+	//Resize the HeightField, existing heights are discarded. The allocation is kept if it is big enough, so a HeightField
+	//that is regenerated (or copied into) again and again only allocates the first time
+	void Resize(int width, int height, float value = 0.0f);
+
+	//Set every height (including the row padding) to the given value
+	void Fill(float value);
+
+	//Number of columns, number of rows and the distance in floats between the start of each row
+	int Width()  const { return m_Width;  }
+	int Height() const { return m_Height; }
+	int Stride() const { return m_Stride; }
+
+	bool Empty() const { return m_Data == nullptr; }
+
+	//Size of the whole allocation including row padding
+	size_t SizeInBytes() const { return static_cast<size_t>(m_Stride) * m_Height * sizeof(float); }
+
+	//Pointer to the first height of the first row
+	float*       Data()       { return m_Data; }
+	const float* Data() const { return m_Data; }
+
+	//Pointer to the first height of the given row
+	float*       RowData(int z)       { return m_Data + static_cast<size_t>(z) * m_Stride; }
+	const float* RowData(int z) const { return m_Data + static_cast<size_t>(z) * m_Stride; }
+
+	//View of a single row
+	RowView      Row(int z)       { return { RowData(z), m_Width }; }
+	ConstRowView Row(int z) const { return { RowData(z), m_Width }; }
+
+	RowView      operator[](int z)       { return Row(z); }
+	ConstRowView operator[](int z) const { return Row(z); }
+
+	//Access a single height
+	float&       operator()(int x, int z)       { return RowData(z)[x]; }
+	const float& operator()(int x, int z) const { return RowData(z)[x]; }
+
+	//Get a single height with the coordinates clamped to the edges of the HeightField
+	float ClampedAt(int x, int z) const;
+
+	//Find the lowest and highest heights in the HeightField
+	void MinMax(float& minHeight, float& maxHeight) const;
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Free the current allocation and reset the size to 0 x 0
+	void Release();
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	float* m_Data     = nullptr;
+	size_t m_Capacity = 0; //Floats allocated, at least m_Stride * m_Height
+
+	int m_Width  = 0;
+	int m_Height = 0;
+	int m_Stride = 0;
+};
+
+
+//Slope of a HeightField at every cell, as the change in height per cell along x (DX) and along z (DZ)
+struct HeightFieldGradient
+{
+	HeightField DX;
+	HeightField DZ;
+
+	//Resize both HeightFields if they are not already the given size, the contents are lost when they are resized
+	void Resize(int width, int height)
+	{
+		if (DX.Width() != width || DX.Height() != height)  DX.Resize(width, height);
+		if (DZ.Width() != width || DZ.Height() != height)  DZ.Resize(width, height);
+	}
+};
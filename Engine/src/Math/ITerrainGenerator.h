@@ -0,0 +1,21 @@
+//--------------------------------------------------------------------------------------
+// Interface for anything that fills a terrain HeightField
+//--------------------------------------------------------------------------------------
+// Lets DiamondSquare and FractalNoise be swapped freely when building terrain, the result
+// goes into the same HeightField and through the same grid mesh code either way.
+
+#pragma once
+#include "epch.h"
+
+class HeightField;
+class ThreadPool;
+
+class ITerrainGenerator
+{
+public:
+	virtual ~ITerrainGenerator() {}
+
+	//Fill the HeightField with new heights, spreading the work over the given thread pool (the shared pool by default).
+	//Generators that work at a fixed size resize the HeightField, others fill it at its current size.
+	virtual void Generate(HeightField& heightMap, ThreadPool* threadPool = nullptr) = 0;
+};
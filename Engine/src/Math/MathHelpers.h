@@ -70,4 +70,31 @@ inline double Random(const double a, const double b)
 	return a + (b - a) * (static_cast<double>(rand()) / RAND_MAX);
 }
 
+
+// Stateless random numbers - hash a seed and up to three integer coordinates into 32 random bits
+// Unlike rand() there is no hidden state, the same inputs always give the same result, so it can be
+// called from any number of threads in any order and still produce repeatable output
+inline uint32_t HashRandom(uint32_t seed, uint32_t a, uint32_t b = 0, uint32_t c = 0)
+{
+	// Mix each input in turn with the murmur3 finaliser, which spreads every input bit across the output
+	uint32_t h = seed ^ 0x9E3779B9u;
+	for (uint32_t input : { a, b, c })
+	{
+		h ^= input + 0x7F4A7C15u + (h << 6) + (h >> 2);
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+	}
+	return h;
+}
+
+// Return a random 32-bit float from a to b (inclusive) from the result of HashRandom
+inline float RandomFromHash(uint32_t hash, const float a, const float b)
+{
+	// Top 24 bits give every float step in [0, 1] exactly
+	return a + (b - a) * (static_cast<float>(hash >> 8) / static_cast<float>(0xFFFFFF));
+}
+
 #endif // _MATH_HELPERS_H_DEFINED_
@@ -0,0 +1,19 @@
+//--------------------------------------------------------------------------------------
+// Kernels behind the CMatrix4x4 batch functions
+//--------------------------------------------------------------------------------------
+// One set of kernels per instruction set. The AVX2 kernels are in their own file so they can
+// be compiled for AVX2, and like the Perlin noise kernels they don't include any engine
+// headers, so nothing shared is compiled for AVX2. Matrices are 16 floats in CMatrix4x4's
+// row order, aligned to 16 bytes, and multiply row vectors (v' = v * m). Points are 3 floats.
+// CMatrix4x4.cpp picks the kernels once, for the level given by GetSimdLevel.
+
+#pragma once
+#include <cstddef>
+
+//out[i] = in[i] * m for count matrices, out can be the same as in
+void MultiplyMatricesSSE2(const float* in, const float* m, float* out, size_t count);
+void MultiplyMatricesAVX2(const float* in, const float* m, float* out, size_t count);
+
+//out[i] = (in[i], 1) * m for count points, out can be the same as in
+void TransformPointsSSE2(const float* in, const float* m, float* out, size_t count);
+void TransformPointsAVX2(const float* in, const float* m, float* out, size_t count);
@@ -0,0 +1,29 @@
+#include "epch.h"
+#include "NodeTransforms.h"
+
+//Set the number of nodes. New nodes have no translation, rotation or scaling
+void NodeTransforms::Resize(int count)
+{
+	m_Positions.resize(count, CVector3{ 0, 0, 0 });
+	m_Rotations.resize(count, QuaternionIdentity());
+	m_Scales.resize(count, CVector3{ 1, 1, 1 });
+	m_Matrices.resize(count, MatrixIdentity());
+	m_Dirty.resize(count, 0);
+}
+
+//Set position, rotation and scale from a matrix, which must not have shearing
+void NodeTransforms::SetMatrix(int node, const CMatrix4x4& matrix)
+{
+	DecomposeTransform(matrix, m_Positions[node], m_Rotations[node], m_Scales[node]);
+
+	//The matrix given is exact, rebuilding it from the parts would only add rounding
+	m_Matrices[node] = matrix;
+	m_Dirty[node] = 0;
+}
+
+//Build the matrix of a node from its position, rotation and scale
+void NodeTransforms::Compose(int node) const
+{
+	m_Matrices[node] = MatrixFromTransform(m_Positions[node], m_Rotations[node], m_Scales[node]);
+	m_Dirty[node] = 0;
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Node transforms - position, rotation and scale with a lazily built matrix
+//--------------------------------------------------------------------------------------
+// Each node keeps its position, rotation (a quaternion) and scale. Setting any of them only
+// marks the node dirty, the matrix is built the next time it is read. So a prop that is
+// moved, turned and scaled in a frame costs one matrix composition, not three rebuilds, and
+// reading its rotation back doesn't need the matrix to be taken apart again.
+
+#pragma once
+#include "epch.h"
+#include "CQuaternion.h"
+
+class NodeTransforms
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Set the number of nodes. New nodes have no translation, rotation or scaling
+	void Resize(int count);
+
+	int Size() const { return static_cast<int>(m_Positions.size()); }
+
+	const CVector3&    Position(int node) const { return m_Positions[node]; }
+	const CQuaternion& Rotation(int node) const { return m_Rotations[node]; }
+	const CVector3&    Scale(int node)    const { return m_Scales[node]; }
+
+	void SetPosition(int node, const CVector3& position)    { m_Positions[node] = position; m_Dirty[node] = 1; }
+	void SetRotation(int node, const CQuaternion& rotation) { m_Rotations[node] = rotation; m_Dirty[node] = 1; }
+	void SetScale(int node, const CVector3& scale)          { m_Scales[node] = scale;       m_Dirty[node] = 1; }
+
+	//Set position, rotation and scale from a matrix, which must not have shearing. The matrix is kept as it is
+	void SetMatrix(int node, const CMatrix4x4& matrix);
+
+	//Matrix that scales, rotates then translates. Built now if the node has changed since it was last read
+	const CMatrix4x4& Matrix(int node) const
+	{
+		if (m_Dirty[node])  Compose(node);
+		return m_Matrices[node];
+	}
+
+	//True if the node has changed since its matrix was last built
+	bool IsDirty(int node) const { return m_Dirty[node] != 0; }
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	void Compose(int node) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::vector<CVector3>    m_Positions;
+	std::vector<CQuaternion> m_Rotations;
+	std::vector<CVector3>    m_Scales;
+
+	//Cache of the composed matrices, rebuilt on read when the node is dirty
+	mutable std::vector<CMatrix4x4> m_Matrices;
+	mutable std::vector<uint8_t>    m_Dirty;
+};
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Row kernels behind CPerlinNoise::GenerateRow and GenerateGrid
+//--------------------------------------------------------------------------------------
+// One set of kernels per instruction set, each in its own file so it can be compiled for
+// that instruction set. The files for the wider instruction sets do not use the precompiled
+// header, so nothing compiled for AVX2 / AVX-512 leaks into code run on other CPUs.
+// The kernels themselves are written once in PerlinNoiseKernels.inl.
+// CPerlinNoise picks the kernels once, for the level given by GetSimdLevel.
+
+#pragma once
+
+//The per-column arrays are padded to a multiple of this, so kernels can always load whole blocks
+const int kPerlinColumnPadding = 16;
+
+struct PerlinRowArgs
+{
+	//Tables from CPerlinNoise, 512 entries each
+	const int* permutation;
+	const int* gradients;
+
+	//Worked out once per column: permutation[X] and permutation[X + 1] for the unit cube
+	//the column is in, its position within that cube, the fade curve of that position and
+	//the slope of the fade curve (only used by the derivative kernels)
+	const int*   hashX0;
+	const int*   hashX1;
+	const float* fractionX;
+	const float* fadeX;
+	const float* fadeSlopeX;
+
+	//Worked out once per row, and the constant z position
+	int   unitY;
+	float fractionY;
+	float fadeY;
+	float fadeSlopeY;
+	int   unitZ;
+	float fractionZ;
+	float fadeZ;
+
+	//Output for this row. The derivative kernels also write the partial derivatives along noise x and y
+	float* out;
+	float* outDX;
+	float* outDY;
+	int    count;
+};
+
+void PerlinRowSSE2(const PerlinRowArgs& args);
+void PerlinRowAVX2(const PerlinRowArgs& args);
+void PerlinRowAVX512(const PerlinRowArgs& args);
+
+void PerlinRowDerivativesSSE2(const PerlinRowArgs& args);
+void PerlinRowDerivativesAVX2(const PerlinRowArgs& args);
+void PerlinRowDerivativesAVX512(const PerlinRowArgs& args);
@@ -0,0 +1,148 @@
+//--------------------------------------------------------------------------------------
+// Perlin noise row kernels, written once for every instruction set
+//--------------------------------------------------------------------------------------
+// Included by each kernel file after it defines a Simd type with the operations below for
+// its register width. Everything is in an anonymous namespace, so each file gets its own
+// copy compiled for its own instruction set.
+//
+//   Float, Int, kWidth
+//   LoadFloat, LoadInt, SetFloat, SetInt, Add, Sub, Mul, MulAdd (a * b + c), AddInt,
+//   Gather(table, index), Field<kShift>(packed) (signed 2-bit field to float), Store(out, value, count)
+
+#include "PerlinNoiseKernels.h"
+
+namespace
+{
+	template <class Simd>
+	struct PerlinCorner
+	{
+		typename Simd::Float value;     //Gradient dotted with the offset from the corner
+		typename Simd::Float gradientX;
+		typename Simd::Float gradientY;
+	};
+
+	//Look up the packed gradients for a block of hashes and dot them with the given offsets
+	template <class Simd>
+	inline PerlinCorner<Simd> EvaluateCorner(const int* gradients, typename Simd::Int hash,
+	                                         typename Simd::Float x, typename Simd::Float y, typename Simd::Float z)
+	{
+		typename Simd::Int packed = Simd::Gather(gradients, hash);
+		PerlinCorner<Simd> corner;
+		corner.gradientX = Simd::template Field<0>(packed);
+		corner.gradientY = Simd::template Field<2>(packed);
+		typename Simd::Float gradientZ = Simd::template Field<4>(packed);
+		corner.value = Simd::MulAdd(corner.gradientX, x, Simd::MulAdd(corner.gradientY, y, Simd::Mul(gradientZ, z)));
+		return corner;
+	}
+
+	template <class Simd>
+	inline typename Simd::Float Lerp(typename Simd::Float t, typename Simd::Float a, typename Simd::Float b)
+	{
+		return Simd::MulAdd(t, Simd::Sub(b, a), a);
+	}
+
+	//The 8 corners of the unit cube around each point of a block
+	template <class Simd>
+	struct PerlinCube
+	{
+		PerlinCorner<Simd> c000, c100, c010, c110, c001, c101, c011, c111;
+	};
+
+	template <class Simd>
+	inline PerlinCube<Simd> EvaluateCube(const PerlinRowArgs& args, int i)
+	{
+		using Float = typename Simd::Float;
+		using Int = typename Simd::Int;
+
+		const Int one = Simd::SetInt(1);
+		const Int unitY = Simd::SetInt(args.unitY);
+		const Int unitZ = Simd::SetInt(args.unitZ);
+		const Float y0 = Simd::SetFloat(args.fractionY);
+		const Float y1 = Simd::SetFloat(args.fractionY - 1.0f);
+		const Float z0 = Simd::SetFloat(args.fractionZ);
+		const Float z1 = Simd::SetFloat(args.fractionZ - 1.0f);
+
+		//Hash coordinates of the 8 cube corners
+		Int A = Simd::AddInt(Simd::LoadInt(args.hashX0 + i), unitY);
+		Int B = Simd::AddInt(Simd::LoadInt(args.hashX1 + i), unitY);
+		Int AA = Simd::AddInt(Simd::Gather(args.permutation, A), unitZ);
+		Int AB = Simd::AddInt(Simd::Gather(args.permutation, Simd::AddInt(A, one)), unitZ);
+		Int BA = Simd::AddInt(Simd::Gather(args.permutation, B), unitZ);
+		Int BB = Simd::AddInt(Simd::Gather(args.permutation, Simd::AddInt(B, one)), unitZ);
+
+		Float x0 = Simd::LoadFloat(args.fractionX + i);
+		Float x1 = Simd::Sub(x0, Simd::SetFloat(1.0f));
+
+		PerlinCube<Simd> cube;
+		cube.c000 = EvaluateCorner<Simd>(args.gradients, AA, x0, y0, z0);
+		cube.c100 = EvaluateCorner<Simd>(args.gradients, BA, x1, y0, z0);
+		cube.c010 = EvaluateCorner<Simd>(args.gradients, AB, x0, y1, z0);
+		cube.c110 = EvaluateCorner<Simd>(args.gradients, BB, x1, y1, z0);
+		cube.c001 = EvaluateCorner<Simd>(args.gradients, Simd::AddInt(AA, one), x0, y0, z1);
+		cube.c101 = EvaluateCorner<Simd>(args.gradients, Simd::AddInt(BA, one), x1, y0, z1);
+		cube.c011 = EvaluateCorner<Simd>(args.gradients, Simd::AddInt(AB, one), x0, y1, z1);
+		cube.c111 = EvaluateCorner<Simd>(args.gradients, Simd::AddInt(BB, one), x1, y1, z1);
+		return cube;
+	}
+
+	//Blend a value from the 8 corners in the same order as CPerlinNoise::noise
+	template <class Simd, class Corner>
+	inline typename Simd::Float Trilinear(typename Simd::Float u, typename Simd::Float v, typename Simd::Float w,
+	                                      const PerlinCube<Simd>& cube, Corner corner)
+	{
+		return Lerp<Simd>(w, Lerp<Simd>(v, Lerp<Simd>(u, corner(cube.c000), corner(cube.c100)), Lerp<Simd>(u, corner(cube.c010), corner(cube.c110))),
+		                     Lerp<Simd>(v, Lerp<Simd>(u, corner(cube.c001), corner(cube.c101)), Lerp<Simd>(u, corner(cube.c011), corner(cube.c111))));
+	}
+
+	template <class Simd>
+	void PerlinRow(const PerlinRowArgs& args)
+	{
+		using Float = typename Simd::Float;
+		const Float half = Simd::SetFloat(0.5f);
+		const Float v = Simd::SetFloat(args.fadeY);
+		const Float w = Simd::SetFloat(args.fadeZ);
+
+		for (int i = 0; i < args.count; i += Simd::kWidth)
+		{
+			PerlinCube<Simd> cube = EvaluateCube<Simd>(args, i);
+			Float u = Simd::LoadFloat(args.fadeX + i);
+
+			Float value = Trilinear<Simd>(u, v, w, cube, [](const PerlinCorner<Simd>& c) { return c.value; });
+			Simd::Store(args.out + i, Simd::MulAdd(value, half, half), args.count - i);
+		}
+	}
+
+	//As PerlinRow, plus the partial derivatives along noise x and y. Each is the blend of that component
+	//of the corner gradients, plus the slope of the fade curve times the change in value across the cube
+	template <class Simd>
+	void PerlinRowDerivatives(const PerlinRowArgs& args)
+	{
+		using Float = typename Simd::Float;
+		const Float half = Simd::SetFloat(0.5f);
+		const Float v = Simd::SetFloat(args.fadeY);
+		const Float w = Simd::SetFloat(args.fadeZ);
+		const Float dv = Simd::SetFloat(args.fadeSlopeY);
+
+		for (int i = 0; i < args.count; i += Simd::kWidth)
+		{
+			PerlinCube<Simd> cube = EvaluateCube<Simd>(args, i);
+			Float u = Simd::LoadFloat(args.fadeX + i);
+			Float du = Simd::LoadFloat(args.fadeSlopeX + i);
+
+			Float value = Trilinear<Simd>(u, v, w, cube, [](const PerlinCorner<Simd>& c) { return c.value; });
+			Float gradientX = Trilinear<Simd>(u, v, w, cube, [](const PerlinCorner<Simd>& c) { return c.gradientX; });
+			Float gradientY = Trilinear<Simd>(u, v, w, cube, [](const PerlinCorner<Simd>& c) { return c.gradientY; });
+
+			Float changeX = Lerp<Simd>(w, Lerp<Simd>(v, Simd::Sub(cube.c100.value, cube.c000.value), Simd::Sub(cube.c110.value, cube.c010.value)),
+			                              Lerp<Simd>(v, Simd::Sub(cube.c101.value, cube.c001.value), Simd::Sub(cube.c111.value, cube.c011.value)));
+			Float changeY = Lerp<Simd>(w, Lerp<Simd>(u, Simd::Sub(cube.c010.value, cube.c000.value), Simd::Sub(cube.c110.value, cube.c100.value)),
+			                              Lerp<Simd>(u, Simd::Sub(cube.c011.value, cube.c001.value), Simd::Sub(cube.c111.value, cube.c101.value)));
+
+			//noise() returns (value + 1) / 2, so the derivatives are halved too
+			int remaining = args.count - i;
+			Simd::Store(args.out + i, Simd::MulAdd(value, half, half), remaining);
+			Simd::Store(args.outDX + i, Simd::Mul(Simd::MulAdd(du, changeX, gradientX), half), remaining);
+			Simd::Store(args.outDY + i, Simd::Mul(Simd::MulAdd(dv, changeY, gradientY), half), remaining);
+		}
+	}
+}
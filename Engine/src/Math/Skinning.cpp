@@ -0,0 +1,248 @@
+#include "epch.h"
+#include "Skinning.h"
+#include "SkinningKernels.h"
+#include "Utility/CpuFeatures.h"
+#include "Utility/ThreadPool.h"
+#include <emmintrin.h>
+
+namespace
+{
+	//Roughly how many vertices each thread pool task should skin. A few thousand keeps the bones in cache and the
+	//tasks long enough to be worth queuing
+	const int kVerticesPerChunk = 2048;
+
+	using SkinningKernel = void (*)(const SkinningArgs&);
+
+	//The skinning kernel for the SIMD level in use, see GetSimdLevel
+	struct SkinningKernels
+	{
+		const char*    name;
+		SkinningKernel skinVertices;
+	};
+
+	SkinningKernels SelectKernels()
+	{
+		if (GetSimdLevel() >= SimdLevel::AVX2)  return { "AVX2", SkinVerticesAVX2 };
+		return { "SSE2", SkinVerticesSSE2 };
+	}
+
+	const SkinningKernels& Kernels()
+	{
+		static const SkinningKernels kernels = SelectKernels();
+		return kernels;
+	}
+
+
+	//Pack the two layouts into kernel arguments, leaving out any part that isn't in both
+	SkinningArgs MakeArgs(const void* vertices, const SkinnedVertexLayout& layout, int numVertices, const CMatrix4x4* boneMatrices,
+	                      void* output, const SkinnedVertexLayout& outputLayout)
+	{
+		auto both = [](int in, int out) { return in >= 0 && out >= 0; };
+		SkinningArgs args;
+		args.vertices       = static_cast<const char*>(vertices);
+		args.vertexSize     = layout.VertexSize;
+		args.positionOffset = both(layout.PositionOffset, outputLayout.PositionOffset) ? layout.PositionOffset : -1;
+		args.normalOffset   = both(layout.NormalOffset,   outputLayout.NormalOffset)   ? layout.NormalOffset   : -1;
+		args.tangentOffset  = both(layout.TangentOffset,  outputLayout.TangentOffset)  ? layout.TangentOffset  : -1;
+		args.bonesOffset    = layout.BonesOffset;
+
+		args.output               = static_cast<char*>(output);
+		args.outputVertexSize     = outputLayout.VertexSize;
+		args.outputPositionOffset = outputLayout.PositionOffset;
+		args.outputNormalOffset   = outputLayout.NormalOffset;
+		args.outputTangentOffset  = outputLayout.TangentOffset;
+
+		args.boneMatrices = &boneMatrices->e00;
+		args.count        = numVertices;
+		return args;
+	}
+
+
+	//Three floats from anywhere, without reading past them. The fourth element is 0
+	inline __m128 LoadFloat3(const char* p)
+	{
+		__m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+		return _mm_movelh_ps(xy, _mm_load_ss(reinterpret_cast<const float*>(p) + 2));
+	}
+
+	inline void StoreFloat3(char* p, __m128 v)
+	{
+		_mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+		_mm_store_ss(reinterpret_cast<float*>(p) + 2, _mm_movehl_ps(v, v));
+	}
+
+	//x * row0 + y * row1 + z * row2
+	inline __m128 TransformVector(__m128 v, __m128 row0, __m128 row1, __m128 row2)
+	{
+		__m128 result = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), row0);
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+		return _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), row2));
+	}
+}
+
+
+//Skin the given vertices with the given bone matrices, spreading ranges of vertices over the thread pool
+void SkinVertices(const void* vertices, const SkinnedVertexLayout& layout, int numVertices, const CMatrix4x4* boneMatrices,
+                  void* output, const SkinnedVertexLayout& outputLayout, ThreadPool* threadPool /*= nullptr*/)
+{
+	if (numVertices <= 0)  return;
+	if (layout.BonesOffset < 0)  throw std::runtime_error("Vertices to skin have no bones");
+
+	const SkinningArgs args = MakeArgs(vertices, layout, numVertices, boneMatrices, output, outputLayout);
+
+	//Not worth waking the pool for a single chunk
+	if (numVertices <= kVerticesPerChunk)
+	{
+		Kernels().skinVertices(args);
+		return;
+	}
+
+	//Each vertex only depends on itself and the bones, so ranges can be skinned in any order on any thread
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+	threadPool->ParallelFor(0, numVertices, kVerticesPerChunk, [&](int first, int last)
+	{
+		SkinningArgs range = args;
+		range.vertices += static_cast<size_t>(first) * args.vertexSize;
+		range.output   += static_cast<size_t>(first) * args.outputVertexSize;
+		range.count     = last - first;
+		Kernels().skinVertices(range);
+	});
+}
+
+//Skinning written out in plain C++, a vertex at a time
+void SkinVerticesReference(const void* vertices, const SkinnedVertexLayout& layout, int numVertices, const CMatrix4x4* boneMatrices,
+                           void* output, const SkinnedVertexLayout& outputLayout)
+{
+	if (numVertices <= 0)  return;
+	if (layout.BonesOffset < 0)  throw std::runtime_error("Vertices to skin have no bones");
+
+	const SkinningArgs args = MakeArgs(vertices, layout, numVertices, boneMatrices, output, outputLayout);
+	for (int i = 0; i < args.count; ++i)
+	{
+		const char* vertex = args.vertices + static_cast<size_t>(i) * args.vertexSize;
+		char* outVertex = args.output + static_cast<size_t>(i) * args.outputVertexSize;
+
+		//Weighted sum of the bone matrices. The last column is always (0,0,0,1) so it isn't needed
+		const uint8_t* bones = reinterpret_cast<const uint8_t*>(vertex + args.bonesOffset);
+		float weights[4];
+		std::memcpy(weights, bones + 4, sizeof(weights));
+		float blend[4][3] = {};
+		for (int influence = 0; influence < 4; ++influence)
+		{
+			const float* m = &boneMatrices[bones[influence]].e00;
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 3; ++column)  blend[row][column] += weights[influence] * m[row * 4 + column];
+			}
+		}
+
+		auto transform = [&](int inOffset, int outOffset, bool isPoint)
+		{
+			if (inOffset < 0)  return;
+			float v[3], result[3];
+			std::memcpy(v, vertex + inOffset, sizeof(v));
+			for (int column = 0; column < 3; ++column)
+			{
+				result[column] = v[0] * blend[0][column] + v[1] * blend[1][column] + v[2] * blend[2][column] + (isPoint ? blend[3][column] : 0.0f);
+			}
+			std::memcpy(outVertex + outOffset, result, sizeof(result));
+		};
+		transform(args.positionOffset, args.outputPositionOffset, true);
+		transform(args.normalOffset,   args.outputNormalOffset,   false);
+		transform(args.tangentOffset,  args.outputTangentOffset,  false);
+	}
+}
+
+//Name of the instruction set the skinning kernels use on this CPU
+const char* SkinningKernelName()
+{
+	return Kernels().name;
+}
+
+
+
+//--------------------------------------------------------------------------------------
+// BoneWeightPacker
+//--------------------------------------------------------------------------------------
+
+//Constructor from the vertices to fill in. Clears the bones and weights of every vertex
+BoneWeightPacker::BoneWeightPacker(void* vertices, const SkinnedVertexLayout& layout, int numVertices)
+	: m_Bones(static_cast<unsigned char*>(vertices) + layout.BonesOffset), m_VertexSize(layout.VertexSize),
+	  m_Counts(std::max(numVertices, 0), 0)
+{
+	if (layout.BonesOffset < 0)  throw std::runtime_error("Vertices to give bone weights to have no bones");
+
+	unsigned char* bones = m_Bones;
+	for (size_t i = 0; i < m_Counts.size(); ++i, bones += m_VertexSize)  std::memset(bones, 0, 4 + 4 * sizeof(float));
+}
+
+//Influence every vertex by the given bone alone, at full weight
+void BoneWeightPacker::BindAll(uint8_t bone)
+{
+	const float one = 1.0f;
+	unsigned char* bones = m_Bones;
+	for (size_t i = 0; i < m_Counts.size(); ++i, bones += m_VertexSize)
+	{
+		std::memset(bones, 0, 4 + 4 * sizeof(float));
+		bones[0] = bone;
+		std::memcpy(bones + 4, &one, sizeof(float));
+		m_Counts[i] = 1;
+	}
+}
+
+//A vertex already has 4 influences, keep the 4 largest
+void BoneWeightPacker::ReplaceSmallest(unsigned char* bones, uint8_t bone, float weight)
+{
+	float weights[4];
+	std::memcpy(weights, bones + 4, sizeof(weights));
+	int smallest = static_cast<int>(std::min_element(weights, weights + 4) - weights);
+	if (weight <= weights[smallest])  return;
+
+	bones[smallest] = bone;
+	std::memcpy(bones + 4 + smallest * sizeof(float), &weight, sizeof(float));
+}
+
+//SSE2 kernel, used when the CPU has nothing wider (see SkinningKernels.h). One vertex at a time
+void SkinVerticesSSE2(const SkinningArgs& args)
+{
+	const char* vertex = args.vertices;
+	char* outVertex = args.output;
+	for (int i = 0; i < args.count; ++i, vertex += args.vertexSize, outVertex += args.outputVertexSize)
+	{
+		const uint8_t* bones = reinterpret_cast<const uint8_t*>(vertex + args.bonesOffset);
+		const float* m0 = args.boneMatrices + bones[0] * 16;
+		const float* m1 = args.boneMatrices + bones[1] * 16;
+		const float* m2 = args.boneMatrices + bones[2] * 16;
+		const float* m3 = args.boneMatrices + bones[3] * 16;
+
+		__m128 weights = _mm_loadu_ps(reinterpret_cast<const float*>(bones + 4));
+		__m128 w0 = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 w1 = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 w2 = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 w3 = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3));
+
+		//Each row of the blended matrix is the weighted sum of that row of each bone
+		__m128 rows[4];
+		for (int row = 0; row < 4; ++row)
+		{
+			__m128 blend = _mm_mul_ps(w0, _mm_load_ps(m0 + row * 4));
+			blend = _mm_add_ps(blend, _mm_mul_ps(w1, _mm_load_ps(m1 + row * 4)));
+			blend = _mm_add_ps(blend, _mm_mul_ps(w2, _mm_load_ps(m2 + row * 4)));
+			rows[row] = _mm_add_ps(blend, _mm_mul_ps(w3, _mm_load_ps(m3 + row * 4)));
+		}
+
+		if (args.positionOffset >= 0)
+		{
+			__m128 position = TransformVector(LoadFloat3(vertex + args.positionOffset), rows[0], rows[1], rows[2]);
+			StoreFloat3(outVertex + args.outputPositionOffset, _mm_add_ps(position, rows[3]));
+		}
+		if (args.normalOffset >= 0)
+		{
+			StoreFloat3(outVertex + args.outputNormalOffset, TransformVector(LoadFloat3(vertex + args.normalOffset), rows[0], rows[1], rows[2]));
+		}
+		if (args.tangentOffset >= 0)
+		{
+			StoreFloat3(outVertex + args.outputTangentOffset, TransformVector(LoadFloat3(vertex + args.tangentOffset), rows[0], rows[1], rows[2]));
+		}
+	}
+}
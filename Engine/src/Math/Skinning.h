@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// Skinning - blending vertices by their bones on the CPU
+//--------------------------------------------------------------------------------------
+// Linear blend skinning: each vertex has up to four bones and weights, and is transformed by
+// the weighted sum of its bones' matrices. The vertices are read in the layout Mesh loads
+// them in (four bone indices as bytes, then four float weights) and the skinned positions,
+// normals and tangents are written to a buffer the caller provides, in whatever layout it
+// wants, so skinned models can be batched together or used on the CPU (e.g. for picking).
+// The SIMD kernels blend the matrices of one vertex (SSE2) or two vertices (AVX2) at once,
+// and ranges of vertices are spread over the thread pool.
+// BoneWeightPacker fills in those bones and weights when a mesh is loaded, one influence at a
+// time in a single pass, keeping a count per vertex rather than searching for a free slot.
+
+#pragma once
+#include "epch.h"
+#include "CMatrix4x4.h"
+#include <cstring>
+
+class ThreadPool;
+
+//Where each part of a vertex is, in bytes from the start of the vertex. Parts a vertex doesn't have are -1
+struct SkinnedVertexLayout
+{
+	int VertexSize     = 0;
+	int PositionOffset = 0;
+	int NormalOffset   = -1;
+	int TangentOffset  = -1;
+
+	//4 bone indices (bytes) followed by 4 weights (floats). Only needed on the vertices being skinned
+	int BonesOffset    = -1;
+};
+
+//Skin the given vertices with the given bone matrices, one per bone index used by the vertices. The weights of each
+//vertex should add up to 1. Positions, normals and tangents are written to the output vertices, each one only if both
+//layouts have it, and nothing else in the output is changed. The output must not overlap the input.
+//Normals and tangents are transformed by the blended matrix but not renormalised (the shaders normalise them)
+//Ranges of vertices are spread over the given thread pool (the shared pool by default)
+void SkinVertices(const void* vertices, const SkinnedVertexLayout& layout, int numVertices, const CMatrix4x4* boneMatrices,
+                  void* output, const SkinnedVertexLayout& outputLayout, ThreadPool* threadPool = nullptr);
+
+//Same as SkinVertices written out in plain C++, a vertex at a time on the calling thread. The reference the SIMD
+//versions are checked against
+void SkinVerticesReference(const void* vertices, const SkinnedVertexLayout& layout, int numVertices, const CMatrix4x4* boneMatrices,
+                           void* output, const SkinnedVertexLayout& outputLayout);
+
+//Name of the instruction set the skinning kernels use on this CPU
+const char* SkinningKernelName();
+
+//Fills in the bones and weights of vertices one influence at a time, as a file lists them (e.g. bone by bone). Each
+//vertex keeps a count of its influences, so each one goes straight into the next free slot
+class BoneWeightPacker
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor from the vertices to fill in, which must have bones. Clears the bones and weights of every vertex
+	BoneWeightPacker(void* vertices, const SkinnedVertexLayout& layout, int numVertices);
+
+	//Add the influence of a bone on a vertex. Zero weights are left out. A vertex only has room for 4 influences,
+	//after that a new influence replaces the smallest one if it is larger. Weights are not renormalised
+	void Add(int vertex, uint8_t bone, float weight)
+	{
+		if (static_cast<unsigned int>(vertex) >= m_Counts.size())  throw std::runtime_error("Bone weight for a vertex that doesn't exist");
+		if (weight == 0.0f)  return;
+
+		uint8_t& count = m_Counts[vertex];
+		unsigned char* bones = m_Bones + static_cast<size_t>(vertex) * m_VertexSize;
+		if (count < 4)
+		{
+			bones[count] = bone;
+			std::memcpy(bones + 4 + count * sizeof(float), &weight, sizeof(float));
+			++count;
+		}
+		else
+		{
+			ReplaceSmallest(bones, bone, weight);
+		}
+	}
+
+	//Influence every vertex by the given bone alone, at full weight (e.g. a sub-mesh with no bones in a skinned mesh)
+	void BindAll(uint8_t bone);
+
+	//Number of influences given to a vertex so far, up to 4
+	int NumberInfluences(int vertex) const { return m_Counts[vertex]; }
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	void ReplaceSmallest(unsigned char* bones, uint8_t bone, float weight);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	unsigned char*       m_Bones;      //Bones of the first vertex
+	int                  m_VertexSize;
+	std::vector<uint8_t> m_Counts;     //Influences of each vertex so far
+};
@@ -0,0 +1,140 @@
+//--------------------------------------------------------------------------------------
+// AVX2 skinning kernel, two vertices at a time
+//--------------------------------------------------------------------------------------
+// Compiled with AVX2 enabled and without the precompiled header, see SkinningKernels.h.
+// Only called when the CPU supports AVX2 and FMA.
+
+#include "SkinningKernels.h"
+#include <immintrin.h>
+#include <cstdint>
+
+namespace
+{
+	//Three floats from anywhere, without reading past them. The fourth element is 0
+	inline __m128 LoadFloat3(const char* p)
+	{
+		__m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+		return _mm_movelh_ps(xy, _mm_load_ss(reinterpret_cast<const float*>(p) + 2));
+	}
+
+	inline void StoreFloat3(char* p, __m128 v)
+	{
+		_mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+		_mm_store_ss(reinterpret_cast<float*>(p) + 2, _mm_movehl_ps(v, v));
+	}
+
+	//The first vertex in the low half of a register, the second in the high half
+	inline __m256 Pair(__m128 first, __m128 second)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(first), second, 1);
+	}
+
+	inline void StorePair(char* first, char* second, __m256 v)
+	{
+		StoreFloat3(first, _mm256_castps256_ps128(v));
+		StoreFloat3(second, _mm256_extractf128_ps(v, 1));
+	}
+
+	//x * row0 + y * row1 + z * row2 (+ row3 for a point), for both vertices of a pair
+	inline __m256 TransformPair(__m256 v, const __m256* rows, bool isPoint)
+	{
+		__m256 result = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), rows[0]);
+		if (isPoint)  result = _mm256_add_ps(result, rows[3]);
+		result = _mm256_fmadd_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), rows[1], result);
+		return _mm256_fmadd_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), rows[2], result);
+	}
+
+	inline __m128 TransformOne(__m128 v, const __m128* rows, bool isPoint)
+	{
+		__m128 result = _mm_mul_ps(_mm_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), rows[0]);
+		if (isPoint)  result = _mm_add_ps(result, rows[3]);
+		result = _mm_fmadd_ps(_mm_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), rows[1], result);
+		return _mm_fmadd_ps(_mm_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), rows[2], result);
+	}
+}
+
+void SkinVerticesAVX2(const SkinningArgs& args)
+{
+	const char* vertex = args.vertices;
+	char* outVertex = args.output;
+	const int inStride = args.vertexSize, outStride = args.outputVertexSize;
+
+	//Pairs of vertices, the first in the low half of each register and the second in the high half
+	int i = 0;
+	for (; i + 1 < args.count; i += 2, vertex += inStride * 2, outVertex += outStride * 2)
+	{
+		const uint8_t* bonesA = reinterpret_cast<const uint8_t*>(vertex + args.bonesOffset);
+		const uint8_t* bonesB = reinterpret_cast<const uint8_t*>(vertex + inStride + args.bonesOffset);
+
+		const float* mA[4] = { args.boneMatrices + bonesA[0] * 16, args.boneMatrices + bonesA[1] * 16,
+		                       args.boneMatrices + bonesA[2] * 16, args.boneMatrices + bonesA[3] * 16 };
+		const float* mB[4] = { args.boneMatrices + bonesB[0] * 16, args.boneMatrices + bonesB[1] * 16,
+		                       args.boneMatrices + bonesB[2] * 16, args.boneMatrices + bonesB[3] * 16 };
+
+		__m256 weights = Pair(_mm_loadu_ps(reinterpret_cast<const float*>(bonesA + 4)),
+		                      _mm_loadu_ps(reinterpret_cast<const float*>(bonesB + 4)));
+		__m256 w0 = _mm256_permute_ps(weights, _MM_SHUFFLE(0, 0, 0, 0));
+		__m256 w1 = _mm256_permute_ps(weights, _MM_SHUFFLE(1, 1, 1, 1));
+		__m256 w2 = _mm256_permute_ps(weights, _MM_SHUFFLE(2, 2, 2, 2));
+		__m256 w3 = _mm256_permute_ps(weights, _MM_SHUFFLE(3, 3, 3, 3));
+
+		//Each row of both blended matrices is the weighted sum of that row of each bone
+		auto blendRow = [&](int row)
+		{
+			__m256 blend = _mm256_mul_ps(w0, Pair(_mm_load_ps(mA[0] + row * 4), _mm_load_ps(mB[0] + row * 4)));
+			blend = _mm256_fmadd_ps(w1, Pair(_mm_load_ps(mA[1] + row * 4), _mm_load_ps(mB[1] + row * 4)), blend);
+			blend = _mm256_fmadd_ps(w2, Pair(_mm_load_ps(mA[2] + row * 4), _mm_load_ps(mB[2] + row * 4)), blend);
+			return _mm256_fmadd_ps(w3, Pair(_mm_load_ps(mA[3] + row * 4), _mm_load_ps(mB[3] + row * 4)), blend);
+		};
+		const __m256 rows[4] = { blendRow(0), blendRow(1), blendRow(2), blendRow(3) };
+
+		if (args.positionOffset >= 0)
+		{
+			__m256 positions = Pair(LoadFloat3(vertex + args.positionOffset), LoadFloat3(vertex + inStride + args.positionOffset));
+			StorePair(outVertex + args.outputPositionOffset, outVertex + outStride + args.outputPositionOffset, TransformPair(positions, rows, true));
+		}
+		if (args.normalOffset >= 0)
+		{
+			__m256 normals = Pair(LoadFloat3(vertex + args.normalOffset), LoadFloat3(vertex + inStride + args.normalOffset));
+			StorePair(outVertex + args.outputNormalOffset, outVertex + outStride + args.outputNormalOffset, TransformPair(normals, rows, false));
+		}
+		if (args.tangentOffset >= 0)
+		{
+			__m256 tangents = Pair(LoadFloat3(vertex + args.tangentOffset), LoadFloat3(vertex + inStride + args.tangentOffset));
+			StorePair(outVertex + args.outputTangentOffset, outVertex + outStride + args.outputTangentOffset, TransformPair(tangents, rows, false));
+		}
+	}
+
+	//The last vertex of an odd count on its own
+	if (i < args.count)
+	{
+		const uint8_t* bones = reinterpret_cast<const uint8_t*>(vertex + args.bonesOffset);
+		__m128 weights = _mm_loadu_ps(reinterpret_cast<const float*>(bones + 4));
+
+		__m128 rows[4];
+		for (int row = 0; row < 4; ++row)
+		{
+			__m128 blend = _mm_setzero_ps();
+			for (int influence = 0; influence < 4; ++influence)
+			{
+				__m128 weight = _mm_permute_ps(weights, 0);
+				weights = _mm_permute_ps(weights, _MM_SHUFFLE(0, 3, 2, 1));
+				blend = _mm_fmadd_ps(weight, _mm_load_ps(args.boneMatrices + bones[influence] * 16 + row * 4), blend);
+			}
+			rows[row] = blend;
+		}
+
+		if (args.positionOffset >= 0)
+		{
+			StoreFloat3(outVertex + args.outputPositionOffset, TransformOne(LoadFloat3(vertex + args.positionOffset), rows, true));
+		}
+		if (args.normalOffset >= 0)
+		{
+			StoreFloat3(outVertex + args.outputNormalOffset, TransformOne(LoadFloat3(vertex + args.normalOffset), rows, false));
+		}
+		if (args.tangentOffset >= 0)
+		{
+			StoreFloat3(outVertex + args.outputTangentOffset, TransformOne(LoadFloat3(vertex + args.tangentOffset), rows, false));
+		}
+	}
+}
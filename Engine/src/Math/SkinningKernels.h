@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Kernels behind SkinVertices
+//--------------------------------------------------------------------------------------
+// One kernel per instruction set. The AVX2 kernel is in its own file so it can be compiled
+// for AVX2, and like the matrix kernels it doesn't include any engine headers. Bone matrices
+// are 16 floats in CMatrix4x4's row order, aligned to 16 bytes.
+// Skinning.cpp picks the kernel once, for the level given by GetSimdLevel.
+
+#pragma once
+
+struct SkinningArgs
+{
+	//Vertices to skin, and byte offsets of each element within a vertex (-1 if not written).
+	//Bones are 4 byte indices followed by 4 float weights
+	const char* vertices;
+	int         vertexSize;
+	int         positionOffset;
+	int         normalOffset;
+	int         tangentOffset;
+	int         bonesOffset;
+
+	//Where the skinned vertices go, and byte offsets of each element within an output vertex (-1 if not written)
+	char* output;
+	int   outputVertexSize;
+	int   outputPositionOffset;
+	int   outputNormalOffset;
+	int   outputTangentOffset;
+
+	const float* boneMatrices;
+	int          count;
+};
+
+void SkinVerticesSSE2(const SkinningArgs& args);
+void SkinVerticesAVX2(const SkinningArgs& args);
@@ -0,0 +1,270 @@
+#include "epch.h"
+#include "TerrainQuadTree.h"
+#include "Utility/ThreadPool.h"
+
+namespace
+{
+	//Leaves are measured in chunks of this many when spread over the thread pool
+	const int kLeavesPerChunk = 32;
+
+	//True if any part of the box is within range of the point
+	bool InRange(const BoundingBox& box, const CVector3& point, float range)
+	{
+		return range == FLT_MAX || box.DistanceSquared(point) <= range * range;
+	}
+}
+
+//Constructor, Build must be called before anything can be selected
+TerrainQuadTree::TerrainQuadTree(const TerrainQuadTreeSettings& settings /*= TerrainQuadTreeSettings()*/)
+	: m_Settings(settings)
+{
+	if (settings.LeafSize < 1 || (settings.LeafSize & (settings.LeafSize - 1)) != 0)
+	{
+		throw std::runtime_error("Terrain quadtree leaf size must be a power of two");
+	}
+}
+
+//Build the tree for a HeightField covering minPt to maxPt in x and z
+void TerrainQuadTree::Build(const HeightField& heightMap, CVector3 minPt, CVector3 maxPt, ThreadPool* threadPool /*= nullptr*/)
+{
+	if (heightMap.Width() < 2 || heightMap.Height() < 2)  throw std::runtime_error("HeightField is too small for a terrain quadtree");
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+
+	m_Width = heightMap.Width();
+	m_Height = heightMap.Height();
+	m_MinPt = minPt;
+	m_CellSizeX = (maxPt.x - minPt.x) / (m_Width - 1);
+	m_CellSizeZ = (maxPt.z - minPt.z) / (m_Height - 1);
+
+	//The root is the smallest power of two number of leaves that covers every cell
+	int cells = std::max(m_Width, m_Height) - 1;
+	int rootSize = m_Settings.LeafSize;
+	m_NumLevels = 1;
+	while (rootSize < cells)
+	{
+		rootSize *= 2;
+		++m_NumLevels;
+	}
+
+	m_Nodes.clear();
+	std::vector<int> leaves;
+	AddNode(0, 0, rootSize, m_NumLevels - 1, leaves);
+
+	threadPool->ParallelFor(0, static_cast<int>(leaves.size()), kLeavesPerChunk, [&](int first, int last)
+	{
+		for (int leaf = first; leaf < last; ++leaf)
+		{
+			MeasureNode(heightMap, m_Nodes[leaves[leaf]]);
+		}
+	});
+
+	//Children always come after their parent, so working backwards every parent sees finished children
+	for (auto node = m_Nodes.rbegin(); node != m_Nodes.rend(); ++node)
+	{
+		if (node->Level > 0)  CombineChildren(*node);
+	}
+}
+
+//Refresh the minimum and maximum heights of the nodes covering a region of edited cells
+void TerrainQuadTree::UpdateHeights(const HeightField& heightMap, const GridRegion& dirty)
+{
+	if (!m_Nodes.empty())  UpdateNode(heightMap, 0, dirty);
+}
+
+//Distance from the camera covered by each level of detail for the given horizontal field of view
+void TerrainQuadTree::LodRanges(float fov, std::vector<float>& ranges) const
+{
+	//A narrower field of view magnifies the distance, so detail has to reach further to look the same
+	float leafWorldSize = m_Settings.LeafSize * std::max(std::abs(m_CellSizeX), std::abs(m_CellSizeZ));
+	float range = m_Settings.DetailDistance * leafWorldSize / std::tan(fov * 0.5f);
+
+	ranges.resize(m_NumLevels);
+	for (int level = 0; level < m_NumLevels; ++level)
+	{
+		ranges[level] = range;
+		range *= 2.0f;
+	}
+	ranges.back() = FLT_MAX;
+}
+
+//Pick the chunks to draw this frame
+void TerrainQuadTree::Select(const CVector3& cameraPosition, float fov, const Frustum* frustum, std::vector<TerrainChunk>& chunks) const
+{
+	chunks.clear();
+	if (m_Nodes.empty())  return;
+
+	std::vector<float> ranges;
+	LodRanges(fov, ranges);
+
+	//The top level reaches everywhere, so the root never needs a parent to draw it
+	SelectNode(0, cameraPosition, ranges, frustum, chunks);
+}
+
+//Bounding box of a node in world space
+BoundingBox TerrainQuadTree::NodeBounds(int node) const
+{
+	const auto& n = m_Nodes[node];
+	int lastX = std::min(n.X + n.Size, m_Width - 1);
+	int lastZ = std::min(n.Z + n.Size, m_Height - 1);
+
+	CVector3 corner0(m_MinPt.x + n.X * m_CellSizeX, n.MinHeight, m_MinPt.z + n.Z * m_CellSizeZ);
+	CVector3 corner1(m_MinPt.x + lastX * m_CellSizeX, n.MaxHeight, m_MinPt.z + lastZ * m_CellSizeZ);
+
+	//The cell size can be negative if maxPt is less than minPt
+	BoundingBox box;
+	box.Add(corner0);
+	box.Add(corner1);
+	return box;
+}
+
+//How far a vertex at the given distance from the camera has morphed towards the next coarser level
+float TerrainQuadTree::MorphFactor(const TerrainChunk& chunk, float distance)
+{
+	if (distance <= chunk.MorphStart)  return 0.0f;
+	if (distance >= chunk.MorphEnd)    return 1.0f;
+	return (distance - chunk.MorphStart) / (chunk.MorphEnd - chunk.MorphStart);
+}
+
+//Position of a chunk vertex once morphed, in vertices from the corner of the chunk
+void TerrainQuadTree::MorphGridVertex(int x, int z, float morph, float& morphedX, float& morphedZ)
+{
+	morphedX = x - (x & 1) * morph;
+	morphedZ = z - (z & 1) * morph;
+}
+
+//Create the node covering the given square and its children, depth first
+int TerrainQuadTree::AddNode(int x, int z, int size, int level, std::vector<int>& leaves)
+{
+	if (x >= m_Width - 1 || z >= m_Height - 1)  return -1;
+
+	int index = static_cast<int>(m_Nodes.size());
+	TerrainNode node;
+	node.X = x;
+	node.Z = z;
+	node.Size = size;
+	node.Level = level;
+	m_Nodes.push_back(node);
+
+	if (level == 0)
+	{
+		leaves.push_back(index);
+		return index;
+	}
+
+	//Don't hold a reference to the node while adding children, the vector may move
+	int half = size / 2;
+	int children[4];
+	children[0] = AddNode(x,        z,        half, level - 1, leaves);
+	children[1] = AddNode(x + half, z,        half, level - 1, leaves);
+	children[2] = AddNode(x,        z + half, half, level - 1, leaves);
+	children[3] = AddNode(x + half, z + half, half, level - 1, leaves);
+	std::copy(children, children + 4, m_Nodes[index].Children);
+	return index;
+}
+
+//Lowest and highest height in the area a node covers, found directly from the HeightField
+void TerrainQuadTree::MeasureNode(const HeightField& heightMap, TerrainNode& node) const
+{
+	//A node includes the vertices on its far edges, which it shares with its neighbours
+	int lastX = std::min(node.X + node.Size, m_Width - 1);
+	int lastZ = std::min(node.Z + node.Size, m_Height - 1);
+
+	float minHeight = FLT_MAX;
+	float maxHeight = -FLT_MAX;
+	for (int z = node.Z; z <= lastZ; ++z)
+	{
+		const float* row = heightMap.RowData(z);
+		for (int x = node.X; x <= lastX; ++x)
+		{
+			minHeight = std::min(minHeight, row[x]);
+			maxHeight = std::max(maxHeight, row[x]);
+		}
+	}
+	node.MinHeight = minHeight;
+	node.MaxHeight = maxHeight;
+}
+
+//Lowest and highest height of a node from its children
+void TerrainQuadTree::CombineChildren(TerrainNode& node) const
+{
+	node.MinHeight = FLT_MAX;
+	node.MaxHeight = -FLT_MAX;
+	for (int child : node.Children)
+	{
+		if (child < 0)  continue;
+		node.MinHeight = std::min(node.MinHeight, m_Nodes[child].MinHeight);
+		node.MaxHeight = std::max(node.MaxHeight, m_Nodes[child].MaxHeight);
+	}
+}
+
+//Recursive part of UpdateHeights
+void TerrainQuadTree::UpdateNode(const HeightField& heightMap, int node, const GridRegion& dirty)
+{
+	auto& n = m_Nodes[node];
+	if (dirty.MaxX < n.X || dirty.MinX > n.X + n.Size || dirty.MaxZ < n.Z || dirty.MinZ > n.Z + n.Size)  return;
+
+	if (n.Level == 0)
+	{
+		MeasureNode(heightMap, n);
+		return;
+	}
+
+	for (int child : n.Children)
+	{
+		if (child >= 0)  UpdateNode(heightMap, child, dirty);
+	}
+	CombineChildren(n);
+}
+
+//Recursive part of Select
+bool TerrainQuadTree::SelectNode(int node, const CVector3& cameraPosition, const std::vector<float>& ranges, const Frustum* frustum,
+                                 std::vector<TerrainChunk>& chunks) const
+{
+	const auto& n = m_Nodes[node];
+	BoundingBox box = NodeBounds(node);
+
+	//Out of sight, nothing needs drawing but nobody else needs to draw it either
+	if (frustum != nullptr && !frustum->Intersects(box))  return true;
+
+	//Too far away for this level, the parent's level will draw it
+	if (!InRange(box, cameraPosition, ranges[n.Level]))  return false;
+
+	//Most detailed level, or nothing in the node is close enough to need the next level down
+	if (n.Level == 0 || !InRange(box, cameraPosition, ranges[n.Level - 1]))
+	{
+		AddChunk(node, n.Level, ranges, chunks);
+		return true;
+	}
+
+	//Children in range of the next level choose for themselves, the rest are drawn at this node's level
+	for (int child : n.Children)
+	{
+		if (child >= 0 && !SelectNode(child, cameraPosition, ranges, frustum, chunks))
+		{
+			AddChunk(child, n.Level, ranges, chunks);
+		}
+	}
+	return true;
+}
+
+//Add a chunk for the area of a node drawn at the given level
+void TerrainQuadTree::AddChunk(int node, int level, const std::vector<float>& ranges, std::vector<TerrainChunk>& chunks) const
+{
+	TerrainChunk chunk;
+	chunk.Node = node;
+	chunk.Level = level;
+
+	//The top level has nothing coarser to morph to
+	if (level == m_NumLevels - 1)
+	{
+		chunk.MorphStart = FLT_MAX;
+		chunk.MorphEnd = FLT_MAX;
+	}
+	else
+	{
+		float previousRange = level > 0 ? ranges[level - 1] : 0.0f;
+		chunk.MorphEnd = ranges[level];
+		chunk.MorphStart = previousRange + (chunk.MorphEnd - previousRange) * m_Settings.MorphStart;
+	}
+	chunks.push_back(chunk);
+}
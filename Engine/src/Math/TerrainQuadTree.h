@@ -0,0 +1,144 @@
+//--------------------------------------------------------------------------------------
+// Terrain quadtree - chunked level of detail selection for large HeightFields (CDLOD)
+//--------------------------------------------------------------------------------------
+// The HeightField is split into square leaf chunks, grouped four at a time into a quadtree.
+// Every node stores the lowest and highest height it covers, giving it a tight bounding box.
+// Each frame Select walks the tree from the camera position and field of view and picks the
+// chunks to draw: every chunk is drawn as the same size grid, so a node at level L has a
+// vertex every 2^L cells. Each level of detail covers a range of distances from the camera,
+// and the vertices of a chunk morph towards the next coarser level over the far part of its
+// range, so neighbouring chunks always meet without cracks (Strugar, "Continuous
+// Distance-Dependent Level of Detail for Rendering Heightmaps").
+// This is CPU only, the renderer draws the chunks it is given and applies the morph.
+
+#pragma once
+#include "epch.h"
+#include "Bounds.h"
+#include "Frustum.h"
+#include "GridVertexData.h"
+#include "HeightField.h"
+
+class ThreadPool;
+
+struct TerrainQuadTreeSettings
+{
+	//Cells along each side of a leaf chunk, a power of two. Every chunk is drawn as a grid of this many squares
+	int LeafSize = 64;
+
+	//How many leaf chunks away the most detailed level reaches, with a 90 degree field of view.
+	//Narrower fields of view push every level further away. Each level reaches twice as far as the one before
+	float DetailDistance = 4.0f;
+
+	//Fraction of each level's range after which its vertices start to morph to the next level
+	float MorphStart = 0.7f;
+};
+
+//A node of the quadtree, a square of cells from (X, Z) to (X + Size, Z + Size), clipped to the HeightField
+struct TerrainNode
+{
+	int X = 0;
+	int Z = 0;
+	int Size = 0;
+	int Level = 0; // 0 for leaves, one more for each level up the tree
+
+	float MinHeight = 0.0f;
+	float MaxHeight = 0.0f;
+
+	int Children[4] = { -1, -1, -1, -1 }; // -1 for leaves and for children that would be outside the HeightField
+};
+
+//A chunk picked for drawing: the area of a node, with a vertex every 2^Level cells
+//Level is either the node's own level, or one above when the node covers a quarter of its parent's chunk
+struct TerrainChunk
+{
+	int Node = 0;
+	int Level = 0;
+
+	//Vertices are fully the chunk's own level nearer than MorphStart and fully the next coarser level at MorphEnd
+	float MorphStart = 0.0f;
+	float MorphEnd = 0.0f;
+};
+
+class TerrainQuadTree
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor, Build must be called before anything can be selected
+	explicit TerrainQuadTree(const TerrainQuadTreeSettings& settings = TerrainQuadTreeSettings());
+
+	const TerrainQuadTreeSettings& Settings() const { return m_Settings; }
+
+	//Build the tree for a HeightField covering minPt to maxPt in x and z (the y values are ignored)
+	//Leaf minimum and maximum heights are found in parallel over the thread pool
+	void Build(const HeightField& heightMap, CVector3 minPt, CVector3 maxPt, ThreadPool* threadPool = nullptr);
+
+	//Refresh the minimum and maximum heights of the nodes covering a region of edited cells
+	void UpdateHeights(const HeightField& heightMap, const GridRegion& dirty);
+
+	//Distance from the camera covered by each level of detail for the given horizontal field of view (radians)
+	//The top level covers everything beyond the level below it
+	void LodRanges(float fov, std::vector<float>& ranges) const;
+
+	//Pick the chunks to draw this frame. Chunks entirely outside the frustum are skipped, pass nullptr to keep every chunk
+	//Without a frustum the chunks cover the HeightField exactly once
+	void Select(const CVector3& cameraPosition, float fov, const Frustum* frustum, std::vector<TerrainChunk>& chunks) const;
+
+	//Bounding box of a node in world space
+	BoundingBox NodeBounds(int node) const;
+
+	int NumLevels() const { return m_NumLevels; }
+	const std::vector<TerrainNode>& Nodes() const { return m_Nodes; }
+
+	//Size of a cell in world units
+	float CellSizeX() const { return m_CellSizeX; }
+	float CellSizeZ() const { return m_CellSizeZ; }
+
+	//How far a vertex at the given distance from the camera has morphed towards the next coarser level, 0 to 1
+	static float MorphFactor(const TerrainChunk& chunk, float distance);
+
+	//Position of a chunk vertex once morphed, in vertices from the corner of the chunk. Odd vertices slide
+	//towards their even neighbour, so at a morph of 1 the chunk matches the next coarser level exactly
+	static void MorphGridVertex(int x, int z, float morph, float& morphedX, float& morphedZ);
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Create the node covering the given square and its children, depth first. Returns the node index, or -1 if the square is outside the HeightField
+	int AddNode(int x, int z, int size, int level, std::vector<int>& leaves);
+
+	//Lowest and highest height in the area a node covers, found directly from the HeightField
+	void MeasureNode(const HeightField& heightMap, TerrainNode& node) const;
+
+	//Lowest and highest height of a node from its children
+	void CombineChildren(TerrainNode& node) const;
+
+	//Recursive part of UpdateHeights
+	void UpdateNode(const HeightField& heightMap, int node, const GridRegion& dirty);
+
+	//Recursive part of Select. Returns false if the node is beyond the range of its level, so the parent has to draw its area
+	bool SelectNode(int node, const CVector3& cameraPosition, const std::vector<float>& ranges, const Frustum* frustum,
+	                std::vector<TerrainChunk>& chunks) const;
+
+	//Add a chunk for the area of a node drawn at the given level
+	void AddChunk(int node, int level, const std::vector<float>& ranges, std::vector<TerrainChunk>& chunks) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	TerrainQuadTreeSettings m_Settings;
+
+	//Depth first, the root is the first node and every node comes before its children
+	std::vector<TerrainNode> m_Nodes;
+	int m_NumLevels = 0;
+
+	//Size of the HeightField the tree was built for, and its position in the world
+	int m_Width = 0;
+	int m_Height = 0;
+	CVector3 m_MinPt = CVector3(0, 0, 0);
+	float m_CellSizeX = 1.0f;
+	float m_CellSizeZ = 1.0f;
+};
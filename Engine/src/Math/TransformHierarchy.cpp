@@ -0,0 +1,49 @@
+#include "epch.h"
+#include "TransformHierarchy.h"
+#include "Utility/ThreadPool.h"
+
+namespace
+{
+	//Roughly how many matrices each thread pool task should work through, so small hierarchies are batched
+	//together rather than paying for a task each
+	const int kMatricesPerChunk = 1024;
+}
+
+//Constructor from the parent of each node, which must be in depth-first order
+TransformHierarchy::TransformHierarchy(std::vector<unsigned int> parents)
+	: m_Parents(std::move(parents))
+{
+	if (!m_Parents.empty() && m_Parents[0] != 0)  throw std::runtime_error("Root of a transform hierarchy must be its own parent");
+	for (size_t node = 1; node < m_Parents.size(); ++node)
+	{
+		if (m_Parents[node] >= node)  throw std::runtime_error("Transform hierarchy nodes must come after their parents");
+	}
+}
+
+//Work out world matrices from matrices relative to each node's parent, for a number of instances of this hierarchy
+void TransformHierarchy::UpdateWorldMatrices(const CMatrix4x4* local, CMatrix4x4* world, int numInstances,
+                                             ThreadPool* threadPool /*= nullptr*/) const
+{
+	const int numNodes = NumberNodes();
+	if (numNodes == 0 || numInstances <= 0)  return;
+
+	//Each instance only depends on its own matrices, so instances can be done in any order on any thread
+	auto updateInstances = [&](int first, int last)
+	{
+		for (int instance = first; instance < last; ++instance)
+		{
+			size_t offset = static_cast<size_t>(instance) * numNodes;
+			ConcatenateHierarchy(local + offset, m_Parents.data(), world + offset, numNodes);
+		}
+	};
+
+	//Not worth waking the pool for a single chunk, e.g. one model on its own
+	int grainSize = std::max(1, kMatricesPerChunk / numNodes);
+	if (numInstances <= grainSize)
+	{
+		updateInstances(0, numInstances);
+		return;
+	}
+	if (threadPool == nullptr)  threadPool = &ThreadPool::Get();
+	threadPool->ParallelFor(0, numInstances, grainSize, updateInstances);
+}
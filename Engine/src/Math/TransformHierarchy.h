@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// Transform hierarchy - the node tree of a mesh flattened into parent indices
+//--------------------------------------------------------------------------------------
+// Nodes are stored depth-first, so every parent comes before its children and the world
+// matrices of a whole tree can be worked out in a single pass from the front. Every model
+// made from the same mesh shares the same tree, so many instances are updated together:
+// their matrices sit one instance after another in contiguous arrays, and instances are
+// spread over the thread pool, each run through the SIMD ConcatenateHierarchy kernel.
+
+#pragma once
+#include "epch.h"
+#include "CMatrix4x4.h"
+
+class ThreadPool;
+
+class TransformHierarchy
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor for an empty hierarchy
+	TransformHierarchy() {}
+
+	//Constructor from the parent of each node. Node 0 is the root and is its own parent, every other node's parent
+	//must come before it. Throws a std::runtime_error if the nodes aren't in that order
+	explicit TransformHierarchy(std::vector<unsigned int> parents);
+
+	int NumberNodes() const { return static_cast<int>(m_Parents.size()); }
+
+	//The parent of a given node, the root node is its own parent
+	unsigned int Parent(int node) const { return m_Parents[node]; }
+	const unsigned int* Parents() const { return m_Parents.data(); }
+
+	//Work out world matrices from matrices relative to each node's parent, for a number of instances of this hierarchy.
+	//Both arrays hold NumberNodes() matrices per instance, one instance after another. The root matrix of each instance
+	//is already in world space and is copied across. The output can be the same array as the input
+	//Instances are spread over the given thread pool (the shared pool by default)
+	void UpdateWorldMatrices(const CMatrix4x4* local, CMatrix4x4* world, int numInstances, ThreadPool* threadPool = nullptr) const;
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::vector<unsigned int> m_Parents;
+};
@@ -0,0 +1,214 @@
+//--------------------------------------------------------------------------------------
+// float8 and Vec3SoA - eight floats / eight 3D vectors worked on together
+//--------------------------------------------------------------------------------------
+// CVector3's operators are out of line, one vector at a time, so loops over them can't be
+// vectorised. Vec3SoA holds eight vectors as structure of arrays (all the x's, all the y's,
+// all the z's), so every operation below does eight vectors at once and is inlined.
+// Use GatherVec3 / ScatterVec3 to move vectors to and from interleaved vertex data.
+//
+// float8 is two SSE registers normally and one AVX register in files compiled for AVX2.
+// Those are different types, so each is in its own inline namespace to keep the two
+// versions apart at link time. Like the SIMD kernel headers this doesn't include any engine
+// headers, so AVX2 kernel files can use it. Both versions use the same operations: no fused
+// multiply-adds (unless the compiler is set to contract them) and full precision square
+// roots and divides.
+
+#pragma once
+#include <cstddef>
+#include <immintrin.h>
+
+#if defined(__AVX2__)
+inline namespace Vec3SoAAVX2 {
+#else
+inline namespace Vec3SoASSE2 {
+#endif
+
+//-----------------------------------//
+// float8                            //
+//-----------------------------------//
+
+struct float8
+{
+#if defined(__AVX2__)
+	__m256 v;
+
+	__m128 Low()  const { return _mm256_castps256_ps128(v); }
+	__m128 High() const { return _mm256_extractf128_ps(v, 1); }
+	static float8 FromHalves(__m128 low, __m128 high) { return { _mm256_set_m128(high, low) }; }
+#else
+	__m128 low, high;
+
+	__m128 Low()  const { return low; }
+	__m128 High() const { return high; }
+	static float8 FromHalves(__m128 low, __m128 high) { return { low, high }; }
+#endif
+};
+
+const int kFloat8Width = 8;
+
+#if defined(__AVX2__)
+inline float8 Splat(float f)                     { return { _mm256_set1_ps(f) }; }
+inline float8 Load(const float* p)               { return { _mm256_loadu_ps(p) }; }
+inline void   Store(float* p, float8 a)          { _mm256_storeu_ps(p, a.v); }
+inline float8 operator+(float8 a, float8 b)      { return { _mm256_add_ps(a.v, b.v) }; }
+inline float8 operator-(float8 a, float8 b)      { return { _mm256_sub_ps(a.v, b.v) }; }
+inline float8 operator*(float8 a, float8 b)      { return { _mm256_mul_ps(a.v, b.v) }; }
+inline float8 operator/(float8 a, float8 b)      { return { _mm256_div_ps(a.v, b.v) }; }
+inline float8 operator-(float8 a)                { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+inline float8 Min(float8 a, float8 b)            { return { _mm256_min_ps(a.v, b.v) }; }
+inline float8 Max(float8 a, float8 b)            { return { _mm256_max_ps(a.v, b.v) }; }
+inline float8 Sqrt(float8 a)                     { return { _mm256_sqrt_ps(a.v) }; }
+
+//All bits set in the lanes where a >= b, for use with Select
+inline float8 NotLess(float8 a, float8 b)        { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+
+//b where mask is set, a elsewhere
+inline float8 Select(float8 a, float8 b, float8 mask) { return { _mm256_blendv_ps(a.v, b.v, mask.v) }; }
+#else
+inline float8 Splat(float f)                     { __m128 a = _mm_set1_ps(f);  return { a, a }; }
+inline float8 Load(const float* p)               { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+inline void   Store(float* p, float8 a)          { _mm_storeu_ps(p, a.low);  _mm_storeu_ps(p + 4, a.high); }
+inline float8 operator+(float8 a, float8 b)      { return { _mm_add_ps(a.low, b.low), _mm_add_ps(a.high, b.high) }; }
+inline float8 operator-(float8 a, float8 b)      { return { _mm_sub_ps(a.low, b.low), _mm_sub_ps(a.high, b.high) }; }
+inline float8 operator*(float8 a, float8 b)      { return { _mm_mul_ps(a.low, b.low), _mm_mul_ps(a.high, b.high) }; }
+inline float8 operator/(float8 a, float8 b)      { return { _mm_div_ps(a.low, b.low), _mm_div_ps(a.high, b.high) }; }
+inline float8 operator-(float8 a)                { __m128 sign = _mm_set1_ps(-0.0f);  return { _mm_xor_ps(a.low, sign), _mm_xor_ps(a.high, sign) }; }
+inline float8 Min(float8 a, float8 b)            { return { _mm_min_ps(a.low, b.low), _mm_min_ps(a.high, b.high) }; }
+inline float8 Max(float8 a, float8 b)            { return { _mm_max_ps(a.low, b.low), _mm_max_ps(a.high, b.high) }; }
+inline float8 Sqrt(float8 a)                     { return { _mm_sqrt_ps(a.low), _mm_sqrt_ps(a.high) }; }
+
+//All bits set in the lanes where a >= b, for use with Select
+inline float8 NotLess(float8 a, float8 b)        { return { _mm_cmpge_ps(a.low, b.low), _mm_cmpge_ps(a.high, b.high) }; }
+
+//b where mask is set, a elsewhere
+inline float8 Select(float8 a, float8 b, float8 mask)
+{
+	return { _mm_or_ps(_mm_andnot_ps(mask.low, a.low), _mm_and_ps(mask.low, b.low)),
+	         _mm_or_ps(_mm_andnot_ps(mask.high, a.high), _mm_and_ps(mask.high, b.high)) };
+}
+#endif
+
+//0, 1, 2 ... 7, e.g. for the x coordinates of a row of vertices
+inline float8 LaneIndices()
+{
+	return float8::FromHalves(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f));
+}
+
+//a + (b - a) * t
+inline float8 Lerp(float8 a, float8 b, float8 t)  { return a + (b - a) * t; }
+
+
+//-----------------------------------//
+// Vec3SoA                           //
+//-----------------------------------//
+
+struct Vec3SoA
+{
+	float8 x, y, z;
+};
+
+inline Vec3SoA Splat(float x, float y, float z)         { return { Splat(x), Splat(y), Splat(z) }; }
+inline Vec3SoA operator+(const Vec3SoA& a, const Vec3SoA& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3SoA operator-(const Vec3SoA& a, const Vec3SoA& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3SoA operator*(const Vec3SoA& a, const Vec3SoA& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+inline Vec3SoA operator*(const Vec3SoA& v, float8 s)         { return { v.x * s, v.y * s, v.z * s }; }
+inline Vec3SoA operator*(float8 s, const Vec3SoA& v)         { return { v.x * s, v.y * s, v.z * s }; }
+inline Vec3SoA operator-(const Vec3SoA& v)                   { return { -v.x, -v.y, -v.z }; }
+
+inline float8 Dot(const Vec3SoA& a, const Vec3SoA& b)  { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline Vec3SoA Cross(const Vec3SoA& a, const Vec3SoA& b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+inline float8 LengthSquared(const Vec3SoA& v)  { return Dot(v, v); }
+inline float8 Length(const Vec3SoA& v)         { return Sqrt(Dot(v, v)); }
+
+//Unit length vectors in the same directions. Vectors with a squared length below epsilon become zero, as with
+//CVector3's Normalise. The default epsilon is the EPSILON of MathHelpers.h
+inline Vec3SoA Normalise(const Vec3SoA& v, float epsilon = 0.5e-6f)
+{
+	float8 lengthSquared = Dot(v, v);
+	float8 scale = Splat(1.0f) / Sqrt(lengthSquared);
+	scale = Select(Splat(0.0f), scale, NotLess(lengthSquared, Splat(epsilon)));
+	return v * scale;
+}
+
+//a + (b - a) * t for each vector
+inline Vec3SoA Lerp(const Vec3SoA& a, const Vec3SoA& b, float8 t)  { return { Lerp(a.x, b.x, t), Lerp(a.y, b.y, t), Lerp(a.z, b.z, t) }; }
+
+//From / to three arrays of floats (all the x's, y's and z's of a larger SoA array)
+inline Vec3SoA Load(const float* x, const float* y, const float* z)       { return { Load(x), Load(y), Load(z) }; }
+inline void    Store(float* x, float* y, float* z, const Vec3SoA& v)      { Store(x, v.x);  Store(y, v.y);  Store(z, v.z); }
+
+
+//-----------------------------------//
+// Interleaved data                  //
+//-----------------------------------//
+
+//One vector of 3 floats, w is zero. Reading 4 floats is quicker, but only when the 4th is known to be readable
+inline __m128 LoadVec3(const char* data, bool readFourth)
+{
+	const float* p = reinterpret_cast<const float*>(data);
+	if (readFourth)  return _mm_loadu_ps(p);
+	return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p)), _mm_load_ss(p + 2));
+}
+
+//Write x, y and z of v and nothing else
+inline void StoreVec3(char* data, __m128 v)
+{
+	float* p = reinterpret_cast<float*>(data);
+	_mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+	_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+
+//Load count (up to 4) vectors stride bytes apart, transposed into x, y and z registers. Every vector but the last
+//is read as 4 floats, the 4th being inside the next vector. Only 3 floats of the very last vector (the last of the
+//last group) are read, so it can be at the end of a buffer
+inline void GatherVec3x4(const char* data, size_t stride, int count, bool lastGroup, __m128& x, __m128& y, __m128& z)
+{
+	int wholeLoads = lastGroup ? count - 1 : count;
+	__m128 v0 = count > 0 ? LoadVec3(data,              wholeLoads > 0) : _mm_setzero_ps();
+	__m128 v1 = count > 1 ? LoadVec3(data + stride,     wholeLoads > 1) : _mm_setzero_ps();
+	__m128 v2 = count > 2 ? LoadVec3(data + 2 * stride, wholeLoads > 2) : _mm_setzero_ps();
+	__m128 v3 = count > 3 ? LoadVec3(data + 3 * stride, wholeLoads > 3) : _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+	x = v0;
+	y = v1;
+	z = v2;
+}
+
+//Store count (up to 4) vectors from x, y and z registers as 3 floats each, stride bytes apart. Nothing else is written
+inline void ScatterVec3x4(char* data, size_t stride, int count, __m128 x, __m128 y, __m128 z)
+{
+	__m128 w = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	if (count > 0)  StoreVec3(data,              x);
+	if (count > 1)  StoreVec3(data + stride,     y);
+	if (count > 2)  StoreVec3(data + 2 * stride, z);
+	if (count > 3)  StoreVec3(data + 3 * stride, w);
+}
+
+//Load count (up to 8) vectors stride bytes apart, e.g. the normals of consecutive vertices with stride being the
+//vertex size and data pointing at the normal of the first one. Lanes past count are zero
+inline Vec3SoA GatherVec3(const void* data, size_t stride, int count = kFloat8Width)
+{
+	const char* bytes = static_cast<const char*>(data);
+	int lowCount = count < 4 ? count : 4;
+	__m128 lowX, lowY, lowZ, highX, highY, highZ;
+	GatherVec3x4(bytes, stride, lowCount, count <= 4, lowX, lowY, lowZ);
+	GatherVec3x4(bytes + 4 * stride, stride, count - lowCount, true, highX, highY, highZ);
+	return { float8::FromHalves(lowX, highX), float8::FromHalves(lowY, highY), float8::FromHalves(lowZ, highZ) };
+}
+
+//Store the first count (up to 8) vectors of v stride bytes apart, leaving everything between them untouched
+inline void ScatterVec3(void* data, size_t stride, const Vec3SoA& v, int count = kFloat8Width)
+{
+	char* bytes = static_cast<char*>(data);
+	int lowCount = count < 4 ? count : 4;
+	ScatterVec3x4(bytes, stride, lowCount, v.x.Low(), v.y.Low(), v.z.Low());
+	ScatterVec3x4(bytes + 4 * stride, stride, count - lowCount, v.x.High(), v.y.High(), v.z.High());
+}
+
+} // inline namespace
@@ -5,6 +5,7 @@
 
 #include "epch.h"
 #include "Shader.h"
+#include "Data/AssetArchive.h" // Compiled shaders are read from the asset archive when there is one
 
 
 //--------------------------------------------------------------------------------------
@@ -89,26 +90,16 @@ void ReleaseShaders()
 // to this function. The returned pointer needs to be released before quitting. Returns nullptr on failure. 
 ID3D11VertexShader* LoadVertexShader(std::string shaderName)
 {
-    // Open compiled shader object file
-    std::ifstream shaderFile(shaderName + ".cso", std::ios::in | std::ios::binary | std::ios::ate);
-    if (!shaderFile.is_open())
-    {
-        return nullptr;
-    }
-
-    // Read file into vector of chars
-    std::streamoff fileSize = shaderFile.tellg();
-    shaderFile.seekg(0, std::ios::beg);
-    std::vector<char> byteCode(fileSize);
-    shaderFile.read(&byteCode[0], fileSize);
-    if (shaderFile.fail())
+    // Read the compiled shader object, used in place when it is in the asset archive
+    AssetData byteCode;
+    if (!ReadAsset(shaderName + ".cso", byteCode))
     {
         return nullptr;
     }
 
     // Create shader object from loaded file (we will use the object later when rendering)
     ID3D11VertexShader* shader;
-    HRESULT hr = gD3DDevice->CreateVertexShader(byteCode.data(), byteCode.size(), nullptr, &shader);
+    HRESULT hr = gD3DDevice->CreateVertexShader(byteCode.Data(), byteCode.Size(), nullptr, &shader);
     if (FAILED(hr))
     {
         return nullptr;
@@ -122,26 +113,16 @@ ID3D11VertexShader* LoadVertexShader(std::string shaderName)
 // Basically the same code as above but for pixel shaders
 ID3D11GeometryShader* LoadGeometryShader(std::string shaderName)
 {
-    // Open compiled shader object file
-    std::ifstream shaderFile(shaderName + ".cso", std::ios::in | std::ios::binary | std::ios::ate);
-    if (!shaderFile.is_open())
-    {
-        return nullptr;
-    }
-
-    // Read file into vector of chars
-    std::streamoff fileSize = shaderFile.tellg();
-    shaderFile.seekg(0, std::ios::beg);
-    std::vector<char>byteCode(fileSize);
-    shaderFile.read(&byteCode[0], fileSize);
-    if (shaderFile.fail())
+    // Read the compiled shader object, used in place when it is in the asset archive
+    AssetData byteCode;
+    if (!ReadAsset(shaderName + ".cso", byteCode))
     {
         return nullptr;
     }
 
     // Create shader object from loaded file (we will use the object later when rendering)
     ID3D11GeometryShader* shader;
-    HRESULT hr = gD3DDevice->CreateGeometryShader(byteCode.data(), byteCode.size(), nullptr, &shader);
+    HRESULT hr = gD3DDevice->CreateGeometryShader(byteCode.Data(), byteCode.Size(), nullptr, &shader);
     if (FAILED(hr))
     {
         return nullptr;
@@ -156,26 +137,16 @@ ID3D11GeometryShader* LoadGeometryShader(std::string shaderName)
 // Basically the same code as above but for pixel shaders
 ID3D11PixelShader* LoadPixelShader(std::string shaderName)
 {
-    // Open compiled shader object file
-    std::ifstream shaderFile(shaderName + ".cso", std::ios::in | std::ios::binary | std::ios::ate);
-    if (!shaderFile.is_open())
-    {
-        return nullptr;
-    }
-
-    // Read file into vector of chars
-    std::streamoff fileSize = shaderFile.tellg();
-    shaderFile.seekg(0, std::ios::beg);
-    std::vector<char>byteCode(fileSize);
-    shaderFile.read(&byteCode[0], fileSize);
-    if (shaderFile.fail())
+    // Read the compiled shader object, used in place when it is in the asset archive
+    AssetData byteCode;
+    if (!ReadAsset(shaderName + ".cso", byteCode))
     {
         return nullptr;
     }
 
     // Create shader object from loaded file (we will use the object later when rendering)
     ID3D11PixelShader* shader;
-    HRESULT hr = gD3DDevice->CreatePixelShader(byteCode.data(), byteCode.size(), nullptr, &shader);
+    HRESULT hr = gD3DDevice->CreatePixelShader(byteCode.Data(), byteCode.Size(), nullptr, &shader);
     if (FAILED(hr))
     {
         return nullptr;
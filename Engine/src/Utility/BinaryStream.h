@@ -0,0 +1,144 @@
+//--------------------------------------------------------------------------------------
+// Binary streams - plain data in and out of blocks of memory
+//--------------------------------------------------------------------------------------
+// BinaryWriter appends values and arrays of trivially copyable types to a growing block. Each
+// value is padded to its own alignment, so once the block is loaded (e.g. memory mapped) the
+// arrays in it can be used where they are, without copying. BinaryReader walks such a block,
+// checking every read stays inside it and throwing a std::runtime_error when it wouldn't, so a
+// truncated or corrupt file is caught before any of it is used.
+
+#pragma once
+#include "epch.h"
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+class BinaryWriter
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Append a value, returns where it was written
+	template <class T>
+	size_t Write(const T& value)
+	{
+		return WriteArray(&value, 1);
+	}
+
+	//Append an array of values, returns where the first one was written
+	template <class T>
+	size_t WriteArray(const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be written");
+		Align(alignof(T));
+		const size_t offset = m_Data.size();
+		if (count > 0)
+		{
+			m_Data.resize(offset + count * sizeof(T));
+			std::memcpy(m_Data.data() + offset, values, count * sizeof(T));
+		}
+		return offset;
+	}
+
+	//Append a string as its length then its characters (not null terminated)
+	void WriteString(std::string_view string)
+	{
+		Write(static_cast<uint32_t>(string.size()));
+		WriteArray(string.data(), string.size());
+	}
+
+	//Pad with zeros up to a multiple of the given alignment (a power of 2)
+	void Align(size_t alignment)
+	{
+		m_Data.resize((m_Data.size() + alignment - 1) & ~(alignment - 1), 0);
+	}
+
+	//Overwrite a value written earlier, e.g. a header whose offsets weren't known when it was written
+	template <class T>
+	void Patch(size_t offset, const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be written");
+		std::memcpy(m_Data.data() + offset, &value, sizeof(T));
+	}
+
+	size_t Size() const { return m_Data.size(); }
+
+	//The block written so far, moved out of the writer
+	std::vector<unsigned char> Release() { return std::move(m_Data); }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::vector<unsigned char> m_Data;
+};
+
+
+class BinaryReader
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor from a block of memory that must outlive the reader and anything read from it in place. The
+	//name is used in error messages (e.g. the file the block came from)
+	BinaryReader(const void* data, size_t size, std::string name)
+		: m_Data(static_cast<const unsigned char*>(data)), m_Size(size), m_Name(std::move(name)) {}
+
+	//Copy out the next value
+	template <class T>
+	T Read()
+	{
+		T value;
+		std::memcpy(&value, ReadArray<T>(1), sizeof(T));
+		return value;
+	}
+
+	//The next array of values, where it is in the block
+	template <class T>
+	const T* ReadArray(size_t count)
+	{
+		Align(alignof(T));
+		const T* values = ArrayAt<T>(m_Position, count);
+		m_Position += count * sizeof(T);
+		return values;
+	}
+
+	//The next string, where it is in the block
+	std::string_view ReadString()
+	{
+		const uint32_t length = Read<uint32_t>();
+		return { ReadArray<char>(length), length };
+	}
+
+	//An array of values at the given offset from the start of the block, where it is in the block
+	template <class T>
+	const T* ArrayAt(size_t offset, size_t count) const
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be read");
+		if (offset > m_Size || count > (m_Size - offset) / sizeof(T))  throw std::runtime_error("Unexpected end of " + m_Name);
+		if (reinterpret_cast<uintptr_t>(m_Data + offset) % alignof(T) != 0)  throw std::runtime_error("Misaligned data in " + m_Name);
+		return reinterpret_cast<const T*>(m_Data + offset);
+	}
+
+	//Skip up to a multiple of the given alignment (a power of 2) from the start of the block
+	void Align(size_t alignment)
+	{
+		m_Position = (m_Position + alignment - 1) & ~(alignment - 1);
+	}
+
+	void Seek(size_t offset) { m_Position = offset; }
+	size_t Position() const { return m_Position; }
+	size_t Size() const { return m_Size; }
+	const std::string& Name() const { return m_Name; }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	const unsigned char* m_Data;
+	size_t               m_Size;
+	size_t               m_Position = 0;
+	std::string          m_Name;
+};
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Buffer updaters - copy changed ranges of CPU-side data into a buffer
+//--------------------------------------------------------------------------------------
+// Code that edits a CPU-side copy of some buffer data hands the changed byte ranges to an
+// IBufferUpdater rather than talking to the GPU directly. GpuBufferUpdater (Data folder)
+// sends them to a Direct3D buffer, CpuBufferUpdater keeps them in an ordinary array, so
+// the update logic can be checked without a graphics device.
+
+#pragma once
+#include "epch.h"
+
+class IBufferUpdater
+{
+public:
+	virtual ~IBufferUpdater() {}
+
+	//Copy bytes [offset, offset + size) of source over the same bytes of the buffer
+	//source is the start of the whole CPU-side copy, not the start of the range
+	virtual void Update(const void* source, size_t offset, size_t size) = 0;
+};
+
+
+//Keeps the buffer contents in CPU memory, and counts what was uploaded
+class CpuBufferUpdater : public IBufferUpdater
+{
+public:
+	//Constructor, the buffer starts as a copy of the given data
+	CpuBufferUpdater(const void* data, size_t size)
+		: m_Data(static_cast<const char*>(data), static_cast<const char*>(data) + size) {}
+
+	void Update(const void* source, size_t offset, size_t size) override
+	{
+		if (offset + size > m_Data.size())  throw std::runtime_error("Buffer update past the end of the buffer");
+		std::copy_n(static_cast<const char*>(source) + offset, size, m_Data.data() + offset);
+
+		m_BytesUploaded += size;
+		++m_NumUpdates;
+	}
+
+	const std::vector<char>& Data() const { return m_Data; }
+
+	//Totals since construction
+	size_t BytesUploaded() const { return m_BytesUploaded; }
+	size_t NumUpdates()    const { return m_NumUpdates; }
+
+private:
+	std::vector<char> m_Data;
+
+	size_t m_BytesUploaded = 0;
+	size_t m_NumUpdates = 0;
+};
@@ -1,146 +1,450 @@
 #include "CResourceManager.h"
+#include "Data/CookedMesh.h"
+#include "Data/CookedTexture.h"
+#include "Data/MeshImporter.h"
+#include "Data/AssetArchive.h"
+
+namespace
+{
+	//Texture and mesh returned for ids that haven't been loaded
+	constexpr ResourceId kDefaultID = L"default";
+}
 
 //Constructor
 CResourceManager::CResourceManager()
 {
 }
 
-//Function to load a texture into the textureMap 
-void CResourceManager::loadTexture(const wchar_t* uniqueID, std::string filename)
+//Function to load a texture into the textureMap
+TextureHandle CResourceManager::loadTexture(std::wstring_view uniqueID, std::string filename)
+{
+	TextureHandle handle;
+	if (addTexture(uniqueID, filename, handle) || resourceAt(handle).state == LoadState::Evicted)  loadTextureNow(handle);
+
+	//Callers keep what they load here without acquiring it, so it is never evicted
+	pool.SetPinned(handle, true);
+	return handle;
+}
+
+//Function to load a texture into the meshMap
+MeshHandle CResourceManager::loadMesh(std::wstring_view uniqueID, std::string &filename, bool requireTangents)
+{
+	// Set the mesh to the default one if this filename is not valid. A cooked mesh can be shipped without its mesh file
+	filename = meshFileName(filename, requireTangents);
+
+	MeshHandle handle;
+	if (addMesh(uniqueID, filename, requireTangents, handle) || resourceAt(handle).state == LoadState::Evicted)  loadMeshNow(handle);
+
+	//Models keep the mesh they are made with without acquiring it, so it is never evicted
+	pool.SetPinned(handle, true);
+	return handle;
+}
+
+//Function to load a grid mesh into the meshMap
+MeshHandle CResourceManager::loadGrid(std::wstring_view uniqueID, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& HeightMap, bool normals, bool uvs,
+                                      const HeightFieldGradient* gradient, bool requireTangents)
 {
-	HRESULT result;
+	MeshHandle handle;
+	if (!addMesh(uniqueID, "", false, handle))  return handle;
 
-	// Set the texture to the default one if this filename is not valid
-	if (!doesFileExist(filename))
+	//Create a new Grid Mesh
+	Resource& resource = resourceAt(handle);
+	resource.state = LoadState::Failed; //Unless the mesh is created
+	resource.mesh = new Mesh(minPt, maxPt, subDivX, subDivZ, HeightMap, normals, uvs, gradient, requireTangents);
+	resource.state = LoadState::Ready;
+	pool.SetResident(handle, resource.mesh->MemoryUsage());
+
+	//Grids can't be built again without their HeightField, and may have been updated since, so they are never evicted
+	pool.SetPinned(handle, true);
+	return handle;
+}
+
+//Function to return the Texture at the given ID in the textureMap
+ID3D11ShaderResourceView* CResourceManager::getTexture(ResourceId uid)
+{
+	//Search through the textureMap for the requested texture, loading it again if it has been evicted
+	if (const TextureHandle* found = textureMap.Find(uid))
 	{
-		filename = "../Media/DefaultDiffuse.png";
+		const TextureHandle handle = *found;
+		if (resourceAt(handle).state == LoadState::Evicted)  loadTextureNow(handle);
+
+		const Resource& resource = resourceAt(handle);
+		if (resource.state == LoadState::Ready)
+		{
+			pool.Touch(handle);
+			return resource.texture;
+		}
 	}
 
-	std::string dds = ".dds"; //check the filename extension (case insensitive)
-	if (filename.size() >= 4 &&
-		std::equal(dds.rbegin(), dds.rend(), filename.rbegin(), [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); }))
+	//if no texture found then return the default Texture
+	if (uid != kDefaultID && textureMap.Contains(kDefaultID))  return getTexture(kDefaultID);
+	throw std::runtime_error("No texture " + getName(uid) + " and no default texture");
+}
+
+//Function to return the Mesh at the given ID in the meshMap
+Mesh* CResourceManager::getMesh(ResourceId uid)
+{
+	//Search through the meshMap for the requested mesh, loading it again if it has been evicted
+	if (const MeshHandle* found = meshMap.Find(uid))
 	{
-		result = DirectX::CreateDDSTextureFromFile(gD3DDevice, CA2CT(filename.c_str()), NULL, &texture);
+		const MeshHandle handle = *found;
+		if (resourceAt(handle).state == LoadState::Evicted)  loadMeshNow(handle);
+
+		const Resource& resource = resourceAt(handle);
+		if (resource.state == LoadState::Ready)
+		{
+			pool.Touch(handle);
+			return resource.mesh;
+		}
 	}
-	else
+
+	//if no mesh found then return the default Mesh
+	if (uid != kDefaultID && meshMap.Contains(kDefaultID))  return getMesh(kDefaultID);
+	throw std::runtime_error("No mesh " + getName(uid) + " and no default mesh");
+}
+
+//Function to remove a texture and free it
+void CResourceManager::unloadTexture(ResourceId uid)
+{
+	const TextureHandle* found = textureMap.Find(uid);
+	if (!found)  return;
+
+	const TextureHandle handle = *found;
+	if (pool.References(handle) != 0)  throw std::runtime_error("Unloading texture " + getName(uid) + " while it is referenced");
+	evict(handle);
+	pool.Remove(handle);
+	textureMap.Erase(uid);
+}
+
+//Function to remove a mesh and free it
+void CResourceManager::unloadMesh(ResourceId uid)
+{
+	const MeshHandle* found = meshMap.Find(uid);
+	if (!found)  return;
+
+	const MeshHandle handle = *found;
+	if (pool.References(handle) != 0)  throw std::runtime_error("Unloading mesh " + getName(uid) + " while it is referenced");
+	evict(handle);
+	pool.Remove(handle);
+	meshMap.Erase(uid);
+}
+
+//Function to start loading a texture in the background
+TextureHandle CResourceManager::loadTextureAsync(std::wstring_view uniqueID, std::string filename)
+{
+	TextureHandle handle;
+	if (addTexture(uniqueID, filename, handle))  startTextureLoad(handle);
+	return handle;
+}
+
+//Function to start loading a mesh in the background
+MeshHandle CResourceManager::loadMeshAsync(std::wstring_view uniqueID, std::string filename, bool requireTangents)
+{
+	MeshHandle handle;
+	if (addMesh(uniqueID, filename, requireTangents, handle))  startMeshLoad(handle);
+	return handle;
+}
+
+//Function to create the GPU objects of finished loads for up to the given time, then keep to the memory budget
+void CResourceManager::updateLoads(float budgetMilliseconds)
+{
+	loads.Update(budgetMilliseconds);
+	trimResources();
+}
+
+//Function to wait for every load started so far
+void CResourceManager::finishLoads()
+{
+	loads.Finish();
+}
+
+//Function to return a texture from its handle, the default one until it has loaded
+ID3D11ShaderResourceView* CResourceManager::getTexture(TextureHandle handle)
+{
+	Resource& resource = resourceAt(handle);
+	if (resource.state == LoadState::Evicted)  startTextureLoad(handle);
+	if (resource.state != LoadState::Ready)  return getTexture(kDefaultID);
+
+	pool.Touch(handle);
+	return resource.texture;
+}
+
+//Function to return a mesh from its handle, the default one until it has loaded
+Mesh* CResourceManager::getMesh(MeshHandle handle)
+{
+	Resource& resource = resourceAt(handle);
+	if (resource.state == LoadState::Evicted)  startMeshLoad(handle);
+	if (resource.state != LoadState::Ready)  return getMesh(kDefaultID);
+
+	pool.Touch(handle);
+	return resource.mesh;
+}
+
+//Function to keep a texture loaded
+TextureHandle CResourceManager::acquireTexture(ResourceId uid)
+{
+	const TextureHandle* found = textureMap.Find(uid);
+	if (!found)  throw std::runtime_error("No texture " + getName(uid) + " to acquire");
+
+	const TextureHandle handle = *found;
+	if (resourceAt(handle).state == LoadState::Evicted)  loadTextureNow(handle);
+	pool.AddReference(handle);
+	return handle;
+}
+
+//Function to keep a mesh loaded
+MeshHandle CResourceManager::acquireMesh(ResourceId uid)
+{
+	const MeshHandle* found = meshMap.Find(uid);
+	if (!found)  throw std::runtime_error("No mesh " + getName(uid) + " to acquire");
+
+	const MeshHandle handle = *found;
+	if (resourceAt(handle).state == LoadState::Evicted)  loadMeshNow(handle);
+	pool.AddReference(handle);
+	return handle;
+}
+
+//Functions to let a texture or mesh be evicted again
+void CResourceManager::release(TextureHandle handle)
+{
+	pool.Release(handle);
+}
+
+void CResourceManager::release(MeshHandle handle)
+{
+	pool.Release(handle);
+}
+
+//Function to set the most memory the loaded textures and meshes should use
+void CResourceManager::setMemoryBudget(size_t cpuBytes, size_t gpuBytes)
+{
+	pool.SetBudget({ cpuBytes, gpuBytes });
+}
+
+//Function to evict resources until they are within the budget
+int CResourceManager::trimResources()
+{
+	return pool.Trim([this](ResourceHandle handle) { evict(handle); });
+}
+
+//Helper Function to return the resource of a handle
+const CResourceManager::Resource& CResourceManager::resourceAt(ResourceHandle handle) const
+{
+	if (!pool.IsValid(handle))  throw std::runtime_error("Using the handle of a texture or mesh that has been unloaded");
+	return resources[handle.Index];
+}
+
+CResourceManager::Resource& CResourceManager::resourceAt(ResourceHandle handle)
+{
+	if (!pool.IsValid(handle))  throw std::runtime_error("Using the handle of a texture or mesh that has been unloaded");
+	return resources[handle.Index];
+}
+
+//Helper Function to add a texture to the textureMap, or find the one already there
+bool CResourceManager::addTexture(std::wstring_view uniqueID, const std::string& filename, TextureHandle& handle)
+{
+	ResourceId id = resourceNames.Add(uniqueID);
+	if (const TextureHandle* found = textureMap.Find(id))
 	{
-		result = DirectX::CreateWICTextureFromFile(gD3DDevice, gD3DContext, CA2CT(filename.c_str()), NULL, &texture);
+		handle = *found;
+		return false;
 	}
 
-	//Check whether DirectX had an error when creating the texture
-	if (FAILED(result))
+	//Pool entries are reused after unloading, and so are their resources
+	handle = TextureHandle{ pool.Add() };
+	if (handle.Index >= resources.size())  resources.resize(handle.Index + 1);
+	resources[handle.Index] = Resource();
+	resources[handle.Index].id = id;
+	resources[handle.Index].filename = filename;
+	textureMap.Insert(id, handle);
+
+	//Every missing texture falls back on the default one, so it is never evicted
+	if (id == kDefaultID)  pool.SetPinned(handle, true);
+	return true;
+}
+
+//Helper Function to add a mesh to the meshMap, or find the one already there
+bool CResourceManager::addMesh(std::wstring_view uniqueID, const std::string& filename, bool requireTangents, MeshHandle& handle)
+{
+	ResourceId id = resourceNames.Add(uniqueID);
+	if (const MeshHandle* found = meshMap.Find(id))
 	{
-		//Create a DirectX ScratchImage from the TGA file 
-		DirectX::ScratchImage image;
-		result = DirectX::LoadFromTGAFile(CA2CT(filename.c_str()), DirectX::TGA_FLAGS_NONE, nullptr, image);
-		//Check if the Image was created successfully
-		if (FAILED(result))
-		{
-			MessageBox(NULL, L"Texture loading error", L"ERROR", MB_OK);
-		}
-		else
-		{
-			//Create a ShaderResourceView from this Image and then insert it into the textureMap with the uniqueID
-			result = DirectX::CreateShaderResourceView(gD3DDevice, image.GetImages(), image.GetImageCount(), image.GetMetadata(), &texture);
-			if(FAILED(result))
-			{ }
-			else
-			{
-				textureMap.insert(std::make_pair(const_cast<wchar_t*>(uniqueID), texture));
-			}
-		}
+		handle = *found;
+		return false;
 	}
 
-	//If no error found then add the texture to the TextureMap paired with the unique ID Created
-	else
+	handle = MeshHandle{ pool.Add() };
+	if (handle.Index >= resources.size())  resources.resize(handle.Index + 1);
+	resources[handle.Index] = Resource();
+	resources[handle.Index].id = id;
+	resources[handle.Index].filename = filename;
+	resources[handle.Index].requireTangents = requireTangents;
+	meshMap.Insert(id, handle);
+
+	//Every missing mesh falls back on the default one, so it is never evicted
+	if (id == kDefaultID)  pool.SetPinned(handle, true);
+	return true;
+}
+
+//Helper Function to load a texture on this thread
+void CResourceManager::loadTextureNow(TextureHandle handle)
+{
+	DirectX::ScratchImage image;
+	if (!decodeTexture(resourceAt(handle).filename, image) || !createTexture(handle, image))
 	{
-		textureMap.insert(std::make_pair(const_cast<wchar_t*>(uniqueID), texture));
+		resourceAt(handle).state = LoadState::Failed;
+		MessageBox(NULL, L"Texture loading error", L"ERROR", MB_OK);
 	}
 }
 
-//Function to load a texture into the meshMap 
-void CResourceManager::loadMesh(const wchar_t* uniqueID, std::string &filename, bool requireTangents)
+//Helper Function to load a mesh on this thread
+void CResourceManager::loadMeshNow(MeshHandle handle)
+{
+	Resource& resource = resourceAt(handle);
+	resource.state = LoadState::Failed; //Unless the mesh is created
+
+	//The file may have gone since the mesh was first loaded, the default mesh is used then as it would have been
+	resource.mesh = new Mesh(meshFileName(resource.filename, resource.requireTangents), resource.requireTangents);
+	resource.state = LoadState::Ready;
+	pool.SetResident(handle, resource.mesh->MemoryUsage());
+}
+
+//Helper Function to start loading a texture in the background
+void CResourceManager::startTextureLoad(TextureHandle handle)
 {
-	// Set the texture to the default one if this filename is not valid
-	if (!doesFileExist(filename))
+	Resource& resource = resourceAt(handle);
+	resource.state = LoadState::Loading;
+
+	//Decode on a worker thread, create the texture on the main thread
+	loads.Submit([this, handle, filename = resource.filename]() -> LoadQueue::FinishStep
 	{
-		filename = "Data/Teapot.x";
-	}
-	//Check if the Model requires tangents and if yes then create a new mesh with tangents
-	//otherwise create a new mesh without tangents 
-	if(requireTangents) mesh = new Mesh(filename, true);
-	else mesh = new Mesh(filename);
+		auto image = std::make_shared<DirectX::ScratchImage>();
+		bool decoded = decodeTexture(filename, *image);
+		return [this, handle, image, decoded]()
+		{
+			//The texture may have been unloaded meanwhile, and its handle's slot given to another resource
+			if (!pool.IsValid(handle))  return;
+			if (!decoded || !createTexture(handle, *image))
+			{
+				resourceAt(handle).state = LoadState::Failed;
+				MessageBox(NULL, L"Texture loading error", L"ERROR", MB_OK);
+			}
+		};
+	});
+}
+
+//Helper Function to start loading a mesh in the background
+void CResourceManager::startMeshLoad(MeshHandle handle)
+{
+	Resource& resource = resourceAt(handle);
+	resource.state = LoadState::Loading;
 
-	//Add the new mesh to the meshMap paired with the unique ID Created
-	meshMap.insert(std::make_pair(const_cast<wchar_t*>(uniqueID), mesh));
+	//Map or import the mesh on a worker thread, reading all of it from disk there, then create its buffers on the main thread
+	loads.Submit([this, handle, filename = resource.filename, requireTangents = resource.requireTangents]() -> LoadQueue::FinishStep
+	{
+		std::shared_ptr<CookedMeshFile> file;
+		try
+		{
+			file = std::make_shared<CookedMeshFile>(meshFileName(filename, requireTangents), requireTangents);
+			file->Prefetch();
+		}
+		catch (...)
+		{
+			std::exception_ptr error = std::current_exception();
+			return [this, handle, error]()
+			{
+				if (!pool.IsValid(handle))  return;
+				resourceAt(handle).state = LoadState::Failed;
+				std::rethrow_exception(error);
+			};
+		}
+
+		return [this, handle, file]()
+		{
+			//The mesh may have been unloaded meanwhile, and its handle's slot given to another resource
+			if (!pool.IsValid(handle))  return;
+			Resource& resource = resourceAt(handle);
+			resource.state = LoadState::Failed; //Unless the mesh is created
+			resource.mesh = new Mesh(*file);
+			resource.state = LoadState::Ready;
+			pool.SetResident(handle, resource.mesh->MemoryUsage());
+		};
+	});
 }
 
-//Function to load a grid mesh into the meshMap
-void CResourceManager::loadGrid(const wchar_t* uniqueID, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& HeightMap, bool normals, bool uvs)
+//Helper Function to free a resource's texture or mesh, it is loaded again when it is next asked for
+void CResourceManager::evict(ResourceHandle handle)
 {
-	//Create a new Grid Mesh
-	mesh = new Mesh(minPt, maxPt, subDivX, subDivZ, HeightMap, normals, uvs);
+	Resource& resource = resourceAt(handle);
+	if (resource.texture)  resource.texture->Release();
+	delete resource.mesh;
+	resource.texture = nullptr;
+	resource.mesh = nullptr;
+	resource.state = LoadState::Evicted;
+}
 
-	//Add the new mesh to the meshMap paired with the unique ID Created
-	meshMap.insert(std::make_pair(const_cast<wchar_t*>(uniqueID), mesh));
+//Helper Function to check whether the file given actually exists, in the asset archive or on disk
+bool CResourceManager::doesFileExist(const std::string &fname)
+{
+	return AssetExists(fname);
 }
 
-//Function to return the Texture at the given ID in the textureMap
-ID3D11ShaderResourceView* CResourceManager::getTexture(const wchar_t* uid)
+//Helper Function to read and decode a texture file
+bool CResourceManager::decodeTexture(std::string filename, DirectX::ScratchImage& image)
 {
-	//Search through the textureMap for the requested texture
-	//if no texture found then return the default Texture
-	if (textureMap.find(const_cast<wchar_t*>(uid)) != textureMap.end())
+	//Read the whole file, in place when it is in the asset archive, its cooked file if that is current (see CookedTexture.h)
+	//Set the texture to the default one if this filename is not valid, finding that out by reading it rather than asking the
+	//file system first
+	AssetData file;
+	if (ReadCurrentCookedTexture(filename, file))
 	{
-		// texture exists
-		texture = textureMap.at(const_cast<wchar_t*>(uid));
-		return texture;
+		filename = CookedTextureFileName(filename);
 	}
-	else
+	else if (!ReadAsset(filename, file))
 	{
-		return textureMap.at(L"default");
+		filename = "../Media/DefaultDiffuse.png";
+		if (!ReadAsset(filename, file))  return false;
 	}
+
+	return DecodeTexture(filename, file.Data(), file.Size(), image);
 }
 
-//Function to return the Mesh at the given ID in the meshMap
-Mesh* CResourceManager::getMesh(const wchar_t* uid)
+//Helper Function to create a decoded texture for a resource
+bool CResourceManager::createTexture(TextureHandle handle, const DirectX::ScratchImage& image)
 {
-	//Search through the textureMap for the requested texture
-	//if no texture found then return the default Mesh
-	if (meshMap.find(const_cast<wchar_t*>(uid)) != meshMap.end())
+	ID3D11ShaderResourceView* newTexture = nullptr;
+	if (FAILED(DirectX::CreateShaderResourceView(gD3DDevice, image.GetImages(), image.GetImageCount(), image.GetMetadata(), &newTexture)))
 	{
-		// texture exists
-		mesh = meshMap.at(const_cast<wchar_t*>(uid));
-		return mesh;
-	}
-	else
-	{
-		return meshMap.at(L"default");
+		return false;
 	}
+
+	//The decoded image is freed once the texture is made, so only the GPU holds it (every mip-map, as decoded)
+	Resource& resource = resourceAt(handle);
+	resource.texture = newTexture;
+	resource.state = LoadState::Ready;
+	pool.SetResident(handle, { 0, image.GetPixelsSize() });
+	return true;
 }
 
-//Helper Function to check whether the file given actually exists 
-bool CResourceManager::doesFileExist(std::string &fname)
+//Helper Function to return the mesh file to load
+std::string CResourceManager::meshFileName(const std::string& filename, bool requireTangents)
 {
-	//Checks if the string containing the FileName is viable
-	std::ifstream infile(fname);
-	return infile.good();
+	//A cooked mesh can be shipped without its mesh file
+	if (!doesFileExist(filename) && !doesFileExist(CookedMeshFileName(filename, requireTangents)))
+	{
+		return "Data/Teapot.x";
+	}
+	return filename;
 }
 
 //Destructor
 CResourceManager::~CResourceManager()
 {
-	if (texture) texture->Release();
-	if (mesh) mesh->~Mesh();
-
-	for (auto it = textureMap.cbegin(), next_it = it; it != textureMap.cend(); it = next_it)
-	{
-		++next_it;
-		textureMap.erase(it);
-	}
-	for (auto it = meshMap.cbegin(), next_it = it; it != meshMap.cend(); it = next_it)
+	//Release every texture and delete every mesh still loaded. Loads still running are waited for when loads is destroyed,
+	//without creating their textures or meshes
+	for (auto& resource : resources)
 	{
-		++next_it;
-		meshMap.erase(it);
+		if (resource.texture) resource.texture->Release();
+		delete resource.mesh;
 	}
-}
\ No newline at end of file
+}
@@ -2,10 +2,21 @@
 #include "epch.h"
 #include "GraphicsHelpers.h"
 #include "Data/Mesh.h"
+#include "LoadQueue.h"
+#include "ResourceId.h"
+#include "ResourcePool.h"
 #include <WICTextureLoader.h>
 #include <DDSTextureLoader.h>
 #include <DirectXTex.h>
 
+//State of a texture or mesh. Evicted resources load again when they are next asked for
+enum class LoadState { Loading, Ready, Failed, Evicted };
+
+//Handles to textures and meshes, valid as soon as the load has started and until the resource is unloaded
+//Using a handle after its resource has been unloaded throws a std::runtime_error, even if the slot has been reused
+struct TextureHandle : ResourceHandle {};
+struct MeshHandle    : ResourceHandle {};
+
 class CResourceManager
 {
 //----------------------//
@@ -18,35 +29,154 @@ public:
 	//Destructor
 	~CResourceManager();
 
-	//Function to load a texture into the textureMap 
-	void loadTexture(const wchar_t* uniqueID, std::string filename);
+	//Resources are registered under a name and looked up by the ResourceId of the name, so a name built at runtime finds
+	//the same resource as a literal, and ids for fixed names can be made at compile time (constexpr ResourceId)
+	//Loading a name that is already registered returns the resource that is there
+
+	//Function to load a texture into the textureMap. Textures loaded here are never evicted, see the memory budget below
+	TextureHandle loadTexture(std::wstring_view uniqueID, std::string filename);
+
+	//Function to load a texture into the meshMap. Meshes loaded here are never evicted, see the memory budget below
+	MeshHandle loadMesh(std::wstring_view uniqueID, std::string &filename, bool requireTangents = false);
+
+	//Function to load a grid mesh into the meshMap. Grids are never evicted, they can't be rebuilt without their HeightField
+	MeshHandle CResourceManager::loadGrid(std::wstring_view uniqueID, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, const HeightField& HeightMap, bool normals = true, bool uvs = true,
+	                                      const HeightFieldGradient* gradient = nullptr, bool requireTangents = false);
+
+	//Function to return the Texture at the given ID in the textureMap, the default one if there isn't one
+	//Loads the texture again first if it has been evicted
+	ID3D11ShaderResourceView* getTexture(ResourceId uid);
+
+	//Function to return the Mesh at the given ID in the meshMap, the default one if there isn't one
+	//Loads the mesh again first if it has been evicted
+	Mesh* getMesh(ResourceId uid);
+
+	//Function to return the name a resource was registered under, for error messages
+	std::string getName(ResourceId uid) const { return resourceNames.Name(uid); }
+
+	//Functions to remove a texture or mesh and free it. Its handles are no longer valid, and the name can be loaded again
+	//Throws a std::runtime_error if the resource is referenced
+	void unloadTexture(ResourceId uid);
+	void unloadMesh(ResourceId uid);
+
+	//-----------------------//
+	// Background loading    //
+	//-----------------------//
+	//Functions to start loading a texture or mesh and return straight away. Reading the file, importing and decoding run on
+	//the worker threads, many loads at once. Creating the GPU objects waits for updateLoads or finishLoads on the main thread,
+	//which then add the texture or mesh to the textureMap or meshMap like the functions above
+	TextureHandle loadTextureAsync(std::wstring_view uniqueID, std::string filename);
+	MeshHandle loadMeshAsync(std::wstring_view uniqueID, std::string filename, bool requireTangents = false);
+
+	//Function to call once a frame, before anything is drawn. Creates the GPU objects of finished loads for up to the given
+	//time, then evicts resources if they are over the memory budget
+	//Throws the std::runtime_error of a mesh that failed to load, like loadMesh would have
+	void updateLoads(float budgetMilliseconds = 2.0f);
+
+	//Function to wait for every load started so far and create all their GPU objects, e.g. at the end of scene setup
+	void finishLoads();
+
+	//Function to return how many loads haven't finished
+	int numberLoading() const { return loads.NumberPending(); }
+
+	//Functions to return the state of a texture or mesh
+	LoadState getState(TextureHandle handle) const { return resourceAt(handle).state; }
+	LoadState getState(MeshHandle handle) const { return resourceAt(handle).state; }
 
-	//Function to load a texture into the meshMap 
-	void loadMesh(const wchar_t* uniqueID, std::string &filename, bool requireTangents = false);
+	//Functions to return a texture or mesh from its handle, the default one until it has loaded
+	//If it has been evicted it starts loading again in the background
+	ID3D11ShaderResourceView* getTexture(TextureHandle handle);
+	Mesh* getMesh(MeshHandle handle);
 
-	//Function to load a grid mesh into the meshMap
-	void CResourceManager::loadGrid(const wchar_t* uniqueID, CVector3 minPt, CVector3 maxPt, int subDivX, int subDivZ, std::vector<std::vector<float>>& temp, bool normals = true, bool uvs = true);
+	//-----------------------//
+	// Memory budget         //
+	//-----------------------//
+	//Textures and meshes loaded in the background that aren't referenced are evicted, least recently used first, once the
+	//loaded resources use more memory than the budget. They are loaded again when they are next asked for, so pointers
+	//from getTexture and getMesh are only good until the next updateLoads or trimResources. Models keep their mesh pointer,
+	//so hold a reference to a mesh loaded in the background for as long as models use it. Resources loaded with
+	//loadTexture, loadMesh or loadGrid and the default texture and mesh are never evicted, but can still be unloaded
 
-	//Function to return the Texture at the given ID in the textureMap
-	ID3D11ShaderResourceView* getTexture(const wchar_t* uid);
+	//Functions to keep a texture or mesh loaded, loading it again if it has been evicted. Each acquire needs a release
+	//Throws a std::runtime_error if there is no resource with the name
+	TextureHandle acquireTexture(ResourceId uid);
+	MeshHandle acquireMesh(ResourceId uid);
+	void release(TextureHandle handle);
+	void release(MeshHandle handle);
 
-	//Function to return the Mesh at the given ID in the meshMap
-	Mesh* getMesh(const wchar_t* uid);
+	//Function to set the most CPU and GPU memory the loaded textures and meshes should use, unlimited to start with
+	void setMemoryBudget(size_t cpuBytes, size_t gpuBytes);
+
+	//Functions to return the memory used by every loaded texture and mesh, or by one of them (nothing unless it is loaded)
+	ResourceMemory getMemoryUsage() const { return pool.Used(); }
+	ResourceMemory getMemoryUsage(TextureHandle handle) const { return pool.Memory(handle); }
+	ResourceMemory getMemoryUsage(MeshHandle handle) const { return pool.Memory(handle); }
+
+	//Function to evict resources now until they are within the budget, returns how many were evicted
+	int trimResources();
 
 //--------------------------//
 // Private helper functions	//
 //--------------------------//
 private:
-	//Helper Function to check whether the file given actually exists 
-	bool doesFileExist(std::string &fileName);
+	//A texture or mesh, with what is needed to load it again
+	struct Resource
+	{
+		ResourceId id;
+		ID3D11ShaderResourceView* texture = nullptr;
+		Mesh* mesh = nullptr;
+		LoadState state = LoadState::Loading;
+
+		std::string filename; //Empty for grids
+		bool requireTangents = false;
+	};
+
+	//Helper Function to return the resource of a handle, throws if the resource has been unloaded
+	const Resource& resourceAt(ResourceHandle handle) const;
+	Resource& resourceAt(ResourceHandle handle);
+
+	//Helper Functions to add a resource to the textureMap or meshMap, or find the one already there. Returns false if
+	//the name was already registered
+	bool addTexture(std::wstring_view uniqueID, const std::string& filename, TextureHandle& handle);
+	bool addMesh(std::wstring_view uniqueID, const std::string& filename, bool requireTangents, MeshHandle& handle);
+
+	//Helper Functions to load a texture or mesh on this thread, or start loading it in the background
+	void loadTextureNow(TextureHandle handle);
+	void loadMeshNow(MeshHandle handle);
+	void startTextureLoad(TextureHandle handle);
+	void startMeshLoad(MeshHandle handle);
+
+	//Helper Function to free a resource's texture or mesh
+	void evict(ResourceHandle handle);
+
+	//Helper Function to check whether the file given actually exists, in the asset archive (see AssetArchive.h) or on disk
+	static bool doesFileExist(const std::string &fileName);
+
+	//Helper Function to read and decode a texture file, or its cooked file, from the asset archive or disk, the default
+	//texture if the file isn't there. Safe on any thread
+	//Returns false if the file can't be decoded
+	static bool decodeTexture(std::string filename, DirectX::ScratchImage& image);
+
+	//Helper Function to create a decoded texture for a resource. Returns false if it can't be created
+	bool createTexture(TextureHandle handle, const DirectX::ScratchImage& image);
+
+	//Helper Function to return the mesh file to load, the default mesh if neither the file nor its cooked file is there
+	static std::string meshFileName(const std::string& filename, bool requireTangents);
 
 //-------------//
 // Member data //
 //-------------//
 private:
-	ID3D11ShaderResourceView* texture;
-	Mesh* mesh;
+	FlatHashMap<ResourceId, TextureHandle> textureMap;
+	FlatHashMap<ResourceId, MeshHandle> meshMap;
+
+	//Names of everything registered, shared by textures and meshes
+	ResourceNames resourceNames;
+
+	//Every texture and mesh, indexed by their handles. Textures and meshes share one pool so they share one budget
+	std::vector<Resource> resources;
+	ResourcePool pool;
 
-	std::map<wchar_t*, ID3D11ShaderResourceView*> textureMap;
-	std::map<wchar_t*, Mesh*> meshMap;
+	//Declared last so it is destroyed first, waiting for any loads still running on the worker threads
+	LoadQueue loads;
 };
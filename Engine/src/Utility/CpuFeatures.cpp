@@ -0,0 +1,125 @@
+#include "epch.h"
+#include "CpuFeatures.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+	//Run cpuid for the given leaf / sub-leaf, registers are returned as eax, ebx, ecx, edx
+	void CpuId(int leaf, int subLeaf, int registers[4])
+	{
+#ifdef _MSC_VER
+		__cpuidex(registers, leaf, subLeaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subLeaf, a, b, c, d);
+		registers[0] = a; registers[1] = b; registers[2] = c; registers[3] = d;
+#endif
+	}
+
+	//Read the extended control register that says which register states the OS saves
+	uint64_t ReadXcr0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+	}
+
+	CpuFeatures DetectCpuFeatures()
+	{
+		CpuFeatures features;
+
+		int registers[4];
+		CpuId(0, 0, registers);
+		int maxLeaf = registers[0];
+		if (maxLeaf < 1)  return features;
+
+		CpuId(1, 0, registers);
+		features.sse2  = (registers[3] & (1 << 26)) != 0;
+		features.sse41 = (registers[2] & (1 << 19)) != 0;
+
+		//AVX needs the OS to save the YMM registers, AVX-512 also needs the opmask and ZMM registers saved
+		bool osxsave = (registers[2] & (1 << 27)) != 0;
+		uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+		bool osSavesYmm = (xcr0 & 0x06) == 0x06;
+		bool osSavesZmm = (xcr0 & 0xE6) == 0xE6;
+
+		features.avx = osSavesYmm && (registers[2] & (1 << 28)) != 0;
+		features.fma = features.avx && (registers[2] & (1 << 12)) != 0;
+
+		if (maxLeaf >= 7)
+		{
+			CpuId(7, 0, registers);
+			features.avx2    = features.avx && (registers[1] & (1 << 5)) != 0;
+			features.avx512f = features.avx2 && osSavesZmm && (registers[1] & (1 << 16)) != 0;
+			features.avx512dq = features.avx512f && (registers[1] & (1 << 17)) != 0;
+			features.avx512bw = features.avx512f && (registers[1] & (1 << 30)) != 0;
+			features.avx512vl = features.avx512f && (registers[1] & (1u << 31)) != 0;
+		}
+		return features;
+	}
+
+	//Level named by the ENGINE_SIMD environment variable, or the detected level if it isn't set (or isn't a level)
+	//A level wider than the CPU supports would crash, so it can only lower the level. Kernels choose their level while
+	//statics are initialised, so nothing is printed here; each kernel's *KernelName() says which one is in use
+	SimdLevel ChooseSimdLevel()
+	{
+		SimdLevel detected = DetectedSimdLevel();
+
+		const char* variable = std::getenv("ENGINE_SIMD");
+		if (variable == nullptr || *variable == '\0')  return detected;
+
+		std::string name = variable;
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		SimdLevel requested;
+		if      (name == "sse2")                        requested = SimdLevel::SSE2;
+		else if (name == "avx2")                        requested = SimdLevel::AVX2;
+		else if (name == "avx512" || name == "avx-512") requested = SimdLevel::AVX512;
+		else                                            return detected;
+
+		return requested > detected ? detected : requested;
+	}
+}
+
+//Features of the CPU the program is running on
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
+
+
+//Widest level the CPU supports, ignoring ENGINE_SIMD
+SimdLevel DetectedSimdLevel()
+{
+	const CpuFeatures& cpu = GetCpuFeatures();
+	if (cpu.avx512f && cpu.avx512bw && cpu.avx512dq && cpu.avx512vl && cpu.fma)  return SimdLevel::AVX512;
+	if (cpu.avx2 && cpu.fma)  return SimdLevel::AVX2;
+	return SimdLevel::SSE2;
+}
+
+//Level every kernel should use: the detected level, lowered to the one named by ENGINE_SIMD if it is set
+SimdLevel GetSimdLevel()
+{
+	static const SimdLevel level = ChooseSimdLevel();
+	return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX512: return "AVX-512";
+	case SimdLevel::AVX2:   return "AVX2";
+	default:                return "SSE2";
+	}
+}
@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Detection of the SIMD instruction sets available on this CPU
+//--------------------------------------------------------------------------------------
+// Detected once on first use. An instruction set is only reported as available if the
+// operating system also saves the registers it uses (checked with xgetbv).
+//
+// Kernels with versions for several instruction sets pick one with GetSimdLevel, which is
+// the CPU's best level unless the ENGINE_SIMD environment variable asks for a lower one
+// (sse2, avx2 or avx512). That lets every version be run and checked on a single machine.
+// Any other value, or a level the CPU can't run, is ignored. Each kernel reports the version
+// it uses by name (e.g. MatrixKernelName).
+
+#pragma once
+#include "epch.h"
+
+struct CpuFeatures
+{
+	bool sse2    = false;
+	bool sse41   = false;
+	bool avx     = false;
+	bool avx2    = false;
+	bool fma     = false;
+	bool avx512f = false;
+	bool avx512bw = false;
+	bool avx512dq = false;
+	bool avx512vl = false;
+};
+
+//Features of the CPU the program is running on
+const CpuFeatures& GetCpuFeatures();
+
+//The instruction sets kernels are compiled for, in order. AVX2 includes FMA, and AVX-512 is the
+//F, BW, DQ and VL subsets enabled by the compiler's AVX-512 setting
+enum class SimdLevel
+{
+	SSE2,
+	AVX2,
+	AVX512,
+};
+
+//Widest level the CPU supports, ignoring ENGINE_SIMD
+SimdLevel DetectedSimdLevel();
+
+//Level every kernel should use: the detected level, lowered to the one named by ENGINE_SIMD if it is set
+//Worked out once on first use, so every kernel in the program uses the same level
+SimdLevel GetSimdLevel();
+
+//"SSE2", "AVX2" or "AVX-512"
+const char* SimdLevelName(SimdLevel level);
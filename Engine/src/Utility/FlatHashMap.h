@@ -0,0 +1,179 @@
+//--------------------------------------------------------------------------------------
+// FlatHashMap class - an open-addressing hash map in flat arrays
+//--------------------------------------------------------------------------------------
+// Keys and values sit in arrays of their own with no node per entry, so a lookup hashes the key
+// and scans a few neighbouring keys in one cache line rather than chasing pointers through a
+// tree. Collisions are handled by linear probing and erasing shifts the following entries back
+// instead of leaving tombstones, so lookups stay short however many erases there have been.
+// Keys and values must be default constructible and cheap to move, e.g. ids and pointers.
+// Pointers to values are invalidated by inserting or erasing.
+
+#pragma once
+#include "epch.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+template <class Key, class Value, class Hash = std::hash<Key>>
+class FlatHashMap
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//The value stored for a key, null if there isn't one
+	Value* Find(const Key& key)
+	{
+		size_t slot;
+		return FindSlot(key, slot) ? &m_Values[slot] : nullptr;
+	}
+	const Value* Find(const Key& key) const
+	{
+		size_t slot;
+		return FindSlot(key, slot) ? &m_Values[slot] : nullptr;
+	}
+
+	bool Contains(const Key& key) const { return Find(key) != nullptr; }
+
+	//Add a value for a key that isn't in the map yet. Returns the value stored for the key, and false if the key was
+	//already there (its value is left as it was, as std::map::insert does)
+	std::pair<Value*, bool> Insert(const Key& key, Value value)
+	{
+		size_t slot;
+		if (FindSlot(key, slot))  return { &m_Values[slot], false };
+
+		if ((m_Size + 1) * kMaxLoadDenominator > Capacity() * kMaxLoadNumerator)
+		{
+			Rehash(Capacity() == 0 ? kMinCapacity : Capacity() * 2);
+			FindSlot(key, slot);
+		}
+		m_Used[slot]   = 1;
+		m_Keys[slot]   = key;
+		m_Values[slot] = std::move(value);
+		++m_Size;
+		return { &m_Values[slot], true };
+	}
+
+	//The value for a key, adding a default constructed one if the key isn't there
+	Value& operator[](const Key& key) { return *Insert(key, Value()).first; }
+
+	//Remove a key and its value, returns false if the key wasn't there
+	bool Erase(const Key& key)
+	{
+		size_t hole;
+		if (!FindSlot(key, hole))  return false;
+
+		//Shift back each following entry that can move into the hole, i.e. whose home slot isn't after the hole,
+		//so no probe sequence runs into an empty slot before reaching its key
+		const size_t mask = Capacity() - 1;
+		for (size_t next = (hole + 1) & mask; m_Used[next]; next = (next + 1) & mask)
+		{
+			const size_t home = Home(m_Keys[next]);
+			if (((next - home) & mask) >= ((next - hole) & mask))
+			{
+				m_Keys[hole]   = std::move(m_Keys[next]);
+				m_Values[hole] = std::move(m_Values[next]);
+				hole = next;
+			}
+		}
+		m_Used[hole]   = 0;
+		m_Keys[hole]   = Key();
+		m_Values[hole] = Value();
+		--m_Size;
+		return true;
+	}
+
+	//Make room for the given number of entries without growing again
+	void Reserve(size_t count)
+	{
+		size_t capacity = kMinCapacity;
+		while (count * kMaxLoadDenominator > capacity * kMaxLoadNumerator)  capacity *= 2;
+		if (capacity > Capacity())  Rehash(capacity);
+	}
+
+	//Remove every entry, keeping the memory
+	void Clear()
+	{
+		std::fill(m_Used.begin(), m_Used.end(), 0);
+		std::fill(m_Keys.begin(), m_Keys.end(), Key());
+		std::fill(m_Values.begin(), m_Values.end(), Value());
+		m_Size = 0;
+	}
+
+	size_t Size() const { return m_Size; }
+	bool Empty() const { return m_Size == 0; }
+
+	//Call function(key, value) for every entry, in no particular order. The function mustn't insert or erase
+	template <class Function>
+	void ForEach(Function function)
+	{
+		for (size_t slot = 0; slot < m_Used.size(); ++slot)
+		{
+			if (m_Used[slot])  function(static_cast<const Key&>(m_Keys[slot]), m_Values[slot]);
+		}
+	}
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	size_t Capacity() const { return m_Used.size(); }
+
+	//Slot a key's probe sequence starts from. The hash is multiplied by 2^64 / golden ratio and the top bits used, so
+	//weak hashes (e.g. std::hash of an integer is often the integer itself) still spread over the slots
+	size_t Home(const Key& key) const
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull) >> m_Shift);
+	}
+
+	//Find the slot holding a key, or if it isn't there the empty slot where it would go. Returns true if found
+	bool FindSlot(const Key& key, size_t& slot) const
+	{
+		if (Capacity() == 0)  return false;
+		const size_t mask = Capacity() - 1;
+		for (slot = Home(key); m_Used[slot]; slot = (slot + 1) & mask)
+		{
+			if (m_Keys[slot] == key)  return true;
+		}
+		return false;
+	}
+
+	//Move every entry into arrays of the given capacity (a power of 2)
+	void Rehash(size_t capacity)
+	{
+		std::vector<unsigned char> used   = std::move(m_Used);
+		std::vector<Key>           keys   = std::move(m_Keys);
+		std::vector<Value>         values = std::move(m_Values);
+		m_Used.assign(capacity, 0);
+		m_Keys.assign(capacity, Key());
+		m_Values.assign(capacity, Value());
+		m_Shift = 64;
+		for (size_t c = capacity; c > 1; c /= 2)  --m_Shift;
+
+		const size_t mask = capacity - 1;
+		for (size_t old = 0; old < used.size(); ++old)
+		{
+			if (!used[old])  continue;
+			size_t slot = Home(keys[old]);
+			while (m_Used[slot])  slot = (slot + 1) & mask;
+			m_Used[slot]   = 1;
+			m_Keys[slot]   = std::move(keys[old]);
+			m_Values[slot] = std::move(values[old]);
+		}
+	}
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	//Grow once more than 3/4 of the slots are used, linear probing slows quickly past that
+	static const size_t kMaxLoadNumerator   = 3;
+	static const size_t kMaxLoadDenominator = 4;
+	static const size_t kMinCapacity        = 16;
+
+	std::vector<unsigned char> m_Used;      //1 where a slot holds an entry
+	std::vector<Key>           m_Keys;
+	std::vector<Value>         m_Values;
+	size_t                     m_Size  = 0;
+	unsigned int               m_Shift = 64; //64 - log2 of the capacity
+};
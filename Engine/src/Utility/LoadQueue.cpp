@@ -0,0 +1,99 @@
+#include "epch.h"
+#include "LoadQueue.h"
+#include <chrono>
+
+//Constructor, the loads run on the given pool
+LoadQueue::LoadQueue(ThreadPool& threadPool)
+	: m_ThreadPool(threadPool)
+{
+}
+
+//Destructor, waits for loads running on the pool as they refer to the queue
+LoadQueue::~LoadQueue()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Finished.wait(lock, [this]() { return m_NumLoading == 0; });
+}
+
+//Run the load on a worker thread and queue the step it returns for the main thread
+void LoadQueue::Submit(std::function<FinishStep()> load)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_NumLoading;
+		++m_NumPending;
+	}
+
+	m_ThreadPool.Submit([this, load = std::move(load)]()
+	{
+		FinishStep step;
+		try
+		{
+			step = load();
+		}
+		catch (...)
+		{
+			std::exception_ptr error = std::current_exception();
+			step = [error]() { std::rethrow_exception(error); };
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Steps.push_back(std::move(step));
+		--m_NumLoading;
+		m_Finished.notify_all();
+	});
+}
+
+//Run the steps of finished loads until none are left or the budget is used up
+int LoadQueue::Update(float budgetMilliseconds)
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(budgetMilliseconds));
+
+	int numRun = 0;
+	while (RunStep())
+	{
+		++numRun;
+		if (Clock::now() >= end)  break;
+	}
+	return numRun;
+}
+
+//Wait for every load submitted so far, running all their steps
+void LoadQueue::Finish()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Finished.wait(lock, [this]() { return !m_Steps.empty() || m_NumPending == 0; });
+			if (m_NumPending == 0)  return;
+		}
+		while (RunStep()) {}
+	}
+}
+
+//Number of loads submitted whose steps haven't run yet
+int LoadQueue::NumberPending() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_NumPending;
+}
+
+
+//Run the step of the first finished load, returns false if there isn't one
+bool LoadQueue::RunStep()
+{
+	FinishStep step;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Steps.empty())  return false;
+		step = std::move(m_Steps.front());
+		m_Steps.pop_front();
+		--m_NumPending;
+	}
+
+	//Taken off the queue before it runs, so if it throws the next Update moves on to the next step
+	if (step)  step();
+	return true;
+}
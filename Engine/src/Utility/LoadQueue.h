@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------------------
+// LoadQueue class - loads on worker threads, finished off on the main thread
+//--------------------------------------------------------------------------------------
+// Loading an asset is mostly reading and decoding, which any thread can do, followed by a
+// short step that creates the GPU objects, which should happen on the main thread. Submit
+// runs the first part on a ThreadPool and queues the step it returns. The main thread calls
+// Update once a frame to run the queued steps within a time budget, so many assets load at
+// once and a frame never stalls for long on uploads. Finish runs everything to completion,
+// e.g. at the end of scene startup.
+
+#pragma once
+#include "epch.h"
+#include "ThreadPool.h"
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+class LoadQueue
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor, the loads run on the given pool
+	explicit LoadQueue(ThreadPool& threadPool = ThreadPool::Get());
+
+	//Destructor, waits for loads running on the pool. Steps still queued for the main thread are dropped
+	~LoadQueue();
+
+	LoadQueue(const LoadQueue&) = delete;
+	LoadQueue& operator=(const LoadQueue&) = delete;
+
+	//The step run on the main thread once a load has finished
+	using FinishStep = std::function<void()>;
+
+	//Run the load on a worker thread and queue the step it returns for the main thread. If the load throws, the
+	//exception is thrown on the main thread instead, from the Update or Finish that would have run its step
+	void Submit(std::function<FinishStep()> load);
+
+	//Run the steps of finished loads until none are left or the budget is used up. At least one step is run if there
+	//is one, so loading always moves on. Returns the number of steps run. Call from the main thread
+	int Update(float budgetMilliseconds);
+
+	//Wait for every load submitted so far, running all their steps. Call from the main thread
+	void Finish();
+
+	//Number of loads submitted whose steps haven't run yet
+	int NumberPending() const;
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Run the step of the first finished load, returns false if there isn't one
+	bool RunStep();
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	ThreadPool& m_ThreadPool;
+
+	mutable std::mutex      m_Mutex;
+	std::condition_variable m_Finished;    //Signalled when a load finishes on a worker
+	std::deque<FinishStep>  m_Steps;       //Steps of finished loads, in the order they finished
+	int                     m_NumLoading = 0; //Loads submitted and still running on the pool
+	int                     m_NumPending = 0; //Loads submitted whose steps haven't run
+};
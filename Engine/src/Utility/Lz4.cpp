@@ -0,0 +1,150 @@
+#include "epch.h"
+#include "Lz4.h"
+#include <cstring>
+
+namespace
+{
+	//Format limits: matches are at least 4 bytes and copy from at most 64KB back, the last 5 bytes are always literals
+	//and the last match starts at least 12 bytes from the end
+	const size_t kMinMatch      = 4;
+	const size_t kMaxOffset     = 65535;
+	const size_t kLastLiterals  = 5;
+	const size_t kMatchEndLimit = 12;
+
+	//Where the last position with each 4 byte hash was seen, for finding matches
+	const int kHashBits = 16;
+
+	uint32_t Read32(const unsigned char* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - kHashBits);
+	}
+
+	//A length in a token's 4 bits, with the rest in extra bytes of 255 until one is smaller
+	void WriteLength(std::vector<unsigned char>& output, size_t length)
+	{
+		for (length -= 15; length >= 255; length -= 255)  output.push_back(255);
+		output.push_back(static_cast<unsigned char>(length));
+	}
+
+	//A run of literals then a match (no match for the last sequence)
+	void WriteSequence(std::vector<unsigned char>& output, const unsigned char* literals, size_t numLiterals, size_t offset, size_t matchLength)
+	{
+		const size_t matchCode = matchLength >= kMinMatch ? matchLength - kMinMatch : 0;
+		output.push_back(static_cast<unsigned char>((std::min<size_t>(numLiterals, 15) << 4) | std::min<size_t>(matchCode, 15)));
+		if (numLiterals >= 15)  WriteLength(output, numLiterals);
+		output.insert(output.end(), literals, literals + numLiterals);
+		if (matchLength == 0)  return;
+
+		output.push_back(static_cast<unsigned char>(offset & 0xff));
+		output.push_back(static_cast<unsigned char>(offset >> 8));
+		if (matchCode >= 15)  WriteLength(output, matchCode);
+	}
+
+	//A length from a token's 4 bits and the extra bytes after it. Returns false if it runs off the end
+	bool ReadLength(const unsigned char*& input, const unsigned char* end, size_t& length)
+	{
+		if (length != 15)  return true;
+		unsigned char extra;
+		do
+		{
+			if (input == end)  return false;
+			extra = *input++;
+			length += extra;
+		} while (extra == 255);
+		return true;
+	}
+}
+
+//Compress a block of data
+std::vector<unsigned char> CompressLz4(const void* data, size_t size)
+{
+	const unsigned char* input = static_cast<const unsigned char*>(data);
+	std::vector<unsigned char> output;
+	output.reserve(size / 2 + 16);
+
+	size_t anchor = 0; //Start of the literals not written yet
+	if (size > kMatchEndLimit)
+	{
+		std::vector<int64_t> lastSeen(size_t(1) << kHashBits, -1);
+		const size_t matchStartLimit = size - kMatchEndLimit;
+		const size_t matchEndLimit   = size - kLastLiterals;
+		size_t position = 0;
+		while (position < matchStartLimit)
+		{
+			const uint32_t sequence = Read32(input + position);
+			const uint32_t hash = Hash(sequence);
+			const int64_t candidate = lastSeen[hash];
+			lastSeen[hash] = static_cast<int64_t>(position);
+
+			if (candidate < 0 || position - static_cast<size_t>(candidate) > kMaxOffset || Read32(input + candidate) != sequence)
+			{
+				++position;
+				continue;
+			}
+
+			size_t matchLength = kMinMatch;
+			while (position + matchLength < matchEndLimit && input[candidate + matchLength] == input[position + matchLength])  ++matchLength;
+
+			WriteSequence(output, input + anchor, position - anchor, position - static_cast<size_t>(candidate), matchLength);
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	WriteSequence(output, input + anchor, size - anchor, 0, 0);
+	return output;
+}
+
+//Decompress a block into exactly the given number of bytes
+bool DecompressLz4(const void* compressed, size_t compressedSize, void* output, size_t outputSize)
+{
+	const unsigned char* input = static_cast<const unsigned char*>(compressed);
+	const unsigned char* inputEnd = input + compressedSize;
+	unsigned char* out = static_cast<unsigned char*>(output);
+	size_t written = 0;
+
+	while (input != inputEnd)
+	{
+		const unsigned char token = *input++;
+
+		size_t numLiterals = token >> 4;
+		if (!ReadLength(input, inputEnd, numLiterals))  return false;
+		if (numLiterals > static_cast<size_t>(inputEnd - input) || numLiterals > outputSize - written)  return false;
+		std::memcpy(out + written, input, numLiterals);
+		input += numLiterals;
+		written += numLiterals;
+
+		//The last sequence has no match
+		if (input == inputEnd)  break;
+
+		if (inputEnd - input < 2)  return false;
+		const size_t offset = input[0] | (static_cast<size_t>(input[1]) << 8);
+		input += 2;
+		if (offset == 0 || offset > written)  return false;
+
+		size_t matchLength = token & 0xf;
+		if (!ReadLength(input, inputEnd, matchLength))  return false;
+		matchLength += kMinMatch;
+		if (matchLength > outputSize - written)  return false;
+
+		//Matches may overlap what they write (e.g. a run of one byte has offset 1), so copy a byte at a time then
+		const unsigned char* source = out + written - offset;
+		if (offset >= matchLength)
+		{
+			std::memcpy(out + written, source, matchLength);
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; ++i)  out[written + i] = source[i];
+		}
+		written += matchLength;
+	}
+	return written == outputSize;
+}
@@ -0,0 +1,21 @@
+//--------------------------------------------------------------------------------------
+// LZ4 block compression
+//--------------------------------------------------------------------------------------
+// Data is compressed in the LZ4 block format: runs of literal bytes, each followed by a copy
+// of up to 64KB back in the output. Decompressing is little more than memcpy, so it is cheap
+// enough to do while loading, and compressed assets take fewer reads off the disk. The
+// compressor is a simple greedy one, made for offline packing rather than speed. Blocks are
+// compatible with other LZ4 block decoders, but there is no frame, size or checksum around them.
+
+#pragma once
+#include "epch.h"
+
+//Most bytes a byte of a block can decompress to. A copy's length goes up by 255 for each extra length byte
+const size_t kLz4MaxRatio = 255;
+
+//Compress a block of data. Incompressible data comes out slightly larger than it went in
+std::vector<unsigned char> CompressLz4(const void* data, size_t size);
+
+//Decompress a block into exactly the given number of bytes. Checks every copy stays inside both blocks, so corrupt data
+//is caught rather than read or written past the ends. Returns false if the block is corrupt or isn't that size
+bool DecompressLz4(const void* compressed, size_t compressedSize, void* output, size_t outputSize);
@@ -0,0 +1,123 @@
+#include "epch.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Constructor that opens the given file, throws if it can't be mapped
+MappedFile::MappedFile(const std::string& fileName)
+{
+	if (!Open(fileName))  throw std::runtime_error("Can't map file " + fileName);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: m_Data(other.m_Data), m_Size(other.m_Size), m_Open(other.m_Open)
+{
+	other.m_Data = nullptr;
+	other.m_Size = 0;
+	other.m_Open = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_Data, other.m_Data);
+		std::swap(m_Size, other.m_Size);
+		std::swap(m_Open, other.m_Open);
+	}
+	return *this;
+}
+
+//Map the given file, closing any file already open. Returns false if the file doesn't exist or can't be mapped
+//The file and mapping handles are closed straight away, the view keeps the mapping alive until it is unmapped
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)  return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	//Windows can't map an empty file
+	if (size.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (mapping)  CloseHandle(mapping);
+		if (view == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		m_Data = static_cast<const unsigned char*>(view);
+		m_Size = static_cast<size_t>(size.QuadPart);
+	}
+	CloseHandle(file);
+#else
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file < 0)  return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	if (status.st_size > 0)
+	{
+		void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+		m_Data = static_cast<const unsigned char*>(view);
+		m_Size = static_cast<size_t>(status.st_size);
+	}
+	close(file);
+#endif
+
+	m_Open = true;
+	return true;
+}
+
+//Touch every page of the file
+void MappedFile::Prefetch() const
+{
+	//4KB is the smallest page size of the systems we run on, larger pages are just touched more than once
+	//Read through volatile so the reads aren't optimised away
+	const size_t kPageSize = 4096;
+	const volatile unsigned char* data = m_Data;
+	for (size_t offset = 0; offset < m_Size; offset += kPageSize)  (void)data[offset];
+}
+
+//Unmap the file
+void MappedFile::Close()
+{
+	if (m_Data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+#else
+		munmap(const_cast<unsigned char*>(m_Data), m_Size);
+#endif
+	}
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Open = false;
+}
@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// MappedFile class - a read-only view of a whole file through the virtual memory system
+//--------------------------------------------------------------------------------------
+// The file's pages are only read from disk when they are first touched, and come straight
+// from the OS file cache when the file has been read recently, so nothing is copied into
+// buffers of our own. Data stays valid until the file is closed or the MappedFile destroyed.
+
+#pragma once
+#include "epch.h"
+
+class MappedFile
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	MappedFile() {}
+
+	//Constructor that opens the given file, throws a std::runtime_error if it can't be mapped
+	explicit MappedFile(const std::string& fileName);
+
+	//Destructor, unmaps the file
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	//Map the given file, closing any file already open. Returns false if the file doesn't exist or can't be mapped
+	//An empty file opens with no data
+	bool Open(const std::string& fileName);
+
+	//Unmap the file, Data() becomes null
+	void Close();
+
+	bool IsOpen() const { return m_Open; }
+
+	//Touch every page of the file so it is read from disk now, e.g. on a loading thread, rather than by whoever
+	//uses the data first
+	void Prefetch() const;
+
+	const unsigned char* Data() const { return m_Data; }
+	size_t Size() const { return m_Size; }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	const unsigned char* m_Data = nullptr;
+	size_t               m_Size = 0;
+	bool                 m_Open = false;
+};
@@ -0,0 +1,67 @@
+#include "epch.h"
+#include "NameIndex.h"
+
+namespace
+{
+	//Node names are short, so one block holds the names of a large rig. Longer names get a block of their own
+	const size_t kBlockSize = 4096;
+}
+
+//Give the next index the given name. Returns the name as stored in the table
+std::string_view NameIndex::Add(std::string_view name)
+{
+	const unsigned int index = Size();
+	auto existing = m_Indices.find(name);
+	if (existing != m_Indices.end())
+	{
+		//Share the copy the first index made
+		std::string_view stored = m_Names[existing->second];
+		m_Names.push_back(stored);
+		return stored;
+	}
+
+	std::string_view stored = Intern(name);
+	m_Names.push_back(stored);
+	m_Indices.emplace(stored, index);
+	return stored;
+}
+
+//Make room for the given number of indices
+void NameIndex::Reserve(unsigned int count)
+{
+	m_Names.reserve(count);
+	m_Indices.reserve(count);
+}
+
+//Remove every name and free the storage
+void NameIndex::Clear()
+{
+	m_Indices.clear();
+	m_Names.clear();
+	m_Blocks.clear();
+	m_BlockUsed = m_BlockSize = 0;
+}
+
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+
+//Copy a name into the storage blocks, starting a new block when the current one is full
+std::string_view NameIndex::Intern(std::string_view name)
+{
+	//Null terminated so the names can be passed to C APIs with .data()
+	const size_t size = name.size() + 1;
+	if (m_BlockUsed + size > m_BlockSize)
+	{
+		m_BlockSize = std::max(kBlockSize, size);
+		m_Blocks.push_back(std::make_unique<char[]>(m_BlockSize));
+		m_BlockUsed = 0;
+	}
+
+	char* stored = m_Blocks.back().get() + m_BlockUsed;
+	std::copy(name.begin(), name.end(), stored);
+	stored[name.size()] = '\0';
+	m_BlockUsed += size;
+	return { stored, name.size() };
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// NameIndex class - names given to a run of indices, looked up through a hash table
+//--------------------------------------------------------------------------------------
+// Each index (e.g. a node of a mesh) is given a name in turn. Names are interned: each
+// distinct name is copied once into blocks of storage that never move, and every index with
+// that name shares the copy, so the string_views handed out stay valid for the life of the
+// table, even when it is moved. Finding an index from its name is a hash lookup rather than a
+// walk comparing strings, which matters when binding hundreds of bones to hundreds of nodes.
+
+#pragma once
+#include "epch.h"
+#include <string_view>
+#include <unordered_map>
+
+class NameIndex
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Returned by Find for a name no index has
+	static constexpr unsigned int kNotFound = ~0u;
+
+	//Give the next index (Size() before the call) the given name. Returns the name as stored in the table
+	//Several indices can share a name, Find returns the first of them
+	std::string_view Add(std::string_view name);
+
+	//The first index with the given name, or kNotFound
+	unsigned int Find(std::string_view name) const
+	{
+		auto index = m_Indices.find(name);
+		return index != m_Indices.end() ? index->second : kNotFound;
+	}
+
+	std::string_view Name(unsigned int index) const { return m_Names[index]; }
+
+	unsigned int Size() const { return static_cast<unsigned int>(m_Names.size()); }
+
+	//Make room for the given number of indices
+	void Reserve(unsigned int count);
+
+	//Remove every name and free the storage
+	void Clear();
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Copy a name into the storage blocks, starting a new block when the current one is full
+	std::string_view Intern(std::string_view name);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::vector<std::unique_ptr<char[]>> m_Blocks;
+	size_t m_BlockUsed = 0;
+	size_t m_BlockSize = 0;
+
+	std::vector<std::string_view>                     m_Names;   //By index
+	std::unordered_map<std::string_view, unsigned int> m_Indices; //First index with each name, keys point into m_Blocks
+};
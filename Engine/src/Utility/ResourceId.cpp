@@ -0,0 +1,63 @@
+#include "epch.h"
+#include "ResourceId.h"
+
+namespace
+{
+	//A wide name as a narrow one for messages: ASCII as it is, anything else as \uXXXX (or \UXXXXXXXX), so different names
+	//stay different
+	std::string NarrowName(std::wstring_view name)
+	{
+		static const char kHexDigits[] = "0123456789abcdef";
+		std::string narrow;
+		narrow.reserve(name.size());
+		for (wchar_t c : name)
+		{
+			const uint32_t code = static_cast<uint32_t>(c);
+			if (code < 128)
+			{
+				narrow += static_cast<char>(code);
+				continue;
+			}
+			const bool large = code > 0xffff;
+			narrow += large ? "\\U" : "\\u";
+			for (int shift = large ? 28 : 12; shift >= 0; shift -= 4)  narrow += kHexDigits[(code >> shift) & 0xf];
+		}
+		return narrow;
+	}
+}
+
+//Record the name of an id
+ResourceId ResourceNames::Add(std::string_view name)
+{
+	const ResourceId id(name);
+	auto inserted = m_Names.Insert(id, std::string(name));
+	if (!inserted.second && *inserted.first != name)
+	{
+		throw std::runtime_error("Resource names \"" + *inserted.first + "\" and \"" + std::string(name) + "\" have the same id");
+	}
+	return id;
+}
+
+ResourceId ResourceNames::Add(std::wstring_view name)
+{
+	//Hashed as it is, the narrow copy is only for messages
+	const ResourceId id(name);
+	std::string narrow = NarrowName(name);
+	auto inserted = m_Names.Insert(id, narrow);
+	if (!inserted.second && *inserted.first != narrow)
+	{
+		throw std::runtime_error("Resource names \"" + *inserted.first + "\" and \"" + narrow + "\" have the same id");
+	}
+	return id;
+}
+
+//The name of an id, or its hash in hex
+std::string ResourceNames::Name(ResourceId id) const
+{
+	if (const std::string* name = m_Names.Find(id))  return *name;
+
+	static const char kHexDigits[] = "0123456789abcdef";
+	std::string hex = "#";
+	for (int shift = 60; shift >= 0; shift -= 4)  hex += kHexDigits[(id.Hash >> shift) & 0xf];
+	return hex;
+}
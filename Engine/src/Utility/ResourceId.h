@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------
+// Resource ids - 64-bit hashes of resource names
+//--------------------------------------------------------------------------------------
+// Resources are looked up by a 64-bit FNV-1a hash of their name, so two names that are spelt
+// the same find the same resource wherever the strings came from, and looking one up costs a
+// hash rather than string compares. The hash is constexpr, so an id for a fixed name can be
+// worked out at compile time (constexpr ResourceId kGround = L"Ground"). Names are hashed by
+// character code, so a name gives the same id as a narrow or wide string as long as it is
+// ASCII. ResourceNames keeps the name behind each id for error messages and catches two
+// names that hash to the same id.
+
+#pragma once
+#include "epch.h"
+#include "FlatHashMap.h"
+#include <string_view>
+
+//64-bit FNV-1a of the character codes of a name
+template <class Char>
+constexpr uint64_t HashResourceName(std::basic_string_view<Char> name)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (Char c : name)
+	{
+		//Characters are unsigned so UTF-8 bytes past 127 don't sign extend
+		hash ^= static_cast<uint64_t>(static_cast<std::make_unsigned_t<Char>>(c));
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+struct ResourceId
+{
+	uint64_t Hash = 0;
+
+	constexpr ResourceId() {}
+	constexpr explicit ResourceId(uint64_t hash) : Hash(hash) {}
+
+	//Ids from names, implicit so a name can be passed wherever an id is wanted
+	constexpr ResourceId(std::string_view name)  : Hash(HashResourceName(name)) {}
+	constexpr ResourceId(std::wstring_view name) : Hash(HashResourceName(name)) {}
+	constexpr ResourceId(const char* name)       : Hash(HashResourceName(std::string_view(name))) {}
+	constexpr ResourceId(const wchar_t* name)    : Hash(HashResourceName(std::wstring_view(name))) {}
+	ResourceId(const std::string& name)          : Hash(HashResourceName(std::string_view(name))) {}
+	ResourceId(const std::wstring& name)         : Hash(HashResourceName(std::wstring_view(name))) {}
+
+	constexpr bool operator==(const ResourceId& other) const { return Hash == other.Hash; }
+	constexpr bool operator!=(const ResourceId& other) const { return Hash != other.Hash; }
+};
+
+namespace std
+{
+	template <>
+	struct hash<ResourceId>
+	{
+		size_t operator()(const ResourceId& id) const { return static_cast<size_t>(id.Hash); }
+	};
+}
+
+
+//The names behind resource ids, for diagnostics
+class ResourceNames
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Record the name of an id, returns the id. Adding a name again is fine, adding a different name with the same id
+	//throws a std::runtime_error, as the two resources couldn't be told apart
+	ResourceId Add(std::string_view name);
+	ResourceId Add(std::wstring_view name);
+
+	//The name of an id, or its hash in hex if it has no name (e.g. an id made from a name that was never added)
+	std::string Name(ResourceId id) const;
+
+	size_t Size() const { return m_Names.Size(); }
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	FlatHashMap<ResourceId, std::string> m_Names;
+};
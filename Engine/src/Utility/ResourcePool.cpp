@@ -0,0 +1,172 @@
+#include "epch.h"
+#include "ResourcePool.h"
+
+//Add an entry, reusing a removed one if there is one
+ResourceHandle ResourcePool::Add()
+{
+	unsigned int index;
+	if (!m_FreeEntries.empty())
+	{
+		index = m_FreeEntries.back();
+		m_FreeEntries.pop_back();
+	}
+	else
+	{
+		index = static_cast<unsigned int>(m_Entries.size());
+		m_Entries.emplace_back();
+	}
+	return { index, m_Entries[index].Generation };
+}
+
+//Remove an entry, its handles are no longer valid
+void ResourcePool::Remove(ResourceHandle handle)
+{
+	Entry& entry = Get(handle);
+	if (entry.References != 0)  throw std::runtime_error("Removing a resource that is still referenced");
+
+	if (entry.Resident)  SetEvicted(handle);
+
+	//A new generation makes the old handles stale. Generation 0 is kept for default constructed handles
+	const unsigned int generation = entry.Generation + 1;
+	entry = Entry();
+	entry.Generation = generation != 0 ? generation : 1;
+	m_FreeEntries.push_back(handle.Index);
+}
+
+//False for handles to removed entries
+bool ResourcePool::IsValid(ResourceHandle handle) const
+{
+	return handle.Index < m_Entries.size() && m_Entries[handle.Index].Generation == handle.Generation;
+}
+
+//A referenced entry is never evicted
+void ResourcePool::AddReference(ResourceHandle handle)
+{
+	Entry& entry = Get(handle);
+	if (Evictable(entry))  Unlink(handle.Index);
+	++entry.References;
+}
+
+void ResourcePool::Release(ResourceHandle handle)
+{
+	Entry& entry = Get(handle);
+	if (entry.References == 0)  throw std::runtime_error("Releasing a resource that isn't referenced");
+
+	//Once nothing references it, it is the most recently used of the entries that can be evicted
+	--entry.References;
+	if (Evictable(entry))  LinkNewest(handle.Index);
+}
+
+//A pinned entry is never evicted
+void ResourcePool::SetPinned(ResourceHandle handle, bool pinned)
+{
+	Entry& entry = Get(handle);
+	if (entry.Pinned == pinned)  return;
+
+	if (Evictable(entry))  Unlink(handle.Index);
+	entry.Pinned = pinned;
+	if (Evictable(entry))  LinkNewest(handle.Index);
+}
+
+//Record that an entry has been loaded and how much memory it uses
+void ResourcePool::SetResident(ResourceHandle handle, ResourceMemory memory)
+{
+	Entry& entry = Get(handle);
+	if (entry.Resident)  SetEvicted(handle);
+
+	entry.Resident = true;
+	entry.Memory   = memory;
+	m_Used.CpuBytes += memory.CpuBytes;
+	m_Used.GpuBytes += memory.GpuBytes;
+	if (Evictable(entry))  LinkNewest(handle.Index);
+}
+
+//Record that an entry has been freed
+void ResourcePool::SetEvicted(ResourceHandle handle)
+{
+	Entry& entry = Get(handle);
+	if (!entry.Resident)  return;
+
+	if (Evictable(entry))  Unlink(handle.Index);
+	m_Used.CpuBytes -= entry.Memory.CpuBytes;
+	m_Used.GpuBytes -= entry.Memory.GpuBytes;
+	entry.Resident = false;
+	entry.Memory   = ResourceMemory();
+}
+
+ResourceMemory ResourcePool::Memory(ResourceHandle handle) const
+{
+	return Get(handle).Memory;
+}
+
+//Record that an entry has been used. Referenced entries aren't in the eviction order until they are released
+void ResourcePool::Touch(ResourceHandle handle)
+{
+	if (Evictable(Get(handle)) && m_Newest != handle.Index)
+	{
+		Unlink(handle.Index);
+		LinkNewest(handle.Index);
+	}
+}
+
+//Evict unreferenced entries, least recently used first, until the pool is within its budget
+int ResourcePool::Trim(const std::function<void(ResourceHandle)>& evict)
+{
+	int numberEvicted = 0;
+	unsigned int index = m_Oldest;
+	while (index != kNone && OverBudget())
+	{
+		Entry& entry = m_Entries[index];
+		const unsigned int newer = entry.Newer;
+
+		//Evicting an entry that only uses the memory that is within budget wouldn't help
+		const bool freesCpu = m_Used.CpuBytes > m_Budget.CpuBytes && entry.Memory.CpuBytes > 0;
+		const bool freesGpu = m_Used.GpuBytes > m_Budget.GpuBytes && entry.Memory.GpuBytes > 0;
+		if (freesCpu || freesGpu)
+		{
+			const ResourceHandle handle = { index, entry.Generation };
+			evict(handle);
+			SetEvicted(handle);
+			++numberEvicted;
+		}
+		index = newer;
+	}
+	return numberEvicted;
+}
+
+
+//The entry of a handle, throws if the handle is stale
+const ResourcePool::Entry& ResourcePool::Get(ResourceHandle handle) const
+{
+	if (!IsValid(handle))  throw std::runtime_error("Using a resource handle that is no longer valid");
+	return m_Entries[handle.Index];
+}
+
+ResourcePool::Entry& ResourcePool::Get(ResourceHandle handle)
+{
+	if (!IsValid(handle))  throw std::runtime_error("Using a resource handle that is no longer valid");
+	return m_Entries[handle.Index];
+}
+
+//Put an entry at the newest end of the eviction order
+void ResourcePool::LinkNewest(unsigned int index)
+{
+	Entry& entry = m_Entries[index];
+	entry.Older = m_Newest;
+	entry.Newer = kNone;
+	if (m_Newest != kNone)  m_Entries[m_Newest].Newer = index;
+	else                    m_Oldest = index;
+	m_Newest = index;
+}
+
+//Take an entry out of the eviction order
+void ResourcePool::Unlink(unsigned int index)
+{
+	Entry& entry = m_Entries[index];
+	if (entry.Older != kNone)  m_Entries[entry.Older].Newer = entry.Newer;
+	else                       m_Oldest = entry.Newer;
+	if (entry.Newer != kNone)  m_Entries[entry.Newer].Older = entry.Older;
+	else                       m_Newest = entry.Older;
+	entry.Older = kNone;
+	entry.Newer = kNone;
+}
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// ResourcePool class - reference counts, memory use and eviction order of resources
+//--------------------------------------------------------------------------------------
+// Keeps the bookkeeping for a set of resources without knowing what they are: each entry has a
+// generational handle, a reference count and the CPU and GPU bytes it uses while it is loaded.
+// Removing an entry bumps its generation, so old handles to the slot are caught rather than
+// finding whatever is stored there next. Loaded entries that nobody references are kept in
+// least recently used order, and Trim evicts them oldest first while the pool is over its
+// budget. The owner frees the resource itself and can load it again when it is next wanted.
+
+#pragma once
+#include "epch.h"
+#include <functional>
+#include <limits>
+
+//Bytes used by a resource, or by a whole pool
+struct ResourceMemory
+{
+	size_t CpuBytes = 0;
+	size_t GpuBytes = 0;
+};
+
+//An entry in a ResourcePool. A default constructed handle is never valid
+struct ResourceHandle
+{
+	unsigned int Index      = ~0u;
+	unsigned int Generation = 0;
+
+	bool operator==(const ResourceHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+};
+
+class ResourcePool
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Add an entry, not loaded and not referenced
+	ResourceHandle Add();
+
+	//Remove an entry, its handles are no longer valid. Will throw a std::runtime_error exception if it is referenced
+	void Remove(ResourceHandle handle);
+
+	//False for handles to removed entries. Every other function throws a std::runtime_error exception for them
+	bool IsValid(ResourceHandle handle) const;
+
+	//A referenced entry is never evicted. Each AddReference needs a Release
+	void AddReference(ResourceHandle handle);
+	void Release(ResourceHandle handle);
+	unsigned int References(ResourceHandle handle) const { return Get(handle).References; }
+
+	//A pinned entry is never evicted either, e.g. one its owner can't load again, but unlike a referenced one it can be
+	//removed while it is pinned
+	void SetPinned(ResourceHandle handle, bool pinned);
+	bool IsPinned(ResourceHandle handle) const { return Get(handle).Pinned; }
+
+	//Record that an entry has been loaded and how much memory it uses, or that it has been freed
+	void SetResident(ResourceHandle handle, ResourceMemory memory);
+	void SetEvicted(ResourceHandle handle);
+	bool IsResident(ResourceHandle handle) const { return Get(handle).Resident; }
+	ResourceMemory Memory(ResourceHandle handle) const;
+
+	//Record that an entry has been used, so it is evicted after everything used before it
+	void Touch(ResourceHandle handle);
+
+	//Most memory the loaded entries should use, unlimited to start with
+	void SetBudget(ResourceMemory budget) { m_Budget = budget; }
+	ResourceMemory Budget() const { return m_Budget; }
+
+	//Memory used by every loaded entry, referenced or not
+	ResourceMemory Used() const { return m_Used; }
+	bool OverBudget() const { return m_Used.CpuBytes > m_Budget.CpuBytes || m_Used.GpuBytes > m_Budget.GpuBytes; }
+
+	//Evict unreferenced, unpinned entries, least recently used first, until the pool is within its budget or nothing more can be
+	//evicted. Only entries using the kind of memory that is over budget are evicted. evict(handle) is called to free
+	//each one before it is marked as evicted, and mustn't add or remove entries. Returns how many were evicted
+	int Trim(const std::function<void(ResourceHandle)>& evict);
+
+	//Number of entries, loaded or not
+	size_t Size() const { return m_Entries.size() - m_FreeEntries.size(); }
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	struct Entry
+	{
+		unsigned int   Generation = 1;
+		unsigned int   References = 0;
+		bool           Resident   = false;
+		bool           Pinned     = false;
+		ResourceMemory Memory;
+
+		//Neighbours in the eviction order. Entries are only in it while they are resident, unreferenced and not pinned
+		unsigned int   Older = kNone;
+		unsigned int   Newer = kNone;
+	};
+
+	//The entry of a handle, throws if the handle is stale
+	const Entry& Get(ResourceHandle handle) const;
+	Entry&       Get(ResourceHandle handle);
+
+	//Whether an entry belongs in the eviction order
+	static bool Evictable(const Entry& entry) { return entry.Resident && entry.References == 0 && !entry.Pinned; }
+
+	//Put an entry at the newest end of the eviction order, or take it out
+	void LinkNewest(unsigned int index);
+	void Unlink(unsigned int index);
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	static const unsigned int kNone = ~0u;
+
+	std::vector<Entry>        m_Entries;
+	std::vector<unsigned int> m_FreeEntries; //Removed entries, reused by Add
+
+	//Ends of the eviction order, a list threaded through the entries so using or evicting one doesn't search
+	unsigned int m_Oldest = kNone;
+	unsigned int m_Newest = kNone;
+
+	ResourceMemory m_Used;
+	ResourceMemory m_Budget = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max() };
+};
@@ -0,0 +1,144 @@
+#include "epch.h"
+#include "ThreadPool.h"
+#include <atomic>
+
+namespace
+{
+	//State shared between the threads working on a single ParallelFor
+	struct ParallelForJob
+	{
+		int begin     = 0;
+		int end       = 0;
+		int grainSize = 1;
+		int numChunks = 0;
+		const std::function<void(int, int)>* function = nullptr;
+
+		std::atomic<int> nextChunk{ 0 };
+		std::atomic<int> finishedChunks{ 0 };
+
+		std::mutex finishedMutex;
+		std::condition_variable allFinished;
+		std::exception_ptr error;
+
+		//Claim and run chunks until there are none left
+		void RunChunks()
+		{
+			for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+			{
+				int chunkBegin = begin + chunk * grainSize;
+				int chunkEnd = std::min(chunkBegin + grainSize, end);
+				try
+				{
+					(*function)(chunkBegin, chunkEnd);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(finishedMutex);
+					if (!error)  error = std::current_exception();
+				}
+
+				if (++finishedChunks == numChunks)
+				{
+					std::lock_guard<std::mutex> lock(finishedMutex);
+					allFinished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+//Constructor to start the given number of worker threads
+ThreadPool::ThreadPool(unsigned int numWorkers)
+{
+	m_Workers.reserve(numWorkers);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		m_Workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+//Destructor, finishes any queued tasks then joins the worker threads
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_ShuttingDown = true;
+	}
+	m_TaskAvailable.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+//The pool shared across the engine, one worker per hardware thread other than the main thread
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+//Split [begin, end) into chunks of grainSize items and call function(chunkBegin, chunkEnd) for each chunk across the pool
+void ThreadPool::ParallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& function)
+{
+	if (end <= begin)  return;
+	grainSize = std::max(grainSize, 1);
+
+	auto job = std::make_shared<ParallelForJob>();
+	job->begin = begin;
+	job->end = end;
+	job->grainSize = grainSize;
+	job->numChunks = (end - begin + grainSize - 1) / grainSize;
+	job->function = &function;
+
+	//Only wake as many workers as there are chunks for them to take, the calling thread takes one share itself
+	int helpers = std::min(job->numChunks - 1, static_cast<int>(m_Workers.size()));
+	for (int i = 0; i < helpers; ++i)
+	{
+		Enqueue([job]() { job->RunChunks(); });
+	}
+
+	//Work alongside the helpers, then wait for any chunks they are still running
+	job->RunChunks();
+	{
+		std::unique_lock<std::mutex> lock(job->finishedMutex);
+		job->allFinished.wait(lock, [&job]() { return job->finishedChunks == job->numChunks; });
+	}
+
+	if (job->error)  std::rethrow_exception(job->error);
+}
+
+//Add a task to the queue and wake a worker to run it
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	if (m_Workers.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_Tasks.push_back(std::move(task));
+	}
+	m_TaskAvailable.notify_one();
+}
+
+//Loop run by each worker thread
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_TaskMutex);
+			m_TaskAvailable.wait(lock, [this]() { return m_ShuttingDown || !m_Tasks.empty(); });
+			if (m_Tasks.empty())  return; // Only reached when shutting down
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+		task();
+	}
+}
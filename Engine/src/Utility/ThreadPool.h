@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// ThreadPool class - a fixed set of worker threads that run queued tasks
+//--------------------------------------------------------------------------------------
+// Use ThreadPool::Get() for the pool shared by the whole engine. ParallelFor splits a range
+// into chunks and the calling thread works on the chunks alongside the workers, so it is
+// safe to call ParallelFor from inside another task.
+
+#pragma once
+#include "epch.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <deque>
+
+class ThreadPool
+{
+//----------------------//
+// Construction / Usage	//
+//----------------------//
+public:
+	//Constructor to start the given number of worker threads. 0 workers means every task runs on the calling thread
+	explicit ThreadPool(unsigned int numWorkers);
+
+	//Destructor, finishes any queued tasks then joins the worker threads
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//The pool shared across the engine, one worker per hardware thread other than the main thread
+	static ThreadPool& Get();
+
+	//Number of threads that take part in a ParallelFor (the workers plus the calling thread)
+	unsigned int NumThreads() const { return static_cast<unsigned int>(m_Workers.size()) + 1; }
+
+	//Queue a task to be run on a worker thread. The future becomes ready once the task has run
+	template <class Function>
+	auto Submit(Function&& function) -> std::future<decltype(function())>
+	{
+		using ResultType = decltype(function());
+		auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Function>(function));
+		std::future<ResultType> result = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	//Split [begin, end) into chunks of grainSize items and call function(chunkBegin, chunkEnd) for each chunk
+	//across the pool. Returns once every chunk has finished. Chunks may run in any order on any thread.
+	void ParallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& function);
+
+//--------------------------//
+// Private helper functions	//
+//--------------------------//
+private:
+	//Add a task to the queue and wake a worker to run it
+	void Enqueue(std::function<void()> task);
+
+	//Loop run by each worker thread
+	void WorkerLoop();
+
+//-------------//
+// Member data //
+//-------------//
+private:
+	std::vector<std::thread> m_Workers;
+
+	std::deque<std::function<void()>> m_Tasks;
+	std::mutex m_TaskMutex;
+	std::condition_variable m_TaskAvailable;
+	bool m_ShuttingDown = false;
+};
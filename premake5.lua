@@ -31,3 +31,6 @@ group ""
 
 include "Engine"
 include "Editor"
+include "Benchmark"
+include "AssetPack"
+include "AssetCook"